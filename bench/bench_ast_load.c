@@ -0,0 +1,79 @@
+// Compares re-parsing a program against reloading its serialized AST.
+// Usage: bench_ast_load [tokens]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lexer.h"
+#include "parser.h"
+#include "ast.h"
+#include "ast_serialize.h"
+#include "bench_generator.h"
+#include "stats.h"
+
+// Visit every node straight out of the view without materializing anything
+static unsigned long walkView(const ASTView* view) {
+    size_t capacity = 1024, depth = 0;
+    ASTRef* stack = (ASTRef*)malloc(capacity * sizeof(ASTRef));
+    unsigned long visited = 0;
+
+    stack[depth++] = astViewRoot(view);
+    while (depth > 0) {
+        ASTRef ref = stack[--depth];
+        if (ref == AST_REF_NULL) continue;
+        visited++;
+        if (depth + 3 > capacity) {
+            capacity *= 2;
+            stack = (ASTRef*)realloc(stack, capacity * sizeof(ASTRef));
+        }
+        stack[depth++] = astViewNext(view, ref);
+        stack[depth++] = astViewChild(view, ref, 0);
+        stack[depth++] = astViewChild(view, ref, 1);
+    }
+    free(stack);
+    return visited;
+}
+
+int main(int argc, char* argv[]) {
+    size_t tokens = argc > 1 ? (size_t)strtoull(argv[1], NULL, 10) : 100000;
+    const char* path = "bench_ast_load.cpya";
+    GeneratorOptions options;
+    GeneratedProgram program;
+    defaultGeneratorOptions(&options);
+    generateProgram(&options, tokens, &program);
+    const char* source = program.source;
+
+    double t0 = wallClock();
+    initLexer(source);
+    ASTNode* ast = parse();
+    double parseTime = wallClock() - t0;
+
+    t0 = wallClock();
+    writeASTFile(ast, path, stderr);
+    double writeTime = wallClock() - t0;
+
+    ASTView view;
+    t0 = wallClock();
+    mapASTFile(path, &view, stderr);
+    unsigned long nodes = walkView(&view);
+    double viewTime = wallClock() - t0;
+
+    t0 = wallClock();
+    ASTNode* loaded = materializeAST(&view);
+    double materializeTime = wallClock() - t0;
+
+    fprintf(stderr, "tokens:               %zu (%zu source bytes, %u serialized bytes)\n",
+            program.tokens, program.length, (unsigned)view.mappingSize);
+    fprintf(stderr, "parse:                %10.3f ms\n", parseTime * 1e3);
+    fprintf(stderr, "serialize + write:    %10.3f ms\n", writeTime * 1e3);
+    fprintf(stderr, "map + walk (%lu nodes): %8.3f ms (%.1fx faster than parse)\n",
+            nodes, viewTime * 1e3, parseTime / viewTime);
+    fprintf(stderr, "materialize:          %10.3f ms (%.1fx faster than parse)\n",
+            materializeTime * 1e3, parseTime / materializeTime);
+
+    closeASTView(&view);
+    remove(path);
+    freeAST(loaded);
+    freeAST(ast);
+    freeGeneratedProgram(&program);
+    return 0;
+}
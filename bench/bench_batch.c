@@ -0,0 +1,155 @@
+// Throughput of many small compilations: one `my_compiler --file` process
+// per source, as a build system runs it, against a single `--batch`
+// process with io_uring and with the pread() fallback. Every flow must
+// produce the same objects.
+//
+// Usage: bench_batch [--compiler <path>] [--files N] [--tokens N] [--jobs N]
+#include <fcntl.h>
+#include <limits.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "bench_generator.h"
+#include "stats.h"
+
+extern char** environ;
+
+static const char* directory = "bench_batch_files";
+
+static pid_t spawn(char* const argv[]) {
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, 1, "/dev/null", O_WRONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, 2, "/dev/null", O_WRONLY, 0);
+    pid_t pid;
+    int rc = posix_spawn(&pid, argv[0], &actions, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    return rc == 0 ? pid : -1;
+}
+
+static bool succeeded(pid_t pid) {
+    int status;
+    return pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// Up to `jobs` compiler processes at a time, one per file
+static bool compileEach(const char* compiler, int files, int jobs) {
+    pid_t* running = (pid_t*)calloc((size_t)jobs, sizeof(pid_t));
+    bool ok = true;
+    char source[PATH_MAX], object[PATH_MAX];
+    for (int i = 0; i < files; i++) {
+        int slot = i % jobs;
+        if (running[slot]) ok = succeeded(running[slot]) && ok;
+        snprintf(source, sizeof(source), "%s/src/f%d.cpy", directory, i);
+        snprintf(object, sizeof(object), "%s/process/f%d.o", directory, i);
+        char* args[] = {(char*)compiler, "--file", source, "--emit-obj", object, NULL};
+        running[slot] = spawn(args);
+    }
+    for (int slot = 0; slot < jobs; slot++) {
+        if (running[slot]) ok = succeeded(running[slot]) && ok;
+    }
+    free(running);
+    return ok;
+}
+
+static bool compileBatch(const char* compiler, const char* output, const char* jobs, bool ring) {
+    char list[PATH_MAX], build[PATH_MAX];
+    snprintf(list, sizeof(list), "%s/files.txt", directory);
+    snprintf(build, sizeof(build), "%s/%s", directory, output);
+    char* args[] = {(char*)compiler, "--batch", list, "--build-dir", build, "--jobs", (char*)jobs,
+                    ring ? NULL : "--no-io-uring", NULL};
+    return succeeded(spawn(args));
+}
+
+static bool sameFile(const char* a, const char* b) {
+    FILE* left = fopen(a, "rb");
+    FILE* right = fopen(b, "rb");
+    bool same = left && right;
+    while (same) {
+        int x = fgetc(left), y = fgetc(right);
+        same = x == y;
+        if (x == EOF) break;
+    }
+    if (left) fclose(left);
+    if (right) fclose(right);
+    return same;
+}
+
+static void report(const char* name, int files, double seconds) {
+    printf("%-28s %9.3f s %9.0f files/s\n", name, seconds, files / seconds);
+}
+
+int main(int argc, char* argv[]) {
+    const char* compiler = "./my_compiler";
+    int files = 500;
+    size_t tokens = 1000;
+    int jobs = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--compiler") == 0 && i + 1 < argc) {
+            compiler = argv[++i];
+        } else if (strcmp(argv[i], "--files") == 0 && i + 1 < argc) {
+            files = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--tokens") == 0 && i + 1 < argc) {
+            tokens = (size_t)strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            jobs = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--compiler <path>] [--files N] [--tokens N] [--jobs N]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (files < 1) files = 1;
+    if (jobs < 1) jobs = 1;
+
+    char command[512];
+    snprintf(command, sizeof(command), "rm -rf %s && mkdir -p %s/src %s/process", directory, directory, directory);
+    if (system(command) != 0) return 1;
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/files.txt", directory);
+    FILE* list = fopen(path, "w");
+    size_t bytes = 0;
+    for (int i = 0; i < files; i++) {
+        GeneratorOptions options;
+        GeneratedProgram program;
+        defaultGeneratorOptions(&options);
+        options.seed = (unsigned)i + 1;
+        generateProgram(&options, tokens, &program);
+        snprintf(path, sizeof(path), "%s/src/f%d.cpy", directory, i);
+        FILE* file = fopen(path, "wb");
+        fwrite(program.source, 1, program.length, file);
+        fclose(file);
+        fprintf(list, "%s\n", path);
+        bytes += program.length;
+        freeGeneratedProgram(&program);
+    }
+    fclose(list);
+    printf("input: %d files of %zu tokens, %zu bytes in all; %d jobs\n", files, tokens, bytes, jobs);
+
+    char jobText[16];
+    snprintf(jobText, sizeof(jobText), "%d", jobs);
+    double start = wallClock();
+    bool ok = compileEach(compiler, files, jobs);
+    report("process per file", files, wallClock() - start);
+    start = wallClock();
+    ok = compileBatch(compiler, "ring", jobText, true) && ok;
+    report("batch (io_uring if allowed)", files, wallClock() - start);
+    start = wallClock();
+    ok = compileBatch(compiler, "pread", jobText, false) && ok;
+    report("batch (pread)", files, wallClock() - start);
+
+    for (int i = 0; ok && i < files; i++) {
+        char process[PATH_MAX], ring[PATH_MAX], pread[PATH_MAX];
+        snprintf(process, sizeof(process), "%s/process/f%d.o", directory, i);
+        snprintf(ring, sizeof(ring), "%s/ring/f%d.o", directory, i);
+        snprintf(pread, sizeof(pread), "%s/pread/f%d.o", directory, i);
+        ok = sameFile(process, ring) && sameFile(process, pread);
+    }
+    if (!ok) fprintf(stderr, "Error: The flows failed or wrote different objects.\n");
+
+    snprintf(command, sizeof(command), "rm -rf %s", directory);
+    system(command);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,156 @@
+// Native code emission: writing the ELF object directly versus writing GNU
+// as source and running the system assembler on it, as a compiler driver
+// that shells out to `as` would.
+//
+// Usage: bench_codegen [--sizes N,N,...] [--assembler <path>] [--seed N]
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "bench_generator.h"
+#include "lexer.h"
+#include "parser.h"
+#include "ast.h"
+#include "codegen.h"
+#include "elf_writer.h"
+#include "stats.h"
+
+extern char** environ;
+
+#define MAX_SIZES 16
+#define MIN_SAMPLE_SECONDS 0.5
+
+static const char* objectPath = "bench_codegen_direct.o";
+static const char* assemblyPath = "bench_codegen.s";
+static const char* assembledPath = "bench_codegen_as.o";
+
+typedef struct {
+    double generate;        // Code generation, including the listing if any
+    double finish;          // Writing the object, or running `as`
+    long objectBytes;
+} Sample;
+
+static long fileSize(const char* path) {
+    struct stat info;
+    return stat(path, &info) == 0 ? (long)info.st_size : -1;
+}
+
+static bool runAssembler(const char* assembler) {
+    char* argv[] = {(char*)assembler, "-o", (char*)assembledPath, (char*)assemblyPath, NULL};
+    pid_t pid;
+    if (posix_spawnp(&pid, assembler, NULL, NULL, argv, environ) != 0) return false;
+    int status;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static bool measureDirect(ASTNode* ast, Sample* sample) {
+    ObjectFile object;
+    initObjectFile(&object);
+    double start = wallClock();
+    bool ok = generateCode(ast, NULL, &object, NULL, stderr);
+    double generated = wallClock();
+    ok = ok && writeELFFile(&object, objectPath);
+    sample->generate = generated - start;
+    sample->finish = wallClock() - generated;
+    sample->objectBytes = fileSize(objectPath);
+    freeObjectFile(&object);
+    return ok;
+}
+
+static bool measureAssembler(ASTNode* ast, const char* assembler, Sample* sample) {
+    ObjectFile object;
+    initObjectFile(&object);
+    double start = wallClock();
+    FILE* listing = fopen(assemblyPath, "w");
+    bool ok = listing && generateCode(ast, NULL, &object, listing, stderr);
+    if (listing) ok = fclose(listing) == 0 && ok;
+    double generated = wallClock();
+    ok = ok && runAssembler(assembler);
+    sample->generate = generated - start;
+    sample->finish = wallClock() - generated;
+    sample->objectBytes = fileSize(assembledPath);
+    freeObjectFile(&object);
+    return ok;
+}
+
+static void keepBest(Sample* best, const Sample* sample, bool first) {
+    if (first || sample->generate + sample->finish < best->generate + best->finish) *best = *sample;
+}
+
+static int parseSizes(const char* list, size_t sizes[MAX_SIZES]) {
+    int count = 0;
+    char* copy = (char*)malloc(strlen(list) + 1);
+    strcpy(copy, list);
+    for (char* item = strtok(copy, ","); item && count < MAX_SIZES; item = strtok(NULL, ",")) {
+        sizes[count++] = (size_t)strtoull(item, NULL, 10);
+    }
+    free(copy);
+    return count;
+}
+
+int main(int argc, char* argv[]) {
+    size_t sizes[MAX_SIZES] = {1000, 10000, 100000, 1000000};
+    int sizeCount = 4;
+    const char* assembler = "as";
+    GeneratorOptions options;
+    defaultGeneratorOptions(&options);
+    options.calls = true;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--sizes") == 0 && i + 1 < argc) {
+            sizeCount = parseSizes(argv[++i], sizes);
+        } else if (strcmp(argv[i], "--assembler") == 0 && i + 1 < argc) {
+            assembler = argv[++i];
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            options.seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else {
+            fprintf(stderr, "Usage: %s [--sizes N,N,...] [--assembler <path>] [--seed N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    printf("%-10s %10s %-14s %12s %12s %12s %10s %9s\n",
+           "tokens", "functions", "path", "codegen (ms)", "finish (ms)", "total (ms)", "object", "speedup");
+    for (int s = 0; s < sizeCount; s++) {
+        GeneratedProgram program;
+        generateProgram(&options, sizes[s], &program);
+        initLexer(program.source);
+        ASTNode* ast = parse();
+
+        Sample direct, assembled, sample;
+        bool ok = true;
+        double started = wallClock();
+        for (int run = 0; ok && (run < 3 || wallClock() - started < MIN_SAMPLE_SECONDS); run++) {
+            ok = measureDirect(ast, &sample);
+            keepBest(&direct, &sample, run == 0);
+        }
+        started = wallClock();
+        for (int run = 0; ok && (run < 3 || wallClock() - started < MIN_SAMPLE_SECONDS); run++) {
+            ok = measureAssembler(ast, assembler, &sample);
+            keepBest(&assembled, &sample, run == 0);
+        }
+        freeAST(ast);
+        if (!ok) {
+            fprintf(stderr, "Code generation or '%s' failed at %zu tokens.\n", assembler, program.tokens);
+            freeGeneratedProgram(&program);
+            return 1;
+        }
+
+        double directTotal = direct.generate + direct.finish;
+        double assembledTotal = assembled.generate + assembled.finish;
+        printf("%-10zu %10zu %-14s %12.3f %12.3f %12.3f %10ld %9s\n", program.tokens, program.functions,
+               "direct ELF", direct.generate * 1e3, direct.finish * 1e3, directTotal * 1e3, direct.objectBytes, "");
+        printf("%-10s %10s %-14s %12.3f %12.3f %12.3f %10ld %8.1fx\n", "", "", "text + as",
+               assembled.generate * 1e3, assembled.finish * 1e3, assembledTotal * 1e3, assembled.objectBytes,
+               assembledTotal / directTotal);
+        freeGeneratedProgram(&program);
+    }
+
+    remove(objectPath);
+    remove(assemblyPath);
+    remove(assembledPath);
+    return 0;
+}
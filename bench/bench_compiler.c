@@ -0,0 +1,197 @@
+// Front-end throughput benchmark over generated programs of growing size.
+//
+// Usage: bench_compiler [--sizes N,N,...] [--full] [--locals N] [--operands N]
+//                       [--depth N] [--string-length N] [--seed N] [--json]
+//
+// For every size the lexer, parser and semantic analysis are timed (best of
+// several runs for small inputs), and the scaling column reports the local
+// exponent k of time ~ tokens^k against the previous size (1.00 = linear).
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench_generator.h"
+#include "lexer.h"
+#include "parser.h"
+#include "ast.h"
+#include "semantic_analysis.h"
+#include "stats.h"
+
+#define MAX_SIZES 16
+#define MIN_SAMPLE_SECONDS 0.2
+
+typedef enum {
+    BENCH_LEX,
+    BENCH_PARSE,
+    BENCH_SEMANTIC,
+    BENCH_LEX_STRINGS,
+    BENCH_KIND_COUNT
+} BenchKind;
+
+static const char* const benchNames[BENCH_KIND_COUNT] = {
+    [BENCH_LEX] = "lex",
+    [BENCH_PARSE] = "parse",
+    [BENCH_SEMANTIC] = "semantic",
+    [BENCH_LEX_STRINGS] = "lex-strings",
+};
+
+typedef struct {
+    size_t tokens;
+    size_t bytes;
+    unsigned long long nodes;
+    double seconds;
+} BenchResult;
+
+static void silentError(const char* format, va_list args) {
+    (void)format;
+    (void)args;
+}
+
+static unsigned long long lexAll(const char* source) {
+    unsigned long long tokens = 0;
+    initLexer(source);
+    for (Token token = scanToken(); token.type != TOKEN_EOF && token.type != TOKEN_ERROR; token = scanToken()) {
+        tokens++;
+    }
+    return tokens;
+}
+
+// Run one measurement, repeating small inputs and keeping the fastest run
+static BenchResult measure(BenchKind kind, const GeneratedProgram* program) {
+    BenchResult result = {program->tokens, program->length, 0, 0};
+    double best = -1;
+    double started = wallClock();
+
+    do {
+        double elapsed;
+        if (kind == BENCH_LEX || kind == BENCH_LEX_STRINGS) {
+            double start = wallClock();
+            lexAll(program->source);
+            elapsed = wallClock() - start;
+        } else {
+            unsigned long long nodes = compilerStats.allocs[MEM_AST].count;
+            double start = wallClock();
+            initLexer(program->source);
+            ASTNode* ast = parse();
+            elapsed = wallClock() - start;
+            result.nodes = compilerStats.allocs[MEM_AST].count - nodes;
+
+            if (kind == BENCH_SEMANTIC) {
+                start = wallClock();
+                analyzeProgram(ast);
+                elapsed = wallClock() - start;
+            }
+            freeAST(ast);
+        }
+        if (best < 0 || elapsed < best) best = elapsed;
+    } while (wallClock() - started < MIN_SAMPLE_SECONDS && program->tokens < 1000000);
+
+    result.seconds = best;
+    return result;
+}
+
+static int parseSizes(const char* list, size_t sizes[MAX_SIZES]) {
+    int count = 0;
+    char* copy = (char*)malloc(strlen(list) + 1);
+    strcpy(copy, list);
+    for (char* item = strtok(copy, ","); item && count < MAX_SIZES; item = strtok(NULL, ",")) {
+        sizes[count++] = (size_t)strtoull(item, NULL, 10);
+    }
+    free(copy);
+    return count;
+}
+
+int main(int argc, char* argv[]) {
+    size_t sizes[MAX_SIZES] = {1000, 10000, 100000, 1000000};
+    int sizeCount = 4;
+    bool json = false;
+    GeneratorOptions options;
+    defaultGeneratorOptions(&options);
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--sizes") == 0 && i + 1 < argc) {
+            sizeCount = parseSizes(argv[++i], sizes);
+        } else if (strcmp(argv[i], "--full") == 0 && sizeCount < MAX_SIZES) {
+            sizes[sizeCount++] = 10000000;
+        } else if (strcmp(argv[i], "--locals") == 0 && i + 1 < argc) {
+            options.localsPerScope = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--operands") == 0 && i + 1 < argc) {
+            options.exprOperands = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc) {
+            options.exprDepth = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--string-length") == 0 && i + 1 < argc) {
+            options.stringLength = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            options.seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--json") == 0) {
+            json = true;
+        } else {
+            fprintf(stderr, "Usage: %s [--sizes N,N,...] [--full] [--locals N] [--operands N] "
+                            "[--depth N] [--string-length N] [--seed N] [--json]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (options.localsPerScope < 1) options.localsPerScope = 1;
+    if (options.exprOperands < 1) options.exprOperands = 1;
+    if (options.exprDepth < 0) options.exprDepth = 0;
+
+    // Semantic errors are not expected, but must not flood the output
+    setErrorFunction(silentError);
+
+    BenchResult previous[BENCH_KIND_COUNT];
+    memset(previous, 0, sizeof(previous));
+
+    if (json) {
+        printf("{\n  \"locals_per_scope\": %d, \"expr_operands\": %d, \"expr_depth\": %d, "
+               "\"string_length\": %d, \"seed\": %u,\n  \"results\": [",
+               options.localsPerScope, options.exprOperands, options.exprDepth, options.stringLength, options.seed);
+    } else {
+        printf("%-12s %10s %12s %10s %10s %9s %12s %8s\n",
+               "benchmark", "tokens", "bytes", "time (ms)", "Mtok/s", "MB/s", "nodes/s", "scaling");
+    }
+
+    bool first = true;
+    for (int s = 0; s < sizeCount; s++) {
+        GeneratedProgram programs[2];
+        GeneratorOptions stringOptions = options;
+        stringOptions.strings = true;
+        generateProgram(&options, sizes[s], &programs[0]);
+        generateProgram(&stringOptions, sizes[s], &programs[1]);
+
+        for (int k = 0; k < BENCH_KIND_COUNT; k++) {
+            const GeneratedProgram* program = &programs[k == BENCH_LEX_STRINGS ? 1 : 0];
+            BenchResult result = measure((BenchKind)k, program);
+            double scaling = 0;
+            if (previous[k].seconds > 0 && result.seconds > 0 && result.tokens != previous[k].tokens) {
+                scaling = log(result.seconds / previous[k].seconds) / log((double)result.tokens / previous[k].tokens);
+            }
+            double mtok = result.tokens / result.seconds / 1e6;
+            double mb = result.bytes / result.seconds / 1e6;
+            double nodesPerSec = result.nodes / result.seconds;
+
+            if (json) {
+                printf("%s\n    {\"benchmark\": \"%s\", \"tokens\": %zu, \"bytes\": %zu, \"nodes\": %llu, "
+                       "\"ms\": %.3f, \"mtok_per_sec\": %.3f, \"mb_per_sec\": %.3f, \"scaling\": %.3f}",
+                       first ? "" : ",", benchNames[k], result.tokens, result.bytes, result.nodes,
+                       result.seconds * 1e3, mtok, mb, scaling);
+            } else {
+                printf("%-12s %10zu %12zu %10.3f %10.2f %9.1f %12.0f ", benchNames[k], result.tokens,
+                       result.bytes, result.seconds * 1e3, mtok, mb, nodesPerSec);
+                if (scaling > 0) {
+                    printf("%8.2f\n", scaling);
+                } else {
+                    printf("%8s\n", "-");
+                }
+            }
+            fflush(stdout);
+            first = false;
+            previous[k] = result;
+        }
+
+        freeGeneratedProgram(&programs[0]);
+        freeGeneratedProgram(&programs[1]);
+    }
+
+    if (json) printf("\n  ]\n}\n");
+    return 0;
+}
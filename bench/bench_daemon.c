@@ -0,0 +1,196 @@
+// Latency of cold `my_compiler --file` invocations versus requests served by
+// a warm `my_compiler --daemon`. Rows marked "cache hit" resend an unchanged
+// file and are answered from the daemon's result cache; "edited" rows change
+// a literal before every request, as a small edit in an editor does, so
+// each is compiled. Daemon rows are compared against the cold process
+// doing the same work.
+//
+// Usage: bench_daemon [--compiler <path>] [--tokens N] [--runs N] [--clients N]
+#include <fcntl.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <threads.h>
+#include <unistd.h>
+#include "bench_generator.h"
+#include "server.h"
+#include "stats.h"
+
+extern char** environ;
+
+static const char* socketPath = "bench_daemon.sock";
+
+static int compareDoubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Returns the mean; with a `baseline` mean the speedup over it is shown
+static double report(const char* name, double* samples, int count, double baseline) {
+    double total = 0;
+    for (int i = 0; i < count; i++) total += samples[i];
+    qsort(samples, count, sizeof(double), compareDoubles);
+    double mean = total / count;
+    printf("%-36s mean %9.3f ms   p50 %9.3f ms   p95 %9.3f ms", name, mean * 1e3, samples[count / 2] * 1e3,
+           samples[(int)(count * 0.95)] * 1e3);
+    if (baseline > 0) printf("   %7.1fx", baseline / mean);
+    printf("\n");
+    return mean;
+}
+
+// The generated program, followed by a global whose value is `edit` when
+// that is not negative
+static void writeSource(const char* path, const GeneratedProgram* program, int edit) {
+    FILE* file = fopen(path, "wb");
+    fwrite(program->source, 1, program->length, file);
+    if (edit >= 0) fprintf(file, "\nint benchEdit = %d;\n", edit);
+    fclose(file);
+}
+
+static pid_t spawn(char* const argv[], bool quiet) {
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    if (quiet) {
+        posix_spawn_file_actions_addopen(&actions, 1, "/dev/null", O_WRONLY, 0);
+        posix_spawn_file_actions_addopen(&actions, 2, "/dev/null", O_WRONLY, 0);
+    }
+    pid_t pid;
+    int rc = posix_spawn(&pid, argv[0], &actions, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    return rc == 0 ? pid : -1;
+}
+
+static double runProcess(char* const argv[]) {
+    double start = wallClock();
+    pid_t pid = spawn(argv, true);
+    int status;
+    if (pid > 0) waitpid(pid, &status, 0);
+    return wallClock() - start;
+}
+
+typedef struct {
+    const char* path;
+    int requests;
+    double* samples;
+    const GeneratedProgram* edit;       // Rewrite the source before each request; NULL to resend it
+    int firstEdit;                      // Edits are distinct across clients, or one would hit the other's result
+    const char* const* options;
+} ClientThread;
+
+static int clientMain(void* arg) {
+    ClientThread* client = (ClientThread*)arg;
+    for (int i = 0; i < client->requests; i++) {
+        if (client->edit) writeSource(client->path, client->edit, client->firstEdit + i);
+        DaemonResponse response;
+        double start = wallClock();
+        daemonRequest(socketPath, REQUEST_COMPILE, 0, client->path, client->options, &response);
+        client->samples[i] = wallClock() - start;
+        freeDaemonResponse(&response);
+    }
+    return 0;
+}
+
+static double requestRow(const char* name, const char* path, int runs, double* samples,
+                         const GeneratedProgram* edit, const char* const* options, double baseline) {
+    ClientThread client = {path, runs, samples, edit, 0, options};
+    clientMain(&client);
+    return report(name, samples, runs, baseline);
+}
+
+int main(int argc, char* argv[]) {
+    const char* compiler = "./my_compiler";
+    size_t tokens = 2000;
+    int runs = 50;
+    int clients = 4;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--compiler") == 0 && i + 1 < argc) {
+            compiler = argv[++i];
+        } else if (strcmp(argv[i], "--tokens") == 0 && i + 1 < argc) {
+            tokens = (size_t)strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+            runs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--clients") == 0 && i + 1 < argc) {
+            clients = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--compiler <path>] [--tokens N] [--runs N] [--clients N]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (runs < 1) runs = 1;
+    if (clients < 1) clients = 1;
+
+    // Source file for every compilation
+    char directory[4096], path[4200], object[4200];
+    GeneratorOptions options;
+    GeneratedProgram program;
+    defaultGeneratorOptions(&options);
+    generateProgram(&options, tokens, &program);
+    if (!getcwd(directory, sizeof(directory))) return 1;
+    snprintf(path, sizeof(path), "%s/bench_daemon_input.cpy", directory);
+    snprintf(object, sizeof(object), "%s/bench_daemon_input.o", directory);
+    writeSource(path, &program, -1);
+
+    char* daemonArgs[] = {(char*)compiler, "--daemon", "--socket", (char*)socketPath, NULL};
+    pid_t daemon = spawn(daemonArgs, true);
+    DaemonResponse response;
+    for (int attempt = 0; attempt < 500 && !daemonRequest(socketPath, REQUEST_PING, 0, "", NULL, &response); attempt++) {
+        usleep(10000);
+    }
+    freeDaemonResponse(&response);
+
+    printf("input: %zu tokens, %zu bytes; %d runs\n", program.tokens, program.length, runs);
+    double* samples = (double*)malloc(sizeof(double) * (size_t)runs * (size_t)clients);
+    const char* objectOptions[REQUEST_OPTION_COUNT] = {NULL};
+    objectOptions[REQUEST_OPTION_EMIT_OBJECT] = object;
+
+    char* coldArgs[] = {(char*)compiler, "--file", path, NULL};
+    for (int i = 0; i < runs; i++) samples[i] = runProcess(coldArgs);
+    double cold = report("cold process", samples, runs, 0);
+    char* coldObjectArgs[] = {(char*)compiler, "--file", path, "--emit-obj", object, NULL};
+    for (int i = 0; i < runs; i++) samples[i] = runProcess(coldObjectArgs);
+    double coldObject = report("cold process --emit-obj", samples, runs, 0);
+
+    char* clientArgs[] = {(char*)compiler, "--client", "--socket", (char*)socketPath, path, NULL};
+    for (int i = 0; i < runs; i++) samples[i] = runProcess(clientArgs);
+    report("thin client process (cache hit)", samples, runs, cold);
+
+    requestRow("in-process request (cache hit)", path, runs, samples, NULL, NULL, cold);
+    requestRow("in-process request, edited", path, runs, samples, &program, NULL, cold);
+    requestRow("in-process --emit-obj, edited", path, runs, samples, &program, objectOptions, coldObject);
+    requestRow("in-process --emit-obj (cache hit)", path, runs, samples, NULL, objectOptions, coldObject);
+
+    // Concurrent clients against the worker pool, each editing its own file
+    thrd_t* threads = (thrd_t*)malloc(sizeof(thrd_t) * clients);
+    ClientThread* work = (ClientThread*)malloc(sizeof(ClientThread) * clients);
+    char (*paths)[4200] = malloc(sizeof(*paths) * (size_t)clients);
+    double start = wallClock();
+    for (int i = 0; i < clients; i++) {
+        snprintf(paths[i], sizeof(paths[i]), "%s/bench_daemon_input%d.cpy", directory, i);
+        work[i] = (ClientThread){paths[i], runs, samples + (size_t)i * runs, &program, (i + 1) * runs, NULL};
+        thrd_create(&threads[i], clientMain, &work[i]);
+    }
+    for (int i = 0; i < clients; i++) thrd_join(threads[i], NULL);
+    double elapsed = wallClock() - start;
+    char name[64];
+    snprintf(name, sizeof(name), "%d concurrent clients, edited", clients);
+    report(name, samples, runs * clients, cold);
+    printf("%-36s %.0f requests/s\n", "", runs * clients / elapsed);
+
+    daemonRequest(socketPath, REQUEST_SHUTDOWN, 0, "", NULL, &response);
+    freeDaemonResponse(&response);
+    int status;
+    waitpid(daemon, &status, 0);
+
+    remove(path);
+    remove(object);
+    for (int i = 0; i < clients; i++) remove(paths[i]);
+    free(paths);
+    free(threads);
+    free(work);
+    free(samples);
+    freeGeneratedProgram(&program);
+    return 0;
+}
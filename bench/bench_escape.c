@@ -0,0 +1,162 @@
+// String allocation with and without escape analysis: compiles a
+// string-heavy program both ways, links each with the runtime and a driver
+// that calls every function repeatedly, and reports the runtime's
+// allocation counters and the run time.
+//
+// Usage: bench_escape [--functions N] [--iterations N] [--compiler <path>]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lexer.h"
+#include "parser.h"
+#include "ast.h"
+#include "codegen.h"
+#include "optimizer.h"
+#include "elf_writer.h"
+
+static const char* objectPath = "bench_escape.o";
+static const char* driverPath = "bench_escape_main.c";
+static const char* programPath = "bench_escape_program";
+
+// Each function builds a few temporaries it only measures or compares, a
+// local that feeds its result, and returns one new string. Every fourth
+// function also hands a string to another function, which makes it escape.
+static char* generateSource(int functions) {
+    char* source;
+    size_t size;
+    FILE* out = open_memstream(&source, &size);
+    for (int i = 0; i < functions; i++) {
+        fprintf(out, "str f%d(str a, str b) {\n", i);
+        fprintf(out, "    str t = a + \"<%d>\" + b;\n", i);
+        fprintf(out, "    int n = len(t + t) + len(a + b + a);\n");
+        if (i % 4 == 3) {
+            fprintf(out, "    str w = f%d(t, a);\n", i - 1);
+            fprintf(out, "    int m = len(w + b);\n");
+        }
+        fprintf(out, "    str u = t + \"-\" + b;\n");
+        fprintf(out, "    equals(u + \"\", t);\n");
+        fprintf(out, "    return u + \"!\";\n");
+        fprintf(out, "}\n");
+    }
+    fclose(out);
+    return source;
+}
+
+static bool writeDriver(int functions) {
+    FILE* out = fopen(driverPath, "w");
+    if (!out) return false;
+    fprintf(out, "#include <stdio.h>\n#include <stdlib.h>\n#include <time.h>\n#include \"cpy_runtime.h\"\n");
+    for (int i = 0; i < functions; i++) fprintf(out, "cpy_str f%d(cpy_str, cpy_str);\n", i);
+    fprintf(out, "static cpy_str (*const functions[])(cpy_str, cpy_str) = {\n");
+    for (int i = 0; i < functions; i++) fprintf(out, "    f%d,\n", i);
+    fprintf(out, "};\n"
+                 "int main(int argc, char** argv) {\n"
+                 "    long iterations = atol(argv[1]);\n"
+                 "    cpy_str a = cpy_str_new(\"alpha\", 5), b = cpy_str_new(\"beta\", 4);\n"
+                 "    cpy_reset_alloc_stats();\n"
+                 "    struct timespec start, end;\n"
+                 "    clock_gettime(CLOCK_MONOTONIC, &start);\n"
+                 "    for (long n = 0; n < iterations; n++) {\n"
+                 "        for (size_t i = 0; i < sizeof(functions) / sizeof(functions[0]); i++) {\n"
+                 "            cpy_str s = functions[i](a, b);\n"
+                 "            if (cpy_str_header(s)->flags & CPY_STR_HEAP) free((CpyStrHeader*)s - 1);\n"
+                 "        }\n"
+                 "    }\n"
+                 "    clock_gettime(CLOCK_MONOTONIC, &end);\n"
+                 "    const CpyAllocStats* stats = cpy_alloc_stats();\n"
+                 "    printf(\"%%llu %%llu %%llu %%llu %%llu %%.6f\\n\",\n"
+                 "           (unsigned long long)stats->heapAllocations, (unsigned long long)stats->heapBytes,\n"
+                 "           (unsigned long long)stats->regionAllocations, (unsigned long long)stats->regionBytes,\n"
+                 "           (unsigned long long)stats->regionChunks,\n"
+                 "           (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9);\n"
+                 "    return 0;\n"
+                 "}\n");
+    return fclose(out) == 0;
+}
+
+typedef struct {
+    unsigned long long heapAllocations;
+    unsigned long long heapBytes;
+    unsigned long long regionAllocations;
+    unsigned long long regionBytes;
+    unsigned long long regionChunks;
+    double seconds;
+} Result;
+
+static bool measure(const char* source, bool heapStrings, const char* compiler, long iterations, Result* result) {
+    initLexer(source);
+    ASTNode* ast = parse();
+    foldStringConstants(ast);
+    CodegenOptions options = {0};
+    options.heapStrings = heapStrings;
+    ObjectFile object;
+    initObjectFile(&object);
+    bool ok = generateCode(ast, &options, &object, NULL, stderr) && writeELFFile(&object, objectPath);
+    freeObjectFile(&object);
+    freeAST(ast);
+    if (!ok) return false;
+
+    char command[1024];
+    snprintf(command, sizeof(command), "%s -O2 -I %s -o %s %s %s %s", compiler, CPY_RUNTIME_INCLUDE, programPath,
+             driverPath, objectPath, CPY_RUNTIME_LIBRARY);
+    if (system(command) != 0) return false;
+
+    snprintf(command, sizeof(command), "./%s %ld", programPath, iterations);
+    FILE* output = popen(command, "r");
+    if (!output) return false;
+    int fields = fscanf(output, "%llu %llu %llu %llu %llu %lf", &result->heapAllocations, &result->heapBytes,
+                        &result->regionAllocations, &result->regionBytes, &result->regionChunks, &result->seconds);
+    return pclose(output) == 0 && fields == 6;
+}
+
+static void printResult(const char* name, const Result* result, double calls) {
+    printf("%-18s %12llu %12llu %12llu %10llu %12.2f %10.3f %10.1f\n", name, result->heapAllocations,
+           result->heapBytes, result->regionAllocations, result->regionChunks, result->heapAllocations / calls,
+           result->seconds * 1e3, result->seconds / calls * 1e9);
+}
+
+int main(int argc, char* argv[]) {
+    int functions = 64;
+    long iterations = 20000;
+    const char* compiler = "cc";
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--functions") == 0 && i + 1 < argc) {
+            functions = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--compiler") == 0 && i + 1 < argc) {
+            compiler = argv[++i];
+        } else {
+            fprintf(stderr, "Usage: %s [--functions N] [--iterations N] [--compiler <path>]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (functions < 1 || iterations < 1) {
+        fprintf(stderr, "--functions and --iterations must be positive.\n");
+        return 1;
+    }
+
+    char* source = generateSource(functions);
+    Result heap, escape;
+    bool ok = writeDriver(functions) && measure(source, true, compiler, iterations, &heap) &&
+              measure(source, false, compiler, iterations, &escape);
+    free(source);
+    remove(objectPath);
+    remove(driverPath);
+    remove(programPath);
+    if (!ok) {
+        fprintf(stderr, "Compiling, linking or running the program failed.\n");
+        return 1;
+    }
+
+    double calls = (double)functions * (double)iterations;
+    printf("%d functions x %ld iterations\n", functions, iterations);
+    printf("%-18s %12s %12s %12s %10s %12s %10s %10s\n", "", "heap allocs", "heap bytes", "region allocs",
+           "chunks", "heap / call", "time (ms)", "ns / call");
+    printResult("heap only", &heap, calls);
+    printResult("escape analysis", &escape, calls);
+    printf("Heap allocations removed: %.1f%%, time %.2fx\n",
+           100.0 * (1.0 - (double)escape.heapAllocations / (double)heap.heapAllocations),
+           heap.seconds / escape.seconds);
+    return 0;
+}
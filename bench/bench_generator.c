@@ -0,0 +1,203 @@
+#include "bench_generator.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+    size_t tokens;
+    unsigned int rng;
+    long lastFunction;      // Index of the latest complete function, or -1
+} Emitter;
+
+static unsigned int nextRandom(Emitter* e) {
+    // xorshift32; deterministic across platforms unlike rand()
+    e->rng ^= e->rng << 13;
+    e->rng ^= e->rng >> 17;
+    e->rng ^= e->rng << 5;
+    return e->rng;
+}
+
+static void reserve(Emitter* e, size_t extra) {
+    if (e->length + extra + 1 <= e->capacity) return;
+    size_t capacity = e->capacity ? e->capacity : 1 << 16;
+    while (capacity < e->length + extra + 1) capacity *= 2;
+    e->data = (char*)realloc(e->data, capacity);
+    e->capacity = capacity;
+}
+
+static void raw(Emitter* e, const char* text) {
+    size_t n = strlen(text);
+    reserve(e, n);
+    memcpy(e->data + e->length, text, n + 1);
+    e->length += n;
+}
+
+// Append one token followed by a separator
+static void token(Emitter* e, const char* text) {
+    raw(e, text);
+    raw(e, " ");
+    e->tokens++;
+}
+
+static void tokenf(Emitter* e, const char* format, long a, long b) {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), format, a, b);
+    token(e, buffer);
+}
+
+static const char* const operators[] = {"+", "-", "*", "/"};
+
+static void expression(Emitter* e, const GeneratorOptions* options, const char* prefix, long scope, int count,
+                       int depth);
+
+// Emit one operand: a call, a name, a literal or, below the depth limit, a
+// parenthesized sub-expression
+static void operand(Emitter* e, const GeneratorOptions* options, const char* prefix, long scope, int count,
+                    int depth) {
+    if (depth < options->exprDepth && nextRandom(e) % 4 == 0) {
+        token(e, "(");
+        expression(e, options, prefix, scope, count, depth + 1);
+        token(e, ")");
+    } else if (options->calls && e->lastFunction >= 0 && nextRandom(e) % 4 == 0) {
+        // fK(<literal>, <literal>); every index that is a multiple of 4 is a function
+        tokenf(e, "f%ld", (long)(nextRandom(e) % (unsigned)(e->lastFunction / 4 + 1)) * 4, 0);
+        token(e, "(");
+        tokenf(e, "%ld", (long)(nextRandom(e) % 1000), 0);
+        token(e, ",");
+        tokenf(e, "%ld", (long)(nextRandom(e) % 1000), 0);
+        token(e, ")");
+    } else if (count > 0 && nextRandom(e) % 3 != 0) {
+        char name[32];
+        snprintf(name, sizeof(name), "%s%ld_%u", prefix, scope, nextRandom(e) % (unsigned)count);
+        token(e, name);
+    } else {
+        tokenf(e, "%ld", (long)(nextRandom(e) % 1000), 0);
+    }
+}
+
+// Emit an expression over `names` (prefix p, indices [0, count)) and
+// literals, nested `depth` parentheses deep; sub-expressions have at least
+// two operands
+static void expression(Emitter* e, const GeneratorOptions* options, const char* prefix, long scope, int count,
+                       int depth) {
+    int operands = (depth > 0 ? 2 : 1) + (int)(nextRandom(e) % (unsigned)options->exprOperands);
+    for (int i = 0; i < operands; i++) {
+        if (i > 0) token(e, operators[nextRandom(e) % 4]);
+        operand(e, options, prefix, scope, count, depth);
+    }
+}
+
+static void locals(Emitter* e, const GeneratorOptions* options, const char* prefix, long scope) {
+    for (int i = 0; i < options->localsPerScope; i++) {
+        token(e, "int");
+        char name[32];
+        snprintf(name, sizeof(name), "%s%ld_%d", prefix, scope, i);
+        token(e, name);
+        token(e, "=");
+        expression(e, options, prefix, scope, i, 0);
+        token(e, ";");
+    }
+}
+
+static void function(Emitter* e, const GeneratorOptions* options, long index) {
+    token(e, "int");
+    tokenf(e, "f%ld", index, 0);
+    token(e, "(");
+    token(e, "int");
+    tokenf(e, "l%ld_a", index, 0);
+    token(e, ",");
+    token(e, "int");
+    tokenf(e, "l%ld_b", index, 0);
+    token(e, ")");
+    token(e, "{");
+    raw(e, "\n");
+    locals(e, options, "l", index);
+    token(e, "return");
+    expression(e, options, "l", index, options->localsPerScope, 0);
+    token(e, ";");
+    token(e, "}");
+    raw(e, "\n");
+}
+
+static void block(Emitter* e, const GeneratorOptions* options, long index) {
+    token(e, "{");
+    raw(e, "\n");
+    locals(e, options, "b", index);
+    expression(e, options, "b", index, options->localsPerScope, 0);
+    token(e, ";");
+    token(e, "}");
+    raw(e, "\n");
+}
+
+static void stringDecl(Emitter* e, const GeneratorOptions* options, long index) {
+    token(e, "str");
+    tokenf(e, "s%ld", index, 0);
+    token(e, "=");
+    reserve(e, (size_t)options->stringLength + 3);
+    e->data[e->length++] = '"';
+    for (int i = 0; i < options->stringLength; i++) {
+        e->data[e->length++] = (char)('a' + nextRandom(e) % 26);
+    }
+    e->data[e->length++] = '"';
+    e->data[e->length] = '\0';
+    e->tokens++;
+    raw(e, " ");
+    token(e, ";");
+    raw(e, "\n");
+}
+
+void defaultGeneratorOptions(GeneratorOptions* options) {
+    options->seed = 12345;
+    options->localsPerScope = 16;
+    options->exprOperands = 8;
+    options->exprDepth = 2;
+    options->stringLength = 64;
+    options->strings = false;
+    options->calls = false;
+}
+
+void generateProgram(const GeneratorOptions* options, size_t targetTokens, GeneratedProgram* program) {
+    Emitter e;
+    memset(&e, 0, sizeof(Emitter));
+    e.rng = options->seed ? options->seed : 1;
+    e.lastFunction = -1;
+    reserve(&e, targetTokens * 4);
+
+    long index = 0;
+    size_t functions = 0;
+    while (e.tokens < targetTokens) {
+        switch (index % 4) {
+            case 0:
+            case 1:
+                function(&e, options, index);
+                e.lastFunction = index;
+                functions++;
+                break;
+            case 2:
+                block(&e, options, index);
+                break;
+            case 3:
+                if (options->strings) {
+                    stringDecl(&e, options, index);
+                } else {
+                    function(&e, options, index);
+                    functions++;
+                }
+                break;
+        }
+        index++;
+    }
+
+    program->source = e.data;
+    program->length = e.length;
+    program->tokens = e.tokens;
+    program->functions = functions;
+}
+
+void freeGeneratedProgram(GeneratedProgram* program) {
+    free(program->source);
+    memset(program, 0, sizeof(GeneratedProgram));
+}
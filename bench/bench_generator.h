@@ -0,0 +1,30 @@
+#ifndef BENCH_GENERATOR_H
+#define BENCH_GENERATOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Deterministic generator for large synthetic programs. The same options and
+// seed always produce byte-identical source.
+typedef struct {
+    unsigned int seed;
+    int localsPerScope;     // Variable declarations per function body / block
+    int exprOperands;       // Maximum operand count of an expression, at each level
+    int exprDepth;          // Maximum nesting of parenthesized sub-expressions
+    int stringLength;       // Length of generated string literals
+    bool strings;           // Emit `str` declarations with string literals
+    bool calls;             // Let expressions call earlier generated functions
+} GeneratorOptions;
+
+typedef struct {
+    char* source;
+    size_t length;
+    size_t tokens;          // Exact number of tokens emitted (excluding EOF)
+    size_t functions;
+} GeneratedProgram;
+
+void defaultGeneratorOptions(GeneratorOptions* options);
+void generateProgram(const GeneratorOptions* options, size_t targetTokens, GeneratedProgram* program);
+void freeGeneratedProgram(GeneratedProgram* program);
+
+#endif // BENCH_GENERATOR_H
@@ -0,0 +1,89 @@
+// Compares applying single edits to an open document against reparsing and
+// re-analysing the whole program.
+// Usage: bench_incremental [tokens] [edits]
+//
+// Each edit appends " + 1" to the expression before a randomly chosen ';'
+// and is then undone; both steps are timed.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench_generator.h"
+#include "lexer.h"
+#include "parser.h"
+#include "ast.h"
+#include "semantic_analysis.h"
+#include "incremental.h"
+#include "stats.h"
+
+static void silentError(const char* format, va_list args) {
+    (void)format;
+    (void)args;
+}
+
+static int compareSeconds(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char* argv[]) {
+    size_t tokens = argc > 1 ? (size_t)strtoull(argv[1], NULL, 10) : 1000000;
+    int edits = argc > 2 ? atoi(argv[2]) : 1000;
+    GeneratorOptions options;
+    GeneratedProgram program;
+    defaultGeneratorOptions(&options);
+    generateProgram(&options, tokens, &program);
+    size_t lines = 0;
+    for (const char* p = program.source; *p; p++) lines += *p == '\n';
+
+    double t0 = wallClock();
+    initLexer(program.source);
+    ASTNode* ast = parse();
+    setErrorFunction(silentError);
+    analyzeProgram(ast);
+    setErrorFunction(NULL);
+    double fullTime = wallClock() - t0;
+    freeAST(ast);
+
+    t0 = wallClock();
+    Document* document = openDocument(program.source, program.length);
+    double openTime = wallClock() - t0;
+
+    double* samples = (double*)malloc(2 * (size_t)edits * sizeof(double));
+    unsigned state = 1;
+    int applied = 0;
+    for (int i = 0; i < edits; i++) {
+        state = state * 1103515245u + 12345u;
+        const char* text = documentText(document, NULL);
+        const char* semicolon = strchr(text + (state >> 8) % program.length, ';');
+        if (!semicolon) continue;
+        size_t offset = (size_t)(semicolon - text);
+
+        t0 = wallClock();
+        editDocument(document, offset, 0, " + 1", 4);
+        samples[applied++] = wallClock() - t0;
+        t0 = wallClock();
+        editDocument(document, offset, 4, "", 0);
+        samples[applied++] = wallClock() - t0;
+    }
+    if (applied == 0) {
+        fprintf(stderr, "No edits applied\n");
+        return 1;
+    }
+    qsort(samples, (size_t)applied, sizeof(double), compareSeconds);
+    double total = 0;
+    for (int i = 0; i < applied; i++) total += samples[i];
+
+    fprintf(stderr, "program:              %zu tokens, %zu lines, %zu functions, %zu bytes\n",
+            program.tokens, lines, program.functions, program.length);
+    fprintf(stderr, "full parse + analyse: %10.3f ms\n", fullTime * 1e3);
+    fprintf(stderr, "open document:        %10.3f ms\n", openTime * 1e3);
+    fprintf(stderr, "edit (%d):          mean %8.3f ms, median %.3f ms, p99 %.3f ms, max %.3f ms\n",
+            applied, total / applied * 1e3, samples[applied / 2] * 1e3,
+            samples[(size_t)applied * 99 / 100] * 1e3, samples[applied - 1] * 1e3);
+    fprintf(stderr, "speedup (mean):       %10.1fx\n", fullTime / (total / applied));
+
+    free(samples);
+    closeDocument(document);
+    freeGeneratedProgram(&program);
+    return 0;
+}
@@ -0,0 +1,77 @@
+// Compares parsing and analysing a generated program eagerly against a lazy
+// parse that expands only some of its function bodies, as a program using a
+// small part of a large library would.
+// Usage: bench_lazy [tokens] [percent-of-bodies-used]
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench_generator.h"
+#include "lexer.h"
+#include "parser.h"
+#include "ast.h"
+#include "semantic_analysis.h"
+#include "stats.h"
+
+typedef struct {
+    double seconds;
+    unsigned long long astBytes;
+    unsigned long long stringBytes;
+} FrontEndRun;
+
+static void silentError(const char* format, va_list args) {
+    (void)format;
+    (void)args;
+}
+
+// Parse and analyse, then expand every function whose index falls in the
+// used fraction; returns the AST so it can be freed outside the timing
+static ASTNode* runFrontEnd(const char* source, bool lazy, int percent, FrontEndRun* run) {
+    resetStats();
+    double t0 = wallClock();
+    setLazyBodies(lazy);
+    initLexer(source);
+    ASTNode* ast = parse();
+    setLazyBodies(false);
+    setErrorFunction(silentError);
+    analyzeProgram(ast);
+    setErrorFunction(NULL);
+    int index = 0;
+    for (ASTNode* node = ast->data.block.declarations; node; node = node->next) {
+        if (node->type != AST_FUNC_DECL) continue;
+        if (index++ % 100 < percent && !expandFunctionBody(node)) {
+            fprintf(stderr, "Error: Generated function '%s' did not parse.\n", node->data.funcDecl.name);
+            exit(1);
+        }
+    }
+    run->seconds = wallClock() - t0;
+    run->astBytes = compilerStats.allocs[MEM_AST].bytes;
+    run->stringBytes = compilerStats.allocs[MEM_STRINGS].bytes;
+    return ast;
+}
+
+static void report(const char* name, const FrontEndRun* run, const FrontEndRun* baseline) {
+    fprintf(stderr, "%-8s %10.2f ms %14llu AST bytes %14llu string bytes  (%.2fx time, %.2fx memory)\n", name,
+            run->seconds * 1000, run->astBytes, run->stringBytes, baseline->seconds / run->seconds,
+            (double)(baseline->astBytes + baseline->stringBytes) / (double)(run->astBytes + run->stringBytes));
+}
+
+int main(int argc, char* argv[]) {
+    size_t tokens = argc > 1 ? (size_t)strtoull(argv[1], NULL, 10) : 1000000;
+    int percent = argc > 2 ? atoi(argv[2]) : 10;
+    GeneratorOptions options;
+    GeneratedProgram program;
+    defaultGeneratorOptions(&options);
+    generateProgram(&options, tokens, &program);
+    fprintf(stderr, "program: %zu tokens, %zu bytes, %zu functions, %d%% of bodies used\n", program.tokens,
+            program.length, program.functions, percent);
+
+    FrontEndRun eager, lazy, full;
+    freeAST(runFrontEnd(program.source, false, 0, &eager));
+    freeAST(runFrontEnd(program.source, true, percent, &lazy));
+    freeAST(runFrontEnd(program.source, true, 100, &full));
+    report("eager", &eager, &eager);
+    report("lazy", &lazy, &eager);
+    report("lazy-all", &full, &eager);
+
+    freeGeneratedProgram(&program);
+    return 0;
+}
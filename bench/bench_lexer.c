@@ -0,0 +1,49 @@
+// Lexing throughput of one generated source: the serial scanToken() loop
+// against lexParallel() with a growing number of chunks, each checked to
+// produce the serial token count.
+// Usage: bench_lexer [tokens] [max-chunks]
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench_generator.h"
+#include "lexer.h"
+#include "parallel_lexer.h"
+#include "thread_pool.h"
+#include "stats.h"
+
+int main(int argc, char* argv[]) {
+    size_t tokens = argc > 1 ? (size_t)strtoull(argv[1], NULL, 10) : 4000000;
+    int maxChunks = argc > 2 ? atoi(argv[2]) : 8;
+    GeneratorOptions options;
+    GeneratedProgram program;
+    defaultGeneratorOptions(&options);
+    options.strings = true;
+    generateProgram(&options, tokens, &program);
+    double megabytes = (double)program.length / (1 << 20);
+    fprintf(stderr, "program: %zu tokens, %zu bytes, %d hardware threads\n", program.tokens, program.length,
+            hardwareThreadCount());
+
+    double t0 = wallClock();
+    initLexer(program.source);
+    size_t serialCount = 1;
+    while (scanToken().type != TOKEN_EOF) serialCount++;
+    double serial = wallClock() - t0;
+    fprintf(stderr, "serial    %9.2f ms %9.1f MB/s\n", serial * 1000, megabytes / serial);
+
+    int status = 0;
+    for (int chunks = 1; chunks <= maxChunks; chunks *= 2) {
+        TokenList list;
+        t0 = wallClock();
+        lexParallel(program.source, program.length, chunks, &list);
+        double seconds = wallClock() - t0;
+        fprintf(stderr, "%2d chunks %9.2f ms %9.1f MB/s  %.2fx\n", chunks, seconds * 1000, megabytes / seconds,
+                serial / seconds);
+        if (list.count != serialCount) {
+            fprintf(stderr, "Error: %zu tokens, the serial lexer found %zu\n", list.count, serialCount);
+            status = 1;
+        }
+        freeTokenList(&list);
+    }
+
+    freeGeneratedProgram(&program);
+    return status;
+}
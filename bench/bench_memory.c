@@ -0,0 +1,92 @@
+// Front-end memory footprint over generated programs: bytes of AST and
+// AST strings per byte of source, with a per-kind node breakdown.
+//
+// Usage: bench_memory [--tokens N] [--strings] [--max-ratio R]
+//
+// With --max-ratio the run fails when AST plus string bytes per source byte
+// exceed R, so footprint regressions are caught.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench_generator.h"
+#include "lexer.h"
+#include "parser.h"
+#include "ast.h"
+#include "ast_visitor.h"
+#include "stats.h"
+
+static const char* const kindNames[AST_NODE_TYPE_COUNT] = {
+    [AST_VAR_DECL] = "var-decl",
+    [AST_FUNC_DECL] = "func-decl",
+    [AST_PARAM] = "param",
+    [AST_BLOCK] = "block",
+    [AST_EXPR_STMT] = "expr-stmt",
+    [AST_BINARY_EXPR] = "binary",
+    [AST_LITERAL] = "literal",
+    [AST_IDENTIFIER] = "identifier",
+    [AST_CALL_EXPR] = "call",
+    [AST_RETURN_STMT] = "return",
+    [AST_IMPORT] = "import",
+    [AST_LAZY_BODY] = "lazy-body",
+};
+
+static VisitResult countNode(ASTNode* node, int depth, void* context) {
+    (void)depth;
+    ((unsigned long long*)context)[node->type]++;
+    return VISIT_CONTINUE;
+}
+
+int main(int argc, char* argv[]) {
+    size_t tokens = 1000000;
+    double maxRatio = 0;
+    GeneratorOptions options;
+    defaultGeneratorOptions(&options);
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--tokens") == 0 && i + 1 < argc) {
+            tokens = (size_t)strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--strings") == 0) {
+            options.strings = true;
+        } else if (strcmp(argv[i], "--max-ratio") == 0 && i + 1 < argc) {
+            maxRatio = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--tokens N] [--strings] [--max-ratio R]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    GeneratedProgram program;
+    generateProgram(&options, tokens, &program);
+    resetStats();
+    initLexer(program.source);
+    ASTNode* ast = parse();
+    AllocStats nodes = compilerStats.allocs[MEM_AST];
+    AllocStats strings = compilerStats.allocs[MEM_STRINGS];
+
+    unsigned long long kinds[AST_NODE_TYPE_COUNT] = {0};
+    ASTVisitor visitor = {countNode, NULL, kinds};
+    walkASTNode(ast, &visitor);
+
+    double source = (double)program.length;
+    fprintf(stderr, "program:        %zu tokens, %zu bytes\n", program.tokens, program.length);
+    fprintf(stderr, "token:          %zu bytes (%.2f per source byte if buffered)\n", sizeof(Token),
+            (double)(program.tokens * sizeof(Token)) / source);
+    fprintf(stderr, "%-14s %12s %6s %14s\n", "kind", "nodes", "bytes", "total");
+    for (int kind = 0; kind < AST_NODE_TYPE_COUNT; kind++) {
+        if (kinds[kind] == 0) continue;
+        fprintf(stderr, "%-14s %12llu %6zu %14llu\n", kindNames[kind], kinds[kind], astNodeSize((ASTNodeType)kind),
+                kinds[kind] * astNodeSize((ASTNodeType)kind));
+    }
+    double ratio = (double)(nodes.bytes + strings.bytes) / source;
+    fprintf(stderr, "AST nodes:      %llu bytes, %.2f per source byte (%.2f at a fixed %zu bytes per node)\n",
+            nodes.bytes, nodes.bytes / source, (double)(nodes.count * sizeof(ASTNode)) / source, sizeof(ASTNode));
+    fprintf(stderr, "AST strings:    %llu bytes, %.2f per source byte\n", strings.bytes, strings.bytes / source);
+    fprintf(stderr, "total:          %.2f bytes per source byte\n", ratio);
+
+    freeAST(ast);
+    freeGeneratedProgram(&program);
+    if (maxRatio > 0 && ratio > maxRatio) {
+        fprintf(stderr, "Error: %.2f bytes per source byte exceeds the budget of %.2f\n", ratio, maxRatio);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,165 @@
+// Superword-level parallelism on generated numeric kernels: compiles the
+// same straight-line kernels with and without vectorization, reports how
+// many int +/- operations went into vector lanes, then links each build
+// with a driver that calls every kernel repeatedly and compares the run
+// times and checksums.
+//
+// Usage: bench_vectorize [--functions N] [--steps N] [--iterations N] [--compiler <path>]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lexer.h"
+#include "parser.h"
+#include "ast.h"
+#include "codegen.h"
+#include "elf_writer.h"
+#include "stats.h"
+
+static const char* objectPath = "bench_vectorize.o";
+static const char* driverPath = "bench_vectorize_main.c";
+static const char* programPath = "bench_vectorize_program";
+
+// Two pairs of parallel variables, (u, v) and (w, x), updated step by step.
+// Every fifth step scales u and v instead, which SSE2 cannot do in lanes.
+static char* generateSource(int functions, int steps) {
+    char* source;
+    size_t size;
+    FILE* out = open_memstream(&source, &size);
+    for (int i = 0; i < functions; i++) {
+        fprintf(out, "int k%d(int a, int b, int c, int d) {\n", i);
+        fprintf(out, "    int u0 = a + %d;\n    int v0 = b + %d;\n", i, i + 1);
+        fprintf(out, "    int w0 = c - %d;\n    int x0 = d - %d;\n", i + 2, i + 3);
+        for (int s = 1; s <= steps; s++) {
+            if (s % 5 == 0) {
+                fprintf(out, "    int u%d = u%d * 3;\n    int v%d = v%d * 5;\n", s, s - 1, s, s - 1);
+            } else {
+                fprintf(out, "    int u%d = u%d + w%d - %d;\n", s, s - 1, s - 1, s);
+                fprintf(out, "    int v%d = v%d + x%d - %d;\n", s, s - 1, s - 1, s + 1);
+            }
+            fprintf(out, "    int w%d = w%d - u%d + 1;\n", s, s - 1, s);
+            fprintf(out, "    int x%d = x%d - v%d + 2;\n", s, s - 1, s);
+        }
+        fprintf(out, "    return u%d + v%d + w%d + x%d;\n}\n", steps, steps, steps, steps);
+    }
+    fclose(out);
+    return source;
+}
+
+static bool writeDriver(int functions) {
+    FILE* out = fopen(driverPath, "w");
+    if (!out) return false;
+    fprintf(out, "#include <stdio.h>\n#include <stdlib.h>\n#include <time.h>\n");
+    for (int i = 0; i < functions; i++) fprintf(out, "long k%d(long, long, long, long);\n", i);
+    fprintf(out, "static long (*const kernels[])(long, long, long, long) = {\n");
+    for (int i = 0; i < functions; i++) fprintf(out, "    k%d,\n", i);
+    fprintf(out, "};\n"
+                 "int main(int argc, char** argv) {\n"
+                 "    long iterations = atol(argv[1]);\n"
+                 "    unsigned long checksum = 0;\n"
+                 "    struct timespec start, end;\n"
+                 "    clock_gettime(CLOCK_MONOTONIC, &start);\n"
+                 "    for (long n = 0; n < iterations; n++) {\n"
+                 "        for (size_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]); i++) {\n"
+                 "            checksum = checksum * 31 + (unsigned long)kernels[i](n, n + 1, n * 3, 7 - n);\n"
+                 "        }\n"
+                 "    }\n"
+                 "    clock_gettime(CLOCK_MONOTONIC, &end);\n"
+                 "    printf(\"%%lu %%.6f\\n\", checksum,\n"
+                 "           (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9);\n"
+                 "    return 0;\n"
+                 "}\n");
+    return fclose(out) == 0;
+}
+
+typedef struct {
+    unsigned long long arithmetic;
+    unsigned long long vectorized;
+    size_t codeBytes;
+    unsigned long checksum;
+    double seconds;
+} Result;
+
+static bool measure(const char* source, bool noVectorize, const char* compiler, long iterations, Result* result) {
+    initLexer(source);
+    ASTNode* ast = parse();
+    CodegenOptions options = {0};
+    options.noVectorize = noVectorize;
+    ObjectFile object;
+    initObjectFile(&object);
+    resetStats();
+    bool ok = generateCode(ast, &options, &object, NULL, stderr) && writeELFFile(&object, objectPath);
+    result->arithmetic = compilerStats.arithmeticOperations;
+    result->vectorized = compilerStats.vectorizedOperations;
+    result->codeBytes = object.sections[SECTION_TEXT].size;
+    freeObjectFile(&object);
+    freeAST(ast);
+    if (!ok) return false;
+
+    char command[1024];
+    snprintf(command, sizeof(command), "%s -O2 -o %s %s %s", compiler, programPath, driverPath, objectPath);
+    if (system(command) != 0) return false;
+
+    snprintf(command, sizeof(command), "./%s %ld", programPath, iterations);
+    FILE* output = popen(command, "r");
+    if (!output) return false;
+    int fields = fscanf(output, "%lu %lf", &result->checksum, &result->seconds);
+    return pclose(output) == 0 && fields == 2;
+}
+
+static void printResult(const char* name, const Result* result, double calls) {
+    printf("%-12s %12llu %12llu %10.1f%% %12zu %10.3f %10.1f\n", name, result->arithmetic, result->vectorized,
+           result->arithmetic ? 100.0 * result->vectorized / result->arithmetic : 0.0, result->codeBytes,
+           result->seconds * 1e3, result->seconds / calls * 1e9);
+}
+
+int main(int argc, char* argv[]) {
+    int functions = 32;
+    int steps = 40;
+    long iterations = 20000;
+    const char* compiler = "cc";
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--functions") == 0 && i + 1 < argc) {
+            functions = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--steps") == 0 && i + 1 < argc) {
+            steps = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--compiler") == 0 && i + 1 < argc) {
+            compiler = argv[++i];
+        } else {
+            fprintf(stderr, "Usage: %s [--functions N] [--steps N] [--iterations N] [--compiler <path>]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (functions < 1 || steps < 1 || iterations < 1) {
+        fprintf(stderr, "--functions, --steps and --iterations must be positive.\n");
+        return 1;
+    }
+
+    char* source = generateSource(functions, steps);
+    Result scalar, vector;
+    bool ok = writeDriver(functions) && measure(source, true, compiler, iterations, &scalar) &&
+              measure(source, false, compiler, iterations, &vector);
+    free(source);
+    remove(objectPath);
+    remove(driverPath);
+    remove(programPath);
+    if (!ok) {
+        fprintf(stderr, "Compiling, linking or running the program failed.\n");
+        return 1;
+    }
+    if (scalar.checksum != vector.checksum) {
+        fprintf(stderr, "Checksums differ: scalar %lu, vectorized %lu.\n", scalar.checksum, vector.checksum);
+        return 1;
+    }
+
+    double calls = (double)functions * (double)iterations;
+    printf("%d kernels x %d steps x %ld iterations\n", functions, steps, iterations);
+    printf("%-12s %12s %12s %11s %12s %10s %10s\n", "", "int +/- ops", "vectorized", "rate", "code bytes",
+           "time (ms)", "ns / call");
+    printResult("scalar", &scalar, calls);
+    printResult("SLP", &vector, calls);
+    printf("Vectorization rate: %.1f%%, time %.2fx\n",
+           100.0 * (double)vector.vectorized / (double)vector.arithmetic, scalar.seconds / vector.seconds);
+    return 0;
+}
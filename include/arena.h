@@ -0,0 +1,37 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// Bump allocator for short-lived compiler data. Memory is released in bulk
+// by rolling back to a mark; chunks are kept and reused afterwards, so a
+// steady-state compilation does not touch malloc at all.
+
+typedef struct ArenaChunk {
+    struct ArenaChunk* next;
+    size_t size;
+    size_t used;
+    _Alignas(16) unsigned char data[];
+} ArenaChunk;
+
+typedef struct {
+    ArenaChunk* first;
+    ArenaChunk* current;
+    size_t reservedBytes;       // Total chunk capacity obtained from malloc
+} Arena;
+
+typedef struct {
+    ArenaChunk* chunk;
+    size_t used;
+} ArenaMark;
+
+void initArena(Arena* arena);
+void freeArena(Arena* arena);
+void* arenaAlloc(Arena* arena, size_t size);
+ArenaMark arenaMark(const Arena* arena);
+void arenaRelease(Arena* arena, ArenaMark mark);
+
+// Scratch arena of the compilation running on the calling thread
+Arena* compilationArena();
+
+#endif // ARENA_H
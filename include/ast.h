@@ -1,6 +1,10 @@
 #ifndef AST_H
 #define AST_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
 typedef enum {
     AST_VAR_DECL,
     AST_FUNC_DECL,
@@ -11,11 +15,26 @@ typedef enum {
     AST_LITERAL,
     AST_IDENTIFIER,
     AST_CALL_EXPR,
-    AST_RETURN_STMT
+    AST_RETURN_STMT,
+    AST_IMPORT,
+    AST_LAZY_BODY
 } ASTNodeType;
 
+#define AST_NODE_TYPE_COUNT (AST_LAZY_BODY + 1)
+
+// A node is allocated with only the payload its kind uses (astNodeSize),
+// not the whole union: an identifier takes three words where a function
+// declaration takes six, and the kind shares its word with the few scalar
+// fields. Only the member of `data` matching `type` may be
+// accessed, and a node may change kind in place only to one whose payload
+// is no larger, as constant folding does when it turns an operation into
+// an AST_LITERAL.
 typedef struct ASTNode {
-    ASTNodeType type;
+    uint8_t type;           // ASTNodeType
+    // Scalars of some kinds, packed beside the kind
+    uint8_t operator;       // Binary expression: TokenType
+    bool noEscape;          // Binary expression: result dies with the call (escape analysis)
+    int32_t site;           // Call: index among the calls of its function (code generation)
     struct ASTNode* next;  // For linked list of nodes
     union {
         // Variable declaration
@@ -52,7 +71,6 @@ typedef struct ASTNode {
         // Binary expression
         struct {
             struct ASTNode* left;
-            char operator;
             struct ASTNode* right;
         } binaryExpr;
 
@@ -76,10 +94,25 @@ typedef struct ASTNode {
         struct {
             struct ASTNode* value;
         } returnStmt;
+
+        // Import declaration (top level only)
+        struct {
+            char* module;
+        } import;
+
+        // Function body skipped by lazy parsing, until expandFunctionBody()
+        struct {
+            const char* source;     // Must outlive the stub
+            uint32_t offset;        // Of the body's '{'
+            int line;
+        } lazyBody;
     } data;
 } ASTNode;
 
 ASTNode* newASTNode(ASTNodeType type);
+size_t astNodeSize(ASTNodeType type);
 void freeAST(ASTNode* node);
+// Only this node and its strings, not its children or siblings
+void freeASTNode(ASTNode* node);
 
 #endif // AST_H
@@ -0,0 +1,73 @@
+#ifndef AST_SERIALIZE_H
+#define AST_SERIALIZE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "ast.h"
+
+// Binary AST format ("CPYA").
+//
+// Layout (all integers little-endian):
+//   header        40 bytes, see AST_FORMAT_HEADER_SIZE
+//   node section  node records, children always written before their parent
+//   string table  u32 offsets[stringCount], then NUL-terminated string data
+//
+// A node record is a kind byte, the varint distance back to its `next`
+// sibling (0 = none), then the kind's fields: interned string ids (varint,
+// id + 1, 0 = NULL), child distances (varint, 0 = NULL) and, for binary
+// expressions, an operator byte. Because every reference points backwards, a
+// reader can walk the tree straight out of a read-only mapping.
+#define AST_FORMAT_MAGIC "CPYA"
+#define AST_FORMAT_VERSION 1
+#define AST_FORMAT_HEADER_SIZE 40
+
+typedef uint32_t ASTRef;  // Offset of a node record within the node section
+#define AST_REF_NULL UINT32_MAX
+
+typedef struct {
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+} ASTBuffer;
+
+// Zero-copy view over a serialized AST, either in memory or mapped from disk
+typedef struct {
+    const uint8_t* nodes;
+    uint32_t nodeSectionSize;
+    uint32_t nodeCount;
+    ASTRef root;
+    const uint8_t* stringOffsets;
+    const char* stringData;
+    uint32_t stringCount;
+    uint32_t stringDataSize;
+
+    void* mapping;         // Set when the view owns a file mapping
+    size_t mappingSize;
+} ASTView;
+
+// Writer; errors are reported to `err`
+bool serializeAST(const ASTNode* root, ASTBuffer* out, FILE* err);
+void freeASTBuffer(ASTBuffer* buffer);
+bool writeASTFile(const ASTNode* root, const char* path, FILE* err);
+
+// Reader. Opening checks every node record (known kind, fields in range,
+// references pointing back to the start of a record not referenced yet),
+// so the accessors below and materializeAST() can trust the data; a view
+// that fails is reported to `err`.
+bool openASTView(ASTView* view, const void* data, size_t size, FILE* err);
+bool mapASTFile(const char* path, ASTView* view, FILE* err);
+void closeASTView(ASTView* view);
+
+ASTRef astViewRoot(const ASTView* view);
+ASTNodeType astViewKind(const ASTView* view, ASTRef ref);
+ASTRef astViewNext(const ASTView* view, ASTRef ref);
+ASTRef astViewChild(const ASTView* view, ASTRef ref, int index);
+const char* astViewString(const ASTView* view, ASTRef ref, int index);
+int astViewOperator(const ASTView* view, ASTRef ref);
+
+// Rebuild a heap-allocated tree (release with freeAST)
+ASTNode* materializeAST(const ASTView* view);
+
+#endif // AST_SERIALIZE_H
@@ -0,0 +1,40 @@
+#ifndef AST_VISITOR_H
+#define AST_VISITOR_H
+
+#include <stdbool.h>
+#include "ast.h"
+
+// Iterative AST traversal. The walk keeps an explicit stack in the
+// compilation arena instead of recursing, so neither deep expressions nor
+// long statement lists grow the C stack, and nodes cost no heap allocation.
+//
+// `enter` runs before a node's children (pre-order), `leave` after them
+// (post-order). Siblings linked through `next` are visited in order at the
+// same depth. `leave` may free the node: the walk has already read its
+// children and `next` by then.
+
+typedef enum {
+    VISIT_CONTINUE,
+    VISIT_SKIP_CHILDREN,    // Do not descend; `leave` still runs
+    VISIT_STOP              // Abort the whole walk; no further callbacks
+} VisitResult;
+
+typedef struct {
+    VisitResult (*enter)(ASTNode* node, int depth, void* context);
+    void (*leave)(ASTNode* node, int depth, void* context);
+    void* context;
+} ASTVisitor;
+
+#define AST_MAX_CHILDREN 4
+
+// Heads of the node's child lists in source order; returns how many slots
+// were filled (entries may be NULL for absent optional children)
+int astChildren(const ASTNode* node, ASTNode* children[AST_MAX_CHILDREN]);
+
+// Walk `root` and every sibling after it; returns false if stopped
+bool walkAST(ASTNode* root, const ASTVisitor* visitor);
+
+// Walk `node` and its children but not the siblings after it
+bool walkASTNode(ASTNode* node, const ASTVisitor* visitor);
+
+#endif // AST_VISITOR_H
@@ -0,0 +1,40 @@
+#ifndef ASYNC_IO_H
+#define ASYNC_IO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Asynchronous reads and writes at file offsets. On Linux the requests go
+// through an io_uring, set up with the raw system calls, so a batch of them
+// costs one io_uring_enter() instead of a call each. Where io_uring is
+// missing or not permitted, each request is done with pread()/pwrite() when
+// it is submitted and completes on the next wait, so callers run the same
+// code either way.
+//
+// Like pread(), a request may transfer fewer bytes than asked for; the
+// caller submits the rest. Not thread-safe: one thread owns the queue.
+
+typedef struct AsyncIO AsyncIO;
+
+typedef struct {
+    void* context;          // As given when the request was submitted
+    int64_t result;         // Bytes transferred, or -errno
+} IOCompletion;
+
+// `depth` bounds the requests in flight; submitting more waits for room.
+// With `useRing` false the pread() fallback is used even where io_uring works.
+AsyncIO* createAsyncIO(unsigned depth, bool useRing);
+void destroyAsyncIO(AsyncIO* io);
+bool asyncIOUsesRing(const AsyncIO* io);
+unsigned asyncIOInFlight(const AsyncIO* io);
+
+void submitRead(AsyncIO* io, int fd, void* buffer, size_t size, uint64_t offset, void* context);
+void submitWrite(AsyncIO* io, int fd, const void* buffer, size_t size, uint64_t offset, void* context);
+
+// Sends submitted requests to the kernel and collects up to `capacity`
+// completions, blocking until there is at least one when `wait` is set and
+// anything is in flight. Returns how many were collected.
+size_t collectCompletions(AsyncIO* io, IOCompletion* completions, size_t capacity, bool wait);
+
+#endif // ASYNC_IO_H
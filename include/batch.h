@@ -0,0 +1,40 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "driver.h"
+
+// Compiles many independent sources in one process, for builds that would
+// otherwise start the compiler once per file. The list names one source per
+// line, relative to the working directory, optionally followed by the
+// object to write; by default that is the source's name with a .o suffix in
+// the output directory. Blank lines and lines starting with '#' are skipped.
+// A list in which two sources compile to the same object is rejected.
+//
+// Sources are read and objects written through async_io.h, so on Linux a
+// whole batch of reads and writes costs one system call. A bounded number
+// of files is in flight at once: while some are read or written, those
+// already read compile on a thread pool.
+
+typedef struct {
+    const char* listPath;
+    const char* outputDirectory;    // Created if missing; "." by default
+    int jobs;                       // Parallel compilations; 0 = one per hardware thread
+    bool noRing;                    // Use pread()/pwrite() even where io_uring works
+    CompileOptions compile;         // Code generation options for every file
+} BatchOptions;
+
+typedef struct {
+    int files;
+    int compiled;
+    int failed;
+    bool ring;                      // Whether the I/O went through io_uring
+    double seconds;
+} BatchSummary;
+
+// Reports failures and a summary to `out` and diagnostics to `err`; returns
+// the exit code. `summary` may be NULL.
+int runBatch(const BatchOptions* options, BatchSummary* summary, FILE* out, FILE* err);
+
+#endif // BATCH_H
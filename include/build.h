@@ -0,0 +1,39 @@
+#ifndef BUILD_H
+#define BUILD_H
+
+#include <stdio.h>
+#include "driver.h"
+
+// Builds a program split into modules. Starting from the entry module's
+// source, the modules it imports are found next to it (name.cpy) and each is
+// compiled to name.o and name.cpyi in the output directory, in dependency
+// order; modules whose imports are all done compile in parallel.
+//
+// A module is up to date, and its source is not even read, when its
+// interface records the source's current size and modification time and
+// each of its imports still has the interface hash it was compiled against.
+// A dependency whose body changed but whose interface did not is recompiled
+// on its own, without its importers.
+//
+// Link the objects with the runtime library; the entry module's cpy_init
+// runs every module's top-level code, dependencies first.
+
+typedef struct {
+    const char* entryPath;          // Source of the entry module
+    const char* outputDirectory;    // Created if missing; "." by default
+    int jobs;                       // Parallel compilations; 0 = one per hardware thread
+    CompileOptions compile;         // Code generation options for every module
+} BuildOptions;
+
+typedef struct {
+    int modules;
+    int compiled;
+    int upToDate;
+    int failed;                     // Including modules skipped for a failed import
+} BuildSummary;
+
+// Reports each module to `out` and diagnostics to `err`; returns the exit
+// code. `summary` may be NULL.
+int runBuild(const BuildOptions* options, BuildSummary* summary, FILE* out, FILE* err);
+
+#endif // BUILD_H
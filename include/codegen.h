@@ -0,0 +1,71 @@
+#ifndef CODEGEN_H
+#define CODEGEN_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "ast.h"
+#include "elf_writer.h"
+#include "profile.h"
+
+// Native x86-64 code generation (System V ABI). Values are 64-bit: `int`
+// is a signed integer, `str` a pointer to immutable bytes laid out as in
+// runtime/cpy_runtime.h. Each function declaration becomes a global function
+// symbol; top-level variables live in .bss and top-level statements run from
+// MODULE_INIT_SYMBOL.
+//
+// String literals are pooled: each distinct literal is emitted once in
+// .rodata with its length and hash header. `+` on two strs calls the
+// runtime's cpy_str_concat (run foldStringConstants first so constant
+// operands are joined at compile time), and unless the module defines
+// functions of the same name, `len(s)` reads the length from the header and
+// `equals(a, b)` calls cpy_str_equal. Functions not defined in the module are
+// assumed to return int.
+//
+// Concatenations that escape analysis proves never outlive the call are
+// allocated in a region in the function's stack frame instead, which the
+// epilogue releases (see escape_analysis.h).
+//
+// `return f(...)` compiles to a jump: self-recursion becomes a loop over
+// the function body, and other calls reuse the caller's stack space, so
+// recursion in tail position runs in constant stack.
+//
+// Adjacent `int` declarations whose initializers are the same tree of `+`
+// and `-` over different locals or literals are computed together in the
+// two 64-bit lanes of an SSE2 register, when the cost model expects that
+// to take fewer instructions than the scalar code. The number of
+// operations vectorized is counted in compilerStats.
+//
+// With `profileGenerate`, every function entry and call site increments a
+// counter, and the module registers its counters with the runtime, which
+// writes them out at exit (see cpy_profile.c). Given such a `profile`, code
+// is laid out hot functions first, with functions that never ran moved to
+// .text.unlikely; hot call sites to small straight-line functions are
+// inlined; and the most used variables of hot functions live in
+// callee-saved registers instead of stack slots.
+//
+// Imported modules are known by their interfaces only (see module.h): calls
+// to their functions and loads of their globals reference undefined
+// symbols. The entry module's MODULE_INIT_SYMBOL runs the initializers of
+// all the modules it depends on, dependencies first, before its own
+// top-level statements; a module compiled as a dependency (`moduleName`)
+// names its initializer after itself instead and runs nothing else.
+//
+// Machine code is encoded straight into `object`. If `assembly` is given,
+// the same instructions are also written out as GNU as source, which is how
+// the object path is cross-checked and benchmarked against `as`.
+
+#define MODULE_INIT_SYMBOL "cpy_init"
+
+// Zero-initialized options are the defaults; `options` may be NULL
+typedef struct {
+    bool heapStrings;       // No escape analysis: every computed str is malloc'd
+    bool noTailCalls;       // Keep `return f(...)` an ordinary call
+    bool noVectorize;       // No superword-level parallelism
+    bool profileGenerate;   // Instrument for profiling
+    const Profile* profile; // Optimize for the counts of an instrumented run
+    const char* moduleName; // Compiled as a dependency module rather than the entry
+} CodegenOptions;
+
+bool generateCode(ASTNode* program, const CodegenOptions* options, ObjectFile* object, FILE* assembly, FILE* err);
+
+#endif // CODEGEN_H
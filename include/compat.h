@@ -0,0 +1,32 @@
+#ifndef COMPAT_H
+#define COMPAT_H
+
+#include <string.h>
+#include <stdlib.h>
+
+// The compiler was first written against the MSVC runtime. These shims map the
+// handful of MSVC-only helpers onto their POSIX equivalents so the same
+// sources build with GCC/Clang.
+#ifndef _WIN32
+#define _strdup strdup
+
+static inline int strncpy_s(char* dest, size_t destSize, const char* src, size_t count) {
+    if (!dest || destSize == 0) return 1;
+    size_t n = count < destSize - 1 ? count : destSize - 1;
+    size_t srcLen = strnlen(src, n);
+    memcpy(dest, src, srcLen);
+    dest[srcLen] = '\0';
+    return 0;
+}
+#endif
+
+// Compiler state that is global to one compilation (lexer cursor, parser
+// lookahead, current scope, stats) is per-thread so the compilation server
+// can run several compilations at once.
+#if defined(_MSC_VER) && !defined(__clang__)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL _Thread_local
+#endif
+
+#endif // COMPAT_H
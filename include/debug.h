@@ -0,0 +1,14 @@
+#ifndef DEBUG_H
+#define DEBUG_H
+
+#include <stdio.h>
+
+// Parser and semantic-analysis tracing. It prints on every token and symbol
+// lookup, so it is compiled out unless COMPILER_TRACE is defined.
+#ifdef COMPILER_TRACE
+#define TRACE(...) printf(__VA_ARGS__)
+#else
+#define TRACE(...) ((void)0)
+#endif
+
+#endif // DEBUG_H
@@ -0,0 +1,49 @@
+#ifndef DRIVER_H
+#define DRIVER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "ast.h"
+#include "codegen.h"
+#include "module.h"
+
+// One compilation as run by the command line and by the compilation server.
+// Output (the AST dump) goes to `out`, diagnostics and the stats report to
+// `err`, so callers can capture either stream. A NULL `out` skips the dump.
+
+// The encoded object, for callers that write it themselves (batch.h)
+typedef struct {
+    uint8_t* data;
+    size_t size;
+} ObjectBuffer;
+
+typedef struct {
+    bool stats;
+    bool statsJSON;
+    const char* statsPath;      // Write the stats report here instead of `err`
+    const char* emitASTPath;
+    const char* emitObjectPath;     // Relocatable ELF64 object
+    const char* emitAssemblyPath;   // The same code as GNU as source
+    ObjectBuffer* emitObjectBuffer; // The object in memory; the caller frees its data
+    const char* profileUsePath;     // Counts from a --profile-generate build
+    bool noConstantCalls;           // Leave calls with constant arguments to run time
+    bool lazyBodies;                // Parse function bodies only for the dump and code generation
+    bool check;                     // Diagnostics only: any diagnostic fails, skipped bodies are still checked
+    size_t parallelLexBytes;        // Lex sources this large on every core (0: PARALLEL_LEX_THRESHOLD)
+    const char* emitInterfacePath;  // Module interface for importers (module.h)
+    const char* modulePath;         // Where imported interfaces are looked up
+    const char* sourcePath;         // Source file, whose stamp the interface records
+    ModuleDependencies* dependencies;   // Filled with the modules looked up; the caller frees it
+    CodegenOptions codegen;
+} CompileOptions;
+
+void printAST(FILE* out, ASTNode* node, int indent);
+char* readSourceFile(const char* path, size_t* length);
+
+// Both return the process exit code (0 on success)
+int compileSource(const char* source, const CompileOptions* options, FILE* out, FILE* err);
+int compileSerializedAST(const char* path, const CompileOptions* options, FILE* out, FILE* err);
+
+#endif // DRIVER_H
@@ -0,0 +1,95 @@
+#ifndef ELF_WRITER_H
+#define ELF_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "string_pool.h"
+
+// In-memory relocatable object and its ELF64 (x86-64) encoding. The code
+// generator fills sections, symbols and relocations; writeELFObject lays out
+// a `.o` that the system linker accepts, without going through `as`.
+
+typedef enum {
+    SECTION_TEXT,
+    SECTION_RODATA,
+    SECTION_DATA,
+    SECTION_BSS,
+    // Written only when used
+    SECTION_TEXT_COLD,      // .text.unlikely: code a profile shows never runs
+    SECTION_PROFILE,        // cpy_prof: profile counter descriptors
+    SECTION_COUNT
+} SectionKind;
+
+typedef struct {
+    uint8_t* data;          // Unused for .bss
+    size_t size;
+    size_t capacity;
+    size_t alignment;
+} SectionBuffer;
+
+typedef enum {
+    SYMBOL_SECTION,         // Stands for the start of a section
+    SYMBOL_FUNCTION,
+    SYMBOL_OBJECT,
+    SYMBOL_UNDEFINED        // External, resolved by the linker
+} SymbolKind;
+
+typedef struct {
+    const char* name;       // Owned by ObjectFile.names
+    SymbolKind kind;
+    SectionKind section;
+    uint64_t value;
+    uint64_t size;
+    bool global;
+} ObjectSymbol;
+
+// x86-64 relocation types used by the code generator
+#define RELOC_X86_64_64 1
+#define RELOC_X86_64_PC32 2
+#define RELOC_X86_64_PLT32 4
+
+typedef struct {
+    SectionKind section;    // Section being patched
+    uint64_t offset;
+    uint32_t symbol;        // Index into ObjectFile.symbols
+    uint32_t type;
+    int64_t addend;
+} ObjectRelocation;
+
+typedef struct {
+    SectionBuffer sections[SECTION_COUNT];
+    ObjectSymbol* symbols;
+    uint32_t symbolCount;
+    uint32_t symbolCapacity;
+    ObjectRelocation* relocations;
+    uint32_t relocationCount;
+    uint32_t relocationCapacity;
+    StringPool names;
+    uint32_t* symbolByName;     // Interned name id -> symbol index
+    uint32_t symbolByNameCapacity;
+    uint32_t sectionSymbols[SECTION_COUNT];
+} ObjectFile;
+
+#define NO_SYMBOL UINT32_MAX
+
+void initObjectFile(ObjectFile* object);
+void freeObjectFile(ObjectFile* object);
+
+// Append bytes to a section, returning the offset they start at
+size_t sectionAppend(ObjectFile* object, SectionKind section, const void* data, size_t size);
+size_t sectionReserve(ObjectFile* object, SectionKind section, size_t size, size_t alignment);
+void sectionPatch32(ObjectFile* object, SectionKind section, size_t offset, uint32_t value);
+
+uint32_t addObjectSymbol(ObjectFile* object, const char* name, SymbolKind kind, SectionKind section,
+                         uint64_t value, uint64_t size, bool global);
+uint32_t sectionSymbol(ObjectFile* object, SectionKind section);
+uint32_t findObjectSymbol(const ObjectFile* object, const char* name);
+// Find a symbol by name, adding an undefined one if it is not known yet
+uint32_t symbolReference(ObjectFile* object, const char* name);
+void addRelocation(ObjectFile* object, SectionKind section, uint64_t offset, uint32_t symbol, uint32_t type, int64_t addend);
+
+bool writeELFObject(const ObjectFile* object, uint8_t** data, size_t* size);
+bool writeELFFile(const ObjectFile* object, const char* path);
+
+#endif // ELF_WRITER_H
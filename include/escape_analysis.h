@@ -0,0 +1,31 @@
+#ifndef ESCAPE_ANALYSIS_H
+#define ESCAPE_ANALYSIS_H
+
+#include <stdbool.h>
+#include "ast.h"
+
+// Escape analysis for values computed by binary expressions (in practice
+// `str + str`, the only operator that allocates). A result escapes when it
+// can outlive the call that computed it: it is returned, passed to a
+// function that may keep it, stored in a global, or bound to a local that
+// escapes in turn. Everything else - operands of another operator,
+// arguments of read-only calls, discarded expression statements, locals
+// only read locally - dies with the call.
+//
+// The analysis sets `noEscape` on every binary expression it
+// visits; code generation allocates those results in a region released on
+// return instead of on the heap. Locals are tracked by name, so a name
+// shadowed in an inner block is conservatively treated as one variable.
+
+// Whether `call` (an AST_CALL_EXPR) only reads its arguments, as the str
+// builtins do. A NULL callback treats every call as keeping its arguments.
+typedef bool (*ReadOnlyCall)(const ASTNode* call, void* context);
+
+// `function` is an AST_FUNC_DECL
+void analyzeFunctionEscapes(ASTNode* function, ReadOnlyCall readOnly, void* context);
+
+// The top-level statements of `module` (function declarations are
+// skipped); its top-level variables are globals
+void analyzeModuleEscapes(ASTNode* module, ReadOnlyCall readOnly, void* context);
+
+#endif // ESCAPE_ANALYSIS_H
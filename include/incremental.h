@@ -0,0 +1,53 @@
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "ast.h"
+
+// Incremental reparsing for editors. A document holds a source text with
+// its parsed top-level declarations and their diagnostics. Each edit
+// replaces a byte range with new text and redoes only the declarations it
+// touched: lexing resumes at the end of the last declaration before the
+// edit and stops as soon as the next declaration starts where an old one
+// past the edit did, since the text from there on, and therefore every
+// later token and declaration, is unchanged. Declarations outside that
+// window keep their subtrees.
+//
+// Diagnostics match a full parse and analyzeProgram(). Only the reparsed
+// declarations are analysed again, against the globals declared before
+// them; when the edit declared or removed a global or an import, the
+// top-level statements after it are too.
+//
+// A syntax error becomes a diagnostic on the text from the failed
+// declaration up to the next old declaration past the edit, and parsing
+// resumes there, so the rest of the document keeps its diagnostics. That
+// text is reparsed by every later edit until it parses again.
+
+typedef struct Document Document;
+
+typedef struct {
+    size_t offset;          // Start of the declaration the message is about
+    const char* message;
+} Diagnostic;
+
+Document* openDocument(const char* source, size_t length);
+void closeDocument(Document* document);
+
+// Replace `removed` bytes at `offset` with `length` bytes of `text`; false
+// if the range lies outside the document or the text would outgrow
+// MAX_SOURCE_BYTES
+bool editDocument(Document* document, size_t offset, size_t removed, const char* text, size_t length);
+
+const char* documentText(const Document* document, size_t* length);
+
+// The program as parse() would return it, or NULL while the document has a
+// syntax error. Owned by the document and valid until the next edit; do not
+// modify it.
+const ASTNode* documentAST(const Document* document);
+
+// Copies up to `capacity` diagnostics in source order and returns how many
+// there are. Messages stay valid until the next edit.
+size_t documentDiagnostics(const Document* document, Diagnostic* diagnostics, size_t capacity);
+
+#endif // INCREMENTAL_H
@@ -1,6 +1,9 @@
 #ifndef LEXER_H
 #define LEXER_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 typedef enum {
     TOKEN_INT,
     TOKEN_FLOAT,
@@ -21,18 +24,35 @@ typedef enum {
     TOKEN_COMMA,
     TOKEN_SEMICOLON,
     TOKEN_STRING,
+    TOKEN_IMPORT,
     TOKEN_EOF,
     TOKEN_ERROR
 } TokenType;
 
+// Tokens locate their text by a 32-bit offset into the source being lexed,
+// which bounds sources to MAX_SOURCE_BYTES, and pack into 16 bytes
+#define MAX_SOURCE_BYTES UINT32_MAX
+
 typedef struct {
-    TokenType type;
-    const char* start;
+    uint32_t offset;    // For TOKEN_ERROR, which message (see tokenStart)
     int length;
     int line;
+    uint8_t type;       // TokenType
 } Token;
 
 void initLexer(const char* source);
+// Continue lexing `source` from `offset`, a point between two tokens
+void resumeLexer(const char* source, size_t offset, int line);
 Token scanToken();
 
+// Hand out tokens lexed ahead of time (parallel_lexer.h) instead of
+// scanning; `tokens` must end with TOKEN_EOF and outlive the parse
+void replayTokens(const char* source, const Token* tokens);
+// Source range of the last token scanned, which for a TOKEN_ERROR its
+// offset does not give; not meaningful while replaying
+void lastTokenSpan(size_t* start, size_t* end);
+
+// The token's text in the source being lexed, or the message of a TOKEN_ERROR
+const char* tokenStart(Token token);
+
 #endif // LEXER_H
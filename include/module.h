@@ -0,0 +1,128 @@
+#ifndef MODULE_H
+#define MODULE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "ast.h"
+
+// Modules and their precompiled interfaces.
+//
+// `import name;` at the top level of a source file makes the functions and
+// globals of module `name` (name.cpy) visible to it. Compiling the importer
+// never reads name.cpy: it maps name.cpyi, the interface written when the
+// module itself was compiled, which lists the signatures of its top-level
+// declarations. Names are global at link time, as in C.
+//
+// Interface format ("CPYI", all integers little-endian):
+//   header   64 bytes, see MODULE_HEADER_SIZE
+//   exports  {u8 kind, 3 bytes padding, u32 name, u32 type, u32 params}
+//            where `params` is the parameter types joined by ','
+//   imports  {u32 name, u32 padding, u64 interface hash} as compiled against
+//   inits    u32 name: module initializers to run, dependencies first
+//   strings  NUL-terminated, referenced by offset
+//
+// The header records the size and modification time of the source the
+// interface was built from, so a build can tell whether a module is up to
+// date without reading its source, and a hash of everything importers
+// depend on (exports and initializers), so a module whose body changed but
+// whose interface did not leaves its importers alone.
+#define MODULE_MAGIC "CPYI"
+#define MODULE_VERSION 1
+#define MODULE_HEADER_SIZE 64
+#define MODULE_SOURCE_SUFFIX ".cpy"
+#define MODULE_INTERFACE_SUFFIX ".cpyi"
+
+#define MODULE_FLAG_ENTRY 1u    // Compiled as the program's entry module
+
+typedef enum {
+    EXPORT_FUNCTION,
+    EXPORT_GLOBAL
+} ExportKind;
+
+typedef struct {
+    ExportKind kind;
+    const char* name;
+    const char* type;       // Return type of a function
+    const char* params;     // "int,str"; empty for globals and nullary functions
+} ModuleExport;
+
+// Source file identity as recorded in an interface
+typedef struct {
+    uint64_t size;
+    int64_t modified;       // Nanoseconds since the epoch
+} ModuleStamp;
+
+// Read-only view over a mapped interface file
+typedef struct {
+    const char* name;
+    unsigned flags;
+    ModuleStamp source;
+    uint64_t hash;
+    uint32_t exportCount;
+    uint32_t importCount;
+    uint32_t initCount;
+    const uint8_t* exports;
+    const uint8_t* imports;
+    const uint8_t* inits;
+    const char* strings;
+    uint32_t stringSize;
+
+    void* mapping;
+    size_t mappingSize;
+} ModuleInterface;
+
+bool mapModuleInterface(const char* path, ModuleInterface* module);
+void closeModuleInterface(ModuleInterface* module);
+
+ModuleExport moduleExport(const ModuleInterface* module, uint32_t index);
+const char* moduleImport(const ModuleInterface* module, uint32_t index, uint64_t* hash);
+const char* moduleInit(const ModuleInterface* module, uint32_t index);
+
+// Interface of the module declared by `program`, against the interfaces its
+// imports resolved to in this thread's module cache (see importModule)
+bool writeModuleInterface(const ASTNode* program, const char* name, const ModuleStamp* source, unsigned flags,
+                          const char* path);
+
+bool statModuleSource(const char* path, ModuleStamp* stamp);
+
+// Symbol of a dependency module's initializer: "cpy_init_<name>"
+void moduleInitSymbol(const char* name, char* buffer, size_t size);
+
+// Interfaces loaded by the compilation running on the calling thread. They
+// are looked up in the ':'-separated directories of the search path (the
+// current directory by default) and stay mapped until unloadModules().
+void setModuleSearchPath(const char* path);
+const ModuleInterface* importModule(const char* name);
+void unloadModules();
+
+// For a long-running process (the compilation server): with sharing on,
+// an interface stays mapped after unloadModules() and every thread that
+// imports it reuses that mapping until the file changes on disk, so later
+// compilations neither map nor validate it again. Turning sharing off
+// unmaps those no compilation holds.
+void shareModuleInterfaces(bool share);
+
+// What a compilation's result depends on: every module it looked up, with
+// the hash of the interface found or none. Lets a cache of results (the
+// compilation server) notice that an interface changed, appeared or went.
+typedef struct {
+    char* name;
+    bool found;
+    uint64_t hash;
+} ModuleDependency;
+
+typedef struct {
+    ModuleDependency* items;
+    uint32_t count;
+} ModuleDependencies;
+
+// The modules looked up since the last unloadModules()
+void collectModuleDependencies(ModuleDependencies* dependencies);
+// Whether each still resolves the same way through `searchPath` (NULL for
+// the current directory); does not touch the calling thread's modules
+bool moduleDependenciesCurrent(const ModuleDependencies* dependencies, const char* searchPath);
+void copyModuleDependencies(const ModuleDependencies* from, ModuleDependencies* to);
+void freeModuleDependencies(ModuleDependencies* dependencies);
+
+#endif // MODULE_H
@@ -0,0 +1,27 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "ast.h"
+
+// AST-level optimizations run between semantic analysis and code
+// generation. They rewrite the tree in place.
+
+// Fold `str + str` on string literals into one literal, including
+// `x + "a" + "b"` (concatenation is associative). Returns the number of
+// concatenations removed.
+int foldStringConstants(ASTNode* root);
+
+// Evaluation steps one call may take before it is left to run time
+#define CONSTANT_CALL_FUEL 100000
+
+// Replace calls whose arguments are all literals by the literal they return,
+// when the callee is pure: it reads only its parameters and locals, and calls
+// only len, equals and other pure functions (no globals, no external code,
+// which is where all I/O happens). Calls are evaluated bottom-up, so f(g(1))
+// folds once g(1) has. A call is left alone when it runs out of `fuel`
+// (unbounded recursion, say), divides by zero or does not type-check; the
+// code generator then compiles it, and reports the error, as usual. Returns
+// the number of calls replaced.
+int evaluateConstantCalls(ASTNode* root, long fuel);
+
+#endif // OPTIMIZER_H
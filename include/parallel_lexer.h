@@ -0,0 +1,30 @@
+#ifndef PARALLEL_LEXER_H
+#define PARALLEL_LEXER_H
+
+#include <stddef.h>
+#include "lexer.h"
+
+// Lexing one large source on several threads. The source is cut into
+// chunks just after newlines, guessing that no cut falls inside a string
+// literal (the only token that spans lines), and every chunk is lexed on
+// its own thread. Stitching the chunks back together checks each guess:
+// when the token before a cut runs past it, the chunk after it is lexed
+// again from where that token really ended. The lexer counts every newline
+// it passes exactly once, so a chunk's lines are its own plus the newlines
+// before it. The tokens are exactly those scanToken() returns serially, up
+// to and including TOKEN_EOF.
+
+// Sources smaller than this are not worth the threads
+#define PARALLEL_LEX_THRESHOLD (1u << 20)
+
+typedef struct {
+    Token* tokens;
+    size_t count;
+} TokenList;
+
+// `source` is NUL-terminated and `length` bytes long. It is cut into
+// `chunks` pieces (one per core when < 1), each lexed on a thread of its own.
+void lexParallel(const char* source, size_t length, int chunks, TokenList* list);
+void freeTokenList(TokenList* list);
+
+#endif // PARALLEL_LEXER_H
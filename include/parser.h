@@ -1,9 +1,48 @@
 #ifndef PARSER_H
 #define PARSER_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
 #include "ast.h"
 
 ASTNode* parse();
+
+// Like parse(), but reports a syntax error by returning NULL instead of
+// exiting; the partial tree is freed
+ASTNode* tryParse();
+void setParseErrorStream(FILE* stream);
+
+// Lazy parsing: with it on, a function's body is only brace-matched and
+// recorded as an AST_LAZY_BODY stub holding its source position; the
+// source must then outlive the tree. Passes that read bodies expand them
+// first, which reports the body's syntax errors to the error stream and
+// returns false on one. Analysis and module interfaces need signatures
+// only, so a program checked but not compiled never keeps its bodies.
+void setLazyBodies(bool lazy);
+bool expandFunctionBody(ASTNode* function);
+// Every stub under `root` and its siblings
+bool expandFunctionBodies(ASTNode* root);
+// Parses every stub's body for its syntax errors only, freeing each parsed
+// body at once and leaving the stubs in place; false if any had an error
+bool checkFunctionBodies(ASTNode* root);
+
+// With it on, every token the parser pulls from the lexer is counted and its
+// wall time added to PHASE_LEX (stats.h), so --stats can tell lexing from
+// parsing without lexing the input twice
+void setTokenTiming(bool timed);
+
+// Incremental parsing (incremental.h): parses the top-level declarations
+// that follow the lexer's position (see resumeLexer) one at a time. `accept`
+// receives each with the source range of its tokens, the line its last
+// token ends on and where the next declaration starts (NULL at the end of
+// the input or on a lexical error); it owns the node and returns false to
+// stop early. A syntax error is written to `message` instead of the error
+// stream and makes the call return false; the declaration being parsed when
+// it happened is freed, as with tryParse().
+typedef bool (*DeclarationCallback)(ASTNode* node, const char* start, const char* end, int line, const char* next,
+                                    void* context);
+bool parseDeclarations(DeclarationCallback accept, void* context, char* message, size_t messageSize);
 void initLexer(const char* source);
 
 #endif // PARSER_H
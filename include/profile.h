@@ -0,0 +1,38 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "string_pool.h"
+
+// Execution counts written by a program built with --profile-generate (see
+// cpy_profile.c in the runtime), read back for --profile-use. The file is
+// text, one counter per line:
+//
+//   function <name> <count>
+//   edge <caller> <site> <callee> <count>
+//
+// where <site> numbers the calls in <caller> in source order. Lines starting
+// with '#' are comments. Counts for the same key are added, so profiles of
+// several runs can simply be concatenated.
+
+typedef struct {
+    StringPool keys;            // "function <name>" / "edge <caller> <site> <callee>"
+    uint64_t* counts;           // By key id
+    uint32_t countCapacity;
+    uint64_t maxFunctionCount;
+    uint64_t maxEdgeCount;
+} Profile;
+
+void initProfile(Profile* profile);
+void freeProfile(Profile* profile);
+
+// Adds the counts in `path`; reports malformed files to `err`
+bool loadProfile(Profile* profile, const char* path, FILE* err);
+
+// 0 for functions and call sites the profile has no record of
+uint64_t profileFunctionCount(const Profile* profile, const char* name);
+uint64_t profileEdgeCount(const Profile* profile, const char* caller, uint32_t site, const char* callee);
+
+#endif // PROFILE_H
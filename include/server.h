@@ -0,0 +1,79 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "driver.h"
+
+// Compilation server: `my_compiler --daemon` listens on a Unix domain socket
+// and compiles source files on a worker pool. `my_compiler --client`
+// forwards one compilation to it, with every compile option the command
+// line gave; paths are resolved by the client, so the daemon writes the
+// files the client names. Imports resolve against the forwarded module path,
+// by default the source's directory.
+//
+// Kept warm between requests:
+//   - source file contents, re-read only when the file's stat changes
+//   - imported interfaces, mapped and validated once while unchanged on disk
+//     (shareModuleInterfaces); their globals are still bound into each
+//     compilation's own scope
+//   - results by exact source text, flags and options: the response and,
+//     for --emit-obj, the object bytes, which a hit writes to the path. A
+//     result is only reused while every interface it looked up still
+//     resolves to the same hash. Requests with --stats, --emit-ast,
+//     --emit-asm, --emit-interface or --profile-use are always compiled.
+// A changed source is compiled from scratch: there is no reuse of ASTs or
+// symbol tables below the whole file.
+//
+// Wire format (integers little-endian u32):
+//   request   "CPYQ", kind, flags, path length, path, options length, options
+//   options   one NUL-terminated string per RequestOption, empty when unset
+//   response  exit code, stdout length, stdout, stderr length, stderr
+
+typedef enum {
+    REQUEST_COMPILE,
+    REQUEST_PING,
+    REQUEST_SHUTDOWN
+} RequestKind;
+
+#define REQUEST_FLAG_STATS 1u
+#define REQUEST_FLAG_STATS_JSON 2u
+#define REQUEST_FLAG_CHECK 4u               // --check: diagnostics only
+#define REQUEST_FLAG_NO_ESCAPE_ANALYSIS 8u
+#define REQUEST_FLAG_NO_TAIL_CALLS 16u
+#define REQUEST_FLAG_NO_VECTORIZE 32u
+#define REQUEST_FLAG_NO_CONSTANT_CALLS 64u
+#define REQUEST_FLAG_PROFILE_GENERATE 128u
+
+typedef enum {
+    REQUEST_OPTION_STATS_OUTPUT,
+    REQUEST_OPTION_EMIT_AST,
+    REQUEST_OPTION_EMIT_OBJECT,
+    REQUEST_OPTION_EMIT_ASSEMBLY,
+    REQUEST_OPTION_EMIT_INTERFACE,
+    REQUEST_OPTION_PROFILE_USE,
+    REQUEST_OPTION_MODULE_PATH,
+    REQUEST_OPTION_MODULE_NAME,
+    REQUEST_OPTION_PARALLEL_LEX_BYTES,   // Decimal
+    REQUEST_OPTION_COUNT
+} RequestOption;
+
+typedef struct {
+    int exitCode;
+    char* out;
+    size_t outLength;
+    char* err;
+    size_t errLength;
+} DaemonResponse;
+
+void defaultSocketPath(char* buffer, size_t size);
+int runDaemon(const char* socketPath, int workers);
+
+// Returns false when the daemon cannot be reached. `options` holds
+// REQUEST_OPTION_COUNT strings, NULL for unset ones; it may itself be NULL.
+bool daemonRequest(const char* socketPath, RequestKind kind, unsigned flags, const char* path,
+                   const char* const* options, DaemonResponse* response);
+void freeDaemonResponse(DaemonResponse* response);
+int runClient(const char* socketPath, const char* path, const CompileOptions* options);
+
+#endif // SERVER_H
@@ -0,0 +1,70 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "compat.h"
+
+// Per-phase timing and allocation accounting, reported by `--stats`.
+
+typedef enum {
+    PHASE_LEX,
+    PHASE_PARSE,
+    PHASE_SEMANTIC,
+    PHASE_CODEGEN,
+    PHASE_COUNT
+} CompilerPhase;
+
+typedef enum {
+    MEM_AST,
+    MEM_SYMBOLS,
+    MEM_STRINGS,
+    MEM_SUBSYSTEM_COUNT
+} MemSubsystem;
+
+typedef struct {
+    double wallSeconds;
+    double cpuSeconds;         // Of the compiling thread, not of helpers such as the parallel lexer
+    unsigned long long items;   // Tokens for the lexer, code bytes for codegen, nodes otherwise
+    bool ran;
+    bool cpuEstimated;          // cpuSeconds is a share of another phase's (nestPhase)
+} PhaseStats;
+
+typedef struct {
+    unsigned long long count;
+    unsigned long long bytes;
+} AllocStats;
+
+typedef struct {
+    PhaseStats phases[PHASE_COUNT];
+    AllocStats allocs[MEM_SUBSYSTEM_COUNT];
+    size_t sourceBytes;
+    long peakRSSKilobytes;      // -1 when the platform does not report it
+    // Native int + and - operations, and how many of them were computed in
+    // vector lanes (superword-level parallelism)
+    unsigned long long arithmeticOperations;
+    unsigned long long vectorizedOperations;
+} CompilerStats;
+
+// Allocation counters are always maintained; they are two integer adds.
+// Statistics are per thread, i.e. per compilation in the server.
+extern THREAD_LOCAL CompilerStats compilerStats;
+#define STATS_ALLOC(subsystem, size) \
+    (compilerStats.allocs[(subsystem)].count++, compilerStats.allocs[(subsystem)].bytes += (size))
+
+void resetStats();
+void beginPhase(CompilerPhase phase);
+void endPhase(CompilerPhase phase, unsigned long long items);
+// For an `inner` phase that ran in slices during `outer` and whose wall time
+// and items were added up directly: moves that time out of `outer`, along
+// with the same share of its CPU time. The slices are too short to read the
+// thread CPU clock around each (a system call), so the inner CPU time is an
+// estimate and reported as one.
+void nestPhase(CompilerPhase inner, CompilerPhase outer);
+double wallClock();
+
+void printStatsText(FILE* out);
+void printStatsJSON(FILE* out);
+
+#endif // STATS_H
@@ -0,0 +1,31 @@
+#ifndef STRING_POOL_H
+#define STRING_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Interning table: every distinct string is stored once and identified by a
+// dense id (0, 1, 2, ...) in insertion order. Returned pointers stay valid
+// until the pool is freed.
+typedef struct {
+    char** strings;
+    uint32_t* lengths;
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t* buckets;      // Open addressing, holds id + 1 (0 = empty)
+    uint32_t bucketCount;
+    size_t totalBytes;      // Sum of string lengths, excluding terminators
+} StringPool;
+
+#define STRING_NOT_FOUND UINT32_MAX
+
+void initStringPool(StringPool* pool);
+void freeStringPool(StringPool* pool);
+uint32_t internString(StringPool* pool, const char* s, size_t length);
+// Id of an already interned string, or STRING_NOT_FOUND
+uint32_t findString(const StringPool* pool, const char* s, size_t length);
+const char* poolString(const StringPool* pool, uint32_t id);
+uint32_t poolStringLength(const StringPool* pool, uint32_t id);
+uint32_t hashString(const char* s, size_t length);
+
+#endif // STRING_POOL_H
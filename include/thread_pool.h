@@ -0,0 +1,17 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+// Fixed-size pool of worker threads consuming a FIFO task queue.
+
+typedef void (*TaskFunction)(void* arg);
+
+typedef struct ThreadPool ThreadPool;
+
+ThreadPool* createThreadPool(int workers);
+void submitTask(ThreadPool* pool, TaskFunction function, void* arg);
+void waitThreadPool(ThreadPool* pool);     // Block until every submitted task has finished
+void destroyThreadPool(ThreadPool* pool);  // Finish queued tasks, then join the workers
+int threadPoolSize(const ThreadPool* pool);
+int hardwareThreadCount();
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,40 @@
+#include "cpy_runtime.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Referenced by every instrumented module, so the linker keeps this file
+const char cpy_profile_runtime = 1;
+
+// The linker defines these around the descriptors of all linked modules;
+// they stay NULL when there are none
+extern const CpyProfileModule __start_cpy_prof[] __attribute__((weak));
+extern const CpyProfileModule __stop_cpy_prof[] __attribute__((weak));
+
+int cpy_profile_dump(void) {
+    // Compared as pointers; comparing the arrays draws -Warray-compare
+    const CpyProfileModule* start = __start_cpy_prof;
+    const CpyProfileModule* stop = __stop_cpy_prof;
+    if (!start || start == stop) return 0;
+    const char* path = getenv("CPY_PROFILE_FILE");
+    FILE* out = fopen(path && *path ? path : "cpy.profile", "a");
+    if (!out) return -1;
+
+    fputs("# cpy profile\n", out);
+    for (const CpyProfileModule* module = start; module < stop; module++) {
+        const char* record = module->records;
+        for (uint64_t i = 0; i < module->count; i++) {
+            fprintf(out, "%s %llu\n", record, (unsigned long long)module->counters[i]);
+            record += strlen(record) + 1;
+        }
+    }
+    return fclose(out) == 0 ? 0 : -1;
+}
+
+static void dumpAtExit(void) {
+    if (cpy_profile_dump() != 0) fputs("cpy: could not write the profile\n", stderr);
+}
+
+__attribute__((constructor)) static void registerDump(void) {
+    atexit(dumpAtExit);
+}
@@ -0,0 +1,99 @@
+#ifndef CPY_RUNTIME_H
+#define CPY_RUNTIME_H
+
+#include <stdint.h>
+
+// Runtime support linked into compiled programs.
+//
+// A `str` value is a pointer to NUL-terminated bytes (so it can be handed
+// to C directly) preceded by a CpyStrHeader. Strings are immutable: the
+// length and hash are fixed when the string is created, which makes
+// length O(1) and lets equality reject most unequal pairs without looking
+// at the bytes. Literals are emitted by the compiler in exactly this layout
+// in .rodata, one copy per distinct literal.
+
+typedef struct {
+    uint64_t length;        // Bytes, excluding the terminator
+    uint32_t hash;          // FNV-1a of the bytes, as the compiler computes it
+    uint32_t flags;
+} CpyStrHeader;
+
+#define CPY_STR_STATIC 0x1  // Compile-time literal in .rodata
+#define CPY_STR_HEAP 0x2    // Allocated by the runtime
+
+typedef const char* cpy_str;
+
+static inline const CpyStrHeader* cpy_str_header(cpy_str s) {
+    return (const CpyStrHeader*)s - 1;
+}
+
+static inline int64_t cpy_str_length(cpy_str s) {
+    return (int64_t)cpy_str_header(s)->length;
+}
+
+uint32_t cpy_str_hash(const char* bytes, uint64_t length);
+
+// New heap string holding a copy of `bytes`
+cpy_str cpy_str_new(const char* bytes, uint64_t length);
+
+// 1 if equal, 0 otherwise (an int in the language)
+int64_t cpy_str_equal(cpy_str a, cpy_str b);
+
+// `a + b` on values that were not constant at compile time
+cpy_str cpy_str_concat(cpy_str a, cpy_str b);
+
+// Per-call allocation region for strings the compiler proved never outlive
+// the call (see escape_analysis.h). It lives in the caller's stack frame:
+// allocations are bump-allocated from the inline buffer first, and only the
+// overflow goes to malloc'd chunks, which the function epilogue hands to
+// cpy_region_release. The compiler initializes the fields inline and relies
+// on this exact layout.
+#define CPY_REGION_INLINE_BYTES 512
+
+typedef struct CpyRegionChunk CpyRegionChunk;
+
+typedef struct {
+    char* cursor;
+    char* limit;
+    CpyRegionChunk* chunks;     // Overflow, most recent first; NULL if none
+    char buffer[CPY_REGION_INLINE_BYTES];
+} CpyRegion;
+
+#define CPY_STR_REGION 0x4  // Allocated in a CpyRegion
+
+cpy_str cpy_str_concat_in(CpyRegion* region, cpy_str a, cpy_str b);
+void cpy_region_release(CpyRegionChunk* chunks);
+
+// Allocation counters, for measuring what escape analysis saves
+typedef struct {
+    uint64_t heapAllocations;       // Strings malloc'd individually
+    uint64_t heapBytes;
+    uint64_t regionAllocations;     // Strings placed in a region
+    uint64_t regionBytes;
+    uint64_t regionChunks;          // Region overflow chunks malloc'd
+} CpyAllocStats;
+
+const CpyAllocStats* cpy_alloc_stats(void);
+void cpy_reset_alloc_stats(void);
+
+// Profile counters of a module compiled with --profile-generate. The
+// compiler emits one descriptor per object into the `cpy_prof` section;
+// `counters` holds one execution count per record and `records` the
+// matching NUL-terminated names ("function f", "edge f 0 g"). The
+// descriptor refers to cpy_profile_runtime so linking the module pulls in
+// the dumper, which writes every linked module's counts when the program
+// exits: to $CPY_PROFILE_FILE, or cpy.profile in the working directory.
+// Each run appends, so the file accumulates the counts of all runs.
+typedef struct {
+    uint64_t* counters;
+    const char* records;
+    uint64_t count;
+    const void* runtime;
+} CpyProfileModule;
+
+extern const char cpy_profile_runtime;
+
+// Write the counts now (also done at exit); returns 0 on success
+int cpy_profile_dump(void);
+
+#endif // CPY_RUNTIME_H
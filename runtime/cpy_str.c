@@ -0,0 +1,113 @@
+#include "cpy_runtime.h"
+#include <stdlib.h>
+#include <string.h>
+
+uint32_t cpy_str_hash(const char* bytes, uint64_t length) {
+    // FNV-1a, identical to the compiler's hashString so literal headers and
+    // runtime strings hash alike
+    uint32_t hash = 2166136261u;
+    for (uint64_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static CpyAllocStats allocStats;
+
+const CpyAllocStats* cpy_alloc_stats(void) {
+    return &allocStats;
+}
+
+void cpy_reset_alloc_stats(void) {
+    memset(&allocStats, 0, sizeof(allocStats));
+}
+
+static char* initHeader(CpyStrHeader* header, uint64_t length, uint32_t flags) {
+    header->length = length;
+    header->flags = flags;
+    return (char*)(header + 1);
+}
+
+static char* allocate(uint64_t length) {
+    size_t size = sizeof(CpyStrHeader) + length + 1;
+    CpyStrHeader* header = (CpyStrHeader*)malloc(size);
+    if (!header) abort();
+    allocStats.heapAllocations++;
+    allocStats.heapBytes += size;
+    return initHeader(header, length, CPY_STR_HEAP);
+}
+
+struct CpyRegionChunk {
+    CpyRegionChunk* next;
+    uint64_t padding;           // Keeps the data 16-byte aligned
+};
+
+#define REGION_CHUNK_BYTES 4096
+
+static char* allocateIn(CpyRegion* region, uint64_t length) {
+    size_t size = (sizeof(CpyStrHeader) + length + 1 + 7) & ~(size_t)7;
+    if ((size_t)(region->limit - region->cursor) < size) {
+        // Start a new chunk; the rest of the current one is abandoned
+        size_t chunkBytes = size > REGION_CHUNK_BYTES ? size : REGION_CHUNK_BYTES;
+        CpyRegionChunk* chunk = (CpyRegionChunk*)malloc(sizeof(CpyRegionChunk) + chunkBytes);
+        if (!chunk) abort();
+        chunk->next = region->chunks;
+        region->chunks = chunk;
+        region->cursor = (char*)(chunk + 1);
+        region->limit = region->cursor + chunkBytes;
+        allocStats.regionChunks++;
+    }
+    CpyStrHeader* header = (CpyStrHeader*)region->cursor;
+    region->cursor += size;
+    allocStats.regionAllocations++;
+    allocStats.regionBytes += size;
+    return initHeader(header, length, CPY_STR_REGION);
+}
+
+void cpy_region_release(CpyRegionChunk* chunks) {
+    while (chunks) {
+        CpyRegionChunk* next = chunks->next;
+        free(chunks);
+        chunks = next;
+    }
+}
+
+static cpy_str seal(char* bytes) {
+    CpyStrHeader* header = (CpyStrHeader*)bytes - 1;
+    bytes[header->length] = '\0';
+    header->hash = cpy_str_hash(bytes, header->length);
+    return bytes;
+}
+
+cpy_str cpy_str_new(const char* bytes, uint64_t length) {
+    char* s = allocate(length);
+    memcpy(s, bytes, length);
+    return seal(s);
+}
+
+int64_t cpy_str_equal(cpy_str a, cpy_str b) {
+    if (a == b) return 1; // Pooled literals are shared
+    const CpyStrHeader* x = cpy_str_header(a);
+    const CpyStrHeader* y = cpy_str_header(b);
+    if (x->length != y->length || x->hash != y->hash) return 0;
+    return memcmp(a, b, x->length) == 0;
+}
+
+static cpy_str concatInto(char* s, cpy_str a, uint64_t left, cpy_str b, uint64_t right) {
+    memcpy(s, a, left);
+    memcpy(s + left, b, right);
+    return seal(s);
+}
+
+cpy_str cpy_str_concat(cpy_str a, cpy_str b) {
+    uint64_t left = cpy_str_header(a)->length;
+    uint64_t right = cpy_str_header(b)->length;
+    return concatInto(allocate(left + right), a, left, b, right);
+}
+
+cpy_str cpy_str_concat_in(CpyRegion* region, cpy_str a, cpy_str b) {
+    uint64_t left = cpy_str_header(a)->length;
+    uint64_t right = cpy_str_header(b)->length;
+    return concatInto(allocateIn(region, left + right), a, left, b, right);
+}
@@ -0,0 +1,82 @@
+#include "arena.h"
+#include "compat.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_CHUNK_SIZE (64 * 1024)
+#define ARENA_ALIGNMENT 16
+
+static THREAD_LOCAL Arena threadArena;
+
+void initArena(Arena* arena) {
+    memset(arena, 0, sizeof(Arena));
+}
+
+void freeArena(Arena* arena) {
+    ArenaChunk* chunk = arena->first;
+    while (chunk) {
+        ArenaChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    initArena(arena);
+}
+
+static ArenaChunk* newChunk(Arena* arena, size_t minimum) {
+    size_t size = minimum > ARENA_CHUNK_SIZE ? minimum : ARENA_CHUNK_SIZE;
+    ArenaChunk* chunk = (ArenaChunk*)malloc(sizeof(ArenaChunk) + size);
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+    arena->reservedBytes += size;
+    return chunk;
+}
+
+void* arenaAlloc(Arena* arena, size_t size) {
+    size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+
+    ArenaChunk* chunk = arena->current;
+    if (chunk && chunk->size - chunk->used >= size) {
+        void* p = chunk->data + chunk->used;
+        chunk->used += size;
+        return p;
+    }
+
+    // Reuse a chunk left over from an earlier release if it is big enough
+    if (chunk && chunk->next && chunk->next->size >= size) {
+        chunk = chunk->next;
+    } else {
+        ArenaChunk* fresh = newChunk(arena, size);
+        if (chunk) {
+            fresh->next = chunk->next;
+            chunk->next = fresh;
+        } else {
+            fresh->next = arena->first;
+            arena->first = fresh;
+        }
+        chunk = fresh;
+    }
+    chunk->used = size;
+    arena->current = chunk;
+    return chunk->data;
+}
+
+ArenaMark arenaMark(const Arena* arena) {
+    ArenaMark mark = {arena->current, arena->current ? arena->current->used : 0};
+    return mark;
+}
+
+void arenaRelease(Arena* arena, ArenaMark mark) {
+    arena->current = mark.chunk;
+    if (mark.chunk) {
+        mark.chunk->used = mark.used;
+    } else if (arena->first) {
+        // Released to the very beginning: restart in the first chunk
+        arena->first->used = 0;
+        arena->current = arena->first;
+    }
+}
+
+Arena* compilationArena() {
+    return &threadArena;
+}
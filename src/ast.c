@@ -1,43 +1,70 @@
 #include "ast.h"
+#include "stats.h"
+#include "ast_visitor.h"
+#include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+#define PAYLOAD(member) sizeof(((ASTNode*)0)->data.member)
+#define WORDS(count) ((count) * sizeof(void*))
+
+static const uint8_t payloadSizes[AST_NODE_TYPE_COUNT] = {
+    [AST_VAR_DECL] = PAYLOAD(varDecl),
+    [AST_FUNC_DECL] = PAYLOAD(funcDecl),
+    [AST_PARAM] = PAYLOAD(param),
+    [AST_BLOCK] = PAYLOAD(block),
+    [AST_EXPR_STMT] = PAYLOAD(exprStmt),
+    [AST_BINARY_EXPR] = PAYLOAD(binaryExpr),
+    [AST_LITERAL] = PAYLOAD(literal),
+    [AST_IDENTIFIER] = PAYLOAD(identifier),
+    [AST_CALL_EXPR] = PAYLOAD(callExpr),
+    [AST_RETURN_STMT] = PAYLOAD(returnStmt),
+    [AST_IMPORT] = PAYLOAD(import),
+    [AST_LAZY_BODY] = PAYLOAD(lazyBody),
+};
+
+// Size budget: a word holding the kind and the scalar fields, `next`, then
+// the payload
+_Static_assert(AST_NODE_TYPE_COUNT <= UINT8_MAX + 1, "ASTNodeType must fit ASTNode.type");
+_Static_assert(offsetof(ASTNode, data) == WORDS(2), "ASTNode header is its kind and `next`");
+_Static_assert(offsetof(ASTNode, data) + PAYLOAD(identifier) <= WORDS(3), "identifier nodes take three words");
+_Static_assert(offsetof(ASTNode, data) + PAYLOAD(literal) <= WORDS(3), "literal nodes take three words");
+_Static_assert(offsetof(ASTNode, data) + PAYLOAD(binaryExpr) <= WORDS(4), "binary nodes take four words");
+_Static_assert(offsetof(ASTNode, data) + PAYLOAD(callExpr) <= WORDS(4), "call nodes take four words");
+_Static_assert(sizeof(ASTNode) <= WORDS(6), "no node takes more than six words");
+// Constant folding rewrites these into literals in place
+_Static_assert(PAYLOAD(literal) <= PAYLOAD(binaryExpr) && PAYLOAD(literal) <= PAYLOAD(callExpr),
+               "a literal must fit where an operation or call was");
+
+size_t astNodeSize(ASTNodeType type) {
+    return offsetof(ASTNode, data) + payloadSizes[type];
+}
+
 ASTNode* newASTNode(ASTNodeType type) {
-    ASTNode* node = (ASTNode*)malloc(sizeof(ASTNode));
-    node->type = type;
+    size_t size = astNodeSize(type);
+    ASTNode* node = (ASTNode*)malloc(size);
+    STATS_ALLOC(MEM_AST, size);
+    memset(node, 0, size); // Optional children (params, return value) default to NULL
+    node->type = (uint8_t)type;
     node->next = NULL;
     return node;
 }
 
-void freeAST(ASTNode* node) {
-    if (!node) return;
-
+void freeASTNode(ASTNode* node) {
     switch (node->type) {
         case AST_VAR_DECL:
             free(node->data.varDecl.varType);
             free(node->data.varDecl.name);
-            freeAST(node->data.varDecl.initializer);
             break;
         case AST_FUNC_DECL:
             free(node->data.funcDecl.returnType);
             free(node->data.funcDecl.name);
-            freeAST(node->data.funcDecl.params);
-            freeAST(node->data.funcDecl.body);
             break;
         case AST_PARAM:
             free(node->data.param.paramType);
             free(node->data.param.name);
             break;
-        case AST_BLOCK:
-            freeAST(node->data.block.declarations);
-            break;
-        case AST_EXPR_STMT:
-            freeAST(node->data.exprStmt.expression);
-            break;
-        case AST_BINARY_EXPR:
-            freeAST(node->data.binaryExpr.left);
-            freeAST(node->data.binaryExpr.right);
-            break;
         case AST_LITERAL:
             free(node->data.literal.value);
             break;
@@ -46,10 +73,28 @@ void freeAST(ASTNode* node) {
             break;
         case AST_CALL_EXPR:
             free(node->data.callExpr.callee);
-            freeAST(node->data.callExpr.arguments);
+            break;
+        case AST_IMPORT:
+            free(node->data.import.module);
+            break;
+        case AST_BLOCK:
+        case AST_EXPR_STMT:
+        case AST_BINARY_EXPR:
+        case AST_RETURN_STMT:
+        case AST_LAZY_BODY:
             break;
     }
-
-    freeAST(node->next);
     free(node);
 }
+
+// Post-order: a node's children and `next` have been read before it is freed
+static void freeNode(ASTNode* node, int depth, void* context) {
+    (void)depth;
+    (void)context;
+    freeASTNode(node);
+}
+
+void freeAST(ASTNode* node) {
+    ASTVisitor visitor = {NULL, freeNode, NULL};
+    walkAST(node, &visitor);
+}
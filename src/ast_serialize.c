@@ -0,0 +1,706 @@
+#include "ast_serialize.h"
+#include "string_pool.h"
+#include "stats.h"
+#include "compat.h"
+#include "lexer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Field layout per node kind, in record order after the kind byte and `next`:
+// 's' = interned string, 'c' = child node, 'o' = operator byte
+static const char* const nodeLayouts[] = {
+    [AST_VAR_DECL]    = "ssc",
+    [AST_FUNC_DECL]   = "sscc",
+    [AST_PARAM]       = "ss",
+    [AST_BLOCK]       = "c",
+    [AST_EXPR_STMT]   = "c",
+    [AST_BINARY_EXPR] = "occ",
+    [AST_LITERAL]     = "s",
+    [AST_IDENTIFIER]  = "s",
+    [AST_CALL_EXPR]   = "sc",
+    [AST_RETURN_STMT] = "c",
+    [AST_IMPORT]      = "s",
+};
+
+#define NODE_KIND_COUNT ((int)(sizeof(nodeLayouts) / sizeof(nodeLayouts[0])))
+#define MAX_FIELDS 4
+
+// ---------------------------------------------------------------------------
+// Byte helpers
+// ---------------------------------------------------------------------------
+
+static void reserve(ASTBuffer* buffer, size_t extra) {
+    if (buffer->size + extra <= buffer->capacity) return;
+    size_t capacity = buffer->capacity ? buffer->capacity : 4096;
+    while (capacity < buffer->size + extra) capacity *= 2;
+    buffer->data = (uint8_t*)realloc(buffer->data, capacity);
+    buffer->capacity = capacity;
+}
+
+static void putByte(ASTBuffer* buffer, uint8_t byte) {
+    reserve(buffer, 1);
+    buffer->data[buffer->size++] = byte;
+}
+
+static void putVarint(ASTBuffer* buffer, uint32_t value) {
+    reserve(buffer, 5);
+    while (value >= 0x80) {
+        buffer->data[buffer->size++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    buffer->data[buffer->size++] = (uint8_t)value;
+}
+
+static void putU32At(uint8_t* p, uint32_t value) {
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    p[2] = (uint8_t)(value >> 16);
+    p[3] = (uint8_t)(value >> 24);
+}
+
+static uint32_t getU32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static const uint8_t* getVarint(const uint8_t* p, const uint8_t* end, uint32_t* value) {
+    uint32_t result = 0;
+    for (int shift = 0; shift < 35 && p < end; shift += 7) {
+        uint8_t byte = *p++;
+        result |= (uint32_t)(byte & 0x7F) << shift;
+        if (shift == 28 && byte > 0x0F) return NULL;    // Past 32 bits
+        if (!(byte & 0x80)) {
+            *value = result;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+void freeASTBuffer(ASTBuffer* buffer) {
+    free(buffer->data);
+    buffer->data = NULL;
+    buffer->size = 0;
+    buffer->capacity = 0;
+}
+
+// ---------------------------------------------------------------------------
+// Writer
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    ASTBuffer nodes;
+    StringPool strings;
+    uint32_t nodeCount;
+    bool unexpanded;        // Met an AST_LAZY_BODY, which has no serialized form
+} Writer;
+
+// Collect a node's fields in layout order
+static void nodeFields(const ASTNode* node, const char* strings[MAX_FIELDS], const ASTNode* children[MAX_FIELDS], int* op) {
+    switch (node->type) {
+        case AST_VAR_DECL:
+            strings[0] = node->data.varDecl.varType;
+            strings[1] = node->data.varDecl.name;
+            children[0] = node->data.varDecl.initializer;
+            break;
+        case AST_FUNC_DECL:
+            strings[0] = node->data.funcDecl.returnType;
+            strings[1] = node->data.funcDecl.name;
+            children[0] = node->data.funcDecl.params;
+            children[1] = node->data.funcDecl.body;
+            break;
+        case AST_PARAM:
+            strings[0] = node->data.param.paramType;
+            strings[1] = node->data.param.name;
+            break;
+        case AST_BLOCK:
+            children[0] = node->data.block.declarations;
+            break;
+        case AST_EXPR_STMT:
+            children[0] = node->data.exprStmt.expression;
+            break;
+        case AST_BINARY_EXPR:
+            *op = (unsigned char)node->operator;
+            children[0] = node->data.binaryExpr.left;
+            children[1] = node->data.binaryExpr.right;
+            break;
+        case AST_LITERAL:
+            strings[0] = node->data.literal.value;
+            break;
+        case AST_IDENTIFIER:
+            strings[0] = node->data.identifier.name;
+            break;
+        case AST_CALL_EXPR:
+            strings[0] = node->data.callExpr.callee;
+            children[0] = node->data.callExpr.arguments;
+            break;
+        case AST_RETURN_STMT:
+            children[0] = node->data.returnStmt.value;
+            break;
+        case AST_IMPORT:
+            strings[0] = node->data.import.module;
+            break;
+    }
+}
+
+static void putRef(ASTBuffer* buffer, ASTRef self, ASTRef target) {
+    putVarint(buffer, target == AST_REF_NULL ? 0 : self - target);
+}
+
+// Write one record; `refs` holds the already written `next` sibling, then
+// the heads of the child lists
+static ASTRef writeRecord(Writer* writer, const ASTNode* node, const ASTRef refs[MAX_FIELDS + 1]) {
+    if (node->type == AST_LAZY_BODY) {
+        writer->unexpanded = true;
+        return AST_REF_NULL;
+    }
+    const char* strings[MAX_FIELDS] = {0};
+    const ASTNode* children[MAX_FIELDS] = {0};
+    int op = 0;
+    nodeFields(node, strings, children, &op);
+
+    ASTRef self = (ASTRef)writer->nodes.size;
+    putByte(&writer->nodes, (uint8_t)node->type);
+    putRef(&writer->nodes, self, refs[0]);
+
+    int s = 0, c = 0;
+    for (const char* field = nodeLayouts[node->type]; *field; field++) {
+        if (*field == 's') {
+            const char* str = strings[s++];
+            putVarint(&writer->nodes, str ? internString(&writer->strings, str, strlen(str)) + 1 : 0);
+        } else if (*field == 'c') {
+            putRef(&writer->nodes, self, refs[1 + c++]);
+        } else {
+            putByte(&writer->nodes, (uint8_t)op);
+        }
+    }
+
+    writer->nodeCount++;
+    return self;
+}
+
+// A node waiting on the writer's stack for what it refers to: its `next`
+// sibling, then each child list, are written before it, so every reference
+// in its record points backwards
+typedef struct {
+    const ASTNode* node;
+    const ASTNode* pending[MAX_FIELDS + 1];
+    ASTRef refs[MAX_FIELDS + 1];
+    int written;
+} WriteFrame;
+
+static void pushWriteFrame(WriteFrame** stack, size_t* depth, size_t* capacity, const ASTNode* node) {
+    if (*depth == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 64;
+        *stack = (WriteFrame*)realloc(*stack, *capacity * sizeof(WriteFrame));
+    }
+    WriteFrame* frame = &(*stack)[(*depth)++];
+    memset(frame, 0, sizeof(WriteFrame));
+    frame->node = node;
+    frame->pending[0] = node->next;
+    const char* strings[MAX_FIELDS] = {0};
+    int op = 0;
+    nodeFields(node, strings, frame->pending + 1, &op);
+}
+
+// Iterative, so neither deep expressions nor long lists grow the C stack
+static ASTRef writeList(Writer* writer, const ASTNode* head) {
+    if (!head) return AST_REF_NULL;
+
+    WriteFrame* stack = NULL;
+    size_t depth = 0, capacity = 0;
+    ASTRef result = AST_REF_NULL;
+    pushWriteFrame(&stack, &depth, &capacity, head);
+    while (depth > 0) {
+        WriteFrame* frame = &stack[depth - 1];
+        if (frame->written <= MAX_FIELDS) {
+            const ASTNode* target = frame->pending[frame->written];
+            if (target) {
+                pushWriteFrame(&stack, &depth, &capacity, target);
+            } else {
+                frame->refs[frame->written++] = AST_REF_NULL;
+            }
+            continue;
+        }
+        ASTRef self = writeRecord(writer, frame->node, frame->refs);
+        if (--depth > 0) {
+            WriteFrame* parent = &stack[depth - 1];
+            parent->refs[parent->written++] = self;
+        } else {
+            result = self;
+        }
+    }
+    free(stack);
+    return result;
+}
+
+bool serializeAST(const ASTNode* root, ASTBuffer* out, FILE* err) {
+    Writer writer;
+    memset(&writer, 0, sizeof(Writer));
+    initStringPool(&writer.strings);
+
+    ASTRef rootRef = writeList(&writer, root);
+    if (writer.unexpanded) {
+        fprintf(err, "Error: Cannot serialize a function body that was not parsed.\n");
+        freeASTBuffer(&writer.nodes);
+        freeStringPool(&writer.strings);
+        return false;
+    }
+
+    uint32_t stringCount = writer.strings.count;
+    size_t stringDataSize = writer.strings.totalBytes + stringCount;
+    size_t nodeOffset = AST_FORMAT_HEADER_SIZE;
+    size_t stringTableOffset = nodeOffset + writer.nodes.size;
+    size_t totalSize = stringTableOffset + (size_t)stringCount * 4 + stringDataSize;
+
+    if (totalSize > UINT32_MAX) {
+        fprintf(err, "Error: AST too large to serialize (%zu bytes).\n", totalSize);
+        freeASTBuffer(&writer.nodes);
+        freeStringPool(&writer.strings);
+        return false;
+    }
+
+    memset(out, 0, sizeof(ASTBuffer));
+    reserve(out, totalSize);
+    uint8_t* p = out->data;
+
+    memcpy(p, AST_FORMAT_MAGIC, 4);
+    p[4] = AST_FORMAT_VERSION & 0xFF;
+    p[5] = AST_FORMAT_VERSION >> 8;
+    p[6] = 0;
+    p[7] = 0;
+    putU32At(p + 8, writer.nodeCount);
+    putU32At(p + 12, rootRef);
+    putU32At(p + 16, (uint32_t)nodeOffset);
+    putU32At(p + 20, (uint32_t)writer.nodes.size);
+    putU32At(p + 24, stringCount);
+    putU32At(p + 28, (uint32_t)stringTableOffset);
+    putU32At(p + 32, (uint32_t)stringDataSize);
+    putU32At(p + 36, 0);
+
+    if (writer.nodes.size) memcpy(p + nodeOffset, writer.nodes.data, writer.nodes.size);
+
+    uint8_t* offsets = p + stringTableOffset;
+    char* data = (char*)(offsets + (size_t)stringCount * 4);
+    uint32_t cursor = 0;
+    for (uint32_t id = 0; id < stringCount; id++) {
+        uint32_t length = poolStringLength(&writer.strings, id);
+        putU32At(offsets + (size_t)id * 4, cursor);
+        memcpy(data + cursor, poolString(&writer.strings, id), length + 1);
+        cursor += length + 1;
+    }
+
+    out->size = totalSize;
+    freeASTBuffer(&writer.nodes);
+    freeStringPool(&writer.strings);
+    return true;
+}
+
+bool writeASTFile(const ASTNode* root, const char* path, FILE* err) {
+    ASTBuffer buffer;
+    if (!serializeAST(root, &buffer, err)) return false;
+
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        fprintf(err, "Error: Could not open '%s' for writing.\n", path);
+        freeASTBuffer(&buffer);
+        return false;
+    }
+    bool ok = fwrite(buffer.data, 1, buffer.size, file) == buffer.size;
+    ok = fclose(file) == 0 && ok;
+    if (!ok) fprintf(err, "Error: Failed to write '%s'.\n", path);
+    freeASTBuffer(&buffer);
+    return ok;
+}
+
+// ---------------------------------------------------------------------------
+// Reader
+// ---------------------------------------------------------------------------
+
+static bool testBit(const uint8_t* bits, uint32_t offset) {
+    return (bits[offset / 8] >> (offset % 8)) & 1;
+}
+
+static void setBit(uint8_t* bits, uint32_t offset) {
+    bits[offset / 8] |= (uint8_t)(1u << (offset % 8));
+}
+
+// A reference `distance` back from the record at `self` must land on an
+// earlier record that nothing else refers to, so the nodes form a tree
+static bool checkRef(uint32_t self, uint32_t distance, const uint8_t* starts, uint8_t* referenced) {
+    if (distance == 0) return true;
+    if (distance > self || !testBit(starts, self - distance) || testBit(referenced, self - distance)) return false;
+    setBit(referenced, self - distance);
+    return true;
+}
+
+// One pass over the node section, record by record
+static bool checkNodes(const ASTView* view) {
+    size_t bitmapSize = (size_t)view->nodeSectionSize / 8 + 1;
+    uint8_t* starts = (uint8_t*)calloc(2, bitmapSize);
+    uint8_t* referenced = starts + bitmapSize;
+    const uint8_t* end = view->nodes + view->nodeSectionSize;
+    uint32_t count = 0;
+    bool valid = true;
+    for (const uint8_t* p = view->nodes; valid && p < end; count++) {
+        uint32_t self = (uint32_t)(p - view->nodes);
+        setBit(starts, self);
+        uint8_t kind = *p++;
+        uint32_t value;
+        valid = kind < NODE_KIND_COUNT && kind != AST_LAZY_BODY && nodeLayouts[kind] &&
+                (p = getVarint(p, end, &value)) && checkRef(self, value, starts, referenced);
+        for (const char* field = valid ? nodeLayouts[kind] : ""; valid && *field; field++) {
+            if (*field == 'o') {
+                valid = p < end && *p <= TOKEN_ERROR;
+                p++;
+            } else if (!(p = getVarint(p, end, &value))) {
+                valid = false;
+            } else if (*field == 's') {
+                valid = value <= view->stringCount;
+            } else {
+                valid = checkRef(self, value, starts, referenced);
+            }
+        }
+    }
+    valid = valid && count == view->nodeCount &&
+            (view->root == AST_REF_NULL || (view->root < view->nodeSectionSize && testBit(starts, view->root)));
+    for (uint32_t id = 0; valid && id < view->stringCount; id++) {
+        valid = getU32(view->stringOffsets + (size_t)id * 4) < view->stringDataSize;
+    }
+    free(starts);
+    return valid;
+}
+
+bool openASTView(ASTView* view, const void* data, size_t size, FILE* err) {
+    const uint8_t* p = (const uint8_t*)data;
+    memset(view, 0, sizeof(ASTView));
+    view->root = AST_REF_NULL;
+
+    if (size < AST_FORMAT_HEADER_SIZE || memcmp(p, AST_FORMAT_MAGIC, 4) != 0) {
+        fprintf(err, "Error: Not a serialized AST.\n");
+        return false;
+    }
+    uint16_t version = (uint16_t)(p[4] | (p[5] << 8));
+    if (version != AST_FORMAT_VERSION) {
+        fprintf(err, "Error: Unsupported AST format version %u.\n", version);
+        return false;
+    }
+
+    uint32_t nodeOffset = getU32(p + 16);
+    uint32_t nodeSize = getU32(p + 20);
+    uint32_t stringCount = getU32(p + 24);
+    uint32_t stringTableOffset = getU32(p + 28);
+    uint32_t stringDataSize = getU32(p + 32);
+
+    if ((uint64_t)nodeOffset + nodeSize > size ||
+        (uint64_t)stringTableOffset + (uint64_t)stringCount * 4 + stringDataSize > size ||
+        (stringDataSize > 0 && p[stringTableOffset + (size_t)stringCount * 4 + stringDataSize - 1] != '\0')) {
+        fprintf(err, "Error: Serialized AST is truncated or corrupt.\n");
+        return false;
+    }
+
+    view->nodes = p + nodeOffset;
+    view->nodeSectionSize = nodeSize;
+    view->nodeCount = getU32(p + 8);
+    view->root = getU32(p + 12);
+    view->stringOffsets = p + stringTableOffset;
+    view->stringData = (const char*)(view->stringOffsets + (size_t)stringCount * 4);
+    view->stringCount = stringCount;
+    view->stringDataSize = stringDataSize;
+
+    if (!checkNodes(view)) {
+        fprintf(err, "Error: Serialized AST is truncated or corrupt.\n");
+        memset(view, 0, sizeof(ASTView));
+        view->root = AST_REF_NULL;
+        return false;
+    }
+    return true;
+}
+
+bool mapASTFile(const char* path, ASTView* view, FILE* err) {
+    memset(view, 0, sizeof(ASTView));
+#ifndef _WIN32
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(err, "Error: Could not open '%s'.\n", path);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        fprintf(err, "Error: Could not read '%s'.\n", path);
+        close(fd);
+        return false;
+    }
+    size_t size = (size_t)st.st_size;
+    void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        fprintf(err, "Error: Could not map '%s'.\n", path);
+        return false;
+    }
+#else
+    // No mmap here; read the whole file into one buffer instead
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        fprintf(err, "Error: Could not open '%s'.\n", path);
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    size_t size = length > 0 ? (size_t)length : 0;
+    void* mapping = size ? malloc(size) : NULL;
+    if (!mapping || fread(mapping, 1, size, file) != size) {
+        fprintf(err, "Error: Could not read '%s'.\n", path);
+        free(mapping);
+        fclose(file);
+        return false;
+    }
+    fclose(file);
+#endif
+
+    if (!openASTView(view, mapping, size, err)) {
+#ifndef _WIN32
+        munmap(mapping, size);
+#else
+        free(mapping);
+#endif
+        return false;
+    }
+    view->mapping = mapping;
+    view->mappingSize = size;
+    return true;
+}
+
+void closeASTView(ASTView* view) {
+    if (view->mapping) {
+#ifndef _WIN32
+        munmap(view->mapping, view->mappingSize);
+#else
+        free(view->mapping);
+#endif
+    }
+    memset(view, 0, sizeof(ASTView));
+    view->root = AST_REF_NULL;
+}
+
+ASTRef astViewRoot(const ASTView* view) {
+    return view->root;
+}
+
+ASTNodeType astViewKind(const ASTView* view, ASTRef ref) {
+    return (ASTNodeType)view->nodes[ref];
+}
+
+// Decode the record at `ref` up to the requested field. `which` selects the
+// field class ('s', 'c', 'o' or 'n' for next) and `index` its position.
+static bool readField(const ASTView* view, ASTRef ref, char which, int index, uint32_t* value) {
+    if (ref == AST_REF_NULL || ref >= view->nodeSectionSize) return false;
+
+    const uint8_t* p = view->nodes + ref;
+    const uint8_t* end = view->nodes + view->nodeSectionSize;
+    uint8_t kind = *p++;
+    if (kind >= NODE_KIND_COUNT || !nodeLayouts[kind]) return false;
+
+    uint32_t field;
+    if (!(p = getVarint(p, end, &field))) return false;
+    if (which == 'n') {
+        *value = field;
+        return true;
+    }
+
+    int seen = 0;
+    for (const char* layout = nodeLayouts[kind]; *layout; layout++) {
+        if (*layout == 'o') {
+            if (p >= end) return false;
+            field = *p++;
+        } else if (!(p = getVarint(p, end, &field))) {
+            return false;
+        }
+        if (*layout == which && seen++ == index) {
+            *value = field;
+            return true;
+        }
+    }
+    return false;
+}
+
+static ASTRef resolveRef(ASTRef self, bool found, uint32_t distance) {
+    if (!found || distance == 0 || distance > self) return AST_REF_NULL;
+    return self - distance;
+}
+
+ASTRef astViewNext(const ASTView* view, ASTRef ref) {
+    uint32_t distance = 0;
+    bool found = readField(view, ref, 'n', 0, &distance);
+    return resolveRef(ref, found, distance);
+}
+
+ASTRef astViewChild(const ASTView* view, ASTRef ref, int index) {
+    uint32_t distance = 0;
+    bool found = readField(view, ref, 'c', index, &distance);
+    return resolveRef(ref, found, distance);
+}
+
+const char* astViewString(const ASTView* view, ASTRef ref, int index) {
+    uint32_t id = 0;
+    if (!readField(view, ref, 's', index, &id) || id == 0 || id > view->stringCount) return NULL;
+    uint32_t offset = getU32(view->stringOffsets + (size_t)(id - 1) * 4);
+    return offset < view->stringDataSize ? view->stringData + offset : NULL;
+}
+
+int astViewOperator(const ASTView* view, ASTRef ref) {
+    uint32_t op = 0;
+    readField(view, ref, 'o', 0, &op);
+    return (int)op;
+}
+
+static char* copyViewString(const ASTView* view, ASTRef ref, int index) {
+    const char* s = astViewString(view, ref, index);
+    if (!s) return NULL;
+    STATS_ALLOC(MEM_STRINGS, strlen(s) + 1);
+    return _strdup(s);
+}
+
+// A new node with its strings and operator; child lists are linked in later
+static ASTNode* materializeNode(const ASTView* view, ASTRef ref) {
+    ASTNode* node = newASTNode(astViewKind(view, ref));
+    switch (node->type) {
+        case AST_VAR_DECL:
+            node->data.varDecl.varType = copyViewString(view, ref, 0);
+            node->data.varDecl.name = copyViewString(view, ref, 1);
+            break;
+        case AST_FUNC_DECL:
+            node->data.funcDecl.returnType = copyViewString(view, ref, 0);
+            node->data.funcDecl.name = copyViewString(view, ref, 1);
+            break;
+        case AST_PARAM:
+            node->data.param.paramType = copyViewString(view, ref, 0);
+            node->data.param.name = copyViewString(view, ref, 1);
+            break;
+        case AST_BINARY_EXPR:
+            node->operator = (uint8_t)astViewOperator(view, ref);
+            break;
+        case AST_LITERAL:
+            node->data.literal.value = copyViewString(view, ref, 0);
+            break;
+        case AST_IDENTIFIER:
+            node->data.identifier.name = copyViewString(view, ref, 0);
+            break;
+        case AST_CALL_EXPR:
+            node->data.callExpr.callee = copyViewString(view, ref, 0);
+            break;
+        case AST_IMPORT:
+            node->data.import.module = copyViewString(view, ref, 0);
+            break;
+        default:
+            break;
+    }
+    return node;
+}
+
+// Where a node's child list `index` goes, in layout order
+static ASTNode** childSlot(ASTNode* node, int index) {
+    switch (node->type) {
+        case AST_VAR_DECL:
+            return &node->data.varDecl.initializer;
+        case AST_FUNC_DECL:
+            return index == 0 ? &node->data.funcDecl.params : &node->data.funcDecl.body;
+        case AST_BLOCK:
+            return &node->data.block.declarations;
+        case AST_EXPR_STMT:
+            return &node->data.exprStmt.expression;
+        case AST_BINARY_EXPR:
+            return index == 0 ? &node->data.binaryExpr.left : &node->data.binaryExpr.right;
+        case AST_CALL_EXPR:
+            return &node->data.callExpr.arguments;
+        case AST_RETURN_STMT:
+            return &node->data.returnStmt.value;
+        default:
+            return NULL;
+    }
+}
+
+static int childCount(ASTNodeType kind) {
+    int count = 0;
+    for (const char* field = nodeLayouts[kind]; *field; field++) count += *field == 'c';
+    return count;
+}
+
+// One list being rebuilt: `node` is its current element, whose child lists
+// are materialized one at a time on frames above this one
+typedef struct {
+    ASTRef ref;
+    ASTNode* node;
+    int child;
+    ASTNode* head;
+    ASTNode* tail;
+} MaterializeFrame;
+
+static void pushMaterializeFrame(const ASTView* view, MaterializeFrame** stack, size_t* depth, size_t* capacity,
+                                 ASTRef ref) {
+    if (*depth == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 64;
+        *stack = (MaterializeFrame*)realloc(*stack, *capacity * sizeof(MaterializeFrame));
+    }
+    MaterializeFrame* frame = &(*stack)[(*depth)++];
+    memset(frame, 0, sizeof(MaterializeFrame));
+    frame->ref = ref;
+    frame->node = materializeNode(view, ref);
+}
+
+// Iterative for the same reason as writeList()
+static ASTNode* materializeList(const ASTView* view, ASTRef ref) {
+    if (ref == AST_REF_NULL) return NULL;
+
+    MaterializeFrame* stack = NULL;
+    size_t depth = 0, capacity = 0;
+    ASTNode* result = NULL;
+    pushMaterializeFrame(view, &stack, &depth, &capacity, ref);
+    while (depth > 0) {
+        MaterializeFrame* frame = &stack[depth - 1];
+        if (frame->child < childCount((ASTNodeType)frame->node->type)) {
+            ASTRef child = astViewChild(view, frame->ref, frame->child);
+            if (child != AST_REF_NULL) {
+                pushMaterializeFrame(view, &stack, &depth, &capacity, child);
+            } else {
+                frame->child++;
+            }
+            continue;
+        }
+
+        if (frame->tail) {
+            frame->tail->next = frame->node;
+        } else {
+            frame->head = frame->node;
+        }
+        frame->tail = frame->node;
+        frame->ref = astViewNext(view, frame->ref);
+        if (frame->ref != AST_REF_NULL) {
+            frame->node = materializeNode(view, frame->ref);
+            frame->child = 0;
+            continue;
+        }
+
+        ASTNode* list = frame->head;
+        if (--depth > 0) {
+            MaterializeFrame* parent = &stack[depth - 1];
+            *childSlot(parent->node, parent->child++) = list;
+        } else {
+            result = list;
+        }
+    }
+    free(stack);
+    return result;
+}
+
+ASTNode* materializeAST(const ASTView* view) {
+    return materializeList(view, view->root);
+}
@@ -0,0 +1,147 @@
+#include "ast_visitor.h"
+#include "arena.h"
+
+#define SEGMENT_FRAMES 256
+
+typedef struct {
+    ASTNode* node;
+    int depth;
+    int state;              // -1 = not entered, 0..n = next child, n+1 = leave
+    bool followSiblings;
+} Frame;
+
+// Stack segments come from the compilation arena and are kept for reuse
+// while the walk runs, so deep trees only allocate when a new depth is
+// reached for the first time.
+typedef struct Segment {
+    struct Segment* previous;
+    struct Segment* next;
+    int count;
+    Frame frames[SEGMENT_FRAMES];
+} Segment;
+
+typedef struct {
+    Arena* arena;
+    Segment* top;
+} Stack;
+
+static Frame* push(Stack* stack, ASTNode* node, int depth, bool followSiblings) {
+    Segment* segment = stack->top;
+    if (!segment || segment->count == SEGMENT_FRAMES) {
+        Segment* next = segment ? segment->next : NULL;
+        if (!next) {
+            next = (Segment*)arenaAlloc(stack->arena, sizeof(Segment));
+            next->next = NULL;
+            next->previous = segment;
+            if (segment) segment->next = next;
+        }
+        next->count = 0;
+        stack->top = segment = next;
+    }
+    Frame* frame = &segment->frames[segment->count++];
+    frame->node = node;
+    frame->depth = depth;
+    frame->state = -1;
+    frame->followSiblings = followSiblings;
+    return frame;
+}
+
+static Frame* peek(Stack* stack) {
+    Segment* segment = stack->top;
+    if (segment->count == 0) {
+        segment = stack->top = segment->previous;
+        if (!segment) return NULL;
+    }
+    return &segment->frames[segment->count - 1];
+}
+
+static void pop(Stack* stack) {
+    stack->top->count--;
+}
+
+int astChildren(const ASTNode* node, ASTNode* children[AST_MAX_CHILDREN]) {
+    switch (node->type) {
+        case AST_VAR_DECL:
+            children[0] = node->data.varDecl.initializer;
+            return 1;
+        case AST_FUNC_DECL:
+            children[0] = node->data.funcDecl.params;
+            children[1] = node->data.funcDecl.body;
+            return 2;
+        case AST_BLOCK:
+            children[0] = node->data.block.declarations;
+            return 1;
+        case AST_EXPR_STMT:
+            children[0] = node->data.exprStmt.expression;
+            return 1;
+        case AST_BINARY_EXPR:
+            children[0] = node->data.binaryExpr.left;
+            children[1] = node->data.binaryExpr.right;
+            return 2;
+        case AST_CALL_EXPR:
+            children[0] = node->data.callExpr.arguments;
+            return 1;
+        case AST_RETURN_STMT:
+            children[0] = node->data.returnStmt.value;
+            return 1;
+        case AST_PARAM:
+        case AST_LITERAL:
+        case AST_IDENTIFIER:
+        case AST_IMPORT:
+        case AST_LAZY_BODY:
+            break;
+    }
+    return 0;
+}
+
+static bool walk(ASTNode* root, const ASTVisitor* visitor, bool followSiblings) {
+    if (!root) return true;
+
+    Arena* arena = compilationArena();
+    ArenaMark mark = arenaMark(arena);
+    Stack stack = {arena, NULL};
+    bool completed = true;
+
+    push(&stack, root, 0, followSiblings);
+    for (Frame* frame; (frame = peek(&stack)) != NULL;) {
+        ASTNode* node = frame->node;
+        ASTNode* children[AST_MAX_CHILDREN];
+        int count = astChildren(node, children);
+
+        if (frame->state < 0) {
+            VisitResult result = visitor->enter ? visitor->enter(node, frame->depth, visitor->context) : VISIT_CONTINUE;
+            if (result == VISIT_STOP) {
+                completed = false;
+                break;
+            }
+            frame->state = result == VISIT_SKIP_CHILDREN ? count : 0;
+        }
+
+        // Descend into the next non-empty child list
+        while (frame->state < count && !children[frame->state]) frame->state++;
+        if (frame->state < count) {
+            ASTNode* child = children[frame->state++];
+            push(&stack, child, frame->depth + 1, true);
+            continue;
+        }
+
+        int depth = frame->depth;
+        ASTNode* next = frame->followSiblings ? node->next : NULL;
+        pop(&stack);
+        if (visitor->leave) visitor->leave(node, depth, visitor->context);
+
+        // The sibling replaces the finished frame, so long lists stay flat
+        if (next) push(&stack, next, depth, true);
+    }
+
+    arenaRelease(arena, mark);
+    return completed;
+}
+
+bool walkAST(ASTNode* root, const ASTVisitor* visitor) {
+    return walk(root, visitor, true);
+}
+
+bool walkASTNode(ASTNode* node, const ASTVisitor* visitor) {
+    return walk(node, visitor, false);
+}
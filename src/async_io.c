@@ -0,0 +1,265 @@
+#include "async_io.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+struct AsyncIO {
+    unsigned depth;
+    unsigned inFlight;          // Submitted and not yet collected
+    IOCompletion* done;         // Fallback: requests already carried out
+    unsigned doneCount;
+#ifdef __linux__
+    int ring;                   // -1 when using the fallback
+    void* sqMapping;
+    size_t sqMappingSize;
+    void* cqMapping;
+    size_t cqMappingSize;
+    struct io_uring_sqe* sqes;
+    size_t sqesSize;
+    unsigned* sqTail;
+    unsigned* sqMask;
+    unsigned* sqArray;
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned* cqMask;
+    struct io_uring_cqe* cqes;
+    unsigned unsubmitted;       // Queued in the ring but not yet entered
+#endif
+};
+
+#ifdef __linux__
+
+// glibc has no wrappers for the io_uring calls
+
+static int ringSetup(unsigned entries, struct io_uring_params* params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int ringEnter(int ring, unsigned submit, unsigned minComplete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, ring, submit, minComplete, flags, NULL, 0);
+}
+
+static int ringRegister(int ring, unsigned opcode, void* arg, unsigned count) {
+    return (int)syscall(__NR_io_uring_register, ring, opcode, arg, count);
+}
+
+// IORING_OP_READ and IORING_OP_WRITE came after io_uring itself, in 5.6
+static bool ringSupportsReadWrite(int ring) {
+    size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe* probe = (struct io_uring_probe*)calloc(1, size);
+    bool supported = ringRegister(ring, IORING_REGISTER_PROBE, probe, 256) == 0 &&
+                     probe->last_op >= IORING_OP_WRITE &&
+                     (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED) &&
+                     (probe->ops[IORING_OP_WRITE].flags & IO_URING_OP_SUPPORTED);
+    free(probe);
+    return supported;
+}
+
+static void unmapRing(AsyncIO* io) {
+    if (io->sqes && io->sqes != MAP_FAILED) munmap(io->sqes, io->sqesSize);
+    if (io->cqMapping && io->cqMapping != MAP_FAILED && io->cqMapping != io->sqMapping) {
+        munmap(io->cqMapping, io->cqMappingSize);
+    }
+    if (io->sqMapping && io->sqMapping != MAP_FAILED) munmap(io->sqMapping, io->sqMappingSize);
+    close(io->ring);
+    io->ring = -1;
+}
+
+static bool setupRing(AsyncIO* io) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    io->ring = ringSetup(io->depth, &params);
+    if (io->ring < 0) {
+        io->ring = -1;
+        return false;
+    }
+    if (!ringSupportsReadWrite(io->ring)) {
+        unmapRing(io);
+        return false;
+    }
+
+    io->sqMappingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    io->cqMappingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single && io->cqMappingSize > io->sqMappingSize) io->sqMappingSize = io->cqMappingSize;
+    io->sqMapping = mmap(NULL, io->sqMappingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, io->ring,
+                         IORING_OFF_SQ_RING);
+    if (io->sqMapping == MAP_FAILED) {
+        unmapRing(io);
+        return false;
+    }
+    io->cqMapping = single ? io->sqMapping
+                           : mmap(NULL, io->cqMappingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                  io->ring, IORING_OFF_CQ_RING);
+    io->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    io->sqes = (struct io_uring_sqe*)mmap(NULL, io->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                          io->ring, IORING_OFF_SQES);
+    if (io->cqMapping == MAP_FAILED || io->sqes == MAP_FAILED) {
+        unmapRing(io);
+        return false;
+    }
+
+    char* sq = (char*)io->sqMapping;
+    char* cq = (char*)io->cqMapping;
+    io->sqTail = (unsigned*)(sq + params.sq_off.tail);
+    io->sqMask = (unsigned*)(sq + params.sq_off.ring_mask);
+    io->sqArray = (unsigned*)(sq + params.sq_off.array);
+    io->cqHead = (unsigned*)(cq + params.cq_off.head);
+    io->cqTail = (unsigned*)(cq + params.cq_off.tail);
+    io->cqMask = (unsigned*)(cq + params.cq_off.ring_mask);
+    io->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+    return true;
+}
+
+// With at most `depth` requests in flight the submission queue, which
+// holds at least that many, always has room
+static void queueRequest(AsyncIO* io, uint8_t opcode, int fd, const void* buffer, size_t size, uint64_t offset,
+                         void* context) {
+    unsigned tail = *io->sqTail;
+    unsigned index = tail & *io->sqMask;
+    struct io_uring_sqe* sqe = &io->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->off = offset;
+    sqe->addr = (uint64_t)(uintptr_t)buffer;
+    sqe->len = size > 0x7ffff000u ? 0x7ffff000u : (unsigned)size;   // The most one read() moves
+    sqe->user_data = (uint64_t)(uintptr_t)context;
+    io->sqArray[index] = index;
+    __atomic_store_n(io->sqTail, tail + 1, __ATOMIC_RELEASE);
+    io->unsubmitted++;
+    io->inFlight++;
+}
+
+static size_t reapRing(AsyncIO* io, IOCompletion* completions, size_t capacity) {
+    unsigned head = *io->cqHead;
+    unsigned tail = __atomic_load_n(io->cqTail, __ATOMIC_ACQUIRE);
+    size_t count = 0;
+    while (head != tail && count < capacity) {
+        const struct io_uring_cqe* cqe = &io->cqes[head & *io->cqMask];
+        completions[count].context = (void*)(uintptr_t)cqe->user_data;
+        completions[count].result = cqe->res;
+        count++;
+        head++;
+    }
+    __atomic_store_n(io->cqHead, head, __ATOMIC_RELEASE);
+    io->inFlight -= (unsigned)count;
+    return count;
+}
+
+static size_t collectRing(AsyncIO* io, IOCompletion* completions, size_t capacity, bool wait) {
+    size_t count = reapRing(io, completions, capacity);
+    unsigned minComplete = count == 0 && wait && io->inFlight > 0 ? 1 : 0;
+    while (io->unsubmitted > 0 || minComplete > 0) {
+        int entered = ringEnter(io->ring, io->unsubmitted, minComplete, minComplete ? IORING_ENTER_GETEVENTS : 0);
+        if (entered < 0) {
+            if (errno == EINTR) continue;
+            // EAGAIN or EBUSY: the kernel is short of room until completions are reaped
+            break;
+        }
+        io->unsubmitted -= (unsigned)entered;
+        break;
+    }
+    if (count < capacity) count += reapRing(io, completions + count, capacity - count);
+    return count;
+}
+
+#endif // __linux__
+
+AsyncIO* createAsyncIO(unsigned depth, bool useRing) {
+    AsyncIO* io = (AsyncIO*)calloc(1, sizeof(AsyncIO));
+    io->depth = depth > 0 ? depth : 1;
+    io->done = (IOCompletion*)malloc(io->depth * sizeof(IOCompletion));
+#ifdef __linux__
+    io->ring = -1;
+    if (useRing) setupRing(io);
+#else
+    (void)useRing;
+#endif
+    return io;
+}
+
+void destroyAsyncIO(AsyncIO* io) {
+    if (!io) return;
+#ifdef __linux__
+    if (io->ring >= 0) unmapRing(io);
+#endif
+    free(io->done);
+    free(io);
+}
+
+bool asyncIOUsesRing(const AsyncIO* io) {
+#ifdef __linux__
+    return io->ring >= 0;
+#else
+    (void)io;
+    return false;
+#endif
+}
+
+unsigned asyncIOInFlight(const AsyncIO* io) {
+    return io->inFlight;
+}
+
+static void finishNow(AsyncIO* io, int64_t result, void* context) {
+    io->done[io->doneCount].context = context;
+    io->done[io->doneCount].result = result < 0 ? -(int64_t)errno : result;
+    io->doneCount++;
+    io->inFlight++;
+}
+
+void submitRead(AsyncIO* io, int fd, void* buffer, size_t size, uint64_t offset, void* context) {
+#ifdef __linux__
+    if (io->ring >= 0) {
+        queueRequest(io, IORING_OP_READ, fd, buffer, size, offset, context);
+        return;
+    }
+#endif
+#ifdef _WIN32
+    int64_t result = _lseeki64(fd, (long long)offset, SEEK_SET) < 0 ? -1 : _read(fd, buffer, (unsigned)size);
+#else
+    int64_t result = pread(fd, buffer, size, (off_t)offset);
+#endif
+    finishNow(io, result, context);
+}
+
+void submitWrite(AsyncIO* io, int fd, const void* buffer, size_t size, uint64_t offset, void* context) {
+#ifdef __linux__
+    if (io->ring >= 0) {
+        queueRequest(io, IORING_OP_WRITE, fd, buffer, size, offset, context);
+        return;
+    }
+#endif
+#ifdef _WIN32
+    int64_t result = _lseeki64(fd, (long long)offset, SEEK_SET) < 0 ? -1 : _write(fd, buffer, (unsigned)size);
+#else
+    int64_t result = pwrite(fd, buffer, size, (off_t)offset);
+#endif
+    finishNow(io, result, context);
+}
+
+size_t collectCompletions(AsyncIO* io, IOCompletion* completions, size_t capacity, bool wait) {
+#ifdef __linux__
+    if (io->ring >= 0) return collectRing(io, completions, capacity, wait);
+#endif
+    (void)wait;
+    size_t count = io->doneCount < capacity ? io->doneCount : capacity;
+    memcpy(completions, io->done, count * sizeof(IOCompletion));
+    memmove(io->done, io->done + count, (io->doneCount - count) * sizeof(IOCompletion));
+    io->doneCount -= (unsigned)count;
+    io->inFlight -= (unsigned)count;
+    return count;
+}
@@ -0,0 +1,367 @@
+#include "batch.h"
+#include "compat.h"
+#include "lexer.h"
+#include "stats.h"
+#include "string_pool.h"
+
+#ifndef _WIN32
+#include "async_io.h"
+#include "thread_pool.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <threads.h>
+#include <unistd.h>
+
+// Files in flight at once: enough to keep the pool and the disk busy while
+// bounding the sources and objects held in memory
+#define BATCH_DEPTH 64
+
+typedef enum {
+    FILE_WAITING,
+    FILE_READING,
+    FILE_COMPILING,
+    FILE_WRITING,
+    FILE_DONE,
+    FILE_FAILED
+} FileState;
+
+typedef struct Batch Batch;
+
+typedef struct {
+    Batch* batch;
+    char* sourcePath;
+    char* objectPath;
+    FileState state;
+    int fd;
+    char* source;
+    size_t size;
+    size_t transferred;     // Bytes of the source read or of the object written
+    ObjectBuffer object;
+    char* errors;           // Diagnostics of a failed compilation
+} BatchFile;
+
+struct Batch {
+    const BatchOptions* options;
+    BatchFile* files;
+    size_t count;
+    AsyncIO* io;
+    ThreadPool* pool;
+    size_t next;            // First file not started yet
+    size_t active;          // Started and not finished
+    size_t compiling;
+
+    mtx_t lock;
+    cnd_t finished;
+    BatchFile** compiled;   // Compilations done but not yet written
+    size_t compiledCount;
+};
+
+// ---------------------------------------------------------------------------
+// File list
+// ---------------------------------------------------------------------------
+
+static char* copyRange(const char* start, size_t length) {
+    char* copy = (char*)malloc(length + 1);
+    memcpy(copy, start, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+static char* defaultObjectPath(const char* directory, const char* source) {
+    const char* slash = strrchr(source, '/');
+    const char* base = slash ? slash + 1 : source;
+    const char* dot = strrchr(base, '.');
+    size_t baseLength = dot && dot != base ? (size_t)(dot - base) : strlen(base);
+    size_t length = strlen(directory) + baseLength + 4;
+    char* path = (char*)malloc(length);
+    snprintf(path, length, "%s/%.*s.o", directory, (int)baseLength, base);
+    return path;
+}
+
+// Two sources writing one object (a/x.cpy and b/x.cpy by default) would
+// race, so the list is rejected instead
+static bool readFileList(Batch* batch, const char* outputDirectory, FILE* err) {
+    char* list = readSourceFile(batch->options->listPath, NULL);
+    if (!list) {
+        fprintf(err, "Error: Could not read '%s'.\n", batch->options->listPath);
+        return false;
+    }
+    StringPool objects;     // Object id n is that of file n
+    initStringPool(&objects);
+    bool ok = true;
+    size_t capacity = 0;
+    for (char* line = list; ok && *line;) {
+        size_t length = strcspn(line, "\n");
+        char* end = line + length;
+        char* field = line + strspn(line, " \t\r");
+        if (field < end && *field != '#') {
+            size_t sourceLength = strcspn(field, " \t\r\n");
+            char* object = field + sourceLength;
+            object += strspn(object, " \t\r");
+            size_t objectLength = object < end ? strcspn(object, " \t\r\n") : 0;
+
+            if (batch->count == capacity) {
+                capacity = capacity ? capacity * 2 : 256;
+                batch->files = (BatchFile*)realloc(batch->files, capacity * sizeof(BatchFile));
+            }
+            BatchFile* file = &batch->files[batch->count++];
+            memset(file, 0, sizeof(BatchFile));
+            file->batch = batch;
+            file->fd = -1;
+            file->sourcePath = copyRange(field, sourceLength);
+            file->objectPath = objectLength ? copyRange(object, objectLength)
+                                            : defaultObjectPath(outputDirectory, file->sourcePath);
+
+            uint32_t id = internString(&objects, file->objectPath, strlen(file->objectPath));
+            if (objects.count < batch->count) {
+                fprintf(err, "Error: '%s' and '%s' both compile to '%s'; name the object of one in the list.\n",
+                        batch->files[id].sourcePath, file->sourcePath, file->objectPath);
+                ok = false;
+            }
+        }
+        line = *end ? end + 1 : end;
+    }
+    freeStringPool(&objects);
+    free(list);
+    return ok;
+}
+
+// ---------------------------------------------------------------------------
+// Pipeline: read, compile, write
+// ---------------------------------------------------------------------------
+
+static void fail(BatchFile* file, const char* format, const char* path) {
+    size_t length = strlen(format) + strlen(path);
+    free(file->errors);
+    file->errors = (char*)malloc(length);
+    snprintf(file->errors, length, format, path);
+    if (file->fd >= 0) close(file->fd);
+    file->fd = -1;
+    free(file->source);
+    file->source = NULL;
+    free(file->object.data);
+    file->object.data = NULL;
+    file->state = FILE_FAILED;
+    file->batch->active--;
+}
+
+// Runs on a pool worker; compiler state is per-thread
+static void compileFile(void* arg) {
+    BatchFile* file = (BatchFile*)arg;
+    Batch* batch = file->batch;
+
+    CompileOptions options = batch->options->compile;
+    options.stats = false;
+    options.emitASTPath = NULL;
+    options.emitAssemblyPath = NULL;
+    options.emitObjectPath = NULL;
+    options.emitObjectBuffer = &file->object;
+    options.sourcePath = file->sourcePath;
+
+    size_t errorsLength = 0;
+    FILE* err = open_memstream(&file->errors, &errorsLength);
+    bool ok = compileSource(file->source, &options, NULL, err ? err : stderr) == 0;
+    if (err) fclose(err);
+    free(file->source);
+    file->source = NULL;
+    if (!ok) {
+        free(file->object.data);
+        file->object.data = NULL;
+    }
+
+    mtx_lock(&batch->lock);
+    batch->compiled[batch->compiledCount++] = file;
+    cnd_signal(&batch->finished);
+    mtx_unlock(&batch->lock);
+}
+
+static void startCompile(BatchFile* file) {
+    close(file->fd);
+    file->fd = -1;
+    file->source[file->size] = '\0';
+    file->state = FILE_COMPILING;
+    file->batch->compiling++;
+    submitTask(file->batch->pool, compileFile, file);
+}
+
+// Opening and sizing stay synchronous: the read needs the size for its buffer
+static void startRead(BatchFile* file) {
+    file->batch->active++;
+    file->fd = open(file->sourcePath, O_RDONLY);
+    struct stat st;
+    if (file->fd < 0 || fstat(file->fd, &st) != 0 || (uint64_t)st.st_size > MAX_SOURCE_BYTES) {
+        fail(file, "Error: Could not read '%s'.\n", file->sourcePath);
+        return;
+    }
+    file->size = (size_t)st.st_size;
+    file->source = (char*)malloc(file->size + 1);
+    file->state = FILE_READING;
+    if (file->size == 0) {
+        startCompile(file);
+        return;
+    }
+    submitRead(file->batch->io, file->fd, file->source, file->size, 0, file);
+}
+
+static void startWrite(BatchFile* file) {
+    file->batch->compiling--;
+    if (!file->object.data) {
+        file->state = FILE_FAILED;
+        file->batch->active--;
+        return;
+    }
+    file->fd = open(file->objectPath, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (file->fd < 0) {
+        fail(file, "Error: Could not open '%s' for writing.\n", file->objectPath);
+        return;
+    }
+    file->state = FILE_WRITING;
+    file->transferred = 0;
+    submitWrite(file->batch->io, file->fd, file->object.data, file->object.size, 0, file);
+}
+
+// A read or write came back, possibly short
+static void advanceIO(const IOCompletion* completion) {
+    BatchFile* file = (BatchFile*)completion->context;
+    Batch* batch = file->batch;
+    if (completion->result < 0 || (completion->result == 0 && file->state == FILE_WRITING)) {
+        if (file->state == FILE_READING) fail(file, "Error: Could not read '%s'.\n", file->sourcePath);
+        else fail(file, "Error: Could not write '%s'.\n", file->objectPath);
+        return;
+    }
+    file->transferred += (size_t)completion->result;
+    if (file->state == FILE_READING) {
+        // A file that shrank since fstat() ends early
+        if (completion->result > 0 && file->transferred < file->size) {
+            submitRead(batch->io, file->fd, file->source + file->transferred, file->size - file->transferred,
+                       file->transferred, file);
+            return;
+        }
+        file->size = file->transferred;
+        startCompile(file);
+    } else if (file->transferred < file->object.size) {
+        submitWrite(batch->io, file->fd, file->object.data + file->transferred, file->object.size - file->transferred,
+                    file->transferred, file);
+    } else {
+        bool ok = close(file->fd) == 0;
+        file->fd = -1;
+        if (!ok) {
+            fail(file, "Error: Could not write '%s'.\n", file->objectPath);
+            return;
+        }
+        free(file->object.data);
+        file->object.data = NULL;
+        file->state = FILE_DONE;
+        batch->active--;
+    }
+}
+
+// Starts files while there is room, writes compiled ones and handles I/O
+// completions. The loop blocks on the ring while I/O is in flight, picking
+// up compilations that finish meanwhile on its next turn, and on the pool
+// otherwise.
+static void runPipeline(Batch* batch) {
+    IOCompletion completions[BATCH_DEPTH];
+    BatchFile** ready = (BatchFile**)malloc(batch->count * sizeof(BatchFile*));
+    while (batch->next < batch->count || batch->active > 0) {
+        bool progressed = false;
+        while (batch->next < batch->count && batch->active < BATCH_DEPTH) {
+            startRead(&batch->files[batch->next++]);
+            progressed = true;
+        }
+
+        mtx_lock(&batch->lock);
+        size_t readyCount = batch->compiledCount;
+        memcpy(ready, batch->compiled, readyCount * sizeof(BatchFile*));
+        batch->compiledCount = 0;
+        mtx_unlock(&batch->lock);
+        for (size_t i = 0; i < readyCount; i++) startWrite(ready[i]);
+        progressed = progressed || readyCount > 0;
+
+        size_t count = collectCompletions(batch->io, completions, BATCH_DEPTH, !progressed);
+        for (size_t i = 0; i < count; i++) advanceIO(&completions[i]);
+
+        if (!progressed && count == 0 && asyncIOInFlight(batch->io) == 0 && batch->compiling > 0) {
+            mtx_lock(&batch->lock);
+            while (batch->compiledCount == 0) cnd_wait(&batch->finished, &batch->lock);
+            mtx_unlock(&batch->lock);
+        }
+    }
+    free(ready);
+}
+
+static void freeFiles(Batch* batch) {
+    for (size_t i = 0; i < batch->count; i++) {
+        free(batch->files[i].sourcePath);
+        free(batch->files[i].objectPath);
+        free(batch->files[i].errors);
+    }
+    free(batch->files);
+}
+
+static void report(const Batch* batch, BatchSummary* summary, FILE* out, FILE* err) {
+    for (size_t i = 0; i < batch->count; i++) {
+        const BatchFile* file = &batch->files[i];
+        summary->files++;
+        if (file->state == FILE_DONE) {
+            summary->compiled++;
+            continue;
+        }
+        summary->failed++;
+        fprintf(out, "%-12s %s\n", "failed", file->sourcePath);
+        if (file->errors && file->errors[0]) fputs(file->errors, err);
+    }
+    fprintf(out, "%d files: %d compiled, %d failed in %.3f s (%.0f files/s, %s)\n", summary->files,
+            summary->compiled, summary->failed, summary->seconds,
+            summary->seconds > 0 ? summary->files / summary->seconds : 0.0, summary->ring ? "io_uring" : "pread");
+}
+
+int runBatch(const BatchOptions* options, BatchSummary* summary, FILE* out, FILE* err) {
+    BatchSummary local;
+    if (!summary) summary = &local;
+    memset(summary, 0, sizeof(BatchSummary));
+    double start = wallClock();
+
+    Batch batch;
+    memset(&batch, 0, sizeof(Batch));
+    batch.options = options;
+    const char* outputDirectory = options->outputDirectory ? options->outputDirectory : ".";
+    if (!readFileList(&batch, outputDirectory, err)) {
+        freeFiles(&batch);
+        return 1;
+    }
+    mkdir(outputDirectory, 0777);
+
+    mtx_init(&batch.lock, mtx_plain);
+    cnd_init(&batch.finished);
+    batch.compiled = (BatchFile**)malloc((batch.count > 0 ? batch.count : 1) * sizeof(BatchFile*));
+    batch.io = createAsyncIO(BATCH_DEPTH, !options->noRing);
+    batch.pool = createThreadPool(options->jobs > 0 ? options->jobs : hardwareThreadCount());
+    summary->ring = asyncIOUsesRing(batch.io);
+
+    runPipeline(&batch);
+    destroyThreadPool(batch.pool);
+    destroyAsyncIO(batch.io);
+    summary->seconds = wallClock() - start;
+    report(&batch, summary, out, err);
+
+    freeFiles(&batch);
+    free(batch.compiled);
+    cnd_destroy(&batch.finished);
+    mtx_destroy(&batch.lock);
+    return summary->failed == 0 ? 0 : 1;
+}
+
+#else
+
+int runBatch(const BatchOptions* options, BatchSummary* summary, FILE* out, FILE* err) {
+    (void)options;
+    (void)out;
+    if (summary) memset(summary, 0, sizeof(BatchSummary));
+    fprintf(err, "Error: Batch builds need POSIX file I/O.\n");
+    return 1;
+}
+
+#endif
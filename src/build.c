@@ -0,0 +1,441 @@
+#include "build.h"
+#include "lexer.h"
+#include "module.h"
+#include "string_pool.h"
+#include "thread_pool.h"
+#include "compat.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <threads.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <io.h>
+#define mkdir(path, mode) _mkdir(path)
+#define access _access
+#define F_OK 0
+#else
+#include <unistd.h>
+#endif
+
+typedef enum {
+    STATUS_PENDING,
+    STATUS_RUNNING,
+    STATUS_COMPILED,
+    STATUS_UP_TO_DATE,
+    STATUS_FAILED,
+    STATUS_SKIPPED          // An import failed
+} ModuleStatus;
+
+typedef struct {
+    const char* name;           // Owned by Build.names
+    char* sourcePath;
+    char* objectPath;
+    char* interfacePath;
+    bool entry;
+
+    uint32_t* imports;          // Module indices
+    uint64_t* recordedHashes;   // Interface hash of each import when last compiled
+    uint32_t importCount;
+    uint32_t* importers;
+    uint32_t importerCount;
+
+    // The existing interface matches the source, so the imports above were
+    // read from it rather than from the source
+    bool current;
+    uint64_t hash;              // Interface hash, once built or found up to date
+
+    ModuleStatus status;
+    uint32_t waiting;           // Imports not finished yet
+    char* errors;               // Diagnostics of a failed compilation
+} BuildModule;
+
+typedef struct {
+    const BuildOptions* options;
+    const char* outputDirectory;
+    char* sourceDirectory;
+    StringPool names;           // Module name -> index into `modules`
+    BuildModule* modules;
+    uint32_t moduleCapacity;
+
+    mtx_t lock;
+    cnd_t finished;
+    uint32_t* completed;        // Compilations done but not yet processed
+    uint32_t completedCount;
+} Build;
+
+static char* joinPath(const char* directory, const char* name, const char* suffix) {
+    size_t length = strlen(directory) + strlen(name) + strlen(suffix) + 2;
+    char* path = (char*)malloc(length);
+    if (directory[0]) {
+        snprintf(path, length, "%s/%s%s", directory, name, suffix);
+    } else {
+        snprintf(path, length, "%s%s", name, suffix);
+    }
+    return path;
+}
+
+static uint32_t addModule(Build* build, const char* name) {
+    uint32_t known = build->names.count;
+    uint32_t id = internString(&build->names, name, strlen(name));
+    if (id < known) return id;
+    if (id >= build->moduleCapacity) {
+        build->moduleCapacity = build->names.capacity;
+        build->modules = (BuildModule*)realloc(build->modules, build->moduleCapacity * sizeof(BuildModule));
+    }
+    BuildModule* module = &build->modules[id];
+    memset(module, 0, sizeof(BuildModule));
+    module->name = poolString(&build->names, id);
+    module->sourcePath = joinPath(build->sourceDirectory, name, MODULE_SOURCE_SUFFIX);
+    module->objectPath = joinPath(build->outputDirectory, name, ".o");
+    module->interfacePath = joinPath(build->outputDirectory, name, MODULE_INTERFACE_SUFFIX);
+    return id;
+}
+
+static void addImport(BuildModule* module, uint32_t import, uint64_t recordedHash) {
+    for (uint32_t i = 0; i < module->importCount; i++) {
+        if (module->imports[i] == import) return;
+    }
+    module->imports = (uint32_t*)realloc(module->imports, (module->importCount + 1) * sizeof(uint32_t));
+    module->recordedHashes = (uint64_t*)realloc(module->recordedHashes, (module->importCount + 1) * sizeof(uint64_t));
+    module->imports[module->importCount] = import;
+    module->recordedHashes[module->importCount++] = recordedHash;
+}
+
+// ---------------------------------------------------------------------------
+// Discovery
+// ---------------------------------------------------------------------------
+
+// `import name;` declarations are only allowed at the top level, so a token
+// scan finds them without parsing the bodies
+static void scanImports(Build* build, uint32_t index, const char* source) {
+    initLexer(source);
+    int depth = 0;
+    for (Token token = scanToken(); token.type != TOKEN_EOF && token.type != TOKEN_ERROR; token = scanToken()) {
+        if (token.type == TOKEN_LBRACE) depth++;
+        if (token.type == TOKEN_RBRACE) depth--;
+        if (token.type != TOKEN_IMPORT || depth != 0) continue;
+        Token name = scanToken();
+        if (name.type != TOKEN_IDENTIFIER) continue;    // The compiler reports it
+        char* module = (char*)malloc((size_t)name.length + 1);
+        memcpy(module, tokenStart(name), (size_t)name.length);
+        module[name.length] = '\0';
+        uint32_t import = addModule(build, module);
+        free(module);
+        addImport(&build->modules[index], import, 0);
+    }
+}
+
+static bool objectExists(const char* path) {
+    return access(path, F_OK) == 0;
+}
+
+// Imports of one module, from its interface when that is current and from
+// its source otherwise
+static bool discoverModule(Build* build, uint32_t index, FILE* err) {
+    BuildModule* module = &build->modules[index];
+    ModuleStamp stamp;
+    if (!statModuleSource(module->sourcePath, &stamp)) {
+        fprintf(err, "Error: Module '%s' not found (no '%s').\n", module->name, module->sourcePath);
+        return false;
+    }
+
+    ModuleInterface interface;
+    if (mapModuleInterface(module->interfacePath, &interface)) {
+        module->current = interface.source.size == stamp.size && interface.source.modified == stamp.modified &&
+                          strcmp(interface.name, module->name) == 0 &&
+                          !(interface.flags & MODULE_FLAG_ENTRY) == !module->entry &&
+                          objectExists(module->objectPath);
+        if (module->current) {
+            module->hash = interface.hash;
+            for (uint32_t i = 0; i < interface.importCount; i++) {
+                uint64_t hash;
+                const char* name = moduleImport(&interface, i, &hash);
+                uint32_t import = addModule(build, name);
+                addImport(&build->modules[index], import, hash);
+            }
+        }
+        closeModuleInterface(&interface);
+        if (build->modules[index].current) return true;
+    }
+
+    char* source = readSourceFile(build->modules[index].sourcePath, NULL);
+    if (!source) {
+        fprintf(err, "Error: Could not read '%s'.\n", build->modules[index].sourcePath);
+        return false;
+    }
+    scanImports(build, index, source);
+    free(source);
+    return true;
+}
+
+// Kahn's algorithm; modules left over sit on an import cycle
+static uint32_t* dependencyOrder(Build* build, FILE* err) {
+    uint32_t count = build->names.count;
+    for (uint32_t i = 0; i < count; i++) {
+        BuildModule* module = &build->modules[i];
+        module->waiting = module->importCount;
+        for (uint32_t j = 0; j < module->importCount; j++) {
+            BuildModule* import = &build->modules[module->imports[j]];
+            import->importers = (uint32_t*)realloc(import->importers, (import->importerCount + 1) * sizeof(uint32_t));
+            import->importers[import->importerCount++] = i;
+        }
+    }
+
+    uint32_t* order = (uint32_t*)malloc(count * sizeof(uint32_t));
+    uint32_t* waiting = (uint32_t*)malloc(count * sizeof(uint32_t));
+    uint32_t ordered = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        waiting[i] = build->modules[i].waiting;
+        if (waiting[i] == 0) order[ordered++] = i;
+    }
+    for (uint32_t next = 0; next < ordered; next++) {
+        const BuildModule* module = &build->modules[order[next]];
+        for (uint32_t j = 0; j < module->importerCount; j++) {
+            if (--waiting[module->importers[j]] == 0) order[ordered++] = module->importers[j];
+        }
+    }
+    free(waiting);
+    if (ordered < count) {
+        for (uint32_t i = 0; i < count; i++) {
+            if (build->modules[i].waiting == 0) continue;
+            bool placed = false;
+            for (uint32_t j = 0; j < ordered; j++) placed = placed || order[j] == i;
+            if (!placed) {
+                fprintf(err, "Error: Import cycle through module '%s'.\n", build->modules[i].name);
+                break;
+            }
+        }
+        free(order);
+        return NULL;
+    }
+    return order;
+}
+
+// ---------------------------------------------------------------------------
+// Compilation
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    Build* build;
+    uint32_t index;
+} CompileJob;
+
+static char* readStream(FILE* stream) {
+    long length = ftell(stream);
+    char* text = (char*)malloc(length > 0 ? (size_t)length + 1 : 1);
+    size_t read = 0;
+    if (length > 0) {
+        rewind(stream);
+        read = fread(text, 1, (size_t)length, stream);
+    }
+    text[read] = '\0';
+    return text;
+}
+
+// Runs on a pool worker; compiler state is per-thread, so compilations of
+// independent modules do not interfere
+static void compileModule(void* arg) {
+    CompileJob* job = (CompileJob*)arg;
+    Build* build = job->build;
+    BuildModule* module = &build->modules[job->index];
+
+    CompileOptions options = build->options->compile;
+    options.stats = false;
+    options.emitASTPath = NULL;
+    options.emitAssemblyPath = NULL;
+    options.emitObjectPath = module->objectPath;
+    options.emitInterfacePath = module->interfacePath;
+    options.sourcePath = module->sourcePath;
+    options.modulePath = build->outputDirectory;
+    options.codegen.moduleName = module->entry ? NULL : module->name;
+
+    FILE* err = tmpfile();
+    bool ok = false;
+    char* source = readSourceFile(module->sourcePath, NULL);
+    if (!source) {
+        if (err) fprintf(err, "Error: Could not read '%s'.\n", module->sourcePath);
+    } else {
+        ok = compileSource(source, &options, NULL, err ? err : stderr) == 0;
+        free(source);
+    }
+
+    ModuleInterface interface;
+    if (ok && mapModuleInterface(module->interfacePath, &interface)) {
+        module->hash = interface.hash;
+        closeModuleInterface(&interface);
+    } else {
+        ok = false;
+    }
+    char* errors = err ? readStream(err) : NULL;
+    if (err) fclose(err);
+
+    mtx_lock(&build->lock);
+    module->status = ok ? STATUS_COMPILED : STATUS_FAILED;
+    module->errors = errors;
+    build->completed[build->completedCount++] = job->index;
+    cnd_signal(&build->finished);
+    mtx_unlock(&build->lock);
+    free(job);
+}
+
+// Whether a ready module has to be compiled, or can be skipped
+static ModuleStatus decide(const Build* build, const BuildModule* module) {
+    bool rebuild = !module->current;
+    for (uint32_t i = 0; i < module->importCount; i++) {
+        const BuildModule* import = &build->modules[module->imports[i]];
+        if (import->status == STATUS_FAILED || import->status == STATUS_SKIPPED) return STATUS_SKIPPED;
+        if (import->hash != module->recordedHashes[i]) rebuild = true;
+    }
+    return rebuild ? STATUS_PENDING : STATUS_UP_TO_DATE;
+}
+
+static void schedule(Build* build, ThreadPool* pool, uint32_t* ready, uint32_t readyCount, uint32_t* remaining) {
+    while (readyCount > 0) {
+        uint32_t index = ready[--readyCount];
+        BuildModule* module = &build->modules[index];
+        ModuleStatus status = decide(build, module);
+        if (status == STATUS_PENDING) {
+            module->status = STATUS_RUNNING;
+            CompileJob* job = (CompileJob*)malloc(sizeof(CompileJob));
+            job->build = build;
+            job->index = index;
+            submitTask(pool, compileModule, job);
+            continue;
+        }
+        // Settled without compiling: release the importers right away
+        module->status = status;
+        (*remaining)--;
+        for (uint32_t i = 0; i < module->importerCount; i++) {
+            if (--build->modules[module->importers[i]].waiting == 0) ready[readyCount++] = module->importers[i];
+        }
+    }
+}
+
+static void runSchedule(Build* build, int jobs) {
+    uint32_t count = build->names.count;
+    uint32_t* ready = (uint32_t*)malloc(count * sizeof(uint32_t));
+    uint32_t readyCount = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (build->modules[i].waiting == 0) ready[readyCount++] = i;
+    }
+    uint32_t remaining = count;
+    ThreadPool* pool = createThreadPool(jobs);
+
+    mtx_lock(&build->lock);
+    schedule(build, pool, ready, readyCount, &remaining);
+    while (remaining > 0) {
+        while (build->completedCount == 0) cnd_wait(&build->finished, &build->lock);
+        readyCount = 0;
+        while (build->completedCount > 0) {
+            BuildModule* module = &build->modules[build->completed[--build->completedCount]];
+            remaining--;
+            for (uint32_t i = 0; i < module->importerCount; i++) {
+                if (--build->modules[module->importers[i]].waiting == 0) ready[readyCount++] = module->importers[i];
+            }
+        }
+        schedule(build, pool, ready, readyCount, &remaining);
+    }
+    mtx_unlock(&build->lock);
+
+    destroyThreadPool(pool);
+    free(ready);
+}
+
+// ---------------------------------------------------------------------------
+// Driver
+// ---------------------------------------------------------------------------
+
+static const char* const statusNames[] = {
+    [STATUS_PENDING] = "pending",
+    [STATUS_RUNNING] = "running",
+    [STATUS_COMPILED] = "compiled",
+    [STATUS_UP_TO_DATE] = "up to date",
+    [STATUS_FAILED] = "failed",
+    [STATUS_SKIPPED] = "skipped (an import failed)",
+};
+
+static void report(const Build* build, const uint32_t* order, BuildSummary* summary, FILE* out, FILE* err) {
+    for (uint32_t i = 0; i < build->names.count; i++) {
+        const BuildModule* module = &build->modules[order[i]];
+        fprintf(out, "%-12s %s\n", statusNames[module->status], module->name);
+        if (module->errors && module->errors[0]) fputs(module->errors, err);
+        summary->modules++;
+        if (module->status == STATUS_COMPILED) summary->compiled++;
+        if (module->status == STATUS_UP_TO_DATE) summary->upToDate++;
+        if (module->status == STATUS_FAILED || module->status == STATUS_SKIPPED) summary->failed++;
+    }
+    fprintf(out, "%d modules: %d compiled, %d up to date, %d failed\n", summary->modules, summary->compiled,
+            summary->upToDate, summary->failed);
+}
+
+static void freeBuild(Build* build) {
+    for (uint32_t i = 0; i < build->names.count; i++) {
+        BuildModule* module = &build->modules[i];
+        free(module->sourcePath);
+        free(module->objectPath);
+        free(module->interfacePath);
+        free(module->imports);
+        free(module->recordedHashes);
+        free(module->importers);
+        free(module->errors);
+    }
+    free(build->modules);
+    free(build->completed);
+    free(build->sourceDirectory);
+    freeStringPool(&build->names);
+    mtx_destroy(&build->lock);
+    cnd_destroy(&build->finished);
+}
+
+int runBuild(const BuildOptions* options, BuildSummary* summary, FILE* out, FILE* err) {
+    BuildSummary local;
+    if (!summary) summary = &local;
+    memset(summary, 0, sizeof(BuildSummary));
+
+    // The entry module names the program; its imports sit beside it
+    const char* slash = strrchr(options->entryPath, '/');
+    const char* base = slash ? slash + 1 : options->entryPath;
+    size_t baseLength = strlen(base);
+    size_t suffixLength = strlen(MODULE_SOURCE_SUFFIX);
+    if (baseLength <= suffixLength || strcmp(base + baseLength - suffixLength, MODULE_SOURCE_SUFFIX) != 0) {
+        fprintf(err, "Error: '%s' is not a %s source file.\n", options->entryPath, MODULE_SOURCE_SUFFIX);
+        return 1;
+    }
+
+    Build build;
+    memset(&build, 0, sizeof(Build));
+    build.options = options;
+    build.outputDirectory = options->outputDirectory ? options->outputDirectory : ".";
+    size_t directoryLength = slash ? (size_t)(slash - options->entryPath) : 0;
+    build.sourceDirectory = (char*)malloc(directoryLength + 2);
+    snprintf(build.sourceDirectory, directoryLength + 2, "%.*s", (int)directoryLength, options->entryPath);
+    if (slash && directoryLength == 0) strcpy(build.sourceDirectory, "/");
+    initStringPool(&build.names);
+    mtx_init(&build.lock, mtx_plain);
+    cnd_init(&build.finished);
+
+    char* entryName = (char*)malloc(baseLength - suffixLength + 1);
+    memcpy(entryName, base, baseLength - suffixLength);
+    entryName[baseLength - suffixLength] = '\0';
+    uint32_t entry = addModule(&build, entryName);
+    free(entryName);
+    build.modules[entry].entry = true;
+
+    mkdir(build.outputDirectory, 0777);
+    bool ok = true;
+    for (uint32_t i = 0; ok && i < build.names.count; i++) ok = discoverModule(&build, i, err);
+    uint32_t* order = ok ? dependencyOrder(&build, err) : NULL;
+    if (order) {
+        build.completed = (uint32_t*)malloc(build.names.count * sizeof(uint32_t));
+        runSchedule(&build, options->jobs > 0 ? options->jobs : hardwareThreadCount());
+        report(&build, order, summary, out, err);
+        free(order);
+    } else {
+        summary->failed = 1;
+    }
+    freeBuild(&build);
+    return summary->failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,1716 @@
+#include "codegen.h"
+#include "lexer.h"
+#include "arena.h"
+#include "ast_visitor.h"
+#include "escape_analysis.h"
+#include "module.h"
+#include "string_pool.h"
+#include "stats.h"
+#include "compat.h"
+#include <errno.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Straightforward stack-machine code: every expression leaves its value in
+// %rax, intermediate results are pushed, locals live in fixed %rbp slots.
+
+enum {
+    RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RBP = 5, RSI = 6, RDI = 7,
+    R8 = 8, R9 = 9, R12 = 12, R13 = 13, R14 = 14, R15 = 15,
+    NO_REGISTER = -1
+};
+
+static const char* const registerNames[] = {
+    "%rax", "%rcx", "%rdx", "%rbx", "%rsp", "%rbp", "%rsi", "%rdi",
+    "%r8", "%r9", "%r10", "%r11", "%r12", "%r13", "%r14", "%r15"
+};
+
+#define REGISTER_ARGUMENTS 6
+static const int argumentRegisters[REGISTER_ARGUMENTS] = {RDI, RSI, RDX, RCX, R8, R9};
+
+// Callee-saved registers that hold the most used variables of hot functions
+#define PROMOTABLE_REGISTERS 5
+static const int promotableRegisters[PROMOTABLE_REGISTERS] = {RBX, R12, R13, R14, R15};
+
+// Profile-use thresholds: a function or call site is hot at this share of
+// the busiest one, and only variables read or written this often are
+// worth a register
+#define HOT_PERCENT 1
+#define PROMOTE_MIN_USES 2
+// Largest body, in statements, that is inlined
+#define INLINE_MAX_STATEMENTS 8
+
+typedef enum {
+    TYPE_UNKNOWN,           // Result of an external function: treated as int
+    TYPE_INT,
+    TYPE_STR
+} ValueType;
+
+static const char* const typeNames[] = {"int", "int", "str"};
+
+typedef struct {
+    const char* name;
+    int32_t offset;         // From %rbp
+    ValueType type;
+    int reg;                // Callee-saved register holding it, or NO_REGISTER
+} Local;
+
+// Literal header written before the bytes of each pooled string; must match
+// CpyStrHeader in runtime/cpy_runtime.h
+#define STR_HEADER_SIZE 16
+#define STR_FLAG_STATIC 1
+
+// CpyRegion, placed below the locals of a function that allocates
+// non-escaping strings, and the slot saving %rax while it is released
+#define REGION_CURSOR 0
+#define REGION_LIMIT 8
+#define REGION_CHUNKS 16
+#define REGION_BUFFER 24
+#define REGION_INLINE_BYTES 512
+#define REGION_FRAME_BYTES (REGION_BUFFER + REGION_INLINE_BYTES + 8)
+
+typedef struct {
+    size_t offset;          // rel32 field patched to the epilogue
+    bool release;           // Taken after the region was set up
+} ReturnJump;
+
+typedef struct {
+    CodegenOptions options;
+    ObjectFile* object;
+    FILE* assembly;
+    FILE* err;
+    bool failed;
+    SectionKind text;       // SECTION_TEXT, or SECTION_TEXT_COLD for cold functions
+
+    // State of the function being generated
+    Local* locals;
+    int localCount;
+    int localCapacity;
+    int localBase;          // First local in scope: an inlined body sees only its own
+    int32_t slotBytes;      // Frame bytes taken by the locals in scope
+    int pushed;             // 8-byte words pushed below the frame
+    uint32_t returnLabel;
+    ReturnJump* returnJumps;
+    int returnJumpCount;
+    int returnJumpCapacity;
+    uint32_t functionCount;
+    uint32_t labelCount;
+    ValueType returnType;
+
+    // For self tail calls: the function's name and arity, and where its
+    // body starts once the parameters are in their slots
+    const char* functionName;
+    int paramCount;
+    size_t loopHead;
+
+    // Frame size is patched into the prologue once the body is generated
+    size_t frameSizeField;
+    int32_t localBytes;     // Peak local slots, from the prologue
+    // Code is straight-line, so the region is set up at its first use and
+    // live from there to every later return
+    bool regionLive;
+
+    // Variables kept in callee-saved registers (hot functions, with a
+    // profile), by declaration, and where the registers are saved
+    const ASTNode* promoted[PROMOTABLE_REGISTERS];
+    int promotedCount;
+    int32_t saveOffset;
+    bool inlineCalls;       // Hot call sites may be inlined here
+
+    // Low slots of the pairs written by a vector store (see trackVectorSlots)
+    int32_t* vectorSlots;
+    int vectorSlotCount;
+    int vectorSlotCapacity;
+
+    // --profile-generate: counters are consecutive .bss words from
+    // counterBase, named by the NUL-terminated strings in `records`
+    uint32_t counterCount;
+    size_t counterBase;
+    char* records;
+    size_t recordBytes;
+    size_t recordCapacity;
+
+    // Value type of globals and return type of the module's functions, by
+    // symbol index
+    uint8_t* symbolTypes;
+    uint32_t symbolTypeCapacity;
+    // Declaration of each of the module's functions, by symbol index
+    ASTNode** functionNodes;
+    uint32_t functionNodeCapacity;
+
+    // Globals declared by imported modules, which stay undefined symbols
+    StringPool importedGlobals;
+    // Symbol of this module's initializer and, for the entry module, the
+    // initializers of its dependencies that it runs first
+    char initSymbol[256];
+    StringPool initCalls;
+
+    // Each distinct string literal is emitted once; id -> offset of its
+    // bytes in .rodata
+    StringPool literals;
+    uint32_t* literalOffsets;
+    uint32_t literalCapacity;
+} CodeGenerator;
+
+static void codegenError(CodeGenerator* gen, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    vfprintf(gen->err, format, args);
+    va_end(args);
+    fputc('\n', gen->err);
+    gen->failed = true;
+}
+
+// ---------------------------------------------------------------------------
+// Instruction encoding. Each helper appends the machine code and, when an
+// assembly listing is requested, the matching AT&T line.
+// ---------------------------------------------------------------------------
+
+static void assemblyLine(CodeGenerator* gen, const char* format, ...) {
+    if (!gen->assembly) return;
+    va_list args;
+    va_start(args, format);
+    fputc('\t', gen->assembly);
+    vfprintf(gen->assembly, format, args);
+    fputc('\n', gen->assembly);
+    va_end(args);
+}
+
+static void writeAssemblyString(FILE* out, const char* s, size_t length) {
+    fputc('"', out);
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (c >= 0x20 && c < 0x7F && c != '"' && c != '\\') {
+            fputc(c, out);
+        } else {
+            fprintf(out, "\\%03o", c);
+        }
+    }
+    fputc('"', out);
+}
+
+static size_t textOffset(const CodeGenerator* gen) {
+    return gen->object->sections[gen->text].size;
+}
+
+static void emitBytes(CodeGenerator* gen, const uint8_t* bytes, size_t size) {
+    sectionAppend(gen->object, gen->text, bytes, size);
+}
+
+// Directive selecting the section code currently goes to, in the listing
+static const char* textDirective(const CodeGenerator* gen) {
+    return gen->text == SECTION_TEXT_COLD ? "\t.section .text.unlikely,\"ax\",@progbits\n" : "\t.text\n";
+}
+
+static void emit32(CodeGenerator* gen, uint32_t value) {
+    uint8_t bytes[4] = {(uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24)};
+    emitBytes(gen, bytes, 4);
+}
+
+// REX.W prefix with the extension bits for the ModRM reg and rm fields
+static uint8_t rex(int reg, int rm) {
+    return (uint8_t)(0x48 | (reg >= 8 ? 0x04 : 0) | (rm >= 8 ? 0x01 : 0));
+}
+
+static void moveImmediate(CodeGenerator* gen, int reg, int64_t value) {
+    if (value >= INT32_MIN && value <= INT32_MAX) {
+        uint8_t bytes[3] = {rex(0, reg), 0xC7, (uint8_t)(0xC0 | (reg & 7))};
+        emitBytes(gen, bytes, 3);
+        emit32(gen, (uint32_t)value);
+        assemblyLine(gen, "movq $%lld, %s", (long long)value, registerNames[reg]);
+    } else {
+        uint8_t bytes[2] = {rex(0, reg), (uint8_t)(0xB8 | (reg & 7))};
+        emitBytes(gen, bytes, 2);
+        emit32(gen, (uint32_t)value);
+        emit32(gen, (uint32_t)((uint64_t)value >> 32));
+        assemblyLine(gen, "movabsq $%lld, %s", (long long)value, registerNames[reg]);
+    }
+}
+
+static void moveRegister(CodeGenerator* gen, int destination, int source) {
+    uint8_t bytes[3] = {rex(source, destination), 0x89, (uint8_t)(0xC0 | ((source & 7) << 3) | (destination & 7))};
+    emitBytes(gen, bytes, 3);
+    assemblyLine(gen, "movq %s, %s", registerNames[source], registerNames[destination]);
+}
+
+// movq disp32(%rbp), reg  /  movq reg, disp32(%rbp)
+static void frameAccess(CodeGenerator* gen, uint8_t opcode, int reg, int32_t offset) {
+    uint8_t bytes[3] = {rex(reg, 0), opcode, (uint8_t)(0x80 | ((reg & 7) << 3) | RBP)};
+    emitBytes(gen, bytes, 3);
+    emit32(gen, (uint32_t)offset);
+}
+
+static void loadFrame(CodeGenerator* gen, int reg, int32_t offset) {
+    frameAccess(gen, 0x8B, reg, offset);
+    assemblyLine(gen, "movq %d(%%rbp), %s", offset, registerNames[reg]);
+}
+
+static void storeFrame(CodeGenerator* gen, int32_t offset, int reg) {
+    frameAccess(gen, 0x89, reg, offset);
+    assemblyLine(gen, "movq %s, %d(%%rbp)", registerNames[reg], offset);
+}
+
+// movq reg, disp32(%rsp)
+static void storeStack(CodeGenerator* gen, int32_t offset, int reg) {
+    uint8_t bytes[4] = {rex(reg, 0), 0x89, (uint8_t)(0x84 | ((reg & 7) << 3)), 0x24};
+    emitBytes(gen, bytes, 4);
+    emit32(gen, (uint32_t)offset);
+    assemblyLine(gen, "movq %s, %d(%%rsp)", registerNames[reg], offset);
+}
+
+// RIP-relative operand against `symbol`; the 32-bit displacement is the
+// last field of the instruction, hence the -4 addend
+static void ripOperand(CodeGenerator* gen, const uint8_t* prefix, size_t size, uint32_t symbol, int64_t addend) {
+    emitBytes(gen, prefix, size);
+    addRelocation(gen->object, gen->text, textOffset(gen), symbol, RELOC_X86_64_PC32, addend - 4);
+    emit32(gen, 0);
+}
+
+static void loadGlobal(CodeGenerator* gen, int reg, uint32_t symbol) {
+    uint8_t bytes[3] = {rex(reg, 0), 0x8B, (uint8_t)(((reg & 7) << 3) | 5)};
+    ripOperand(gen, bytes, 3, symbol, 0);
+    assemblyLine(gen, "movq %s(%%rip), %s", gen->object->symbols[symbol].name, registerNames[reg]);
+}
+
+static void storeGlobal(CodeGenerator* gen, uint32_t symbol, int reg) {
+    uint8_t bytes[3] = {rex(reg, 0), 0x89, (uint8_t)(((reg & 7) << 3) | 5)};
+    ripOperand(gen, bytes, 3, symbol, 0);
+    assemblyLine(gen, "movq %s, %s(%%rip)", registerNames[reg], gen->object->symbols[symbol].name);
+}
+
+static void push(CodeGenerator* gen, int reg) {
+    if (reg >= 8) emitBytes(gen, (const uint8_t[]){0x41}, 1);
+    emitBytes(gen, (const uint8_t[]){(uint8_t)(0x50 | (reg & 7))}, 1);
+    assemblyLine(gen, "pushq %s", registerNames[reg]);
+    gen->pushed++;
+}
+
+static void pop(CodeGenerator* gen, int reg) {
+    if (reg >= 8) emitBytes(gen, (const uint8_t[]){0x41}, 1);
+    emitBytes(gen, (const uint8_t[]){(uint8_t)(0x58 | (reg & 7))}, 1);
+    assemblyLine(gen, "popq %s", registerNames[reg]);
+    gen->pushed--;
+}
+
+// addq/subq $bytes, %rsp
+static void adjustStack(CodeGenerator* gen, int32_t bytes) {
+    if (bytes == 0) return;
+    uint8_t opcode[3] = {0x48, 0x81, (uint8_t)(bytes > 0 ? 0xC4 : 0xEC)};
+    emitBytes(gen, opcode, 3);
+    emit32(gen, (uint32_t)(bytes > 0 ? bytes : -bytes));
+    assemblyLine(gen, "%s $%d, %%rsp", bytes > 0 ? "addq" : "subq", bytes > 0 ? bytes : -bytes);
+}
+
+// %rax = %rax <op> %rcx
+static void arithmetic(CodeGenerator* gen, int op) {
+    if (op == TOKEN_PLUS || op == TOKEN_MINUS) compilerStats.arithmeticOperations++;
+    switch (op) {
+        case TOKEN_PLUS:
+            emitBytes(gen, (const uint8_t[]){0x48, 0x01, 0xC8}, 3);
+            assemblyLine(gen, "addq %%rcx, %%rax");
+            break;
+        case TOKEN_MINUS:
+            emitBytes(gen, (const uint8_t[]){0x48, 0x29, 0xC8}, 3);
+            assemblyLine(gen, "subq %%rcx, %%rax");
+            break;
+        case TOKEN_STAR:
+            emitBytes(gen, (const uint8_t[]){0x48, 0x0F, 0xAF, 0xC1}, 4);
+            assemblyLine(gen, "imulq %%rcx, %%rax");
+            break;
+        case TOKEN_SLASH:
+            emitBytes(gen, (const uint8_t[]){0x48, 0x99, 0x48, 0xF7, 0xF9}, 5);
+            assemblyLine(gen, "cqto");
+            assemblyLine(gen, "idivq %%rcx");
+            break;
+        default:
+            codegenError(gen, "Error: Unsupported operator in code generation.");
+            break;
+    }
+}
+
+static void call(CodeGenerator* gen, const char* name) {
+    // %al bounds the vector registers used by a variadic callee (none here)
+    emitBytes(gen, (const uint8_t[]){0x31, 0xC0, 0xE8}, 3);
+    addRelocation(gen->object, gen->text, textOffset(gen), symbolReference(gen->object, name), RELOC_X86_64_PLT32, -4);
+    emit32(gen, 0);
+    assemblyLine(gen, "xorl %%eax, %%eax");
+    assemblyLine(gen, "call %s", name);
+}
+
+// Call a runtime helper whose arguments are already in registers
+static void callRuntime(CodeGenerator* gen, const char* name) {
+    bool pad = gen->pushed & 1;
+    if (pad) adjustStack(gen, -8);
+    call(gen, name);
+    if (pad) adjustStack(gen, 8);
+}
+
+// movq -16(%rax), %rax: the length field of a str header
+static void loadStringLength(CodeGenerator* gen) {
+    emitBytes(gen, (const uint8_t[]){0x48, 0x8B, 0x40, (uint8_t)-STR_HEADER_SIZE}, 4);
+    assemblyLine(gen, "movq -%d(%%rax), %%rax", STR_HEADER_SIZE);
+}
+
+// leaq disp32(%rbp), reg
+static void addressFrame(CodeGenerator* gen, int reg, int32_t offset) {
+    frameAccess(gen, 0x8D, reg, offset);
+    assemblyLine(gen, "leaq %d(%%rbp), %s", offset, registerNames[reg]);
+}
+
+static void jumpToReturn(CodeGenerator* gen) {
+    emitBytes(gen, (const uint8_t[]){0xE9}, 1);
+    if (gen->returnJumpCount == gen->returnJumpCapacity) {
+        gen->returnJumpCapacity = gen->returnJumpCapacity ? gen->returnJumpCapacity * 2 : 16;
+        gen->returnJumps = (ReturnJump*)realloc(gen->returnJumps, gen->returnJumpCapacity * sizeof(ReturnJump));
+    }
+    gen->returnJumps[gen->returnJumpCount].offset = textOffset(gen);
+    gen->returnJumps[gen->returnJumpCount].release = gen->regionLive;
+    gen->returnJumpCount++;
+    emit32(gen, 0);
+    assemblyLine(gen, "jmp .L%s%u", gen->regionLive ? "release" : "return", gen->returnLabel);
+}
+
+// ---------------------------------------------------------------------------
+// Call region for non-escaping strings
+// ---------------------------------------------------------------------------
+
+static int32_t regionOffset(const CodeGenerator* gen) {
+    return -gen->localBytes - REGION_FRAME_BYTES + 8;
+}
+
+// cursor = buffer, limit = buffer + size, chunks = NULL; only %rdx is used
+static void setUpRegion(CodeGenerator* gen) {
+    int32_t region = regionOffset(gen);
+    addressFrame(gen, RDX, region + REGION_BUFFER);
+    storeFrame(gen, region + REGION_CURSOR, RDX);
+    addressFrame(gen, RDX, region + REGION_BUFFER + REGION_INLINE_BYTES);
+    storeFrame(gen, region + REGION_LIMIT, RDX);
+    moveImmediate(gen, RDX, 0);
+    storeFrame(gen, region + REGION_CHUNKS, RDX);
+    gen->regionLive = true;
+}
+
+// Free the region's overflow chunks, if any, keeping %rax if `keepResult`
+static void freeRegionChunks(CodeGenerator* gen, bool keepResult) {
+    int32_t region = regionOffset(gen);
+    int32_t saved = region - 8;
+    uint32_t label = gen->labelCount++;
+    loadFrame(gen, RDI, region + REGION_CHUNKS);
+    emitBytes(gen, (const uint8_t[]){0x48, 0x85, 0xFF, 0x74}, 4);
+    size_t skip = textOffset(gen);
+    emitBytes(gen, (const uint8_t[]){0}, 1);
+    assemblyLine(gen, "testq %%rdi, %%rdi");
+    assemblyLine(gen, "je .Lkept%u", label);
+    if (keepResult) storeFrame(gen, saved, RAX);
+    callRuntime(gen, "cpy_region_release");
+    if (keepResult) loadFrame(gen, RAX, saved);
+    gen->object->sections[gen->text].data[skip] = (uint8_t)(textOffset(gen) - (skip + 1));
+    if (gen->assembly) fprintf(gen->assembly, ".Lkept%u:\n", label);
+}
+
+// Runs on every return once the region is live
+static void releaseRegion(CodeGenerator* gen) {
+    if (gen->assembly) fprintf(gen->assembly, ".Lrelease%u:\n", gen->returnLabel);
+    freeRegionChunks(gen, true);
+}
+
+// Callee-saved registers holding promoted variables are saved after the
+// prologue and restored before the frame is torn down
+static void saveRegisters(CodeGenerator* gen) {
+    for (int i = 0; i < gen->promotedCount; i++) {
+        storeFrame(gen, gen->saveOffset - 8 * i, promotableRegisters[i]);
+    }
+}
+
+static void restoreRegisters(CodeGenerator* gen) {
+    for (int i = 0; i < gen->promotedCount; i++) {
+        loadFrame(gen, promotableRegisters[i], gen->saveOffset - 8 * i);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Profile instrumentation
+// ---------------------------------------------------------------------------
+
+// incq on a new counter named by the formatted record; touches no register
+static void countEvent(CodeGenerator* gen, const char* format, ...) {
+    char record[512];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(record, sizeof(record), format, args);
+    va_end(args);
+    if (length < 0) return;
+    if ((size_t)length >= sizeof(record)) length = (int)sizeof(record) - 1;
+
+    if (gen->recordBytes + (size_t)length + 1 > gen->recordCapacity) {
+        gen->recordCapacity = gen->recordCapacity ? gen->recordCapacity * 2 : 1024;
+        if (gen->recordCapacity < gen->recordBytes + (size_t)length + 1) gen->recordCapacity += (size_t)length + 1;
+        gen->records = (char*)realloc(gen->records, gen->recordCapacity);
+    }
+    memcpy(gen->records + gen->recordBytes, record, (size_t)length + 1);
+    gen->recordBytes += (size_t)length + 1;
+
+    size_t offset = sectionReserve(gen->object, SECTION_BSS, 8, 8);
+    if (gen->counterCount++ == 0) gen->counterBase = offset;
+    ripOperand(gen, (const uint8_t[]){0x48, 0xFF, 0x05}, 3, sectionSymbol(gen->object, SECTION_BSS), (int64_t)offset);
+    assemblyLine(gen, "incq .Lprof+%zu(%%rip)", offset - gen->counterBase);
+}
+
+static void countCall(CodeGenerator* gen, const ASTNode* call) {
+    if (!gen->options.profileGenerate) return;
+    countEvent(gen, "edge %s %d %s", gen->functionName, call->site, call->data.callExpr.callee);
+}
+
+// The module's CpyProfileModule {counters, records, count, runtime} in
+// cpy_prof, where the runtime finds it at exit
+static void emitProfileModule(CodeGenerator* gen) {
+    if (gen->counterCount == 0) return;
+    ObjectFile* object = gen->object;
+    size_t records = sectionAppend(object, SECTION_RODATA, gen->records, gen->recordBytes);
+    size_t descriptor = sectionReserve(object, SECTION_PROFILE, 32, 8);
+    uint8_t* count = object->sections[SECTION_PROFILE].data + descriptor + 16;
+    for (int i = 0; i < 8; i++) count[i] = (uint8_t)((uint64_t)gen->counterCount >> (8 * i));
+    addRelocation(object, SECTION_PROFILE, descriptor, sectionSymbol(object, SECTION_BSS), RELOC_X86_64_64,
+                  (int64_t)gen->counterBase);
+    addRelocation(object, SECTION_PROFILE, descriptor + 8, sectionSymbol(object, SECTION_RODATA), RELOC_X86_64_64,
+                  (int64_t)records);
+    addRelocation(object, SECTION_PROFILE, descriptor + 24, symbolReference(object, "cpy_profile_runtime"),
+                  RELOC_X86_64_64, 0);
+
+    if (gen->assembly) {
+        fprintf(gen->assembly, "\t.bss\n\t.p2align 3\n.Lprof:\n\t.zero %u\n", 8 * gen->counterCount);
+        fprintf(gen->assembly, "\t.section .rodata\n.Lprofrecords:\n");
+        for (size_t offset = 0; offset < gen->recordBytes; offset += strlen(gen->records + offset) + 1) {
+            fprintf(gen->assembly, "\t.string ");
+            writeAssemblyString(gen->assembly, gen->records + offset, strlen(gen->records + offset));
+            fputc('\n', gen->assembly);
+        }
+        fprintf(gen->assembly, "\t.section cpy_prof,\"aw\",@progbits\n\t.p2align 3\n"
+                "\t.quad .Lprof, .Lprofrecords, %u, cpy_profile_runtime\n", gen->counterCount);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Names
+// ---------------------------------------------------------------------------
+
+static ValueType typeFromName(const char* name) {
+    return name && strcmp(name, "str") == 0 ? TYPE_STR : TYPE_INT;
+}
+
+static void setSymbolType(CodeGenerator* gen, uint32_t symbol, ValueType type) {
+    if (symbol >= gen->symbolTypeCapacity) {
+        uint32_t capacity = gen->object->symbolCapacity;
+        gen->symbolTypes = (uint8_t*)realloc(gen->symbolTypes, capacity);
+        memset(gen->symbolTypes + gen->symbolTypeCapacity, TYPE_UNKNOWN, capacity - gen->symbolTypeCapacity);
+        gen->symbolTypeCapacity = capacity;
+    }
+    gen->symbolTypes[symbol] = (uint8_t)type;
+}
+
+static ValueType symbolType(const CodeGenerator* gen, uint32_t symbol) {
+    return symbol < gen->symbolTypeCapacity ? (ValueType)gen->symbolTypes[symbol] : TYPE_UNKNOWN;
+}
+
+static void addLocal(CodeGenerator* gen, const char* name, int32_t offset, ValueType type) {
+    if (gen->localCount == gen->localCapacity) {
+        gen->localCapacity = gen->localCapacity ? gen->localCapacity * 2 : 32;
+        gen->locals = (Local*)realloc(gen->locals, gen->localCapacity * sizeof(Local));
+    }
+    gen->locals[gen->localCount].name = name;
+    gen->locals[gen->localCount].offset = offset;
+    gen->locals[gen->localCount].type = type;
+    gen->locals[gen->localCount].reg = NO_REGISTER;
+    gen->localCount++;
+}
+
+// Slots whose pair was last written by one vector store: loading them
+// back with one vector load is forwarded from that store, while a load
+// spanning two scalar stores would stall
+static bool vectorWritten(const CodeGenerator* gen, int32_t lowOffset) {
+    for (int i = 0; i < gen->vectorSlotCount; i++) {
+        if (gen->vectorSlots[i] == lowOffset) return true;
+    }
+    return false;
+}
+
+// Slots from `lowOffset` were stored to, as a vector pair or not: forget
+// the pairs that overlap them
+static void trackVectorSlots(CodeGenerator* gen, int32_t lowOffset, bool vector) {
+    int kept = 0;
+    for (int i = 0; i < gen->vectorSlotCount; i++) {
+        int32_t slot = gen->vectorSlots[i];
+        if (slot > lowOffset - 16 && slot < lowOffset + 16) continue;
+        gen->vectorSlots[kept++] = slot;
+    }
+    gen->vectorSlotCount = kept;
+    if (!vector) return;
+    if (gen->vectorSlotCount == gen->vectorSlotCapacity) {
+        gen->vectorSlotCapacity = gen->vectorSlotCapacity ? gen->vectorSlotCapacity * 2 : 16;
+        gen->vectorSlots = (int32_t*)realloc(gen->vectorSlots, gen->vectorSlotCapacity * sizeof(int32_t));
+    }
+    gen->vectorSlots[gen->vectorSlotCount++] = lowOffset;
+}
+
+// Give `name` the next free frame slot
+static int32_t declareLocal(CodeGenerator* gen, const char* name, ValueType type) {
+    gen->slotBytes += 8;
+    addLocal(gen, name, -gen->slotBytes, type);
+    trackVectorSlots(gen, -gen->slotBytes, false);
+    return -gen->slotBytes;
+}
+
+static int promotedRegister(const CodeGenerator* gen, const ASTNode* declaration) {
+    for (int i = 0; i < gen->promotedCount; i++) {
+        if (gen->promoted[i] == declaration) return promotableRegisters[i];
+    }
+    return NO_REGISTER;
+}
+
+// Declare `name` for `declaration` and store `source` in it: in its
+// register if the variable was promoted, otherwise in its frame slot
+static void bindLocal(CodeGenerator* gen, const ASTNode* declaration, const char* name, ValueType type, int source) {
+    int32_t offset = declareLocal(gen, name, type);
+    int reg = promotedRegister(gen, declaration);
+    if (reg == NO_REGISTER) {
+        storeFrame(gen, offset, source);
+    } else {
+        gen->locals[gen->localCount - 1].reg = reg;
+        moveRegister(gen, reg, source);
+    }
+}
+
+static void storeLocal(CodeGenerator* gen, const Local* local, int source) {
+    if (local->reg == NO_REGISTER) {
+        storeFrame(gen, local->offset, source);
+    } else {
+        moveRegister(gen, local->reg, source);
+    }
+}
+
+static const Local* findLocal(const CodeGenerator* gen, const char* name) {
+    // Innermost declaration first
+    for (int i = gen->localCount - 1; i >= gen->localBase; i--) {
+        if (strcmp(gen->locals[i].name, name) == 0) return &gen->locals[i];
+    }
+    return NULL;
+}
+
+static uint32_t findGlobal(const CodeGenerator* gen, const char* name) {
+    uint32_t symbol = findObjectSymbol(gen->object, name);
+    if (symbol == NO_SYMBOL || gen->object->symbols[symbol].kind == SYMBOL_OBJECT) return symbol;
+    // An imported global is defined by its own module's object
+    if (gen->object->symbols[symbol].kind == SYMBOL_UNDEFINED &&
+        findString(&gen->importedGlobals, name, strlen(name)) != STRING_NOT_FOUND) {
+        return symbol;
+    }
+    return NO_SYMBOL;
+}
+
+static ValueType loadVariable(CodeGenerator* gen, int reg, const char* name) {
+    const Local* local = findLocal(gen, name);
+    if (local) {
+        if (local->reg == NO_REGISTER) {
+            loadFrame(gen, reg, local->offset);
+        } else {
+            moveRegister(gen, reg, local->reg);
+        }
+        return local->type;
+    }
+    uint32_t global = findGlobal(gen, name);
+    if (global != NO_SYMBOL) {
+        loadGlobal(gen, reg, global);
+        return symbolType(gen, global);
+    }
+    codegenError(gen, "Error: Undeclared identifier '%s'.", name);
+    return TYPE_INT;
+}
+
+static bool compatible(ValueType expected, ValueType actual) {
+    return (expected == TYPE_STR) == (actual == TYPE_STR);
+}
+
+static void checkAssignable(CodeGenerator* gen, ValueType expected, ValueType actual, const char* what, const char* name) {
+    if (!compatible(expected, actual)) {
+        codegenError(gen, "Error: %s '%s' expects %s but got %s.", what, name, typeNames[expected], typeNames[actual]);
+    }
+}
+
+static bool checkSupportedType(CodeGenerator* gen, const char* type, const char* name) {
+    if (type && strcmp(type, "float") == 0) {
+        codegenError(gen, "Error: '%s': float values are not supported by the native code generator.", name);
+        return false;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Expressions
+// ---------------------------------------------------------------------------
+
+// Offset in .rodata of the bytes of a pooled literal, emitting it on first use
+static uint32_t poolLiteral(CodeGenerator* gen, const char* bytes, size_t length) {
+    uint32_t id = internString(&gen->literals, bytes, length);
+    if (id < gen->literalCapacity && gen->literalOffsets[id] != UINT32_MAX) return gen->literalOffsets[id];
+    if (id >= gen->literalCapacity) {
+        uint32_t previous = gen->literalCapacity;
+        gen->literalCapacity = gen->literals.capacity;
+        gen->literalOffsets = (uint32_t*)realloc(gen->literalOffsets, gen->literalCapacity * sizeof(uint32_t));
+        memset(gen->literalOffsets + previous, 0xFF, (gen->literalCapacity - previous) * sizeof(uint32_t));
+    }
+
+    // Header {u64 length, u32 hash, u32 flags}, then the bytes and a NUL
+    uint32_t hash = hashString(bytes, length);
+    uint8_t header[STR_HEADER_SIZE];
+    for (int i = 0; i < 8; i++) header[i] = (uint8_t)((uint64_t)length >> (8 * i));
+    for (int i = 0; i < 4; i++) header[8 + i] = (uint8_t)(hash >> (8 * i));
+    for (int i = 0; i < 4; i++) header[12 + i] = (uint8_t)(STR_FLAG_STATIC >> (8 * i));
+    size_t start = sectionReserve(gen->object, SECTION_RODATA, STR_HEADER_SIZE, 16);
+    memcpy(gen->object->sections[SECTION_RODATA].data + start, header, STR_HEADER_SIZE);
+    uint32_t offset = (uint32_t)sectionAppend(gen->object, SECTION_RODATA, bytes, length);
+    sectionAppend(gen->object, SECTION_RODATA, "", 1);
+
+    if (gen->assembly) {
+        fprintf(gen->assembly, "\t.section .rodata\n\t.p2align 4\n\t.quad %zu\n\t.long %u, %d\n.Lstr%u:\n\t.string ",
+                length, hash, STR_FLAG_STATIC, offset);
+        writeAssemblyString(gen->assembly, bytes, length);
+        fprintf(gen->assembly, "\n%s", textDirective(gen));
+    }
+    gen->literalOffsets[id] = offset;
+    return offset;
+}
+
+static ValueType loadLiteral(CodeGenerator* gen, int reg, const char* value) {
+    if (value[0] == '"') {
+        // A str points at the bytes, just past the header
+        uint32_t offset = poolLiteral(gen, value + 1, strlen(value) - 2);
+        uint8_t bytes[3] = {rex(reg, 0), 0x8D, (uint8_t)(((reg & 7) << 3) | 5)};
+        ripOperand(gen, bytes, 3, sectionSymbol(gen->object, SECTION_RODATA), (int64_t)offset);
+        assemblyLine(gen, "leaq .Lstr%u(%%rip), %s", offset, registerNames[reg]);
+        return TYPE_STR;
+    }
+
+    errno = 0;
+    char* end;
+    long long number = strtoll(value, &end, 10);
+    if (errno == ERANGE || *end != '\0') {
+        codegenError(gen, "Error: Integer literal '%s' out of range.", value);
+        return TYPE_INT;
+    }
+    moveImmediate(gen, reg, number);
+    return TYPE_INT;
+}
+
+static bool isLeaf(const ASTNode* node) {
+    return node->type == AST_LITERAL || node->type == AST_IDENTIFIER;
+}
+
+static ValueType loadLeaf(CodeGenerator* gen, int reg, ASTNode* node) {
+    if (node->type == AST_LITERAL) {
+        return loadLiteral(gen, reg, node->data.literal.value);
+    }
+    return loadVariable(gen, reg, node->data.identifier.name);
+}
+
+static ValueType generateExpression(CodeGenerator* gen, ASTNode* node);
+
+// len(s) and equals(a, b) on str, unless the module defines its own
+static bool isBuiltinCall(const CodeGenerator* gen, const ASTNode* node) {
+    const char* name = node->data.callExpr.callee;
+    const ASTNode* first = node->data.callExpr.arguments;
+    uint32_t symbol = findObjectSymbol(gen->object, name);
+    if (symbol != NO_SYMBOL && symbolType(gen, symbol) != TYPE_UNKNOWN) return false;
+    if (strcmp(name, "len") == 0) return first && !first->next;
+    if (strcmp(name, "equals") == 0) return first && first->next && !first->next->next;
+    return false;
+}
+
+static bool builtinReadsOnly(const ASTNode* call, void* context) {
+    return isBuiltinCall((const CodeGenerator*)context, call);
+}
+
+static bool generateBuiltin(CodeGenerator* gen, ASTNode* node, ValueType* result) {
+    if (!isBuiltinCall(gen, node)) return false;
+    const char* name = node->data.callExpr.callee;
+    ASTNode* first = node->data.callExpr.arguments;
+
+    if (strcmp(name, "len") == 0) {
+        checkAssignable(gen, TYPE_STR, generateExpression(gen, first), "Argument of", name);
+        loadStringLength(gen);
+    } else {
+        checkAssignable(gen, TYPE_STR, generateExpression(gen, first), "Argument of", name);
+        push(gen, RAX);
+        checkAssignable(gen, TYPE_STR, generateExpression(gen, first->next), "Argument of", name);
+        moveRegister(gen, RSI, RAX);
+        pop(gen, RDI);
+        callRuntime(gen, "cpy_str_equal");
+    }
+    *result = TYPE_INT;
+    return true;
+}
+
+static bool callsItself(ASTNode* body, const char* name);
+
+// Small and simple enough to paste into a caller: straight-line statements
+// ending in its only return, no nested blocks, and not recursive
+static bool inlinable(const ASTNode* function, int arguments) {
+    int params = 0;
+    for (const ASTNode* param = function->data.funcDecl.params; param; param = param->next) params++;
+    if (params != arguments || params > REGISTER_ARGUMENTS) return false;
+
+    int statements = 0;
+    const ASTNode* statement = function->data.funcDecl.body->data.block.declarations;
+    for (; statement; statement = statement->next) {
+        if (++statements > INLINE_MAX_STATEMENTS) return false;
+        if (!statement->next) break;
+        if (statement->type != AST_VAR_DECL && statement->type != AST_EXPR_STMT) return false;
+    }
+    if (!statement || statement->type != AST_RETURN_STMT || !statement->data.returnStmt.value) return false;
+    return !callsItself(function->data.funcDecl.body, function->data.funcDecl.name);
+}
+
+static ASTNode* functionNode(const CodeGenerator* gen, uint32_t symbol) {
+    return symbol < gen->functionNodeCapacity ? gen->functionNodes[symbol] : NULL;
+}
+
+// The module function to inline at `call`, if the profile shows the call
+// site is hot; NULL to generate a call
+static ASTNode* inlineTarget(const CodeGenerator* gen, const ASTNode* call) {
+    const Profile* profile = gen->options.profile;
+    if (!gen->inlineCalls || !profile) return NULL;
+    const char* callee = call->data.callExpr.callee;
+    uint64_t count = profileEdgeCount(profile, gen->functionName, (uint32_t)call->site, callee);
+    if (count == 0 || count * 100 < profile->maxEdgeCount * HOT_PERCENT) return NULL;
+    if (strcmp(callee, gen->functionName) == 0) return NULL;
+
+    int arguments = 0;
+    for (const ASTNode* argument = call->data.callExpr.arguments; argument; argument = argument->next) arguments++;
+    ASTNode* function = functionNode(gen, findObjectSymbol(gen->object, callee));
+    return function && inlinable(function, arguments) ? function : NULL;
+}
+
+static void generateStatement(CodeGenerator* gen, ASTNode* node, bool last);
+
+// The callee's body in place of the call: its parameters and locals get
+// slots of their own above ours, and its return value is left in %rax
+static ValueType generateInlined(CodeGenerator* gen, ASTNode* call, ASTNode* function) {
+    for (ASTNode* argument = call->data.callExpr.arguments; argument; argument = argument->next) {
+        generateExpression(gen, argument);
+        push(gen, RAX);
+    }
+
+    int localBase = gen->localBase;
+    int localCount = gen->localCount;
+    int32_t slotBytes = gen->slotBytes;
+    gen->localBase = gen->localCount;
+    gen->inlineCalls = false;
+    if (gen->assembly) fprintf(gen->assembly, "\t# inlined %s\n", function->data.funcDecl.name);
+
+    int params = 0;
+    for (ASTNode* param = function->data.funcDecl.params; param; param = param->next, params++) {
+        declareLocal(gen, param->data.param.name, typeFromName(param->data.param.paramType));
+    }
+    for (int i = params - 1; i >= 0; i--) {
+        pop(gen, RAX);
+        storeFrame(gen, gen->locals[gen->localBase + i].offset, RAX);
+    }
+    ASTNode* statement = function->data.funcDecl.body->data.block.declarations;
+    for (; statement->next; statement = statement->next) generateStatement(gen, statement, false);
+    generateExpression(gen, statement->data.returnStmt.value);
+
+    gen->localBase = localBase;
+    gen->localCount = localCount;
+    gen->slotBytes = slotBytes;
+    gen->inlineCalls = true;
+    return symbolType(gen, findObjectSymbol(gen->object, function->data.funcDecl.name));
+}
+
+static ValueType generateCall(CodeGenerator* gen, ASTNode* node) {
+    ValueType builtin;
+    if (generateBuiltin(gen, node, &builtin)) return builtin;
+    ASTNode* inlined = inlineTarget(gen, node);
+    if (inlined) return generateInlined(gen, node, inlined);
+
+    int count = 0;
+    for (ASTNode* argument = node->data.callExpr.arguments; argument; argument = argument->next) count++;
+    int inRegisters = count < REGISTER_ARGUMENTS ? count : REGISTER_ARGUMENTS;
+    int onStack = count - inRegisters;
+
+    // Stack arguments go in a reserved area (padded so %rsp is 16-byte
+    // aligned at the call); register arguments are pushed while the rest
+    // are evaluated, so arguments are evaluated left to right
+    int padding = (gen->pushed + onStack) & 1;
+    adjustStack(gen, -8 * (onStack + padding));
+    gen->pushed += onStack + padding;
+
+    int index = 0;
+    for (ASTNode* argument = node->data.callExpr.arguments; argument; argument = argument->next, index++) {
+        generateExpression(gen, argument);
+        if (index < REGISTER_ARGUMENTS) {
+            push(gen, RAX);
+        } else {
+            storeStack(gen, 8 * index, RAX); // Past the six pushed register arguments
+        }
+    }
+    for (int i = inRegisters - 1; i >= 0; i--) pop(gen, argumentRegisters[i]);
+
+    countCall(gen, node);
+    call(gen, node->data.callExpr.callee);
+    adjustStack(gen, 8 * (onStack + padding));
+    gen->pushed -= onStack + padding;
+
+    uint32_t symbol = findObjectSymbol(gen->object, node->data.callExpr.callee);
+    return symbolType(gen, symbol);
+}
+
+// jmp to `name` through the PLT, as a call would
+static void jumpTo(CodeGenerator* gen, const char* name) {
+    emitBytes(gen, (const uint8_t[]){0x31, 0xC0, 0xE9}, 3);
+    addRelocation(gen->object, gen->text, textOffset(gen), symbolReference(gen->object, name), RELOC_X86_64_PLT32, -4);
+    emit32(gen, 0);
+    assemblyLine(gen, "xorl %%eax, %%eax");
+    assemblyLine(gen, "jmp %s", name);
+}
+
+// Frame slot of parameter `index`, as generateFunction lays them out
+static int32_t parameterOffset(int index) {
+    return index < REGISTER_ARGUMENTS ? -8 * (index + 1) : 16 + 8 * (index - REGISTER_ARGUMENTS);
+}
+
+// `return f(...)` without growing the stack. A call to the function itself
+// stores the arguments over the parameters and jumps back to the top of the
+// body, making the recursion a loop. Any other callee is entered with a
+// jump once this frame is torn down, provided its stack arguments fit in
+// the area our caller set up for ours. Returns false, generating nothing,
+// if the call has to stay a call.
+static bool generateTailCall(CodeGenerator* gen, ASTNode* node, ValueType* result) {
+    if (gen->options.noTailCalls || node->type != AST_CALL_EXPR || isBuiltinCall(gen, node)) return false;
+    const char* callee = node->data.callExpr.callee;
+    int count = 0;
+    for (ASTNode* argument = node->data.callExpr.arguments; argument; argument = argument->next) count++;
+    bool self = strcmp(callee, gen->functionName) == 0 && count == gen->paramCount;
+    int incoming = gen->paramCount > REGISTER_ARGUMENTS ? gen->paramCount - REGISTER_ARGUMENTS : 0;
+    if (!self && count - REGISTER_ARGUMENTS > incoming) return false;
+
+    // Every argument is evaluated before any parameter slot is overwritten
+    for (ASTNode* argument = node->data.callExpr.arguments; argument; argument = argument->next) {
+        generateExpression(gen, argument);
+        push(gen, RAX);
+    }
+    // Arguments escape, so none of them lives in the region
+    if (gen->regionLive) freeRegionChunks(gen, false);
+    for (int i = count - 1; i >= 0; i--) {
+        if (self) {
+            pop(gen, RAX);
+            storeLocal(gen, &gen->locals[i], RAX); // The parameters are the first locals
+        } else if (i >= REGISTER_ARGUMENTS) {
+            pop(gen, RAX);
+            storeFrame(gen, parameterOffset(i), RAX);
+        } else {
+            pop(gen, argumentRegisters[i]);
+        }
+    }
+
+    countCall(gen, node);
+    if (self) {
+        emitBytes(gen, (const uint8_t[]){0xE9}, 1);
+        emit32(gen, (uint32_t)(gen->loopHead - (textOffset(gen) + 4)));
+        assemblyLine(gen, "jmp .Lloop%u", gen->returnLabel);
+    } else {
+        restoreRegisters(gen);
+        emitBytes(gen, (const uint8_t[]){0xC9}, 1);
+        assemblyLine(gen, "leave");
+        jumpTo(gen, callee);
+    }
+    *result = symbolType(gen, findObjectSymbol(gen->object, callee));
+    return true;
+}
+
+static ValueType generateOperand(CodeGenerator* gen, ASTNode* node) {
+    switch (node->type) {
+        case AST_LITERAL:
+        case AST_IDENTIFIER:
+            return loadLeaf(gen, RAX, node);
+        case AST_CALL_EXPR:
+            return generateCall(gen, node);
+        case AST_BINARY_EXPR:
+            return generateExpression(gen, node);
+        default:
+            codegenError(gen, "Error: Unexpected node in expression.");
+            return TYPE_INT;
+    }
+}
+
+// %rax = %rax <op> %rcx on operands of the given types
+static ValueType applyOperator(CodeGenerator* gen, const ASTNode* node, ValueType left, ValueType right) {
+    int op = node->operator;
+    if (left != TYPE_STR && right != TYPE_STR) {
+        arithmetic(gen, op);
+        return TYPE_INT;
+    }
+    if (op == TOKEN_PLUS && left == TYPE_STR && right == TYPE_STR) {
+        // Constant operands were folded already; this concatenates at run time
+        if (!gen->options.heapStrings && node->noEscape) {
+            if (!gen->regionLive) setUpRegion(gen);
+            moveRegister(gen, RSI, RAX);
+            moveRegister(gen, RDX, RCX);
+            addressFrame(gen, RDI, regionOffset(gen));
+            callRuntime(gen, "cpy_str_concat_in");
+        } else {
+            moveRegister(gen, RDI, RAX);
+            moveRegister(gen, RSI, RCX);
+            callRuntime(gen, "cpy_str_concat");
+        }
+        return TYPE_STR;
+    }
+    codegenError(gen, "Error: Operator is not defined for %s and %s.", typeNames[left], typeNames[right]);
+    return TYPE_INT;
+}
+
+static ValueType generateExpression(CodeGenerator* gen, ASTNode* node) {
+    if (node->type != AST_BINARY_EXPR) {
+        return generateOperand(gen, node);
+    }
+
+    // `a + b + c ...` is left-deep, so walk the left spine with a loop and
+    // only recurse into (parenthesized) right operands
+    int depth = 0;
+    ASTNode* leftmost = node;
+    while (leftmost->type == AST_BINARY_EXPR) {
+        leftmost = leftmost->data.binaryExpr.left;
+        depth++;
+    }
+
+    Arena* arena = compilationArena();
+    ArenaMark mark = arenaMark(arena);
+    ASTNode** spine = (ASTNode**)arenaAlloc(arena, sizeof(ASTNode*) * (size_t)depth);
+    int index = depth;
+    for (ASTNode* current = node; current->type == AST_BINARY_EXPR; current = current->data.binaryExpr.left) {
+        spine[--index] = current;
+    }
+
+    ValueType type = generateOperand(gen, leftmost);
+    for (int i = 0; i < depth; i++) {
+        ASTNode* right = spine[i]->data.binaryExpr.right;
+        ValueType rightType;
+        if (isLeaf(right)) {
+            rightType = loadLeaf(gen, RCX, right);
+        } else {
+            push(gen, RAX);
+            rightType = generateExpression(gen, right);
+            moveRegister(gen, RCX, RAX);
+            pop(gen, RAX);
+        }
+        type = applyOperator(gen, spine[i], type, rightType);
+    }
+    arenaRelease(arena, mark);
+    return type;
+}
+
+// ---------------------------------------------------------------------------
+// Superword-level parallelism. Two adjacent `int` declarations whose
+// initializers are isomorphic trees of `+` and `-` are computed in the two
+// lanes of SSE2 registers (the x86-64 baseline; AVX would need a CPU
+// check), %xmm<depth> holding each subtree. Lane 0 belongs to the second
+// declaration, which gets the lower slot, so one unaligned store writes
+// both results.
+// ---------------------------------------------------------------------------
+
+#define VECTOR_MAX_LEAVES 16
+#define VECTOR_REGISTERS 8      // %xmm0-%xmm7 need no REX prefix
+
+typedef struct {
+    const char* firstName;      // The second tree must not read it
+    int leaves;
+    int registers;              // Deepest %xmm used + 1
+    int vectorCost;             // Estimated instructions
+    int scalarCost;
+} VectorPlan;
+
+// SSE2 instruction with a mandatory prefix on an %rbp slot
+static void sseFrame(CodeGenerator* gen, uint8_t prefix, uint8_t opcode, int xmm, int32_t offset) {
+    uint8_t bytes[4] = {prefix, 0x0F, opcode, (uint8_t)(0x80 | (xmm << 3) | RBP)};
+    emitBytes(gen, bytes, 4);
+    emit32(gen, (uint32_t)offset);
+}
+
+// ... and on two registers
+static void sseRegisters(CodeGenerator* gen, uint8_t opcode, const char* mnemonic, int destination, int source) {
+    uint8_t bytes[4] = {0x66, 0x0F, opcode, (uint8_t)(0xC0 | (destination << 3) | source)};
+    emitBytes(gen, bytes, 4);
+    assemblyLine(gen, "%s %%xmm%d, %%xmm%d", mnemonic, source, destination);
+}
+
+static bool intLiteral(const ASTNode* node, int64_t* value) {
+    if (node->type != AST_LITERAL || node->data.literal.value[0] == '"') return false;
+    errno = 0;
+    char* end;
+    long long number = strtoll(node->data.literal.value, &end, 10);
+    if (errno == ERANGE || *end != '\0') return false;
+    *value = number;
+    return true;
+}
+
+// An int variable in a frame slot
+static const Local* slotLocal(const CodeGenerator* gen, const ASTNode* node) {
+    if (node->type != AST_IDENTIFIER) return NULL;
+    const Local* local = findLocal(gen, node->data.identifier.name);
+    return local && local->type == TYPE_INT && local->reg == NO_REGISTER ? local : NULL;
+}
+
+// Instructions the stack machine spends on `node`, as generateExpression
+// emits them
+static int scalarCost(const ASTNode* node) {
+    if (node->type != AST_BINARY_EXPR) return 1;
+    const ASTNode* right = node->data.binaryExpr.right;
+    return scalarCost(node->data.binaryExpr.left) + (isLeaf(right) ? 1 : scalarCost(right) + 3) + 1;
+}
+
+// Whether `first` and `second` can be computed as one vector tree in
+// %xmm<depth> and up, adding up the cost of doing so
+static bool planVector(const CodeGenerator* gen, const ASTNode* first, const ASTNode* second, int depth,
+                       VectorPlan* plan) {
+    if (depth + 2 > VECTOR_REGISTERS) return false;
+    if (depth + 2 > plan->registers) plan->registers = depth + 2;
+
+    if (first->type == AST_BINARY_EXPR || second->type == AST_BINARY_EXPR) {
+        if (first->type != second->type) return false;
+        int op = first->operator;
+        if (op != second->operator || (op != TOKEN_PLUS && op != TOKEN_MINUS)) return false;
+        plan->vectorCost++;
+        return planVector(gen, first->data.binaryExpr.left, second->data.binaryExpr.left, depth, plan) &&
+               planVector(gen, first->data.binaryExpr.right, second->data.binaryExpr.right, depth + 1, plan);
+    }
+
+    if (++plan->leaves > VECTOR_MAX_LEAVES) return false;
+    int64_t value;
+    if (intLiteral(first, &value) && intLiteral(second, &value)) {
+        plan->vectorCost++;         // movdqa of a constant pair
+        return true;
+    }
+    if (second->type == AST_IDENTIFIER && strcmp(second->data.identifier.name, plan->firstName) == 0) return false;
+    const Local* a = slotLocal(gen, first);
+    const Local* b = slotLocal(gen, second);
+    if (!a || !b) return false;
+    bool contiguous = a->offset == b->offset + 8 && vectorWritten(gen, b->offset);
+    plan->vectorCost += contiguous ? 1 : 3;     // movdqu, or movq + movq + punpcklqdq
+    return true;
+}
+
+// Lane 0 from `second`, lane 1 from `first`, into %xmm<depth>
+static void generateVectorTree(CodeGenerator* gen, const ASTNode* first, const ASTNode* second, int depth) {
+    if (first->type == AST_BINARY_EXPR) {
+        generateVectorTree(gen, first->data.binaryExpr.left, second->data.binaryExpr.left, depth);
+        generateVectorTree(gen, first->data.binaryExpr.right, second->data.binaryExpr.right, depth + 1);
+        if (first->operator == TOKEN_PLUS) {
+            sseRegisters(gen, 0xD4, "paddq", depth, depth + 1);
+        } else {
+            sseRegisters(gen, 0xFB, "psubq", depth, depth + 1);
+        }
+        compilerStats.arithmeticOperations += 2;
+        compilerStats.vectorizedOperations += 2;
+        return;
+    }
+
+    int64_t high, low;
+    if (intLiteral(first, &high) && intLiteral(second, &low)) {
+        size_t offset = sectionReserve(gen->object, SECTION_RODATA, 16, 16);
+        uint8_t* constant = gen->object->sections[SECTION_RODATA].data + offset;
+        for (int i = 0; i < 8; i++) {
+            constant[i] = (uint8_t)((uint64_t)low >> (8 * i));
+            constant[8 + i] = (uint8_t)((uint64_t)high >> (8 * i));
+        }
+        if (gen->assembly) {
+            fprintf(gen->assembly, "\t.section .rodata\n\t.p2align 4\n.Lvec%zu:\n\t.quad %lld, %lld\n%s", offset,
+                    (long long)low, (long long)high, textDirective(gen));
+        }
+        uint8_t prefix[4] = {0x66, 0x0F, 0x6F, (uint8_t)((depth << 3) | 5)};
+        ripOperand(gen, prefix, 4, sectionSymbol(gen->object, SECTION_RODATA), (int64_t)offset);
+        assemblyLine(gen, "movdqa .Lvec%zu(%%rip), %%xmm%d", offset, depth);
+        return;
+    }
+
+    const Local* a = findLocal(gen, first->data.identifier.name);
+    const Local* b = findLocal(gen, second->data.identifier.name);
+    if (a->offset == b->offset + 8 && vectorWritten(gen, b->offset)) {
+        sseFrame(gen, 0xF3, 0x6F, depth, b->offset);
+        assemblyLine(gen, "movdqu %d(%%rbp), %%xmm%d", b->offset, depth);
+        return;
+    }
+    sseFrame(gen, 0xF3, 0x7E, depth, b->offset);
+    assemblyLine(gen, "movq %d(%%rbp), %%xmm%d", b->offset, depth);
+    sseFrame(gen, 0xF3, 0x7E, depth + 1, a->offset);
+    assemblyLine(gen, "movq %d(%%rbp), %%xmm%d", a->offset, depth + 1);
+    sseRegisters(gen, 0x6C, "punpcklqdq", depth, depth + 1);
+}
+
+// Both declarations at once, if they pack and the cost model agrees;
+// returns false, generating nothing, otherwise
+static bool generateVectorPair(CodeGenerator* gen, ASTNode* first, ASTNode* second) {
+    if (gen->options.noVectorize || first->type != AST_VAR_DECL || second->type != AST_VAR_DECL) return false;
+    const char* types[2] = {first->data.varDecl.varType, second->data.varDecl.varType};
+    for (int i = 0; i < 2; i++) {
+        if (!types[i] || strcmp(types[i], "int") != 0) return false;
+    }
+    if (strcmp(first->data.varDecl.name, second->data.varDecl.name) == 0) return false;
+    if (promotedRegister(gen, first) != NO_REGISTER || promotedRegister(gen, second) != NO_REGISTER) return false;
+    ASTNode* a = first->data.varDecl.initializer;
+    ASTNode* b = second->data.varDecl.initializer;
+    if (a->type != AST_BINARY_EXPR) return false;
+
+    VectorPlan plan = {first->data.varDecl.name, 0, 0, 1, scalarCost(a) + scalarCost(b) + 2};
+    if (!planVector(gen, a, b, 0, &plan) || plan.vectorCost >= plan.scalarCost) return false;
+
+    generateVectorTree(gen, a, b, 0);
+    declareLocal(gen, first->data.varDecl.name, TYPE_INT);
+    int32_t low = declareLocal(gen, second->data.varDecl.name, TYPE_INT);
+    sseFrame(gen, 0xF3, 0x7F, 0, low);
+    assemblyLine(gen, "movdqu %%xmm0, %d(%%rbp)", low);
+    trackVectorSlots(gen, low, true);
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Statements and functions
+// ---------------------------------------------------------------------------
+
+static void generateBlock(CodeGenerator* gen, ASTNode* statements, bool last) {
+    int localCount = gen->localCount;
+    int32_t slotBytes = gen->slotBytes;
+    for (ASTNode* statement = statements; statement; statement = statement->next) {
+        if (statement->next && generateVectorPair(gen, statement, statement->next)) {
+            statement = statement->next;
+            continue;
+        }
+        generateStatement(gen, statement, last && !statement->next);
+    }
+    gen->localCount = localCount;
+    gen->slotBytes = slotBytes;
+}
+
+// `last`: nothing follows in the function, so a return can fall through
+static void generateStatement(CodeGenerator* gen, ASTNode* node, bool last) {
+    switch (node->type) {
+        case AST_VAR_DECL: {
+            const char* name = node->data.varDecl.name;
+            ValueType type = typeFromName(node->data.varDecl.varType);
+            checkSupportedType(gen, node->data.varDecl.varType, name);
+            checkAssignable(gen, type, generateExpression(gen, node->data.varDecl.initializer), "Variable", name);
+            bindLocal(gen, node, name, type, RAX);
+            break;
+        }
+        case AST_EXPR_STMT:
+            generateExpression(gen, node->data.exprStmt.expression);
+            break;
+        case AST_RETURN_STMT:
+            if (node->data.returnStmt.value) {
+                ValueType type;
+                bool jumped = generateTailCall(gen, node->data.returnStmt.value, &type);
+                if (!jumped) type = generateExpression(gen, node->data.returnStmt.value);
+                if (!compatible(gen->returnType, type)) {
+                    codegenError(gen, "Error: Return of %s from a function returning %s.",
+                                 typeNames[type], typeNames[gen->returnType]);
+                }
+                if (jumped) break;
+            } else {
+                moveImmediate(gen, RAX, 0);
+            }
+            if (!last) jumpToReturn(gen);
+            break;
+        case AST_BLOCK:
+            generateBlock(gen, node->data.block.declarations, last);
+            break;
+        case AST_FUNC_DECL:
+            codegenError(gen, "Error: Nested function '%s' is not supported.", node->data.funcDecl.name);
+            break;
+        default:
+            codegenError(gen, "Error: Unexpected statement node.");
+            break;
+    }
+}
+
+typedef struct {
+    int live;
+    int peak;
+} FrameUsage;
+
+static VisitResult countLocals(ASTNode* node, int depth, void* context) {
+    (void)depth;
+    FrameUsage* usage = (FrameUsage*)context;
+    switch (node->type) {
+        case AST_BLOCK:
+            return VISIT_CONTINUE;
+        case AST_VAR_DECL:
+            if (++usage->live > usage->peak) usage->peak = usage->live;
+            return VISIT_SKIP_CHILDREN;
+        default:
+            return VISIT_SKIP_CHILDREN; // Expressions declare nothing
+    }
+}
+
+static void releaseLocals(ASTNode* node, int depth, void* context) {
+    (void)depth;
+    if (node->type != AST_BLOCK) return;
+    for (ASTNode* statement = node->data.block.declarations; statement; statement = statement->next) {
+        if (statement->type == AST_VAR_DECL) ((FrameUsage*)context)->live--;
+    }
+}
+
+// Most local slots live at once in `statement`
+static int peakLocals(ASTNode* statement) {
+    FrameUsage usage = {0, 0};
+    ASTVisitor visitor = {countLocals, releaseLocals, &usage};
+    walkASTNode(statement, &visitor);
+    return usage.peak;
+}
+
+static VisitResult findSelfCall(ASTNode* node, int depth, void* context) {
+    (void)depth;
+    if (node->type == AST_CALL_EXPR && strcmp(node->data.callExpr.callee, (const char*)context) == 0) return VISIT_STOP;
+    return VISIT_CONTINUE;
+}
+
+static bool callsItself(ASTNode* body, const char* name) {
+    ASTVisitor visitor = {findSelfCall, NULL, (void*)name};
+    return !walkASTNode(body, &visitor);
+}
+
+typedef struct {
+    CodeGenerator* gen;
+    int sites;
+    int inlineSlots;        // Most slots one inlined body takes
+} CallSites;
+
+// Numbers the calls of a function in source order (the profile's call
+// site ids) and sizes the frame space the hot ones need once inlined
+static VisitResult numberCallSite(ASTNode* node, int depth, void* context) {
+    (void)depth;
+    CallSites* sites = (CallSites*)context;
+    if (node->type != AST_CALL_EXPR || isBuiltinCall(sites->gen, node)) return VISIT_CONTINUE;
+    node->site = sites->sites++;
+    ASTNode* function = inlineTarget(sites->gen, node);
+    if (function) {
+        int slots = peakLocals(function->data.funcDecl.body);
+        for (ASTNode* param = function->data.funcDecl.params; param; param = param->next) slots++;
+        if (slots > sites->inlineSlots) sites->inlineSlots = slots;
+    }
+    return VISIT_CONTINUE;
+}
+
+// How often each variable name is declared and used in a function
+typedef struct {
+    StringPool names;
+    int* declarations;      // By name id
+    int* uses;
+    const ASTNode** declaration;
+    uint32_t capacity;
+} VariableUsage;
+
+static uint32_t usageOf(VariableUsage* usage, const char* name) {
+    uint32_t id = internString(&usage->names, name, strlen(name));
+    if (id >= usage->capacity) {
+        uint32_t previous = usage->capacity;
+        usage->capacity = usage->names.capacity;
+        usage->declarations = (int*)realloc(usage->declarations, usage->capacity * sizeof(int));
+        usage->uses = (int*)realloc(usage->uses, usage->capacity * sizeof(int));
+        usage->declaration = (const ASTNode**)realloc(usage->declaration, usage->capacity * sizeof(ASTNode*));
+        for (uint32_t i = previous; i < usage->capacity; i++) {
+            usage->declarations[i] = 0;
+            usage->uses[i] = 0;
+            usage->declaration[i] = NULL;
+        }
+    }
+    return id;
+}
+
+// The initial store counts as a use
+static void declareVariable(VariableUsage* usage, const ASTNode* declaration, const char* name) {
+    uint32_t id = usageOf(usage, name);
+    usage->declarations[id]++;
+    usage->uses[id]++;
+    usage->declaration[id] = declaration;
+}
+
+static VisitResult countVariableUses(ASTNode* node, int depth, void* context) {
+    (void)depth;
+    VariableUsage* usage = (VariableUsage*)context;
+    if (node->type == AST_VAR_DECL) {
+        declareVariable(usage, node, node->data.varDecl.name);
+    } else if (node->type == AST_IDENTIFIER) {
+        usage->uses[usageOf(usage, node->data.identifier.name)]++;
+    }
+    return VISIT_CONTINUE;
+}
+
+// In a hot function, the most used variables get the callee-saved
+// registers. Only names declared once qualify, so that a register always
+// stands for the same variable.
+static void choosePromoted(CodeGenerator* gen, ASTNode* function) {
+    gen->promotedCount = 0;
+    const Profile* profile = gen->options.profile;
+    if (!profile) return;
+    uint64_t count = profileFunctionCount(profile, function->data.funcDecl.name);
+    if (count == 0 || count * 100 < profile->maxFunctionCount * HOT_PERCENT) return;
+
+    VariableUsage usage;
+    memset(&usage, 0, sizeof(VariableUsage));
+    initStringPool(&usage.names);
+    for (ASTNode* param = function->data.funcDecl.params; param; param = param->next) {
+        declareVariable(&usage, param, param->data.param.name);
+    }
+    ASTVisitor visitor = {countVariableUses, NULL, &usage};
+    walkASTNode(function->data.funcDecl.body, &visitor);
+
+    while (gen->promotedCount < PROMOTABLE_REGISTERS) {
+        uint32_t best = STRING_NOT_FOUND;
+        for (uint32_t id = 0; id < usage.names.count; id++) {
+            if (usage.declarations[id] != 1 || usage.uses[id] < PROMOTE_MIN_USES) continue;
+            if (best == STRING_NOT_FOUND || usage.uses[id] > usage.uses[best]) best = id;
+        }
+        if (best == STRING_NOT_FOUND) break;
+        gen->promoted[gen->promotedCount++] = usage.declaration[best];
+        usage.uses[best] = 0;
+    }
+
+    free(usage.declarations);
+    free(usage.uses);
+    free(usage.declaration);
+    freeStringPool(&usage.names);
+}
+
+static void beginFunction(CodeGenerator* gen, const char* name, int slots) {
+    size_t start = textOffset(gen);
+    uint32_t symbol = findObjectSymbol(gen->object, name);
+    if (symbol == NO_SYMBOL) {
+        addObjectSymbol(gen->object, name, SYMBOL_FUNCTION, gen->text, start, 0, true);
+    } else if (gen->object->symbols[symbol].kind == SYMBOL_UNDEFINED) {
+        // Called before it was defined
+        gen->object->symbols[symbol].kind = SYMBOL_FUNCTION;
+        gen->object->symbols[symbol].section = gen->text;
+        gen->object->symbols[symbol].value = start;
+    } else {
+        codegenError(gen, "Error: '%s' is already defined.", name);
+    }
+    if (gen->assembly) {
+        fprintf(gen->assembly, "\t.globl %s\n\t.type %s, @function\n%s:\n", name, name, name);
+    }
+
+    gen->localCount = 0;
+    gen->localBase = 0;
+    gen->vectorSlotCount = 0;
+    gen->slotBytes = 0;
+    gen->pushed = 0;
+    gen->returnJumpCount = 0;
+    gen->returnLabel = gen->functionCount++;
+    gen->returnType = TYPE_INT;
+    gen->localBytes = slots * 8;
+    gen->regionLive = false;
+
+    // subq $frame, %rsp with the size filled in by endFunction
+    emitBytes(gen, (const uint8_t[]){0x55, 0x48, 0x89, 0xE5, 0x48, 0x81, 0xEC}, 7);
+    gen->frameSizeField = textOffset(gen);
+    emit32(gen, 0);
+    assemblyLine(gen, "pushq %%rbp");
+    assemblyLine(gen, "movq %%rsp, %%rbp");
+    assemblyLine(gen, "subq $.Lframe%u, %%rsp", gen->returnLabel);
+}
+
+static void endFunction(CodeGenerator* gen, const char* name) {
+    size_t release = textOffset(gen);
+    if (gen->regionLive) releaseRegion(gen);
+    size_t epilogue = textOffset(gen);
+    for (int i = 0; i < gen->returnJumpCount; i++) {
+        size_t field = gen->returnJumps[i].offset;
+        size_t target = gen->returnJumps[i].release ? release : epilogue;
+        sectionPatch32(gen->object, gen->text, field, (uint32_t)(target - (field + 4)));
+    }
+    if (gen->assembly) fprintf(gen->assembly, ".Lreturn%u:\n", gen->returnLabel);
+    restoreRegisters(gen);
+    emitBytes(gen, (const uint8_t[]){0xC9, 0xC3}, 2);
+    assemblyLine(gen, "leave");
+    assemblyLine(gen, "ret");
+    assemblyLine(gen, ".size %s, .-%s", name, name);
+
+    int32_t frame = (gen->localBytes + (gen->regionLive ? REGION_FRAME_BYTES : 0) + 15) & ~15;
+    sectionPatch32(gen->object, gen->text, gen->frameSizeField, (uint32_t)frame);
+    if (gen->assembly) fprintf(gen->assembly, "\t.set .Lframe%u, %d\n", gen->returnLabel, frame);
+
+    uint32_t symbol = findObjectSymbol(gen->object, name);
+    gen->object->symbols[symbol].size = textOffset(gen) - gen->object->symbols[symbol].value;
+}
+
+// Target of self tail calls, once the parameters are in their slots
+static void markLoopHead(CodeGenerator* gen) {
+    gen->loopHead = textOffset(gen);
+    if (gen->assembly) fprintf(gen->assembly, ".Lloop%u:\n", gen->returnLabel);
+}
+
+// Whether control cannot fall off the end of `statements` (a trailing
+// block is looked into, since its last return falls through as well)
+static bool endsWithReturn(ASTNode* statements) {
+    while (statements) {
+        while (statements->next) statements = statements->next;
+        if (statements->type != AST_BLOCK) return statements->type == AST_RETURN_STMT;
+        statements = statements->data.block.declarations;
+    }
+    return false;
+}
+
+static void generateFunction(CodeGenerator* gen, ASTNode* node) {
+    const char* name = node->data.funcDecl.name;
+    checkSupportedType(gen, node->data.funcDecl.returnType, name);
+
+    int params = 0;
+    for (ASTNode* param = node->data.funcDecl.params; param; param = param->next) {
+        checkSupportedType(gen, param->data.param.paramType, param->data.param.name);
+        params++;
+    }
+    int spilled = params < REGISTER_ARGUMENTS ? params : REGISTER_ARGUMENTS;
+    if (!gen->options.heapStrings) analyzeFunctionEscapes(node, builtinReadsOnly, gen);
+    gen->functionName = name;
+    gen->paramCount = params;
+    gen->inlineCalls = gen->options.profile != NULL;
+
+    CallSites sites = {gen, 0, 0};
+    ASTVisitor visitor = {numberCallSite, NULL, &sites};
+    walkASTNode(node->data.funcDecl.body, &visitor);
+    choosePromoted(gen, node);
+
+    // The registers are saved past the local slots
+    int slots = spilled + peakLocals(node->data.funcDecl.body) + sites.inlineSlots;
+    beginFunction(gen, name, slots + gen->promotedCount);
+    gen->saveOffset = -8 * (slots + 1);
+    gen->returnType = typeFromName(node->data.funcDecl.returnType);
+    saveRegisters(gen);
+    if (gen->options.profileGenerate) countEvent(gen, "function %s", name);
+
+    // Register parameters get a slot; the rest are already in the caller's frame
+    int index = 0;
+    for (ASTNode* param = node->data.funcDecl.params; param; param = param->next, index++) {
+        ValueType type = typeFromName(param->data.param.paramType);
+        if (index < REGISTER_ARGUMENTS) {
+            bindLocal(gen, param, param->data.param.name, type, argumentRegisters[index]);
+        } else {
+            int32_t offset = parameterOffset(index);
+            addLocal(gen, param->data.param.name, offset, type);
+            int reg = promotedRegister(gen, param);
+            if (reg != NO_REGISTER) {
+                gen->locals[gen->localCount - 1].reg = reg;
+                loadFrame(gen, reg, offset);
+            }
+        }
+    }
+
+    markLoopHead(gen);
+
+    ASTNode* statements = node->data.funcDecl.body->data.block.declarations;
+    generateBlock(gen, statements, true);
+    if (!endsWithReturn(statements)) moveImmediate(gen, RAX, 0);
+    endFunction(gen, name);
+}
+
+// Top-level statements other than function declarations, in source order
+static void generateModuleInit(CodeGenerator* gen, ASTNode* declarations) {
+    int slots = 0;
+    for (ASTNode* node = declarations; node; node = node->next) {
+        if (node->type == AST_FUNC_DECL || node->type == AST_VAR_DECL || node->type == AST_IMPORT) continue;
+        int peak = peakLocals(node);
+        if (peak > slots) slots = peak;
+    }
+    if (!gen->options.heapStrings) analyzeModuleEscapes(declarations, builtinReadsOnly, gen);
+    gen->functionName = gen->initSymbol;
+    gen->paramCount = 0;
+    gen->inlineCalls = false;
+    gen->promotedCount = 0;
+
+    CallSites sites = {gen, 0, 0};
+    ASTVisitor visitor = {numberCallSite, NULL, &sites};
+    for (ASTNode* node = declarations; node; node = node->next) {
+        if (node->type != AST_FUNC_DECL) walkASTNode(node, &visitor);
+    }
+
+    beginFunction(gen, gen->initSymbol, slots);
+    if (gen->options.profileGenerate) countEvent(gen, "function %s", gen->initSymbol);
+    markLoopHead(gen);
+    for (uint32_t i = 0; i < gen->initCalls.count; i++) callRuntime(gen, poolString(&gen->initCalls, i));
+
+    for (ASTNode* node = declarations; node; node = node->next) {
+        switch (node->type) {
+            case AST_FUNC_DECL:
+            case AST_IMPORT:
+                break;
+            case AST_VAR_DECL: {
+                uint32_t global = findGlobal(gen, node->data.varDecl.name);
+                if (global == NO_SYMBOL) break; // Duplicate, already reported
+                ValueType type = generateExpression(gen, node->data.varDecl.initializer);
+                checkAssignable(gen, symbolType(gen, global), type, "Variable", node->data.varDecl.name);
+                storeGlobal(gen, global, RAX);
+                break;
+            }
+            default:
+                generateStatement(gen, node, false);
+                break;
+        }
+    }
+    moveImmediate(gen, RAX, 0);
+    endFunction(gen, gen->initSymbol);
+}
+
+// Signatures of the imported modules' functions and globals, from their
+// interfaces. The entry module also collects the initializers to run.
+static void declareImports(CodeGenerator* gen, ASTNode* declarations) {
+    for (ASTNode* node = declarations; node; node = node->next) {
+        if (node->type != AST_IMPORT) continue;
+        const ModuleInterface* module = importModule(node->data.import.module);
+        if (!module) {
+            codegenError(gen, "Error: No interface for module '%s'.", node->data.import.module);
+            continue;
+        }
+        for (uint32_t i = 0; i < module->exportCount; i++) {
+            ModuleExport exported = moduleExport(module, i);
+            uint32_t symbol = symbolReference(gen->object, exported.name);
+            if (gen->object->symbols[symbol].kind != SYMBOL_UNDEFINED) continue;
+            setSymbolType(gen, symbol, typeFromName(exported.type));
+            if (exported.kind == EXPORT_GLOBAL) {
+                internString(&gen->importedGlobals, exported.name, strlen(exported.name));
+            }
+        }
+        if (gen->options.moduleName) continue;
+        for (uint32_t i = 0; i < module->initCount; i++) {
+            const char* init = moduleInit(module, i);
+            internString(&gen->initCalls, init, strlen(init));
+        }
+    }
+}
+
+static void setFunctionNode(CodeGenerator* gen, uint32_t symbol, ASTNode* node) {
+    if (symbol >= gen->functionNodeCapacity) {
+        uint32_t capacity = gen->object->symbolCapacity;
+        gen->functionNodes = (ASTNode**)realloc(gen->functionNodes, capacity * sizeof(ASTNode*));
+        for (uint32_t i = gen->functionNodeCapacity; i < capacity; i++) gen->functionNodes[i] = NULL;
+        gen->functionNodeCapacity = capacity;
+    }
+    gen->functionNodes[symbol] = node;
+}
+
+typedef struct {
+    ASTNode* node;
+    uint64_t count;         // Entries in the profile
+    int index;              // Source order, to keep the sort stable
+} FunctionOrder;
+
+static int hotterFirst(const void* a, const void* b) {
+    const FunctionOrder* left = (const FunctionOrder*)a;
+    const FunctionOrder* right = (const FunctionOrder*)b;
+    if (left->count != right->count) return left->count > right->count ? -1 : 1;
+    return left->index - right->index;
+}
+
+// Functions in source order, or with a profile, busiest first and those
+// that never ran in .text.unlikely, away from the code that does
+static void generateFunctions(CodeGenerator* gen, ASTNode* declarations) {
+    int count = 0;
+    for (ASTNode* node = declarations; node; node = node->next) {
+        if (node->type == AST_FUNC_DECL) count++;
+    }
+    if (count == 0) return;
+    FunctionOrder* order = (FunctionOrder*)malloc(sizeof(FunctionOrder) * (size_t)count);
+    const Profile* profile = gen->options.profile;
+    int index = 0;
+    for (ASTNode* node = declarations; node; node = node->next) {
+        if (node->type != AST_FUNC_DECL) continue;
+        order[index].node = node;
+        order[index].count = profile ? profileFunctionCount(profile, node->data.funcDecl.name) : 0;
+        order[index].index = index;
+        index++;
+    }
+    bool layout = profile && profile->maxFunctionCount > 0;
+    if (layout) qsort(order, (size_t)count, sizeof(FunctionOrder), hotterFirst);
+
+    for (int i = 0; i < count; i++) {
+        SectionKind text = layout && order[i].count == 0 ? SECTION_TEXT_COLD : SECTION_TEXT;
+        if (text != gen->text) {
+            gen->text = text;
+            if (gen->assembly) fputs(textDirective(gen), gen->assembly);
+        }
+        generateFunction(gen, order[i].node);
+    }
+    free(order);
+
+    if (gen->text != SECTION_TEXT) {
+        gen->text = SECTION_TEXT;
+        if (gen->assembly) fputs(textDirective(gen), gen->assembly);
+    }
+}
+
+bool generateCode(ASTNode* program, const CodegenOptions* options, ObjectFile* object, FILE* assembly, FILE* err) {
+    CodeGenerator gen;
+    memset(&gen, 0, sizeof(CodeGenerator));
+    if (options) gen.options = *options;
+    gen.object = object;
+    gen.assembly = assembly;
+    gen.err = err ? err : stderr;
+    gen.text = SECTION_TEXT;
+    initStringPool(&gen.literals);
+    initStringPool(&gen.importedGlobals);
+    initStringPool(&gen.initCalls);
+    if (gen.options.moduleName) {
+        moduleInitSymbol(gen.options.moduleName, gen.initSymbol, sizeof(gen.initSymbol));
+    } else {
+        snprintf(gen.initSymbol, sizeof(gen.initSymbol), "%s", MODULE_INIT_SYMBOL);
+    }
+
+    ASTNode* declarations = program->type == AST_BLOCK ? program->data.block.declarations : program;
+    declareImports(&gen, declarations);
+
+    // Globals first, so function bodies can refer to any of them
+    bool hasInit = gen.initCalls.count > 0;
+    for (ASTNode* node = declarations; node; node = node->next) {
+        if (node->type == AST_FUNC_DECL || node->type == AST_IMPORT) continue;
+        hasInit = true;
+        if (node->type != AST_VAR_DECL) continue;
+
+        const char* name = node->data.varDecl.name;
+        checkSupportedType(&gen, node->data.varDecl.varType, name);
+        if (findObjectSymbol(object, name) != NO_SYMBOL) {
+            codegenError(&gen, "Error: '%s' is already defined.", name);
+            continue;
+        }
+        size_t offset = sectionReserve(object, SECTION_BSS, 8, 8);
+        uint32_t symbol = addObjectSymbol(object, name, SYMBOL_OBJECT, SECTION_BSS, offset, 8, true);
+        setSymbolType(&gen, symbol, typeFromName(node->data.varDecl.varType));
+        if (assembly) {
+            fprintf(assembly, "\t.bss\n\t.p2align 3\n\t.globl %s\n\t.type %s, @object\n\t.size %s, 8\n%s:\n\t.zero 8\n",
+                    name, name, name, name);
+        }
+    }
+
+    // Return types of the module's functions, so calls ahead of the callee's
+    // definition are typed; clashes are reported when the body is generated
+    for (ASTNode* node = declarations; node; node = node->next) {
+        if (node->type != AST_FUNC_DECL || findObjectSymbol(object, node->data.funcDecl.name) != NO_SYMBOL) continue;
+        uint32_t symbol = symbolReference(object, node->data.funcDecl.name);
+        setSymbolType(&gen, symbol, typeFromName(node->data.funcDecl.returnType));
+        setFunctionNode(&gen, symbol, node);
+    }
+
+    if (assembly) fprintf(assembly, "\t.text\n");
+    generateFunctions(&gen, declarations);
+    if (hasInit) generateModuleInit(&gen, declarations);
+    emitProfileModule(&gen);
+    if (assembly) fprintf(assembly, "\t.section .note.GNU-stack,\"\",@progbits\n");
+
+    free(gen.locals);
+    free(gen.returnJumps);
+    free(gen.symbolTypes);
+    free(gen.functionNodes);
+    free(gen.vectorSlots);
+    free(gen.records);
+    free(gen.literalOffsets);
+    freeStringPool(&gen.literals);
+    freeStringPool(&gen.importedGlobals);
+    freeStringPool(&gen.initCalls);
+    return !gen.failed;
+}
@@ -0,0 +1,309 @@
+#include "driver.h"
+#include "lexer.h"
+#include "parallel_lexer.h"
+#include "parser.h"
+#include "ast_serialize.h"
+#include "semantic_analysis.h"
+#include "codegen.h"
+#include "optimizer.h"
+#include "module.h"
+#include "stats.h"
+#include "thread_pool.h"
+#include "ast_visitor.h"
+#include "compat.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char* operatorSymbol(int op) {
+    switch (op) {
+        case TOKEN_PLUS: return "+";
+        case TOKEN_MINUS: return "-";
+        case TOKEN_STAR: return "*";
+        case TOKEN_SLASH: return "/";
+    }
+    return "?";
+}
+
+typedef struct {
+    FILE* out;
+    int indent;
+} PrintContext;
+
+static VisitResult printNode(ASTNode* node, int depth, void* context) {
+    FILE* out = ((PrintContext*)context)->out;
+
+    for (int i = ((PrintContext*)context)->indent + depth; i > 0; i--) fputs("  ", out);
+    switch (node->type) {
+        case AST_VAR_DECL:
+            fprintf(out, "VarDecl: %s %s = \n", node->data.varDecl.varType, node->data.varDecl.name);
+            break;
+        case AST_FUNC_DECL:
+            fprintf(out, "FuncDecl: %s %s\n", node->data.funcDecl.returnType, node->data.funcDecl.name);
+            break;
+        case AST_PARAM:
+            fprintf(out, "Param: %s %s\n", node->data.param.paramType, node->data.param.name);
+            break;
+        case AST_BLOCK:
+            fprintf(out, "Block\n");
+            break;
+        case AST_EXPR_STMT:
+            fprintf(out, "ExprStmt\n");
+            break;
+        case AST_BINARY_EXPR:
+            fprintf(out, "BinaryExpr: %s\n", operatorSymbol(node->operator));
+            break;
+        case AST_LITERAL:
+            fprintf(out, "Literal: %s\n", node->data.literal.value);
+            break;
+        case AST_IDENTIFIER:
+            fprintf(out, "Identifier: %s\n", node->data.identifier.name);
+            break;
+        case AST_CALL_EXPR:
+            fprintf(out, "CallExpr: %s\n", node->data.callExpr.callee);
+            break;
+        case AST_RETURN_STMT:
+            fprintf(out, "ReturnStmt\n");
+            break;
+        case AST_IMPORT:
+            fprintf(out, "Import: %s\n", node->data.import.module);
+            break;
+        case AST_LAZY_BODY:
+            fprintf(out, "LazyBody\n");
+            break;
+    }
+    return VISIT_CONTINUE;
+}
+
+void printAST(FILE* out, ASTNode* node, int indent) {
+    PrintContext context = {out, indent};
+    ASTVisitor visitor = {printNode, NULL, &context};
+    walkAST(node, &visitor);
+}
+
+
+char* readSourceFile(const char* path, size_t* length) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return NULL;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size < 0) {
+        fclose(file);
+        return NULL;
+    }
+
+    char* source = (char*)malloc((size_t)size + 1);
+    size_t read = fread(source, 1, (size_t)size, file);
+    fclose(file);
+    if (read != (size_t)size) {
+        free(source);
+        return NULL;
+    }
+    source[size] = '\0';
+    if (length) *length = (size_t)size;
+    return source;
+}
+
+// Semantic errors are routed to the stream of the compilation that raised them
+static THREAD_LOCAL FILE* diagnostics = NULL;
+static THREAD_LOCAL int diagnosticCount = 0;
+
+static void reportDiagnostic(const char* format, va_list args) {
+    vfprintf(diagnostics, format, args);
+    fputc('\n', diagnostics);
+    diagnosticCount++;
+}
+
+static bool emitNativeCode(ASTNode* ast, const CompileOptions* options, FILE* err) {
+    FILE* assembly = NULL;
+    if (options->emitAssemblyPath) {
+        assembly = fopen(options->emitAssemblyPath, "w");
+        if (!assembly) {
+            fprintf(err, "Error: Could not open '%s' for writing.\n", options->emitAssemblyPath);
+            return false;
+        }
+    }
+
+    CodegenOptions codegen = options->codegen;
+    Profile profile;
+    initProfile(&profile);
+    if (options->profileUsePath) {
+        if (!loadProfile(&profile, options->profileUsePath, err)) {
+            freeProfile(&profile);
+            if (assembly) fclose(assembly);
+            return false;
+        }
+        codegen.profile = &profile;
+    }
+
+    ObjectFile object;
+    initObjectFile(&object);
+    beginPhase(PHASE_CODEGEN);
+    if (!options->noConstantCalls) evaluateConstantCalls(ast, CONSTANT_CALL_FUEL);
+    foldStringConstants(ast);
+    bool ok = generateCode(ast, &codegen, &object, assembly, err);
+    endPhase(PHASE_CODEGEN, object.sections[SECTION_TEXT].size + object.sections[SECTION_TEXT_COLD].size);
+    freeProfile(&profile);
+
+    if (assembly) ok = fclose(assembly) == 0 && ok;
+    if (ok && options->emitObjectPath) ok = writeELFFile(&object, options->emitObjectPath);
+    if (ok && options->emitObjectBuffer) {
+        ok = writeELFObject(&object, &options->emitObjectBuffer->data, &options->emitObjectBuffer->size);
+    }
+    freeObjectFile(&object);
+    return ok;
+}
+
+// The module's name is given for dependencies; the entry module is named
+// after its interface file
+static bool emitInterface(const ASTNode* ast, const CompileOptions* options) {
+    const char* name = options->codegen.moduleName;
+    char entryName[256];
+    if (!name) {
+        const char* base = strrchr(options->emitInterfacePath, '/');
+        base = base ? base + 1 : options->emitInterfacePath;
+        size_t length = strcspn(base, ".");
+        snprintf(entryName, sizeof(entryName), "%.*s", (int)length, base);
+        name = entryName;
+    }
+    ModuleStamp stamp = {0, 0};
+    if (options->sourcePath) statModuleSource(options->sourcePath, &stamp);
+    return writeModuleInterface(ast, name, &stamp, options->codegen.moduleName ? 0 : MODULE_FLAG_ENTRY,
+                                options->emitInterfacePath);
+}
+
+static int compileAST(ASTNode* ast, unsigned long long nodes, const CompileOptions* options, FILE* out, FILE* err) {
+    beginPhase(PHASE_SEMANTIC);
+    analyzeProgram(ast);
+    endPhase(PHASE_SEMANTIC, nodes);
+
+    // The remaining steps need the bodies a lazy parse skipped; analysis
+    // and the module interface only read signatures
+    bool needsBodies = out || options->emitASTPath || options->emitObjectPath || options->emitAssemblyPath ||
+                       options->emitObjectBuffer;
+    if (options->lazyBodies && needsBodies && !expandFunctionBodies(ast)) {
+        freeAST(ast);
+        return 1;
+    }
+    // A check still owes the syntax errors of the bodies it skipped
+    if (options->lazyBodies && options->check && !needsBodies && !checkFunctionBodies(ast)) {
+        freeAST(ast);
+        return 1;
+    }
+
+    if (options->emitASTPath && !writeASTFile(ast, options->emitASTPath, err)) {
+        freeAST(ast);
+        return 1;
+    }
+
+    // Print the AST
+    if (out) printAST(out, ast, 0);
+
+    // No native code for a program with semantic errors. Code generation
+    // comes after the dump because it rewrites the tree.
+    if ((options->emitObjectPath || options->emitAssemblyPath || options->emitObjectBuffer) &&
+        (diagnosticCount > 0 || !emitNativeCode(ast, options, err))) {
+        freeAST(ast);
+        return 1;
+    }
+    // Importers compile against the interface, so only once the module did
+    if (options->emitInterfacePath && (diagnosticCount > 0 || !emitInterface(ast, options))) {
+        freeAST(ast);
+        return 1;
+    }
+
+    // Free the AST
+    freeAST(ast);
+
+    // Otherwise semantic errors are reported but only block native code
+    int exitCode = options->check && diagnosticCount > 0 ? 1 : 0;
+
+    if (options->stats) {
+        FILE* report = options->statsPath ? fopen(options->statsPath, "w") : err;
+        if (!report) {
+            fprintf(err, "Error: Could not open '%s' for writing.\n", options->statsPath);
+            return 1;
+        }
+        if (options->statsJSON) {
+            printStatsJSON(report);
+        } else {
+            printStatsText(report);
+        }
+        if (report != err) fclose(report);
+    }
+    return exitCode;
+}
+
+// Imports resolve against `modulePath` for the length of one compilation
+static int finishCompilation(ASTNode* ast, unsigned long long nodes, const CompileOptions* options, FILE* out, FILE* err) {
+    diagnostics = err;
+    diagnosticCount = 0;
+    setErrorFunction(reportDiagnostic);
+    setModuleSearchPath(options->modulePath);
+    int exitCode = compileAST(ast, nodes, options, out, err);
+    if (options->dependencies) collectModuleDependencies(options->dependencies);
+    unloadModules();
+    return exitCode;
+}
+
+int compileSource(const char* source, const CompileOptions* options, FILE* out, FILE* err) {
+    resetStats();
+    compilerStats.sourceBytes = strlen(source);
+    if (compilerStats.sourceBytes > MAX_SOURCE_BYTES) {
+        fprintf(err, "Error: Source is larger than %lu bytes.\n", (unsigned long)MAX_SOURCE_BYTES);
+        return 1;
+    }
+
+    // Large sources are lexed up front on every core and the parser replays
+    // the tokens; otherwise it pulls them from the lexer on demand
+    size_t threshold = options->parallelLexBytes ? options->parallelLexBytes : PARALLEL_LEX_THRESHOLD;
+    TokenList tokens = {0};
+    if (compilerStats.sourceBytes >= threshold && hardwareThreadCount() > 1) {
+        beginPhase(PHASE_LEX);
+        lexParallel(source, compilerStats.sourceBytes, 0, &tokens);
+        endPhase(PHASE_LEX, tokens.count - 1);
+    }
+    // Otherwise the parser times the tokens it pulls on demand
+    bool timeTokens = options->stats && !tokens.tokens;
+
+    unsigned long long nodes = compilerStats.allocs[MEM_AST].count;
+    beginPhase(PHASE_PARSE);
+
+    // Initialize the lexer
+    if (tokens.tokens) replayTokens(source, tokens.tokens);
+    else initLexer(source);
+
+    // Parse the source code
+    setParseErrorStream(err);
+    setLazyBodies(options->lazyBodies);
+    setTokenTiming(timeTokens);
+    ASTNode* ast = tryParse();
+    setTokenTiming(false);
+    setLazyBodies(false);
+    freeTokenList(&tokens);
+    if (!ast) return 1;
+
+    nodes = compilerStats.allocs[MEM_AST].count - nodes;
+    endPhase(PHASE_PARSE, nodes);
+    if (timeTokens) nestPhase(PHASE_LEX, PHASE_PARSE);
+
+    return finishCompilation(ast, nodes, options, out, err);
+}
+
+int compileSerializedAST(const char* path, const CompileOptions* options, FILE* out, FILE* err) {
+    resetStats();
+
+    // Reload a previously serialized AST instead of parsing
+    ASTView view;
+    if (!mapASTFile(path, &view, err)) return 1;
+
+    unsigned long long nodes = compilerStats.allocs[MEM_AST].count;
+    beginPhase(PHASE_PARSE);
+    ASTNode* ast = materializeAST(&view);
+    closeASTView(&view);
+    nodes = compilerStats.allocs[MEM_AST].count - nodes;
+    endPhase(PHASE_PARSE, nodes);
+
+    return finishCompilation(ast, nodes, options, out, err);
+}
@@ -0,0 +1,434 @@
+#include "elf_writer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ELF constants, spelled out here so the writer does not need <elf.h>
+#define ELF_HEADER_SIZE 64
+#define SECTION_HEADER_SIZE 64
+#define SYMBOL_ENTRY_SIZE 24
+#define RELA_ENTRY_SIZE 24
+
+#define ET_REL 1
+#define EM_X86_64 62
+
+#define SHT_PROGBITS 1
+#define SHT_SYMTAB 2
+#define SHT_STRTAB 3
+#define SHT_RELA 4
+#define SHT_NOBITS 8
+
+#define SHF_WRITE 0x1
+#define SHF_ALLOC 0x2
+#define SHF_EXECINSTR 0x4
+#define SHF_INFO_LINK 0x40
+
+#define STB_LOCAL 0
+#define STB_GLOBAL 1
+#define STT_NOTYPE 0
+#define STT_OBJECT 1
+#define STT_FUNC 2
+#define STT_SECTION 3
+
+static const struct {
+    const char* name;
+    uint32_t type;
+    uint64_t flags;
+} sectionInfo[SECTION_COUNT] = {
+    [SECTION_TEXT]      = {".text", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR},
+    [SECTION_RODATA]    = {".rodata", SHT_PROGBITS, SHF_ALLOC},
+    [SECTION_DATA]      = {".data", SHT_PROGBITS, SHF_ALLOC | SHF_WRITE},
+    [SECTION_BSS]       = {".bss", SHT_NOBITS, SHF_ALLOC | SHF_WRITE},
+    [SECTION_TEXT_COLD] = {".text.unlikely", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR},
+    [SECTION_PROFILE]   = {"cpy_prof", SHT_PROGBITS, SHF_ALLOC | SHF_WRITE},
+};
+
+// ---------------------------------------------------------------------------
+// Object model
+// ---------------------------------------------------------------------------
+
+void initObjectFile(ObjectFile* object) {
+    memset(object, 0, sizeof(ObjectFile));
+    initStringPool(&object->names);
+    for (int i = 0; i < SECTION_COUNT; i++) {
+        object->sections[i].alignment = 1;
+        object->sectionSymbols[i] = NO_SYMBOL;
+    }
+    object->sections[SECTION_TEXT].alignment = 16;
+    object->sections[SECTION_TEXT_COLD].alignment = 16;
+}
+
+void freeObjectFile(ObjectFile* object) {
+    for (int i = 0; i < SECTION_COUNT; i++) {
+        free(object->sections[i].data);
+    }
+    free(object->symbols);
+    free(object->relocations);
+    free(object->symbolByName);
+    freeStringPool(&object->names);
+    memset(object, 0, sizeof(ObjectFile));
+}
+
+static void growSection(SectionBuffer* buffer, size_t extra) {
+    if (buffer->size + extra <= buffer->capacity) return;
+    size_t capacity = buffer->capacity ? buffer->capacity : 4096;
+    while (capacity < buffer->size + extra) capacity *= 2;
+    buffer->data = (uint8_t*)realloc(buffer->data, capacity);
+    buffer->capacity = capacity;
+}
+
+size_t sectionAppend(ObjectFile* object, SectionKind section, const void* data, size_t size) {
+    SectionBuffer* buffer = &object->sections[section];
+    size_t offset = buffer->size;
+    growSection(buffer, size);
+    memcpy(buffer->data + offset, data, size);
+    buffer->size += size;
+    return offset;
+}
+
+size_t sectionReserve(ObjectFile* object, SectionKind section, size_t size, size_t alignment) {
+    SectionBuffer* buffer = &object->sections[section];
+    size_t offset = (buffer->size + alignment - 1) & ~(alignment - 1);
+    if (alignment > buffer->alignment) buffer->alignment = alignment;
+    if (section != SECTION_BSS) {
+        growSection(buffer, offset + size - buffer->size);
+        memset(buffer->data + buffer->size, 0, offset + size - buffer->size);
+    }
+    buffer->size = offset + size;
+    return offset;
+}
+
+void sectionPatch32(ObjectFile* object, SectionKind section, size_t offset, uint32_t value) {
+    uint8_t* p = object->sections[section].data + offset;
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    p[2] = (uint8_t)(value >> 16);
+    p[3] = (uint8_t)(value >> 24);
+}
+
+static uint32_t appendSymbol(ObjectFile* object, const ObjectSymbol* symbol) {
+    if (object->symbolCount == object->symbolCapacity) {
+        object->symbolCapacity = object->symbolCapacity ? object->symbolCapacity * 2 : 64;
+        object->symbols = (ObjectSymbol*)realloc(object->symbols, object->symbolCapacity * sizeof(ObjectSymbol));
+    }
+    object->symbols[object->symbolCount] = *symbol;
+    return object->symbolCount++;
+}
+
+uint32_t addObjectSymbol(ObjectFile* object, const char* name, SymbolKind kind, SectionKind section,
+                         uint64_t value, uint64_t size, bool global) {
+    uint32_t id = internString(&object->names, name, strlen(name));
+    if (object->names.capacity > object->symbolByNameCapacity) {
+        object->symbolByNameCapacity = object->names.capacity;
+        object->symbolByName = (uint32_t*)realloc(object->symbolByName, object->symbolByNameCapacity * sizeof(uint32_t));
+    }
+    ObjectSymbol symbol = {poolString(&object->names, id), kind, section, value, size, global};
+    uint32_t index = appendSymbol(object, &symbol);
+    object->symbolByName[id] = index;
+    return index;
+}
+
+uint32_t sectionSymbol(ObjectFile* object, SectionKind section) {
+    if (object->sectionSymbols[section] == NO_SYMBOL) {
+        ObjectSymbol symbol = {"", SYMBOL_SECTION, section, 0, 0, false};
+        object->sectionSymbols[section] = appendSymbol(object, &symbol);
+    }
+    return object->sectionSymbols[section];
+}
+
+uint32_t findObjectSymbol(const ObjectFile* object, const char* name) {
+    uint32_t id = findString(&object->names, name, strlen(name));
+    return id == STRING_NOT_FOUND ? NO_SYMBOL : object->symbolByName[id];
+}
+
+uint32_t symbolReference(ObjectFile* object, const char* name) {
+    uint32_t index = findObjectSymbol(object, name);
+    if (index != NO_SYMBOL) return index;
+    return addObjectSymbol(object, name, SYMBOL_UNDEFINED, SECTION_TEXT, 0, 0, true);
+}
+
+void addRelocation(ObjectFile* object, SectionKind section, uint64_t offset, uint32_t symbol, uint32_t type, int64_t addend) {
+    if (object->relocationCount == object->relocationCapacity) {
+        object->relocationCapacity = object->relocationCapacity ? object->relocationCapacity * 2 : 256;
+        object->relocations = (ObjectRelocation*)realloc(object->relocations,
+                                                         object->relocationCapacity * sizeof(ObjectRelocation));
+    }
+    ObjectRelocation* relocation = &object->relocations[object->relocationCount++];
+    relocation->section = section;
+    relocation->offset = offset;
+    relocation->symbol = symbol;
+    relocation->type = type;
+    relocation->addend = addend;
+}
+
+// ---------------------------------------------------------------------------
+// ELF encoding
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+} Output;
+
+static void reserve(Output* out, size_t extra) {
+    if (out->size + extra <= out->capacity) return;
+    size_t capacity = out->capacity ? out->capacity : 4096;
+    while (capacity < out->size + extra) capacity *= 2;
+    out->data = (uint8_t*)realloc(out->data, capacity);
+    out->capacity = capacity;
+}
+
+static void putBytes(Output* out, const void* data, size_t size) {
+    reserve(out, size);
+    memcpy(out->data + out->size, data, size);
+    out->size += size;
+}
+
+static void putU8(Output* out, uint8_t value) {
+    putBytes(out, &value, 1);
+}
+
+static void putU16(Output* out, uint16_t value) {
+    uint8_t bytes[2] = {(uint8_t)value, (uint8_t)(value >> 8)};
+    putBytes(out, bytes, 2);
+}
+
+static void putU32(Output* out, uint32_t value) {
+    uint8_t bytes[4];
+    for (int i = 0; i < 4; i++) bytes[i] = (uint8_t)(value >> (8 * i));
+    putBytes(out, bytes, 4);
+}
+
+static void putU64(Output* out, uint64_t value) {
+    uint8_t bytes[8];
+    for (int i = 0; i < 8; i++) bytes[i] = (uint8_t)(value >> (8 * i));
+    putBytes(out, bytes, 8);
+}
+
+static void align(Output* out, size_t alignment) {
+    while (out->size % alignment) putU8(out, 0);
+}
+
+// Append a NUL-terminated name to a string table, returning its offset
+static uint32_t putName(Output* table, const char* name) {
+    uint32_t offset = (uint32_t)table->size;
+    putBytes(table, name, strlen(name) + 1);
+    return offset;
+}
+
+typedef struct {
+    uint32_t name;
+    uint32_t type;
+    uint64_t flags;
+    uint64_t offset;
+    uint64_t size;
+    uint32_t link;
+    uint32_t info;
+    uint64_t alignment;
+    uint64_t entrySize;
+} SectionHeader;
+
+// Section header indices: null, then the content sections in SectionKind
+// order (the optional ones only if they have contents or are referred to),
+// then the bookkeeping sections
+static bool sectionWritten(const ObjectFile* object, int kind) {
+    return kind < SECTION_TEXT_COLD || object->sections[kind].size > 0 || object->sectionSymbols[kind] != NO_SYMBOL;
+}
+
+bool writeELFObject(const ObjectFile* object, uint8_t** data, size_t* size) {
+    Output out = {0};
+    Output names = {0};         // .shstrtab
+    Output strings = {0};       // .strtab
+    SectionHeader headers[24];
+    uint16_t contentIndex[SECTION_COUNT] = {0};
+    int headerCount = 0;
+    memset(headers, 0, sizeof(headers));
+
+    putU8(&names, 0);
+    putU8(&strings, 0);
+    headerCount++; // Null section
+
+    // Header placeholder, patched once the section header offset is known
+    reserve(&out, ELF_HEADER_SIZE);
+    memset(out.data, 0, ELF_HEADER_SIZE);
+    out.size = ELF_HEADER_SIZE;
+
+    for (int kind = 0; kind < SECTION_COUNT; kind++) {
+        if (!sectionWritten(object, kind)) continue;
+        const SectionBuffer* buffer = &object->sections[kind];
+        contentIndex[kind] = (uint16_t)headerCount;
+        SectionHeader* header = &headers[headerCount++];
+        header->name = putName(&names, sectionInfo[kind].name);
+        header->type = sectionInfo[kind].type;
+        header->flags = sectionInfo[kind].flags;
+        header->alignment = buffer->alignment;
+        align(&out, buffer->alignment);
+        header->offset = out.size;
+        header->size = buffer->size;
+        if (buffer->size && sectionInfo[kind].type != SHT_NOBITS) putBytes(&out, buffer->data, buffer->size);
+    }
+
+    // Marks the stack as non-executable for the linker
+    SectionHeader* note = &headers[headerCount++];
+    note->name = putName(&names, ".note.GNU-stack");
+    note->type = SHT_PROGBITS;
+    note->offset = out.size;
+    note->alignment = 1;
+
+    // Symbol table: ELF wants every local symbol before the first global one
+    uint32_t* elfIndex = (uint32_t*)malloc((object->symbolCount + 1) * sizeof(uint32_t));
+    uint32_t next = 1;
+    for (int pass = 0; pass < 2; pass++) {
+        for (uint32_t i = 0; i < object->symbolCount; i++) {
+            if (object->symbols[i].global == (pass == 1)) elfIndex[i] = next++;
+        }
+    }
+    uint32_t firstGlobal = 1;
+    for (uint32_t i = 0; i < object->symbolCount; i++) {
+        if (!object->symbols[i].global) firstGlobal++;
+    }
+
+    int symtabIndex = headerCount;
+    SectionHeader* symtab = &headers[headerCount++];
+    symtab->name = putName(&names, ".symtab");
+    symtab->type = SHT_SYMTAB;
+    symtab->alignment = 8;
+    symtab->entrySize = SYMBOL_ENTRY_SIZE;
+    symtab->info = firstGlobal;
+    symtab->link = (uint32_t)headerCount; // .strtab follows
+    align(&out, 8);
+    symtab->offset = out.size;
+
+    for (int i = 0; i < SYMBOL_ENTRY_SIZE; i++) putU8(&out, 0);
+    for (int pass = 0; pass < 2; pass++) {
+        for (uint32_t i = 0; i < object->symbolCount; i++) {
+            const ObjectSymbol* symbol = &object->symbols[i];
+            if (symbol->global != (pass == 1)) continue;
+            uint8_t type = STT_NOTYPE;
+            uint16_t sectionIndex = contentIndex[symbol->section];
+            switch (symbol->kind) {
+                case SYMBOL_SECTION: type = STT_SECTION; break;
+                case SYMBOL_FUNCTION: type = STT_FUNC; break;
+                case SYMBOL_OBJECT: type = STT_OBJECT; break;
+                case SYMBOL_UNDEFINED: sectionIndex = 0; break;
+            }
+            putU32(&out, symbol->kind == SYMBOL_SECTION ? 0 : putName(&strings, symbol->name));
+            putU8(&out, (uint8_t)(((symbol->global ? STB_GLOBAL : STB_LOCAL) << 4) | type));
+            putU8(&out, 0);
+            putU16(&out, sectionIndex);
+            putU64(&out, symbol->value);
+            putU64(&out, symbol->size);
+        }
+    }
+    symtab->size = out.size - symtab->offset;
+
+    SectionHeader* strtab = &headers[headerCount++];
+    strtab->name = putName(&names, ".strtab");
+    strtab->type = SHT_STRTAB;
+    strtab->alignment = 1;
+    strtab->offset = out.size;
+    strtab->size = strings.size;
+    putBytes(&out, strings.data, strings.size);
+
+    // One .rela section per content section that has relocations
+    for (int kind = 0; kind < SECTION_COUNT; kind++) {
+        uint64_t start = 0;
+        bool any = false;
+        for (uint32_t i = 0; i < object->relocationCount; i++) {
+            const ObjectRelocation* relocation = &object->relocations[i];
+            if ((int)relocation->section != kind) continue;
+            if (!any) {
+                align(&out, 8);
+                start = out.size;
+                any = true;
+            }
+            putU64(&out, relocation->offset);
+            putU64(&out, ((uint64_t)elfIndex[relocation->symbol] << 32) | relocation->type);
+            putU64(&out, (uint64_t)relocation->addend);
+        }
+        if (!any) continue;
+
+        char name[32];
+        snprintf(name, sizeof(name), ".rela%s", sectionInfo[kind].name);
+        SectionHeader* rela = &headers[headerCount++];
+        rela->name = putName(&names, name);
+        rela->type = SHT_RELA;
+        rela->flags = SHF_INFO_LINK;
+        rela->offset = start;
+        rela->size = out.size - start;
+        rela->link = (uint32_t)symtabIndex;
+        rela->info = contentIndex[kind];
+        rela->alignment = 8;
+        rela->entrySize = RELA_ENTRY_SIZE;
+    }
+    free(elfIndex);
+
+    int shstrtabIndex = headerCount;
+    SectionHeader* shstrtab = &headers[headerCount++];
+    shstrtab->name = putName(&names, ".shstrtab");
+    shstrtab->type = SHT_STRTAB;
+    shstrtab->alignment = 1;
+    shstrtab->offset = out.size;
+    shstrtab->size = names.size;
+    putBytes(&out, names.data, names.size);
+
+    align(&out, 8);
+    uint64_t headerOffset = out.size;
+    for (int i = 0; i < headerCount; i++) {
+        putU32(&out, headers[i].name);
+        putU32(&out, headers[i].type);
+        putU64(&out, headers[i].flags);
+        putU64(&out, 0); // Address: not loaded yet
+        putU64(&out, headers[i].offset);
+        putU64(&out, headers[i].size);
+        putU32(&out, headers[i].link);
+        putU32(&out, headers[i].info);
+        putU64(&out, headers[i].alignment);
+        putU64(&out, headers[i].entrySize);
+    }
+
+    // File header
+    Output header = {0};
+    static const uint8_t ident[16] = {0x7F, 'E', 'L', 'F', 2 /* 64-bit */, 1 /* little endian */, 1 /* version */};
+    putBytes(&header, ident, sizeof(ident));
+    putU16(&header, ET_REL);
+    putU16(&header, EM_X86_64);
+    putU32(&header, 1);
+    putU64(&header, 0); // Entry
+    putU64(&header, 0); // Program headers
+    putU64(&header, headerOffset);
+    putU32(&header, 0); // Flags
+    putU16(&header, ELF_HEADER_SIZE);
+    putU16(&header, 0);
+    putU16(&header, 0);
+    putU16(&header, SECTION_HEADER_SIZE);
+    putU16(&header, (uint16_t)headerCount);
+    putU16(&header, (uint16_t)shstrtabIndex);
+    memcpy(out.data, header.data, ELF_HEADER_SIZE);
+
+    free(header.data);
+    free(names.data);
+    free(strings.data);
+    *data = out.data;
+    *size = out.size;
+    return true;
+}
+
+bool writeELFFile(const ObjectFile* object, const char* path) {
+    uint8_t* data;
+    size_t size;
+    if (!writeELFObject(object, &data, &size)) return false;
+
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open '%s' for writing.\n", path);
+        free(data);
+        return false;
+    }
+    bool ok = fwrite(data, 1, size, file) == size;
+    ok = fclose(file) == 0 && ok;
+    if (!ok) fprintf(stderr, "Error: Could not write '%s'.\n", path);
+    free(data);
+    return ok;
+}
@@ -0,0 +1,168 @@
+#include "escape_analysis.h"
+#include "ast_visitor.h"
+#include "string_pool.h"
+#include "debug.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    uint32_t local;         // Id in EscapeState.locals
+    ASTNode* value;
+} Binding;
+
+typedef struct {
+    ReadOnlyCall readOnly;
+    void* context;
+
+    StringPool locals;      // By name
+    bool* escapes;          // By local id
+    uint32_t escapesCapacity;
+
+    // Expressions whose value escapes directly (returned, passed on, stored
+    // in a global); applied after the walk, which resets every flag it sees
+    ASTNode** roots;
+    size_t rootCount;
+    size_t rootCapacity;
+
+    // `T name = value;` for locals, so an escaping local taints its value
+    Binding* bindings;
+    size_t bindingCount;
+    size_t bindingCapacity;
+} EscapeState;
+
+static uint32_t localId(EscapeState* state, const char* name) {
+    uint32_t id = internString(&state->locals, name, strlen(name));
+    if (id >= state->escapesCapacity) {
+        uint32_t previous = state->escapesCapacity;
+        state->escapesCapacity = state->locals.capacity;
+        state->escapes = (bool*)realloc(state->escapes, state->escapesCapacity * sizeof(bool));
+        memset(state->escapes + previous, 0, (state->escapesCapacity - previous) * sizeof(bool));
+    }
+    return id;
+}
+
+// Returns true if `name` was not already known to escape
+static bool markLocal(EscapeState* state, const char* name) {
+    uint32_t id = localId(state, name);
+    if (state->escapes[id]) return false;
+    state->escapes[id] = true;
+    return true;
+}
+
+static void addRoot(EscapeState* state, ASTNode* value) {
+    if (state->rootCount == state->rootCapacity) {
+        state->rootCapacity = state->rootCapacity ? state->rootCapacity * 2 : 16;
+        state->roots = (ASTNode**)realloc(state->roots, state->rootCapacity * sizeof(ASTNode*));
+    }
+    state->roots[state->rootCount++] = value;
+}
+
+// The value of `expression` outlives the call. Only a bare name passes an
+// existing value on; an operator result is new, and its operands are copied.
+static void escape(EscapeState* state, ASTNode* expression) {
+    if (!expression) return;
+    if (expression->type == AST_IDENTIFIER) {
+        markLocal(state, expression->data.identifier.name);
+    } else if (expression->type == AST_BINARY_EXPR) {
+        addRoot(state, expression);
+    }
+}
+
+static void bind(EscapeState* state, const char* name, ASTNode* value) {
+    if (state->bindingCount == state->bindingCapacity) {
+        state->bindingCapacity = state->bindingCapacity ? state->bindingCapacity * 2 : 16;
+        state->bindings = (Binding*)realloc(state->bindings, state->bindingCapacity * sizeof(Binding));
+    }
+    state->bindings[state->bindingCount].local = localId(state, name);
+    state->bindings[state->bindingCount].value = value;
+    state->bindingCount++;
+}
+
+static VisitResult visitNode(ASTNode* node, int depth, void* context) {
+    (void)depth;
+    EscapeState* state = (EscapeState*)context;
+    switch (node->type) {
+        case AST_BINARY_EXPR:
+            node->noEscape = true;
+            break;
+        case AST_RETURN_STMT:
+            escape(state, node->data.returnStmt.value);
+            break;
+        case AST_CALL_EXPR:
+            if (state->readOnly && state->readOnly(node, state->context)) break;
+            for (ASTNode* argument = node->data.callExpr.arguments; argument; argument = argument->next) {
+                escape(state, argument);
+            }
+            break;
+        case AST_VAR_DECL:
+            bind(state, node->data.varDecl.name, node->data.varDecl.initializer);
+            break;
+        case AST_FUNC_DECL:
+            return VISIT_SKIP_CHILDREN; // Analyzed on its own
+        default:
+            break;
+    }
+    return VISIT_CONTINUE;
+}
+
+static void initEscapeState(EscapeState* state, ReadOnlyCall readOnly, void* context) {
+    memset(state, 0, sizeof(EscapeState));
+    state->readOnly = readOnly;
+    state->context = context;
+    initStringPool(&state->locals);
+}
+
+// Propagate through local bindings to a fixed point, then clear the flag on
+// everything that escapes
+static void finishEscapeState(EscapeState* state) {
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 0; i < state->bindingCount; i++) {
+            const Binding* binding = &state->bindings[i];
+            ASTNode* value = binding->value;
+            if (!state->escapes[binding->local] || !value || value->type != AST_IDENTIFIER) continue;
+            if (markLocal(state, value->data.identifier.name)) changed = true;
+        }
+    }
+
+    for (size_t i = 0; i < state->bindingCount; i++) {
+        if (state->escapes[state->bindings[i].local]) escape(state, state->bindings[i].value);
+    }
+    for (size_t i = 0; i < state->rootCount; i++) {
+        state->roots[i]->noEscape = false;
+    }
+    TRACE("Escape analysis: %zu escaping values, %zu bindings\n", state->rootCount, state->bindingCount);
+
+    freeStringPool(&state->locals);
+    free(state->escapes);
+    free(state->roots);
+    free(state->bindings);
+}
+
+void analyzeFunctionEscapes(ASTNode* function, ReadOnlyCall readOnly, void* context) {
+    EscapeState state;
+    initEscapeState(&state, readOnly, context);
+    ASTVisitor visitor = {visitNode, NULL, &state};
+    walkAST(function->data.funcDecl.body, &visitor);
+    finishEscapeState(&state);
+}
+
+void analyzeModuleEscapes(ASTNode* module, ReadOnlyCall readOnly, void* context) {
+    EscapeState state;
+    initEscapeState(&state, readOnly, context);
+    ASTVisitor visitor = {visitNode, NULL, &state};
+    ASTNode* declarations = module && module->type == AST_BLOCK ? module->data.block.declarations : module;
+    for (ASTNode* node = declarations; node; node = node->next) {
+        if (node->type == AST_FUNC_DECL) continue;
+        if (node->type == AST_VAR_DECL) {
+            // A global: its value is reachable after the init code returns
+            escape(&state, node->data.varDecl.initializer);
+            if (node->data.varDecl.initializer) walkASTNode(node->data.varDecl.initializer, &visitor);
+        } else {
+            walkASTNode(node, &visitor);
+        }
+    }
+    finishEscapeState(&state);
+}
@@ -0,0 +1,349 @@
+#include "incremental.h"
+#include "compat.h"
+#include "lexer.h"
+#include "parser.h"
+#include "semantic_analysis.h"
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// One top-level declaration and the diagnostics raised for it
+typedef struct {
+    ASTNode* node;          // NULL for text that failed to parse
+    size_t start;           // Byte range of its tokens
+    size_t end;
+    int line;               // Line its last token ends on
+    char** messages;
+    uint32_t messageCount;
+} Declaration;
+
+struct Document {
+    char* text;
+    size_t length;
+    size_t textCapacity;
+    Declaration* declarations;      // In source order, non-overlapping
+    size_t count;
+    size_t capacity;
+    size_t broken;                  // Declarations that failed to parse
+    ASTNode* root;
+};
+
+// Declarations reparsed by one edit
+typedef struct {
+    Document* document;
+    Declaration* parsed;
+    size_t count;
+    size_t capacity;
+    size_t syncFrom;        // The window may end at a declaration starting here or later
+    size_t candidate;       // Next old declaration past the edit it may end at
+    bool synced;
+} Window;
+
+static void addMessage(Declaration* declaration, const char* message) {
+    size_t length = strlen(message);
+    while (length > 0 && message[length - 1] == '\n') length--;
+    char* copy = (char*)malloc(length + 1);
+    memcpy(copy, message, length);
+    copy[length] = '\0';
+    declaration->messages = (char**)realloc(declaration->messages,
+                                            (declaration->messageCount + 1) * sizeof(char*));
+    declaration->messages[declaration->messageCount++] = copy;
+}
+
+static void clearMessages(Declaration* declaration) {
+    for (uint32_t i = 0; i < declaration->messageCount; i++) free(declaration->messages[i]);
+    free(declaration->messages);
+    declaration->messages = NULL;
+    declaration->messageCount = 0;
+}
+
+static void releaseDeclaration(Declaration* declaration) {
+    if (declaration->node) {
+        declaration->node->next = NULL;     // freeAST() would follow it into the neighbours
+        freeAST(declaration->node);
+    }
+    clearMessages(declaration);
+}
+
+static bool isFunction(const Declaration* declaration) {
+    return declaration->node && declaration->node->type == AST_FUNC_DECL;
+}
+
+// ---------------------------------------------------------------------------
+// Semantic analysis
+// ---------------------------------------------------------------------------
+
+static THREAD_LOCAL Declaration* reportTarget = NULL;
+
+// Diagnostics go to the declaration being analysed, if any
+static void collectDiagnostic(const char* format, va_list args) {
+    if (!reportTarget) return;
+    char message[512];
+    vsnprintf(message, sizeof(message), format, args);
+    addMessage(reportTarget, message);
+}
+
+static void analyzeDeclaration(Declaration* declaration) {
+    clearMessages(declaration);
+    reportTarget = declaration;
+    analyzeNode(declaration->node);
+}
+
+static bool declaresGlobals(const Declaration* declaration) {
+    return declaration->node && (declaration->node->type == AST_VAR_DECL || declaration->node->type == AST_IMPORT);
+}
+
+// Analyses declarations [from, to) against the globals declared before
+// them, which are replayed without diagnostics. When `globals` changed,
+// everything after them but the functions is analysed again as well.
+static void analyzeDocument(Document* document, bool globals, size_t from, size_t to) {
+    setErrorFunction(collectDiagnostic);
+    enterScope();
+    for (size_t i = 0; i < document->count; i++) {
+        Declaration* declaration = &document->declarations[i];
+        if (!declaration->node) continue;
+        if (i >= from && (i < to || (globals && !isFunction(declaration)))) {
+            analyzeDeclaration(declaration);
+        } else if (i < from && declaresGlobals(declaration)) {
+            reportTarget = NULL;
+            analyzeNode(declaration->node);
+        } else if (i >= to && !globals) {
+            break;
+        }
+    }
+    exitScope();
+    setErrorFunction(NULL);
+    reportTarget = NULL;
+}
+
+// ---------------------------------------------------------------------------
+// Reparsing
+// ---------------------------------------------------------------------------
+
+static void appendParsed(Window* window, Declaration declaration) {
+    if (window->count == window->capacity) {
+        window->capacity = window->capacity ? window->capacity * 2 : 8;
+        window->parsed = (Declaration*)realloc(window->parsed, window->capacity * sizeof(Declaration));
+    }
+    window->parsed[window->count++] = declaration;
+}
+
+static bool acceptDeclaration(ASTNode* node, const char* start, const char* end, int line, const char* next,
+                              void* context) {
+    Window* window = (Window*)context;
+    Document* document = window->document;
+    Declaration declaration = {node, (size_t)(start - document->text), (size_t)(end - document->text), line, NULL, 0};
+    appendParsed(window, declaration);
+    if (!next) return true;
+
+    // Once the next declaration starts where an old one past the edit did,
+    // the rest of the text and so its parse are as before
+    size_t offset = (size_t)(next - document->text);
+    if (offset < window->syncFrom) return true;
+    while (window->candidate < document->count && document->declarations[window->candidate].start < offset) {
+        window->candidate++;
+    }
+    if (window->candidate < document->count && document->declarations[window->candidate].start == offset &&
+        document->declarations[window->candidate].node) {
+        window->synced = true;
+        return false;
+    }
+    return true;
+}
+
+// First declaration whose tokens end at or after `offset`
+static size_t findDeclaration(const Document* document, size_t offset) {
+    size_t low = 0, high = document->count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (document->declarations[middle].end < offset) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+static size_t countLines(const char* text, size_t length) {
+    size_t lines = 0;
+    for (const char* p = text; (p = memchr(p, '\n', length - (size_t)(p - text))) != NULL; p++) lines++;
+    return lines;
+}
+
+// Points the AST at the nodes of declarations [from, to), between the
+// nearest parsed neighbours on either side
+static void linkDeclarations(Document* document, size_t from, size_t to) {
+    ASTNode** link = &document->root->data.block.declarations;
+    for (size_t i = from; i-- > 0;) {
+        if (document->declarations[i].node) {
+            link = &document->declarations[i].node->next;
+            break;
+        }
+    }
+    for (size_t i = from; i < to; i++) {
+        ASTNode* node = document->declarations[i].node;
+        if (!node) continue;
+        *link = node;
+        link = &node->next;
+    }
+    *link = NULL;
+    for (size_t i = to; i < document->count; i++) {
+        if (document->declarations[i].node) {
+            *link = document->declarations[i].node;
+            break;
+        }
+    }
+}
+
+// Offset in the edited text of old offset `offset`, where [start, end) was
+// replaced by `length` bytes
+static size_t mapOffset(size_t offset, size_t start, size_t end, size_t length) {
+    if (offset < start) return offset;
+    if (offset < end) return start + length;
+    return offset - (end - start) + length;
+}
+
+bool editDocument(Document* document, size_t offset, size_t removed, const char* text, size_t length) {
+    if (offset > document->length || removed > document->length - offset) return false;
+    if (length > MAX_SOURCE_BYTES - (document->length - removed)) return false;
+    size_t editEnd = offset + removed;
+    long lineDelta = (long)countLines(text, length) - (long)countLines(document->text + offset, removed);
+
+    // Text that failed to parse is always reparsed, so the window starts at
+    // the first such declaration and must get past the last
+    size_t first = findDeclaration(document, offset);
+    size_t syncFrom = offset + length;
+    if (document->broken > 0) {
+        for (size_t i = 0; i < document->count; i++) {
+            if (document->declarations[i].node) continue;
+            if (i < first) first = i;
+            size_t end = mapOffset(document->declarations[i].end, offset, editEnd, length);
+            if (end > syncFrom) syncFrom = end;
+        }
+    }
+
+    // Declarations past the edit move with the text after it
+    size_t following = document->count;
+    for (size_t i = document->count; i-- > first;) {
+        Declaration* declaration = &document->declarations[i];
+        if (declaration->start < editEnd) break;
+        declaration->start = declaration->start - removed + length;
+        declaration->end = declaration->end - removed + length;
+        declaration->line += (int)lineDelta;
+        following = i;
+    }
+
+    size_t newLength = document->length - removed + length;
+    if (newLength + 1 > document->textCapacity) {
+        document->textCapacity = (newLength + 1) * 2;
+        document->text = (char*)realloc(document->text, document->textCapacity);
+    }
+    memmove(document->text + offset + length, document->text + editEnd, document->length - editEnd + 1);
+    memcpy(document->text + offset, text, length);
+    document->length = newLength;
+
+    // Lex and parse from the end of the last declaration before the window
+    size_t resume = first > 0 ? document->declarations[first - 1].end : 0;
+    int line = first > 0 ? document->declarations[first - 1].line : 1;
+    Window window = {document, NULL, 0, 0, syncFrom, following, false};
+    char message[512];
+    resumeLexer(document->text, resume, line);
+    bool parsed = parseDeclarations(acceptDeclaration, &window, message, sizeof(message));
+
+    size_t last;
+    if (window.synced) {
+        last = window.candidate;
+    } else if (parsed) {
+        last = document->count;
+    } else {
+        // Resume at the next old declaration past both the edit and what
+        // was parsed; everything before it is the failed declaration
+        size_t failedAt = window.count > 0 ? window.parsed[window.count - 1].end : resume;
+        size_t resumeAt = failedAt > syncFrom ? failedAt : syncFrom;
+        last = following;
+        while (last < document->count &&
+               (!document->declarations[last].node || document->declarations[last].start < resumeAt)) {
+            last++;
+        }
+        size_t failedEnd = last < document->count ? document->declarations[last].start : newLength;
+        while (failedAt < failedEnd && isspace((unsigned char)document->text[failedAt])) failedAt++;
+        Declaration failed = {NULL, failedAt, failedEnd, 0, NULL, 0};
+        addMessage(&failed, message);
+        appendParsed(&window, failed);
+    }
+
+    // Replace declarations [first, last) with the reparsed ones
+    bool globals = false;
+    for (size_t i = first; i < last; i++) {
+        Declaration* declaration = &document->declarations[i];
+        if (declaresGlobals(declaration)) globals = true;
+        if (!declaration->node) document->broken--;
+        releaseDeclaration(declaration);
+    }
+    for (size_t i = 0; i < window.count; i++) {
+        if (declaresGlobals(&window.parsed[i])) globals = true;
+        if (!window.parsed[i].node) document->broken++;
+    }
+    size_t count = document->count - (last - first) + window.count;
+    if (count > document->capacity) {
+        document->capacity = count * 2;
+        document->declarations = (Declaration*)realloc(document->declarations,
+                                                       document->capacity * sizeof(Declaration));
+    }
+    memmove(document->declarations + first + window.count, document->declarations + last,
+            (document->count - last) * sizeof(Declaration));
+    memcpy(document->declarations + first, window.parsed, window.count * sizeof(Declaration));
+    document->count = count;
+    free(window.parsed);
+
+    linkDeclarations(document, first, first + window.count);
+    analyzeDocument(document, globals, first, first + window.count);
+    return true;
+}
+
+Document* openDocument(const char* source, size_t length) {
+    Document* document = (Document*)calloc(1, sizeof(Document));
+    document->textCapacity = length + 1;
+    document->text = (char*)malloc(document->textCapacity);
+    document->text[0] = '\0';
+    document->root = newASTNode(AST_BLOCK);
+    editDocument(document, 0, 0, source, length);
+    return document;
+}
+
+void closeDocument(Document* document) {
+    if (!document) return;
+    for (size_t i = 0; i < document->count; i++) releaseDeclaration(&document->declarations[i]);
+    document->root->data.block.declarations = NULL;
+    freeAST(document->root);
+    free(document->declarations);
+    free(document->text);
+    free(document);
+}
+
+const char* documentText(const Document* document, size_t* length) {
+    if (length) *length = document->length;
+    return document->text;
+}
+
+const ASTNode* documentAST(const Document* document) {
+    return document->broken > 0 ? NULL : document->root;
+}
+
+size_t documentDiagnostics(const Document* document, Diagnostic* diagnostics, size_t capacity) {
+    size_t total = 0;
+    for (size_t i = 0; i < document->count; i++) {
+        const Declaration* declaration = &document->declarations[i];
+        for (uint32_t j = 0; j < declaration->messageCount; j++, total++) {
+            if (total < capacity) {
+                diagnostics[total].offset = declaration->start;
+                diagnostics[total].message = declaration->messages[j];
+            }
+        }
+    }
+    return total;
+}
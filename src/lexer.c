@@ -1,17 +1,53 @@
 #include "lexer.h"
+#include "compat.h"
 #include <ctype.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdbool.h>
 
-static const char *start;
-static const char *current;
-static int line;
+static THREAD_LOCAL const char *source;
+static THREAD_LOCAL const char *start;
+static THREAD_LOCAL const char *current;
+static THREAD_LOCAL int line;
+static THREAD_LOCAL const Token *replay;
 
-void initLexer(const char *source) {
-    start = source;
-    current = source;
-    line = 1;
+typedef enum {
+    LEX_UNTERMINATED_STRING,
+    LEX_UNEXPECTED_CHARACTER
+} LexError;
+
+static const char *const errorMessages[] = {
+    [LEX_UNTERMINATED_STRING] = "Unterminated string.",
+    [LEX_UNEXPECTED_CHARACTER] = "Unexpected character.",
+};
+
+_Static_assert(sizeof(Token) <= 16, "Token should pack into 16 bytes");
+_Static_assert(TOKEN_ERROR <= UINT8_MAX, "TokenType must fit Token.type");
+
+void initLexer(const char *text) {
+    resumeLexer(text, 0, 1);
+}
+
+void resumeLexer(const char *text, size_t offset, int atLine) {
+    source = text;
+    start = text + offset;
+    current = start;
+    line = atLine;
+    replay = NULL;
+}
+
+void replayTokens(const char *text, const Token *tokens) {
+    initLexer(text);
+    replay = tokens;
+}
+
+void lastTokenSpan(size_t *from, size_t *to) {
+    *from = (size_t)(start - source);
+    *to = (size_t)(current - source);
+}
+
+const char *tokenStart(Token token) {
+    return token.type == TOKEN_ERROR ? errorMessages[token.offset] : source + token.offset;
 }
 
 static char advance() {
@@ -33,18 +69,18 @@ static bool isAtEnd() {
 
 static Token makeToken(TokenType type) {
     Token token;
-    token.type = type;
-    token.start = start;
+    token.type = (uint8_t)type;
+    token.offset = (uint32_t)(start - source);
     token.length = (int)(current - start);
     token.line = line;
     return token;
 }
 
-static Token errorToken(const char *message) {
+static Token errorToken(LexError error) {
     Token token;
     token.type = TOKEN_ERROR;
-    token.start = message;
-    token.length = (int)strlen(message);
+    token.offset = error;
+    token.length = (int)strlen(errorMessages[error]);
     token.line = line;
     return token;
 }
@@ -91,7 +127,9 @@ static TokenType checkKeyword(int startIdx, int length, const char *rest, TokenT
 
 static TokenType identifierType() {
     switch (start[0]) {
-        case 'i': return checkKeyword(1, 2, "nt", TOKEN_INT);
+        case 'i':
+            if (current - start > 1 && start[1] == 'm') return checkKeyword(2, 4, "port", TOKEN_IMPORT);
+            return checkKeyword(1, 2, "nt", TOKEN_INT);
         case 'f': return checkKeyword(1, 3, "unc", TOKEN_FUNC);
         case 's': return checkKeyword(1, 2, "tr", TOKEN_STR);
         case 'r': return checkKeyword(1, 5, "eturn", TOKEN_RETURN); // Added this line for 'return' keyword
@@ -115,13 +153,19 @@ static Token string() {
         advance();
     }
 
-    if (isAtEnd()) return errorToken("Unterminated string.");
+    if (isAtEnd()) return errorToken(LEX_UNTERMINATED_STRING);
 
     advance(); // Closing quote
     return makeToken(TOKEN_STRING);
 }
 
 Token scanToken() {
+    if (replay) {
+        Token token = *replay;
+        if (token.type != TOKEN_EOF) replay++;
+        return token;
+    }
+
     skipWhitespace();
     start = current;
 
@@ -147,5 +191,5 @@ Token scanToken() {
         case '"': return string();
     }
 
-    return errorToken("Unexpected character.");
+    return errorToken(LEX_UNEXPECTED_CHARACTER);
 }
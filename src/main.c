@@ -1,73 +1,180 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include "lexer.h"
-#include "parser.h"
-#include "ast.h"
+#include <string.h>
+#include <stdbool.h>
+#include "driver.h"
+#include "server.h"
+#include "build.h"
+#include "batch.h"
 
-void printAST(ASTNode* node, int indent) {
-    if (!node) return;
+static void usage(const char* program) {
+    fprintf(stderr, "Usage: %s [options] <source>\n", program);
+    fprintf(stderr, "       %s [options] --file <source-file>\n", program);
+    fprintf(stderr, "       %s [options] --load-ast <ast-file>\n", program);
+    fprintf(stderr, "       %s [options] --build <entry-source> [--build-dir <dir>] [--jobs <n>]\n", program);
+    fprintf(stderr, "       %s [options] --batch <file-list> [--build-dir <dir>] [--jobs <n>] [--no-io-uring]\n", program);
+    fprintf(stderr, "       %s --daemon [--socket <path>] [--workers <n>]\n", program);
+    fprintf(stderr, "       %s [options] --client [--socket <path>] <source-file>\n", program);
+    fprintf(stderr, "Options: --emit-ast <ast-file>  --emit-obj <object-file>  --emit-asm <assembly-file>\n");
+    fprintf(stderr, "         --no-escape-analysis  --no-tail-calls  --no-vectorize\n");
+    fprintf(stderr, "         --no-constant-calls  --check  --parallel-lex-bytes <n>\n");
+    fprintf(stderr, "         --module <name>  --emit-interface <interface-file>  --module-path <dir>[:<dir>...]\n");
+    fprintf(stderr, "         --profile-generate  --profile-use <profile-file>\n");
+    fprintf(stderr, "         --stats[=text|json]  --stats-output <file>\n");
+}
+
+int main(int argc, char* argv[]) {
+    CompileOptions options = {0};
+    const char* loadPath = NULL;
+    const char* filePath = NULL;
+    const char* socketPath = NULL;
+    const char* buildPath = NULL;
+    const char* buildDirectory = NULL;
+    int jobs = 0;
+    const char* source = NULL;
+    bool daemon = false;
+    bool client = false;
+    int workers = 0;
+    const char* batchPath = NULL;
+    bool noRing = false;
+    bool badUsage = false;
 
-    for (int i = 0; i < indent; i++) printf("  ");
-    switch (node->type) {
-        case AST_VAR_DECL:
-            printf("VarDecl: %s %s = \n", node->data.varDecl.varType, node->data.varDecl.name);
-            printAST(node->data.varDecl.initializer, indent + 1);
-            break;
-        case AST_FUNC_DECL:
-            printf("FuncDecl: %s %s\n", node->data.funcDecl.returnType, node->data.funcDecl.name);
-            printAST(node->data.funcDecl.params, indent + 1);
-            printAST(node->data.funcDecl.body, indent + 1);
-            break;
-        case AST_PARAM:
-            printf("Param: %s %s\n", node->data.param.paramType, node->data.param.name);
-            break;
-        case AST_BLOCK:
-            printf("Block\n");
-            printAST(node->data.block.declarations, indent + 1);
-            break;
-        case AST_EXPR_STMT:
-            printf("ExprStmt\n");
-            printAST(node->data.exprStmt.expression, indent + 1);
-            break;
-        case AST_BINARY_EXPR:
-            printf("BinaryExpr: %c\n", node->data.binaryExpr.operator);
-            printAST(node->data.binaryExpr.left, indent + 1);
-            printAST(node->data.binaryExpr.right, indent + 1);
-            break;
-        case AST_LITERAL:
-            printf("Literal: %s\n", node->data.literal.value);
-            break;
-        case AST_IDENTIFIER:
-            printf("Identifier: %s\n", node->data.identifier.name);
-            break;
-        case AST_CALL_EXPR:
-            printf("CallExpr: %s\n", node->data.callExpr.callee);
-            printAST(node->data.callExpr.arguments, indent + 1);
-            break;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--emit-ast") == 0 && i + 1 < argc) {
+            options.emitASTPath = argv[++i];
+        } else if (strcmp(argv[i], "--emit-obj") == 0 && i + 1 < argc) {
+            options.emitObjectPath = argv[++i];
+        } else if (strcmp(argv[i], "--emit-asm") == 0 && i + 1 < argc) {
+            options.emitAssemblyPath = argv[++i];
+        } else if (strcmp(argv[i], "--no-escape-analysis") == 0) {
+            options.codegen.heapStrings = true;
+        } else if (strcmp(argv[i], "--no-tail-calls") == 0) {
+            options.codegen.noTailCalls = true;
+        } else if (strcmp(argv[i], "--no-vectorize") == 0) {
+            options.codegen.noVectorize = true;
+        } else if (strcmp(argv[i], "--parallel-lex-bytes") == 0 && i + 1 < argc) {
+            options.parallelLexBytes = (size_t)strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--check") == 0) {
+            // Diagnostics only: no AST dump, and bodies parsed only if code is emitted
+            options.lazyBodies = true;
+            options.check = true;
+        } else if (strcmp(argv[i], "--no-constant-calls") == 0) {
+            options.noConstantCalls = true;
+        } else if (strcmp(argv[i], "--profile-generate") == 0) {
+            options.codegen.profileGenerate = true;
+        } else if (strcmp(argv[i], "--profile-use") == 0 && i + 1 < argc) {
+            options.profileUsePath = argv[++i];
+        } else if (strcmp(argv[i], "--module") == 0 && i + 1 < argc) {
+            options.codegen.moduleName = argv[++i];
+        } else if (strcmp(argv[i], "--emit-interface") == 0 && i + 1 < argc) {
+            options.emitInterfacePath = argv[++i];
+        } else if (strcmp(argv[i], "--module-path") == 0 && i + 1 < argc) {
+            options.modulePath = argv[++i];
+        } else if (strcmp(argv[i], "--build") == 0 && i + 1 < argc) {
+            buildPath = argv[++i];
+        } else if (strcmp(argv[i], "--build-dir") == 0 && i + 1 < argc) {
+            buildDirectory = argv[++i];
+        } else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            jobs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--load-ast") == 0 && i + 1 < argc) {
+            loadPath = argv[++i];
+        } else if (strcmp(argv[i], "--file") == 0 && i + 1 < argc) {
+            filePath = argv[++i];
+        } else if (strcmp(argv[i], "--stats") == 0 || strcmp(argv[i], "--stats=text") == 0) {
+            options.stats = true;
+        } else if (strcmp(argv[i], "--stats=json") == 0) {
+            options.stats = true;
+            options.statsJSON = true;
+        } else if (strcmp(argv[i], "--stats-output") == 0 && i + 1 < argc) {
+            options.statsPath = argv[++i];
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batchPath = argv[++i];
+        } else if (strcmp(argv[i], "--no-io-uring") == 0) {
+            noRing = true;
+        } else if (strcmp(argv[i], "--daemon") == 0) {
+            daemon = true;
+        } else if (strcmp(argv[i], "--client") == 0) {
+            client = true;
+        } else if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+            socketPath = argv[++i];
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            workers = atoi(argv[++i]);
+        } else if (!source) {
+            source = argv[i];
+        } else {
+            badUsage = true;
+        }
     }
 
-    printAST(node->next, indent);
-}
+    char defaultSocket[256];
+    if (!socketPath) {
+        defaultSocketPath(defaultSocket, sizeof(defaultSocket));
+        socketPath = defaultSocket;
+    }
 
-int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        fprintf(stderr, "Usage: %s <source-file>\n", argv[0]);
-        return 1;
+    if (batchPath) {
+        if (badUsage || source || filePath || loadPath || buildPath || client || daemon) {
+            usage(argv[0]);
+            return 1;
+        }
+        BatchOptions batch = {batchPath, buildDirectory, jobs, noRing, options};
+        return runBatch(&batch, NULL, stdout, stderr);
     }
 
-    const char* source = argv[1];
+    if (buildPath) {
+        if (badUsage || source || filePath || loadPath || client || daemon) {
+            usage(argv[0]);
+            return 1;
+        }
+        BuildOptions build = {buildPath, buildDirectory, jobs, options};
+        return runBuild(&build, NULL, stdout, stderr);
+    }
 
-    // Initialize the lexer
-    initLexer(source);
+    if (daemon) {
+        if (badUsage || source || filePath || loadPath || client) {
+            usage(argv[0]);
+            return 1;
+        }
+        return runDaemon(socketPath, workers);
+    }
 
-    // Parse the source code
-    ASTNode* ast = parse();
+    if (client) {
+        const char* path = filePath ? filePath : source;
+        if (badUsage || !path || (filePath && source) || loadPath) {
+            usage(argv[0]);
+            return 1;
+        }
+        return runClient(socketPath, path, &options);
+    }
 
-    // Print the AST
-    printAST(ast, 0);
+    if (badUsage || (!!source + !!filePath + !!loadPath) != 1) {
+        usage(argv[0]);
+        return 1;
+    }
 
-    // Free the AST
-    freeAST(ast);
+    FILE* out = options.check ? NULL : stdout;
+    if (loadPath) {
+        return compileSerializedAST(loadPath, &options, out, stderr);
+    }
+
+    if (filePath) {
+        // Interfaces of imported modules are looked for next to the file
+        char directory[4096];
+        const char* slash = strrchr(filePath, '/');
+        if (!options.modulePath && slash && (size_t)(slash - filePath) < sizeof(directory)) {
+            snprintf(directory, sizeof(directory), "%.*s", slash == filePath ? 1 : (int)(slash - filePath), filePath);
+            options.modulePath = directory;
+        }
+        options.sourcePath = filePath;
+        char* contents = readSourceFile(filePath, NULL);
+        if (!contents) {
+            fprintf(stderr, "Error: Could not read '%s'.\n", filePath);
+            return 1;
+        }
+        int exitCode = compileSource(contents, &options, out, stderr);
+        free(contents);
+        return exitCode;
+    }
 
-    return 0;
+    return compileSource(source, &options, out, stderr);
 }
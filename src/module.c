@@ -0,0 +1,599 @@
+#include "module.h"
+#include "string_pool.h"
+#include "compat.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <threads.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#define EXPORT_RECORD_SIZE 16
+#define IMPORT_RECORD_SIZE 16
+#define FNV_OFFSET 14695981039346656037ull
+#define FNV_PRIME 1099511628211ull
+
+static uint32_t getU32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t getU64(const uint8_t* p) {
+    return (uint64_t)getU32(p) | ((uint64_t)getU32(p + 4) << 32);
+}
+
+static void putU32(uint8_t* p, uint32_t value) {
+    for (int i = 0; i < 4; i++) p[i] = (uint8_t)(value >> (8 * i));
+}
+
+static void putU64(uint8_t* p, uint64_t value) {
+    putU32(p, (uint32_t)value);
+    putU32(p + 4, (uint32_t)(value >> 32));
+}
+
+// ---------------------------------------------------------------------------
+// Reader
+// ---------------------------------------------------------------------------
+
+static const char* stringAt(const ModuleInterface* module, uint32_t offset) {
+    return offset < module->stringSize ? module->strings + offset : "";
+}
+
+static bool openModuleInterface(ModuleInterface* module, const uint8_t* p, size_t size) {
+    if (size < MODULE_HEADER_SIZE || memcmp(p, MODULE_MAGIC, 4) != 0 || getU32(p + 4) != MODULE_VERSION) {
+        return false;
+    }
+    module->flags = getU32(p + 8);
+    module->source.size = getU64(p + 16);
+    module->source.modified = (int64_t)getU64(p + 24);
+    module->hash = getU64(p + 32);
+    module->exportCount = getU32(p + 40);
+    module->importCount = getU32(p + 44);
+    module->initCount = getU32(p + 48);
+    module->stringSize = getU32(p + 52);
+
+    uint64_t records = (uint64_t)module->exportCount * EXPORT_RECORD_SIZE +
+                       (uint64_t)module->importCount * IMPORT_RECORD_SIZE + (uint64_t)module->initCount * 4;
+    if (MODULE_HEADER_SIZE + records + module->stringSize != size ||
+        (module->stringSize > 0 && p[size - 1] != '\0')) {
+        return false;
+    }
+    module->exports = p + MODULE_HEADER_SIZE;
+    module->imports = module->exports + (size_t)module->exportCount * EXPORT_RECORD_SIZE;
+    module->inits = module->imports + (size_t)module->importCount * IMPORT_RECORD_SIZE;
+    module->strings = (const char*)(module->inits + (size_t)module->initCount * 4);
+    module->name = stringAt(module, getU32(p + 12));
+    return true;
+}
+
+// `identity`, when given, receives the stat of the file that was mapped
+static bool mapInterfaceFile(const char* path, ModuleInterface* module, struct stat* identity) {
+    memset(module, 0, sizeof(ModuleInterface));
+#ifndef _WIN32
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < MODULE_HEADER_SIZE) {
+        close(fd);
+        return false;
+    }
+    if (identity) *identity = st;
+    size_t size = (size_t)st.st_size;
+    void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) return false;
+#else
+    if (identity && stat(path, identity) != 0) return false;
+    FILE* file = fopen(path, "rb");
+    if (!file) return false;
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    size_t size = length > 0 ? (size_t)length : 0;
+    void* mapping = size ? malloc(size) : NULL;
+    if (!mapping || fread(mapping, 1, size, file) != size) {
+        free(mapping);
+        fclose(file);
+        return false;
+    }
+    fclose(file);
+#endif
+
+    if (!openModuleInterface(module, (const uint8_t*)mapping, size)) {
+#ifndef _WIN32
+        munmap(mapping, size);
+#else
+        free(mapping);
+#endif
+        memset(module, 0, sizeof(ModuleInterface));
+        return false;
+    }
+    module->mapping = mapping;
+    module->mappingSize = size;
+    return true;
+}
+
+// Missing and malformed files are not reported: a search tries several
+// directories, and a build treats either as "not built yet"
+bool mapModuleInterface(const char* path, ModuleInterface* module) {
+    return mapInterfaceFile(path, module, NULL);
+}
+
+void closeModuleInterface(ModuleInterface* module) {
+    if (module->mapping) {
+#ifndef _WIN32
+        munmap(module->mapping, module->mappingSize);
+#else
+        free(module->mapping);
+#endif
+    }
+    memset(module, 0, sizeof(ModuleInterface));
+}
+
+ModuleExport moduleExport(const ModuleInterface* module, uint32_t index) {
+    const uint8_t* record = module->exports + (size_t)index * EXPORT_RECORD_SIZE;
+    ModuleExport result;
+    result.kind = record[0] == EXPORT_GLOBAL ? EXPORT_GLOBAL : EXPORT_FUNCTION;
+    result.name = stringAt(module, getU32(record + 4));
+    result.type = stringAt(module, getU32(record + 8));
+    result.params = stringAt(module, getU32(record + 12));
+    return result;
+}
+
+const char* moduleImport(const ModuleInterface* module, uint32_t index, uint64_t* hash) {
+    const uint8_t* record = module->imports + (size_t)index * IMPORT_RECORD_SIZE;
+    if (hash) *hash = getU64(record + 8);
+    return stringAt(module, getU32(record));
+}
+
+const char* moduleInit(const ModuleInterface* module, uint32_t index) {
+    return stringAt(module, getU32(module->inits + (size_t)index * 4));
+}
+
+// ---------------------------------------------------------------------------
+// Writer
+// ---------------------------------------------------------------------------
+
+void moduleInitSymbol(const char* name, char* buffer, size_t size) {
+    snprintf(buffer, size, "cpy_init_%s", name);
+}
+
+bool statModuleSource(const char* path, ModuleStamp* stamp) {
+    struct stat st;
+    if (stat(path, &st) != 0) return false;
+    stamp->size = (uint64_t)st.st_size;
+#ifndef _WIN32
+    stamp->modified = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#else
+    stamp->modified = (int64_t)st.st_mtime * 1000000000;
+#endif
+    return true;
+}
+
+typedef struct {
+    StringPool strings;
+    uint32_t* names;            // Exports: name, type, params string ids
+    uint8_t* kinds;
+    uint32_t exportCount;
+    uint32_t exportCapacity;
+    uint32_t* imports;          // String ids
+    uint64_t* importHashes;
+    uint32_t importCount;
+    StringPool inits;           // In order, without duplicates
+    uint64_t hash;
+} InterfaceWriter;
+
+static void hashBytes(uint64_t* hash, const char* s) {
+    // Include the terminator so "ab","c" and "a","bc" differ
+    do {
+        *hash = (*hash ^ (uint8_t)*s) * FNV_PRIME;
+    } while (*s++);
+}
+
+static uint32_t intern(InterfaceWriter* writer, const char* s) {
+    return internString(&writer->strings, s, strlen(s));
+}
+
+static void addExport(InterfaceWriter* writer, ExportKind kind, const char* name, const char* type, const char* params) {
+    if (writer->exportCount == writer->exportCapacity) {
+        writer->exportCapacity = writer->exportCapacity ? writer->exportCapacity * 2 : 16;
+        writer->names = (uint32_t*)realloc(writer->names, writer->exportCapacity * 3 * sizeof(uint32_t));
+        writer->kinds = (uint8_t*)realloc(writer->kinds, writer->exportCapacity);
+    }
+    uint32_t* ids = writer->names + (size_t)writer->exportCount * 3;
+    ids[0] = intern(writer, name);
+    ids[1] = intern(writer, type ? type : "");
+    ids[2] = intern(writer, params);
+    writer->kinds[writer->exportCount++] = (uint8_t)kind;
+
+    char kindByte[2] = {(char)('0' + kind), '\0'};
+    hashBytes(&writer->hash, kindByte);
+    hashBytes(&writer->hash, name);
+    hashBytes(&writer->hash, type ? type : "");
+    hashBytes(&writer->hash, params);
+}
+
+static void addInit(InterfaceWriter* writer, const char* symbol) {
+    if (findString(&writer->inits, symbol, strlen(symbol)) != STRING_NOT_FOUND) return;
+    internString(&writer->inits, symbol, strlen(symbol));
+    hashBytes(&writer->hash, symbol);
+}
+
+// Parameter types of a function joined by ','
+static char* parameterList(const ASTNode* function) {
+    size_t length = 0;
+    for (const ASTNode* param = function->data.funcDecl.params; param; param = param->next) {
+        length += strlen(param->data.param.paramType) + 1;
+    }
+    char* list = (char*)malloc(length + 1);
+    list[0] = '\0';
+    size_t used = 0;
+    for (const ASTNode* param = function->data.funcDecl.params; param; param = param->next) {
+        size_t n = strlen(param->data.param.paramType);
+        if (used) list[used++] = ',';
+        memcpy(list + used, param->data.param.paramType, n + 1);
+        used += n;
+    }
+    return list;
+}
+
+static bool collectInterface(InterfaceWriter* writer, const ASTNode* program, const char* name, unsigned flags) {
+    const ASTNode* declarations = program->type == AST_BLOCK ? program->data.block.declarations : program;
+    bool hasInit = false;
+    for (const ASTNode* node = declarations; node; node = node->next) {
+        if (node->type == AST_FUNC_DECL) {
+            char* params = parameterList(node);
+            addExport(writer, EXPORT_FUNCTION, node->data.funcDecl.name, node->data.funcDecl.returnType, params);
+            free(params);
+        } else if (node->type == AST_VAR_DECL) {
+            addExport(writer, EXPORT_GLOBAL, node->data.varDecl.name, node->data.varDecl.varType, "");
+        }
+        if (node->type != AST_IMPORT) {
+            hasInit = hasInit || node->type != AST_FUNC_DECL;
+            continue;
+        }
+
+        const char* imported = node->data.import.module;
+        const ModuleInterface* module = importModule(imported);
+        if (!module) return false;
+        for (uint32_t i = 0; i < writer->importCount; i++) {
+            if (strcmp(poolString(&writer->strings, writer->imports[i]), imported) == 0) module = NULL;
+        }
+        if (!module) continue;  // Imported twice
+        writer->imports = (uint32_t*)realloc(writer->imports, (writer->importCount + 1) * sizeof(uint32_t));
+        writer->importHashes = (uint64_t*)realloc(writer->importHashes, (writer->importCount + 1) * sizeof(uint64_t));
+        writer->imports[writer->importCount] = intern(writer, imported);
+        writer->importHashes[writer->importCount++] = module->hash;
+        for (uint32_t i = 0; i < module->initCount; i++) addInit(writer, moduleInit(module, i));
+    }
+    // The entry module's own initializer is cpy_init, which runs the others
+    if (hasInit && !(flags & MODULE_FLAG_ENTRY)) {
+        char symbol[256];
+        moduleInitSymbol(name, symbol, sizeof(symbol));
+        addInit(writer, symbol);
+    }
+    return true;
+}
+
+bool writeModuleInterface(const ASTNode* program, const char* name, const ModuleStamp* source, unsigned flags,
+                          const char* path) {
+    InterfaceWriter writer;
+    memset(&writer, 0, sizeof(InterfaceWriter));
+    writer.hash = FNV_OFFSET;
+    initStringPool(&writer.strings);
+    initStringPool(&writer.inits);
+    bool ok = collectInterface(&writer, program, name, flags);
+
+    uint32_t nameId = intern(&writer, name);
+    uint32_t* initIds = (uint32_t*)malloc((writer.inits.count + 1) * sizeof(uint32_t));
+    for (uint32_t i = 0; i < writer.inits.count; i++) {
+        initIds[i] = intern(&writer, poolString(&writer.inits, i));
+    }
+
+    // String offsets follow from the ids, which count up in insertion order
+    uint32_t* offsets = (uint32_t*)malloc((writer.strings.count + 1) * sizeof(uint32_t));
+    uint32_t stringSize = 0;
+    for (uint32_t i = 0; i < writer.strings.count; i++) {
+        offsets[i] = stringSize;
+        stringSize += poolStringLength(&writer.strings, i) + 1;
+    }
+
+    size_t size = MODULE_HEADER_SIZE + (size_t)writer.exportCount * EXPORT_RECORD_SIZE +
+                  (size_t)writer.importCount * IMPORT_RECORD_SIZE + (size_t)writer.inits.count * 4 + stringSize;
+    uint8_t* data = (uint8_t*)calloc(1, size);
+    memcpy(data, MODULE_MAGIC, 4);
+    putU32(data + 4, MODULE_VERSION);
+    putU32(data + 8, flags);
+    putU32(data + 12, offsets[nameId]);
+    putU64(data + 16, source ? source->size : 0);
+    putU64(data + 24, source ? (uint64_t)source->modified : 0);
+    putU64(data + 32, writer.hash);
+    putU32(data + 40, writer.exportCount);
+    putU32(data + 44, writer.importCount);
+    putU32(data + 48, writer.inits.count);
+    putU32(data + 52, stringSize);
+
+    uint8_t* p = data + MODULE_HEADER_SIZE;
+    for (uint32_t i = 0; i < writer.exportCount; i++, p += EXPORT_RECORD_SIZE) {
+        p[0] = writer.kinds[i];
+        for (int field = 0; field < 3; field++) putU32(p + 4 + 4 * field, offsets[writer.names[i * 3 + field]]);
+    }
+    for (uint32_t i = 0; i < writer.importCount; i++, p += IMPORT_RECORD_SIZE) {
+        putU32(p, offsets[writer.imports[i]]);
+        putU64(p + 8, writer.importHashes[i]);
+    }
+    for (uint32_t i = 0; i < writer.inits.count; i++, p += 4) putU32(p, offsets[initIds[i]]);
+    for (uint32_t i = 0; i < writer.strings.count; i++) {
+        memcpy(p, poolString(&writer.strings, i), poolStringLength(&writer.strings, i) + 1);
+        p += poolStringLength(&writer.strings, i) + 1;
+    }
+
+    // Written aside and renamed over, so a concurrent reader maps either
+    // the old interface or the new one, never half of each
+    if (ok) {
+        size_t pathLength = strlen(path);
+        char* temporary = (char*)malloc(pathLength + 5);
+        memcpy(temporary, path, pathLength);
+        memcpy(temporary + pathLength, ".tmp", 5);
+        FILE* file = fopen(temporary, "wb");
+        ok = file && fwrite(data, 1, size, file) == size;
+        if (file) ok = fclose(file) == 0 && ok;
+        ok = ok && rename(temporary, path) == 0;
+        if (!ok) {
+            fprintf(stderr, "Error: Failed to write '%s'.\n", path);
+            remove(temporary);
+        }
+        free(temporary);
+    }
+
+    free(data);
+    free(offsets);
+    free(initIds);
+    free(writer.names);
+    free(writer.kinds);
+    free(writer.imports);
+    free(writer.importHashes);
+    freeStringPool(&writer.inits);
+    freeStringPool(&writer.strings);
+    return ok;
+}
+
+// ---------------------------------------------------------------------------
+// Loaded interfaces
+// ---------------------------------------------------------------------------
+
+// A mapped interface and the file it came from. Held by the compilations
+// that imported it and, while sharing is on, by the shared table as long
+// as it is the newest mapping of its path.
+typedef struct {
+    ModuleInterface interface;  // First, so importModule()'s result is one of these
+    int refs;
+    struct stat file;
+} LoadedInterface;
+
+static once_flag sharedOnce = ONCE_FLAG_INIT;
+static mtx_t sharedLock;
+static bool sharing = false;
+static StringPool sharedPaths;          // Interned interface paths; ids index `sharedInterfaces`
+static LoadedInterface** sharedInterfaces;
+static uint32_t sharedCapacity;
+
+static void initSharedLock() {
+    mtx_init(&sharedLock, mtx_plain);
+}
+
+static void releaseInterface(LoadedInterface* loaded) {
+    mtx_lock(&sharedLock);
+    bool last = --loaded->refs == 0;
+    mtx_unlock(&sharedLock);
+    if (last) {
+        closeModuleInterface(&loaded->interface);
+        free(loaded);
+    }
+}
+
+// Whether the file at a path is still the one that was mapped
+static bool sameFile(const struct stat* a, const struct stat* b) {
+#ifndef _WIN32
+    return a->st_dev == b->st_dev && a->st_ino == b->st_ino && a->st_size == b->st_size &&
+           a->st_mtim.tv_sec == b->st_mtim.tv_sec && a->st_mtim.tv_nsec == b->st_mtim.tv_nsec;
+#else
+    return a->st_dev == b->st_dev && a->st_ino == b->st_ino && a->st_size == b->st_size &&
+           a->st_mtime == b->st_mtime;
+#endif
+}
+
+// Maps the interface at `path`; with sharing on, an earlier mapping of the
+// same unchanged file is returned instead of mapping and validating it again
+static LoadedInterface* loadInterface(const char* path) {
+    call_once(&sharedOnce, initSharedLock);
+    struct stat st;
+    if (stat(path, &st) != 0) return NULL;
+
+    mtx_lock(&sharedLock);
+    if (sharing) {
+        uint32_t id = findString(&sharedPaths, path, strlen(path));
+        LoadedInterface* current = id != STRING_NOT_FOUND && id < sharedCapacity ? sharedInterfaces[id] : NULL;
+        if (current && sameFile(&current->file, &st)) {
+            current->refs++;
+            mtx_unlock(&sharedLock);
+            return current;
+        }
+    }
+    mtx_unlock(&sharedLock);
+
+    LoadedInterface* loaded = (LoadedInterface*)malloc(sizeof(LoadedInterface));
+    if (!mapInterfaceFile(path, &loaded->interface, &loaded->file)) {
+        free(loaded);
+        return NULL;
+    }
+    loaded->refs = 1;
+
+    LoadedInterface* old = NULL;
+    mtx_lock(&sharedLock);
+    if (sharing) {
+        uint32_t id = internString(&sharedPaths, path, strlen(path));
+        if (id >= sharedCapacity) {
+            uint32_t capacity = sharedPaths.capacity;
+            sharedInterfaces = (LoadedInterface**)realloc(sharedInterfaces, capacity * sizeof(LoadedInterface*));
+            memset(sharedInterfaces + sharedCapacity, 0, (capacity - sharedCapacity) * sizeof(LoadedInterface*));
+            sharedCapacity = capacity;
+        }
+        old = sharedInterfaces[id];
+        sharedInterfaces[id] = loaded;
+        loaded->refs++;
+    }
+    mtx_unlock(&sharedLock);
+    if (old) releaseInterface(old);
+    return loaded;
+}
+
+void shareModuleInterfaces(bool share) {
+    call_once(&sharedOnce, initSharedLock);
+    mtx_lock(&sharedLock);
+    if (share == sharing) {
+        mtx_unlock(&sharedLock);
+        return;
+    }
+    sharing = share;
+    LoadedInterface** interfaces = sharedInterfaces;
+    uint32_t count = share ? 0 : sharedCapacity;
+    if (share) {
+        initStringPool(&sharedPaths);
+    } else {
+        freeStringPool(&sharedPaths);
+        sharedInterfaces = NULL;
+        sharedCapacity = 0;
+    }
+    mtx_unlock(&sharedLock);
+
+    for (uint32_t id = 0; id < count; id++) {
+        if (interfaces[id]) releaseInterface(interfaces[id]);
+    }
+    if (!share) free(interfaces);
+}
+
+// ---------------------------------------------------------------------------
+// Per-thread module cache
+// ---------------------------------------------------------------------------
+
+typedef enum {
+    MODULE_UNKNOWN,
+    MODULE_LOADED,
+    MODULE_MISSING
+} ModuleState;
+
+typedef struct {
+    bool initialized;
+    StringPool names;
+    LoadedInterface** modules;  // By name id; entries never move once loaded
+    uint8_t* states;
+    uint32_t capacity;
+    char* searchPath;
+} ModuleCache;
+
+static THREAD_LOCAL ModuleCache cache;
+
+void setModuleSearchPath(const char* path) {
+    free(cache.searchPath);
+    cache.searchPath = path ? _strdup(path) : NULL;
+}
+
+static LoadedInterface* loadFromSearchPath(const char* searchPath, const char* name) {
+    const char* path = searchPath ? searchPath : ".";
+    size_t nameLength = strlen(name);
+    for (;;) {
+        const char* end = strchr(path, ':');
+        size_t length = end ? (size_t)(end - path) : strlen(path);
+        char* candidate = (char*)malloc(length + nameLength + sizeof(MODULE_INTERFACE_SUFFIX) + 2);
+        if (length == 0) {
+            sprintf(candidate, "%s%s", name, MODULE_INTERFACE_SUFFIX);
+        } else {
+            sprintf(candidate, "%.*s/%s%s", (int)length, path, name, MODULE_INTERFACE_SUFFIX);
+        }
+        LoadedInterface* loaded = loadInterface(candidate);
+        free(candidate);
+        if (loaded) {
+            if (strcmp(loaded->interface.name, name) == 0) return loaded;
+            releaseInterface(loaded);   // Renamed file: not this module
+        }
+        if (!end) return NULL;
+        path = end + 1;
+    }
+}
+
+const ModuleInterface* importModule(const char* name) {
+    if (!cache.initialized) {
+        initStringPool(&cache.names);
+        cache.initialized = true;
+    }
+    uint32_t id = internString(&cache.names, name, strlen(name));
+    if (id >= cache.capacity) {
+        uint32_t capacity = cache.names.capacity;
+        cache.modules = (LoadedInterface**)realloc(cache.modules, capacity * sizeof(LoadedInterface*));
+        cache.states = (uint8_t*)realloc(cache.states, capacity);
+        memset(cache.states + cache.capacity, MODULE_UNKNOWN, capacity - cache.capacity);
+        cache.capacity = capacity;
+    }
+    if (cache.states[id] == MODULE_UNKNOWN) {
+        cache.modules[id] = loadFromSearchPath(cache.searchPath, name);
+        cache.states[id] = cache.modules[id] ? MODULE_LOADED : MODULE_MISSING;
+    }
+    return cache.states[id] == MODULE_LOADED ? &cache.modules[id]->interface : NULL;
+}
+
+void unloadModules() {
+    if (cache.initialized) {
+        for (uint32_t i = 0; i < cache.names.count; i++) {
+            if (cache.states[i] == MODULE_LOADED) releaseInterface(cache.modules[i]);
+        }
+        freeStringPool(&cache.names);
+    }
+    free(cache.modules);
+    free(cache.states);
+    free(cache.searchPath);
+    memset(&cache, 0, sizeof(ModuleCache));
+}
+
+void collectModuleDependencies(ModuleDependencies* dependencies) {
+    memset(dependencies, 0, sizeof(ModuleDependencies));
+    if (!cache.initialized || cache.names.count == 0) return;
+    dependencies->items = (ModuleDependency*)malloc(cache.names.count * sizeof(ModuleDependency));
+    for (uint32_t id = 0; id < cache.names.count; id++) {
+        ModuleDependency* dependency = &dependencies->items[dependencies->count++];
+        dependency->name = _strdup(poolString(&cache.names, id));
+        dependency->found = cache.states[id] == MODULE_LOADED;
+        dependency->hash = dependency->found ? cache.modules[id]->interface.hash : 0;
+    }
+}
+
+bool moduleDependenciesCurrent(const ModuleDependencies* dependencies, const char* searchPath) {
+    for (uint32_t i = 0; i < dependencies->count; i++) {
+        const ModuleDependency* dependency = &dependencies->items[i];
+        LoadedInterface* loaded = loadFromSearchPath(searchPath, dependency->name);
+        bool same = (loaded != NULL) == dependency->found && (!loaded || loaded->interface.hash == dependency->hash);
+        if (loaded) releaseInterface(loaded);
+        if (!same) return false;
+    }
+    return true;
+}
+
+void copyModuleDependencies(const ModuleDependencies* from, ModuleDependencies* to) {
+    to->count = from->count;
+    to->items = from->count ? (ModuleDependency*)malloc(from->count * sizeof(ModuleDependency)) : NULL;
+    for (uint32_t i = 0; i < from->count; i++) {
+        to->items[i] = from->items[i];
+        to->items[i].name = _strdup(from->items[i].name);
+    }
+}
+
+void freeModuleDependencies(ModuleDependencies* dependencies) {
+    for (uint32_t i = 0; i < dependencies->count; i++) free(dependencies->items[i].name);
+    free(dependencies->items);
+    dependencies->items = NULL;
+    dependencies->count = 0;
+}
@@ -0,0 +1,520 @@
+#include "optimizer.h"
+#include "lexer.h"
+#include "arena.h"
+#include "ast_visitor.h"
+#include "string_pool.h"
+#include "debug.h"
+#include "stats.h"
+#include <errno.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+static bool isStringLiteral(const ASTNode* node) {
+    return node->type == AST_LITERAL && node->data.literal.value[0] == '"';
+}
+
+static bool isConcatenation(const ASTNode* node) {
+    return node->type == AST_BINARY_EXPR && node->operator == TOKEN_PLUS;
+}
+
+// "\"ab\"" from "\"a\"" and "\"b\"" (literal values keep their quotes)
+static char* joinLiterals(const char* left, const char* right) {
+    size_t leftLength = strlen(left) - 1;   // Without the closing quote
+    size_t rightLength = strlen(right) - 1; // Without the opening quote
+    char* value = (char*)malloc(leftLength + rightLength + 1);
+    STATS_ALLOC(MEM_STRINGS, leftLength + rightLength + 1);
+    memcpy(value, left, leftLength);
+    memcpy(value + leftLength, right + 1, rightLength + 1);
+    return value;
+}
+
+// Post-order, so operands are already folded when their parent is seen
+static void foldNode(ASTNode* node, int depth, void* context) {
+    (void)depth;
+    if (!isConcatenation(node)) return;
+    ASTNode* left = node->data.binaryExpr.left;
+    ASTNode* right = node->data.binaryExpr.right;
+    if (!isStringLiteral(right)) return;
+
+    if (isStringLiteral(left)) {
+        // "a" + "b"  ->  "ab"
+        char* value = joinLiterals(left->data.literal.value, right->data.literal.value);
+        freeAST(left);
+        freeAST(right);
+        node->type = AST_LITERAL;
+        node->data.literal.value = value;
+    } else if (isConcatenation(left) && isStringLiteral(left->data.binaryExpr.right)) {
+        // (x + "a") + "b"  ->  x + "ab"
+        ASTNode* inner = left->data.binaryExpr.right;
+        char* value = joinLiterals(inner->data.literal.value, right->data.literal.value);
+        free(inner->data.literal.value);
+        inner->data.literal.value = value;
+        node->data.binaryExpr.left = left->data.binaryExpr.left;
+        node->data.binaryExpr.right = inner;
+        left->data.binaryExpr.left = NULL;
+        left->data.binaryExpr.right = NULL;
+        free(left);
+        freeAST(right);
+    } else {
+        return;
+    }
+    (*(int*)context)++;
+    TRACE("Folded string concatenation\n");
+}
+
+int foldStringConstants(ASTNode* root) {
+    int folded = 0;
+    ASTVisitor visitor = {NULL, foldNode, &folded};
+    walkAST(root, &visitor);
+    return folded;
+}
+
+// ---------------------------------------------------------------------------
+// Compile-time evaluation of pure functions
+// ---------------------------------------------------------------------------
+
+#define EVAL_MAX_DEPTH 256      // Nested calls before giving up
+#define EVAL_STRING_COST 16     // Bytes of string built per unit of fuel
+
+typedef struct {
+    bool isString;
+    int64_t number;
+    const char* bytes;          // In the compilation arena
+    size_t length;
+} Value;
+
+typedef struct {
+    const char* name;
+    Value value;
+} Binding;
+
+typedef struct {
+    StringPool names;           // Every top-level declaration
+    ASTNode** functions;        // By name id, NULL for globals
+    bool* pure;                 // By name id
+    Binding* bindings;          // Scopes of the calls being evaluated
+    size_t bindingCount;
+    size_t bindingCapacity;
+    long fuel;                  // Per top-level call
+    long fuelLimit;
+    int depth;
+    int folded;
+} Evaluator;
+
+typedef enum {
+    EVAL_FAILED,                // Not constant; leave the call to run time
+    EVAL_NEXT,
+    EVAL_RETURNED
+} EvalResult;
+
+static ASTNode* moduleFunction(const Evaluator* ev, const char* name) {
+    uint32_t id = findString(&ev->names, name, strlen(name));
+    return id == STRING_NOT_FOUND ? NULL : ev->functions[id];
+}
+
+// len and equals, unless a top-level declaration takes the name (as in
+// isBuiltinCall in the code generator)
+static bool isBuiltin(const Evaluator* ev, const ASTNode* call) {
+    const char* name = call->data.callExpr.callee;
+    const ASTNode* first = call->data.callExpr.arguments;
+    if (findString(&ev->names, name, strlen(name)) != STRING_NOT_FOUND) return false;
+    if (strcmp(name, "len") == 0) return first && !first->next;
+    if (strcmp(name, "equals") == 0) return first && first->next && !first->next->next;
+    return false;
+}
+
+// Purity: what a function body may touch
+
+typedef struct {
+    Evaluator* ev;
+    StringPool locals;          // Parameters and declared variables
+    uint32_t* callees;          // Module functions called, by name id
+    size_t calleeCount;
+    size_t calleeCapacity;
+    bool impure;
+} PurityScan;
+
+static VisitResult scanLocals(ASTNode* node, int depth, void* context) {
+    (void)depth;
+    PurityScan* scan = (PurityScan*)context;
+    const char* name = NULL;
+    if (node->type == AST_PARAM) name = node->data.param.name;
+    if (node->type == AST_VAR_DECL) name = node->data.varDecl.name;
+    if (name) internString(&scan->locals, name, strlen(name));
+    return VISIT_CONTINUE;
+}
+
+static VisitResult scanEffects(ASTNode* node, int depth, void* context) {
+    (void)depth;
+    PurityScan* scan = (PurityScan*)context;
+    if (node->type == AST_FUNC_DECL && depth > 0) {
+        scan->impure = true;
+    } else if (node->type == AST_IDENTIFIER) {
+        const char* name = node->data.identifier.name;
+        if (findString(&scan->locals, name, strlen(name)) == STRING_NOT_FOUND) scan->impure = true;
+    } else if (node->type == AST_CALL_EXPR && !isBuiltin(scan->ev, node)) {
+        const char* name = node->data.callExpr.callee;
+        uint32_t id = findString(&scan->ev->names, name, strlen(name));
+        if (id == STRING_NOT_FOUND || !scan->ev->functions[id]) {
+            scan->impure = true;    // External code can do anything
+        } else {
+            if (scan->calleeCount == scan->calleeCapacity) {
+                scan->calleeCapacity = scan->calleeCapacity ? scan->calleeCapacity * 2 : 8;
+                scan->callees = (uint32_t*)realloc(scan->callees, scan->calleeCapacity * sizeof(uint32_t));
+            }
+            scan->callees[scan->calleeCount++] = id;
+        }
+    }
+    return scan->impure ? VISIT_STOP : VISIT_CONTINUE;
+}
+
+typedef struct {
+    uint32_t caller;
+    uint32_t callee;
+} CallEdge;
+
+static int compareCallees(const void* a, const void* b) {
+    uint32_t left = ((const CallEdge*)a)->callee;
+    uint32_t right = ((const CallEdge*)b)->callee;
+    return (left > right) - (left < right);
+}
+
+// A function is pure when it reads only its parameters and locals and calls
+// only builtins and pure functions. Impurity spreads from the functions that
+// read globals or call external code to all their callers, transitively.
+static void findPureFunctions(Evaluator* ev, ASTNode* root) {
+    uint32_t count = ev->names.count;
+    CallEdge* edges = NULL;
+    size_t edgeCount = 0;
+    uint32_t* worklist = (uint32_t*)malloc((count + 1) * sizeof(uint32_t));
+    size_t pending = 0;
+
+    for (ASTNode* node = root->data.block.declarations; node; node = node->next) {
+        if (node->type != AST_FUNC_DECL) continue;
+        const char* name = node->data.funcDecl.name;
+        uint32_t id = findString(&ev->names, name, strlen(name));
+        if (ev->functions[id] != node || ev->pure[id]) continue;    // Redefinitions are errors
+
+        PurityScan scan = {ev, {0}, NULL, 0, 0, false};
+        initStringPool(&scan.locals);
+        ASTVisitor locals = {scanLocals, NULL, &scan};
+        ASTVisitor effects = {scanEffects, NULL, &scan};
+        walkASTNode(node, &locals);
+        walkASTNode(node, &effects);
+        if (scan.impure) {
+            worklist[pending++] = id;
+        } else {
+            ev->pure[id] = true;
+            edges = (CallEdge*)realloc(edges, (edgeCount + scan.calleeCount) * sizeof(CallEdge));
+            for (size_t i = 0; i < scan.calleeCount; i++) edges[edgeCount++] = (CallEdge){id, scan.callees[i]};
+        }
+        free(scan.callees);
+        freeStringPool(&scan.locals);
+    }
+
+    // Callers of each function are a contiguous run once sorted by callee
+    if (edgeCount) qsort(edges, edgeCount, sizeof(CallEdge), compareCallees);
+    uint32_t* firstEdge = (uint32_t*)calloc(count + 1, sizeof(uint32_t));
+    for (size_t i = 0; i < edgeCount; i++) firstEdge[edges[i].callee + 1]++;
+    for (uint32_t i = 0; i < count; i++) firstEdge[i + 1] += firstEdge[i];
+    while (pending) {
+        uint32_t callee = worklist[--pending];
+        for (uint32_t i = firstEdge[callee]; i < firstEdge[callee + 1]; i++) {
+            uint32_t caller = edges[i].caller;
+            if (!ev->pure[caller]) continue;
+            ev->pure[caller] = false;
+            worklist[pending++] = caller;
+        }
+    }
+    free(firstEdge);
+    free(edges);
+    free(worklist);
+}
+
+// Evaluation
+
+static bool spend(Evaluator* ev, long cost) {
+    ev->fuel -= cost;
+    return ev->fuel >= 0;
+}
+
+static bool hasType(const Value* value, const char* type) {
+    if (strcmp(type, "str") == 0) return value->isString;
+    if (strcmp(type, "int") == 0) return !value->isString;
+    return false;
+}
+
+static void bind(Evaluator* ev, const char* name, Value value) {
+    if (ev->bindingCount == ev->bindingCapacity) {
+        ev->bindingCapacity = ev->bindingCapacity ? ev->bindingCapacity * 2 : 32;
+        ev->bindings = (Binding*)realloc(ev->bindings, ev->bindingCapacity * sizeof(Binding));
+    }
+    ev->bindings[ev->bindingCount++] = (Binding){name, value};
+}
+
+// Innermost binding of the current call, whose scopes start at `frame`
+static bool lookUp(const Evaluator* ev, size_t frame, const char* name, Value* value) {
+    for (size_t i = ev->bindingCount; i > frame; i--) {
+        if (strcmp(ev->bindings[i - 1].name, name) == 0) {
+            *value = ev->bindings[i - 1].value;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool literalValue(const char* literal, Value* value) {
+    memset(value, 0, sizeof(Value));
+    if (literal[0] == '"') {
+        value->isString = true;
+        value->bytes = literal + 1;
+        value->length = strlen(literal) - 2;
+        return true;
+    }
+    errno = 0;
+    char* end;
+    long long number = strtoll(literal, &end, 10);
+    value->number = number;
+    return errno != ERANGE && *end == '\0';
+}
+
+static bool evaluateExpression(Evaluator* ev, size_t frame, ASTNode* node, Value* result);
+
+static bool applyOperator(Evaluator* ev, TokenType op, Value* left, const Value* right) {
+    if (left->isString || right->isString) {
+        if (op != TOKEN_PLUS || !left->isString || !right->isString) return false;
+        size_t length = left->length + right->length;
+        if (!spend(ev, (long)(length / EVAL_STRING_COST))) return false;
+        char* bytes = (char*)arenaAlloc(compilationArena(), length + 1);
+        memcpy(bytes, left->bytes, left->length);
+        memcpy(bytes + left->length, right->bytes, right->length);
+        bytes[length] = '\0';
+        left->bytes = bytes;
+        left->length = length;
+        return true;
+    }
+    // Wrap around like the generated code does
+    uint64_t a = (uint64_t)left->number, b = (uint64_t)right->number;
+    switch (op) {
+        case TOKEN_PLUS: left->number = (int64_t)(a + b); return true;
+        case TOKEN_MINUS: left->number = (int64_t)(a - b); return true;
+        case TOKEN_STAR: left->number = (int64_t)(a * b); return true;
+        case TOKEN_SLASH:
+            // idiv traps on both; keep the trap for run time
+            if (right->number == 0 || (left->number == INT64_MIN && right->number == -1)) return false;
+            left->number /= right->number;
+            return true;
+        default: return false;
+    }
+}
+
+// Left-deep chains like a + b + c + ... are iterated, not recursed
+static bool evaluateBinary(Evaluator* ev, size_t frame, ASTNode* node, Value* result) {
+    size_t spine = 0;
+    ASTNode* leftmost = node;
+    for (; leftmost->type == AST_BINARY_EXPR; leftmost = leftmost->data.binaryExpr.left) spine++;
+    ASTNode** chain = (ASTNode**)arenaAlloc(compilationArena(), spine * sizeof(ASTNode*));
+    size_t i = spine;
+    for (ASTNode* link = node; link->type == AST_BINARY_EXPR; link = link->data.binaryExpr.left) chain[--i] = link;
+
+    if (!evaluateExpression(ev, frame, leftmost, result)) return false;
+    for (i = 0; i < spine; i++) {
+        Value right;
+        if (!spend(ev, 1) || !evaluateExpression(ev, frame, chain[i]->data.binaryExpr.right, &right) ||
+            !applyOperator(ev, chain[i]->operator, result, &right)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool evaluateCall(Evaluator* ev, size_t frame, ASTNode* call, Value* result);
+
+static bool evaluateExpression(Evaluator* ev, size_t frame, ASTNode* node, Value* result) {
+    if (!spend(ev, 1)) return false;
+    switch (node->type) {
+        case AST_LITERAL: return literalValue(node->data.literal.value, result);
+        case AST_IDENTIFIER: return lookUp(ev, frame, node->data.identifier.name, result);
+        case AST_BINARY_EXPR: return evaluateBinary(ev, frame, node, result);
+        case AST_CALL_EXPR: return evaluateCall(ev, frame, node, result);
+        default: return false;
+    }
+}
+
+static EvalResult evaluateStatements(Evaluator* ev, size_t frame, ASTNode* statement, Value* result) {
+    for (; statement; statement = statement->next) {
+        if (!spend(ev, 1)) return EVAL_FAILED;
+        Value value;
+        switch (statement->type) {
+            case AST_VAR_DECL:
+                if (!statement->data.varDecl.initializer) {
+                    memset(&value, 0, sizeof(Value));
+                    value.isString = strcmp(statement->data.varDecl.varType, "str") == 0;
+                    value.bytes = "";
+                } else if (!evaluateExpression(ev, frame, statement->data.varDecl.initializer, &value)) {
+                    return EVAL_FAILED;
+                }
+                if (!hasType(&value, statement->data.varDecl.varType)) return EVAL_FAILED;
+                bind(ev, statement->data.varDecl.name, value);
+                break;
+            case AST_EXPR_STMT:
+                if (!evaluateExpression(ev, frame, statement->data.exprStmt.expression, &value)) return EVAL_FAILED;
+                break;
+            case AST_RETURN_STMT:
+                if (!statement->data.returnStmt.value) {
+                    memset(result, 0, sizeof(Value));
+                    return EVAL_RETURNED;
+                }
+                return evaluateExpression(ev, frame, statement->data.returnStmt.value, result) ? EVAL_RETURNED
+                                                                                              : EVAL_FAILED;
+            case AST_BLOCK: {
+                size_t scope = ev->bindingCount;
+                EvalResult inner = evaluateStatements(ev, frame, statement->data.block.declarations, result);
+                ev->bindingCount = scope;
+                if (inner != EVAL_NEXT) return inner;
+                break;
+            }
+            default:
+                return EVAL_FAILED;
+        }
+    }
+    return EVAL_NEXT;
+}
+
+static bool evaluateBuiltin(Evaluator* ev, size_t frame, ASTNode* call, Value* result) {
+    ASTNode* first = call->data.callExpr.arguments;
+    Value a, b;
+    if (!evaluateExpression(ev, frame, first, &a) || !a.isString) return false;
+    memset(result, 0, sizeof(Value));
+    if (strcmp(call->data.callExpr.callee, "len") == 0) {
+        result->number = (int64_t)a.length;
+        return true;
+    }
+    if (!evaluateExpression(ev, frame, first->next, &b) || !b.isString) return false;
+    if (!spend(ev, (long)(a.length / EVAL_STRING_COST))) return false;
+    result->number = a.length == b.length && memcmp(a.bytes, b.bytes, a.length) == 0;
+    return true;
+}
+
+static bool evaluateCall(Evaluator* ev, size_t frame, ASTNode* call, Value* result) {
+    if (isBuiltin(ev, call)) return evaluateBuiltin(ev, frame, call, result);
+    ASTNode* function = moduleFunction(ev, call->data.callExpr.callee);
+    if (!function || !ev->pure[findString(&ev->names, call->data.callExpr.callee,
+                                          strlen(call->data.callExpr.callee))]) {
+        return false;
+    }
+    if (ev->depth == EVAL_MAX_DEPTH) return false;
+
+    // Arguments are evaluated in the caller's scope, then bound in the callee's
+    size_t callFrame = ev->bindingCount;
+    ASTNode* param = function->data.funcDecl.params;
+    ASTNode* argument = call->data.callExpr.arguments;
+    for (; param && argument; param = param->next, argument = argument->next) {
+        Value value;
+        if (!evaluateExpression(ev, frame, argument, &value) || !hasType(&value, param->data.param.paramType)) {
+            ev->bindingCount = callFrame;
+            return false;
+        }
+        bind(ev, param->data.param.name, value);
+    }
+    if (param || argument) {
+        ev->bindingCount = callFrame;
+        return false;
+    }
+
+    ev->depth++;
+    EvalResult outcome = evaluateStatements(ev, callFrame, function->data.funcDecl.body->data.block.declarations,
+                                            result);
+    ev->depth--;
+    ev->bindingCount = callFrame;
+    if (outcome == EVAL_FAILED) return false;
+    if (outcome == EVAL_NEXT) {
+        // Falling off the end returns 0, which is only an int
+        memset(result, 0, sizeof(Value));
+    }
+    return hasType(result, function->data.funcDecl.returnType);
+}
+
+static char* valueLiteral(const Value* value) {
+    char* literal;
+    size_t size;
+    if (value->isString) {
+        size = value->length + 3;
+        literal = (char*)malloc(size);
+        literal[0] = '"';
+        memcpy(literal + 1, value->bytes, value->length);
+        literal[value->length + 1] = '"';
+        literal[value->length + 2] = '\0';
+    } else {
+        char digits[32];
+        size = (size_t)snprintf(digits, sizeof(digits), "%" PRId64, value->number) + 1;
+        literal = (char*)malloc(size);
+        memcpy(literal, digits, size);
+    }
+    STATS_ALLOC(MEM_STRINGS, size);
+    return literal;
+}
+
+static bool isConstantCall(const Evaluator* ev, const ASTNode* node) {
+    if (node->type != AST_CALL_EXPR) return false;
+    if (!isBuiltin(ev, node) && !moduleFunction(ev, node->data.callExpr.callee)) return false;
+    for (const ASTNode* argument = node->data.callExpr.arguments; argument; argument = argument->next) {
+        if (argument->type != AST_LITERAL) return false;
+    }
+    return true;
+}
+
+// Post-order, so calls in the arguments are already literals when their
+// parent is seen
+static void foldCall(ASTNode* node, int depth, void* context) {
+    (void)depth;
+    Evaluator* ev = (Evaluator*)context;
+    if (!isConstantCall(ev, node)) return;
+
+    Arena* arena = compilationArena();
+    ArenaMark mark = arenaMark(arena);
+    ev->fuel = ev->fuelLimit;
+    ev->depth = 0;
+    ev->bindingCount = 0;
+    Value value;
+    char* literal = evaluateCall(ev, 0, node, &value) ? valueLiteral(&value) : NULL;
+    arenaRelease(arena, mark);
+    if (!literal) return;
+
+    TRACE("Evaluated call to '%s' at compile time\n", node->data.callExpr.callee);
+    free(node->data.callExpr.callee);
+    freeAST(node->data.callExpr.arguments);
+    node->type = AST_LITERAL;
+    node->data.literal.value = literal;
+    ev->folded++;
+}
+
+int evaluateConstantCalls(ASTNode* root, long fuel) {
+    if (!root || root->type != AST_BLOCK) return 0;
+    Evaluator ev;
+    memset(&ev, 0, sizeof(Evaluator));
+    ev.fuelLimit = fuel;
+    initStringPool(&ev.names);
+    for (ASTNode* node = root->data.block.declarations; node; node = node->next) {
+        if (node->type == AST_FUNC_DECL) internString(&ev.names, node->data.funcDecl.name, strlen(node->data.funcDecl.name));
+        if (node->type == AST_VAR_DECL) internString(&ev.names, node->data.varDecl.name, strlen(node->data.varDecl.name));
+    }
+    ev.functions = (ASTNode**)calloc(ev.names.count + 1, sizeof(ASTNode*));
+    ev.pure = (bool*)calloc(ev.names.count + 1, sizeof(bool));
+    for (ASTNode* node = root->data.block.declarations; node; node = node->next) {
+        if (node->type != AST_FUNC_DECL) continue;
+        uint32_t id = findString(&ev.names, node->data.funcDecl.name, strlen(node->data.funcDecl.name));
+        if (!ev.functions[id]) ev.functions[id] = node;
+    }
+    findPureFunctions(&ev, root);
+
+    ASTVisitor visitor = {NULL, foldCall, &ev};
+    walkAST(root, &visitor);
+
+    free(ev.bindings);
+    free(ev.pure);
+    free(ev.functions);
+    freeStringPool(&ev.names);
+    return ev.folded;
+}
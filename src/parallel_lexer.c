@@ -0,0 +1,149 @@
+#include "parallel_lexer.h"
+#include "thread_pool.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Tokens starting in [start, end) belong to the chunk; the last chunk's end
+// lies past the source so that it keeps TOKEN_EOF
+typedef struct {
+    const char* source;
+    size_t start;
+    size_t end;
+    size_t newlines;        // In [start, end)
+    Token* tokens;
+    size_t count;
+    size_t capacity;
+    size_t last;            // Where the chunk's last token ends
+    int lineShift;          // Added to the chunk's lines when stitching
+    Token* output;
+} Chunk;
+
+static void addToken(Chunk* chunk, Token token) {
+    if (chunk->count == chunk->capacity) {
+        chunk->capacity = chunk->capacity ? chunk->capacity * 2 : 64;
+        chunk->tokens = (Token*)realloc(chunk->tokens, chunk->capacity * sizeof(Token));
+    }
+    chunk->tokens[chunk->count++] = token;
+}
+
+// Lex from `offset`, where the lexer stands at `line`, until a token starts
+// past the chunk
+static void lexChunk(Chunk* chunk, size_t offset, int line) {
+    resumeLexer(chunk->source, offset, line);
+    for (;;) {
+        Token token = scanToken();
+        size_t start, end;
+        lastTokenSpan(&start, &end);
+        if (start >= chunk->end) break;
+        addToken(chunk, token);
+        chunk->last = end;
+        if (token.type == TOKEN_EOF) break;
+    }
+}
+
+static void lexChunkTask(void* arg) {
+    Chunk* chunk = (Chunk*)arg;
+    // The last chunk ends on the source's terminator, which is no newline
+    const char* text = chunk->source;
+    for (const char* p = text + chunk->start; (p = memchr(p, '\n', chunk->end - (size_t)(p - text))); p++) {
+        chunk->newlines++;
+    }
+    // About one token per four bytes of generated code
+    chunk->capacity = (chunk->end - chunk->start) / 4 + 64;
+    chunk->tokens = (Token*)malloc(chunk->capacity * sizeof(Token));
+    lexChunk(chunk, chunk->start, 1);
+}
+
+static void copyChunkTask(void* arg) {
+    Chunk* chunk = (Chunk*)arg;
+    for (size_t i = 0; i < chunk->count; i++) {
+        chunk->output[i] = chunk->tokens[i];
+        chunk->output[i].line += chunk->lineShift;
+    }
+}
+
+// Cut just after the first newline at or past each even share of the source
+static size_t cutChunks(const char* source, size_t length, int count, Chunk* chunks) {
+    size_t cuts = 0;
+    size_t start = 0;
+    for (int i = 1; i <= count; i++) {
+        size_t end = length + 1;
+        if (i < count) {
+            size_t target = (size_t)((unsigned long long)length * (unsigned long long)i / (unsigned long long)count);
+            if (target < start) target = start;
+            const char* newline = (const char*)memchr(source + target, '\n', length - target);
+            if (!newline || (size_t)(newline - source) + 1 >= length) continue;
+            end = (size_t)(newline - source) + 1;
+            if (end <= start) continue;
+        }
+        chunks[cuts] = (Chunk){.source = source, .start = start, .end = end};
+        cuts++;
+        start = end;
+    }
+    return cuts;
+}
+
+void lexParallel(const char* source, size_t length, int chunkCount, TokenList* list) {
+    if (chunkCount < 1) chunkCount = hardwareThreadCount();
+    Chunk* chunks = (Chunk*)malloc((size_t)chunkCount * sizeof(Chunk));
+    size_t count = cutChunks(source, length, chunkCount, chunks);
+
+    ThreadPool* pool = count > 1 ? createThreadPool((int)count) : NULL;
+    if (pool) {
+        for (size_t i = 0; i < count; i++) submitTask(pool, lexChunkTask, &chunks[i]);
+        waitThreadPool(pool);
+    } else {
+        lexChunkTask(&chunks[0]);
+    }
+
+    // Stitch: `resume` and `line` are where the serial lexer stands after
+    // the tokens accepted so far
+    size_t resume = 0;
+    int line = 1;
+    size_t newlinesBefore = 0;
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        Chunk* chunk = &chunks[i];
+        if (resume > chunk->start) {
+            // A string ran past the cut, so the guess was wrong
+            chunk->count = 0;
+            lexChunk(chunk, resume, line);
+            chunk->lineShift = 0;
+        } else {
+            chunk->lineShift = (int)newlinesBefore;
+        }
+        if (chunk->count > 0) {
+            resume = chunk->last;
+            line = chunk->tokens[chunk->count - 1].line + chunk->lineShift;
+        }
+        newlinesBefore += chunk->newlines;
+        total += chunk->count;
+    }
+
+    list->count = total;
+    if (count == 1) {
+        // Nothing to stitch, and the lines are already the serial ones
+        list->tokens = chunks[0].tokens;
+        free(chunks);
+        return;
+    }
+    list->tokens = (Token*)malloc(total * sizeof(Token));
+    Token* output = list->tokens;
+    for (size_t i = 0; i < count; i++) {
+        chunks[i].output = output;
+        output += chunks[i].count;
+        if (pool) submitTask(pool, copyChunkTask, &chunks[i]);
+        else copyChunkTask(&chunks[i]);
+    }
+    if (pool) destroyThreadPool(pool);
+
+    for (size_t i = 0; i < count; i++) free(chunks[i].tokens);
+    free(chunks);
+}
+
+void freeTokenList(TokenList* list) {
+    free(list->tokens);
+    list->tokens = NULL;
+    list->count = 0;
+}
@@ -1,14 +1,21 @@
 #include "parser.h"
+#include "compat.h"
+#include "debug.h"
+#include "stats.h"
+#include "ast_visitor.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <lexer.h>
 #include <stdbool.h>
+#include <stdarg.h>
+#include <setjmp.h>
 #include <ast.h>
 
 // Custom implementation of strndup
 char* custom_strndup(const char* s, size_t n) {
     char* p = (char*)malloc(n + 1);
+    STATS_ALLOC(MEM_STRINGS, n + 1);
     if (p) {
         strncpy_s(p, n + 1, s, n);
         p[n] = '\0';
@@ -16,8 +23,63 @@ char* custom_strndup(const char* s, size_t n) {
     return p;
 }
 
-static Token currentToken;
-static Token previousToken;
+static THREAD_LOCAL Token currentToken;
+static THREAD_LOCAL Token previousToken;
+static THREAD_LOCAL bool lazyBodies = false;
+static THREAD_LOCAL bool timeTokens = false;
+
+// Syntax errors normally end the process; tryParse() arms a recovery point
+// so long-running callers (the compilation server) survive them instead
+static THREAD_LOCAL FILE* errorStream = NULL;
+static THREAD_LOCAL jmp_buf* recoveryPoint = NULL;
+// parseDeclarations() keeps the message instead of printing it
+static THREAD_LOCAL char* errorMessage = NULL;
+static THREAD_LOCAL size_t errorMessageSize = 0;
+// Nodes allocated while a recovery point is armed. Nothing links to the
+// partial tree once a syntax error unwinds the parse, so those after the
+// recovery point's mark are freed one by one.
+static THREAD_LOCAL ASTNode** parsedNodes = NULL;
+static THREAD_LOCAL size_t parsedNodeCount = 0;
+static THREAD_LOCAL size_t parsedNodeCapacity = 0;
+
+static ASTNode* newNode(ASTNodeType type) {
+    ASTNode* node = newASTNode(type);
+    if (recoveryPoint) {
+        if (parsedNodeCount == parsedNodeCapacity) {
+            parsedNodeCapacity = parsedNodeCapacity ? parsedNodeCapacity * 2 : 256;
+            parsedNodes = (ASTNode**)realloc(parsedNodes, parsedNodeCapacity * sizeof(ASTNode*));
+        }
+        parsedNodes[parsedNodeCount++] = node;
+    }
+    return node;
+}
+
+// Ends the parse armed when `mark` nodes were tracked. A failed one frees
+// what it built; otherwise the nodes belong to the caller's tree.
+static void releaseParsedNodes(size_t mark, bool failed) {
+    if (failed) {
+        for (size_t i = mark; i < parsedNodeCount; i++) freeASTNode(parsedNodes[i]);
+    }
+    parsedNodeCount = mark;
+    if (mark == 0) {
+        free(parsedNodes);
+        parsedNodes = NULL;
+        parsedNodeCapacity = 0;
+    }
+}
+
+static void syntaxError(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    if (errorMessage) {
+        vsnprintf(errorMessage, errorMessageSize, format, args);
+    } else {
+        vfprintf(errorStream ? errorStream : stderr, format, args);
+    }
+    va_end(args);
+    if (recoveryPoint) longjmp(*recoveryPoint, 1);
+    exit(1);
+}
 
 // Function prototypes
 static void advance();
@@ -28,6 +90,7 @@ static ASTNode* varDeclaration(TokenType type);
 static ASTNode* funcDeclaration(TokenType type);
 static ASTNode* statement();
 static ASTNode* block();
+static ASTNode* skipBody();
 static ASTNode* exprStatement();
 static ASTNode* returnStatement();
 static ASTNode* primary();
@@ -36,8 +99,17 @@ static ASTNode* arguments();
 
 static void advance() {
     previousToken = currentToken;
-    currentToken = scanToken();
-    printf("Advanced to token: Type=%d, Lexeme='%.*s', Line=%d\n", currentToken.type, currentToken.length, currentToken.start, currentToken.line);
+    if (timeTokens) {
+        // Wall time only: the thread CPU clock is a system call (see nestPhase)
+        PhaseStats* lex = &compilerStats.phases[PHASE_LEX];
+        double start = wallClock();
+        currentToken = scanToken();
+        lex->wallSeconds += wallClock() - start;
+        lex->items += currentToken.type != TOKEN_EOF;
+    } else {
+        currentToken = scanToken();
+    }
+    TRACE("Advanced to token: Type=%d, Lexeme='%.*s', Line=%d\n", currentToken.type, currentToken.length, tokenStart(currentToken), currentToken.line);
 }
 
 static bool check(TokenType type) {
@@ -54,30 +126,40 @@ static bool match(TokenType type) {
 
 static void consume(TokenType type, const char* message) {
     if (!match(type)) {
-        fprintf(stderr, "Error: %s. Found: Type=%d, Lexeme='%.*s', Line=%d\n", message, currentToken.type, currentToken.length, currentToken.start, currentToken.line);
-        exit(1);
+        syntaxError("Error: %s. Found: Type=%d, Lexeme='%.*s', Line=%d\n", message, currentToken.type, currentToken.length, tokenStart(currentToken), currentToken.line);
     }
 }
 
 static ASTNode* newLiteralNode(const char* value, int length) {
-    ASTNode* node = newASTNode(AST_LITERAL);
+    ASTNode* node = newNode(AST_LITERAL);
     node->data.literal.value = custom_strndup(value, length);
     return node;
 }
 
 static ASTNode* newIdentifierNode(const char* name, int length) {
-    ASTNode* node = newASTNode(AST_IDENTIFIER);
+    ASTNode* node = newNode(AST_IDENTIFIER);
     node->data.identifier.name = custom_strndup(name, length);
     return node;
 }
 
 static ASTNode* primary() {
-    if (match(TOKEN_NUMBER)) {
-        return newLiteralNode(previousToken.start, previousToken.length);
+    if (match(TOKEN_NUMBER) || match(TOKEN_STRING)) {
+        // String literals keep their quotes, which tells them apart from numbers
+        return newLiteralNode(tokenStart(previousToken), previousToken.length);
     }
 
     if (match(TOKEN_IDENTIFIER)) {
-        return newIdentifierNode(previousToken.start, previousToken.length);
+        Token name = previousToken;
+        if (match(TOKEN_LPAREN)) {
+            ASTNode* node = newNode(AST_CALL_EXPR);
+            node->data.callExpr.callee = custom_strndup(tokenStart(name), name.length);
+            if (!check(TOKEN_RPAREN)) {
+                node->data.callExpr.arguments = arguments();
+            }
+            consume(TOKEN_RPAREN, "Expect ')' after arguments.");
+            return node;
+        }
+        return newIdentifierNode(tokenStart(name), name.length);
     }
 
     if (match(TOKEN_LPAREN)) {
@@ -86,8 +168,8 @@ static ASTNode* primary() {
         return node;
     }
 
-    fprintf(stderr, "Error: Unexpected token '%.*s'.\n", currentToken.length, currentToken.start);
-    exit(1);
+    syntaxError("Error: Unexpected token '%.*s'.\n", currentToken.length, tokenStart(currentToken));
+    return NULL;
 }
 
 static ASTNode* parseBinaryExpr(int precedence, ASTNode* left) {
@@ -101,24 +183,23 @@ static ASTNode* parseBinaryExpr(int precedence, ASTNode* left) {
             return left; // If not an operator, return the left operand
         }
 
-        printf("Operator found: %.*s\n", currentToken.length, currentToken.start);
+        TRACE("Operator found: %.*s\n", currentToken.length, tokenStart(currentToken));
 
         advance(); // Consume the operator
 
         // Parse the right-hand side expression
         ASTNode* right = primary();
         if (!right) {
-            fprintf(stderr, "Error: Failed to parse right operand of binary expression.\n");
-            exit(1);
+            syntaxError("Error: Failed to parse right operand of binary expression.\n");
         }
 
         // Create a new binary expression node
-        ASTNode* node = newASTNode(AST_BINARY_EXPR);
+        ASTNode* node = newNode(AST_BINARY_EXPR);
         node->data.binaryExpr.left = left;
-        node->data.binaryExpr.operator = operatorType; // Set the operator
+        node->operator = operatorType; // Set the operator
         node->data.binaryExpr.right = right;
 
-        printf("Binary expression parsed: left='%s', operator='%d', right='%s'\n",
+        TRACE("Binary expression parsed: left='%s', operator='%d', right='%s'\n",
                left->data.identifier.name, operatorType, right->data.identifier.name);
 
         left = node; // Update left to the new binary expression node
@@ -131,14 +212,16 @@ static ASTNode* expression() {
 
 static ASTNode* arguments() {
     ASTNode* node = expression();
+    ASTNode* last = node;
     while (match(TOKEN_COMMA)) {
-        node->next = expression();
+        last->next = expression();
+        last = last->next;
     }
     return node;
 }
 
 static ASTNode* varDeclaration(TokenType type) {
-    ASTNode* node = newASTNode(AST_VAR_DECL);
+    ASTNode* node = newNode(AST_VAR_DECL);
 
     // Set the variable type from the captured type token
     if (type == TOKEN_INT) {
@@ -149,34 +232,33 @@ static ASTNode* varDeclaration(TokenType type) {
         node->data.varDecl.varType = custom_strndup("str", 3);
     }
 
-    printf("Parsing variable declaration: type='%s'\n", node->data.varDecl.varType);
+    TRACE("Parsing variable declaration: type='%s'\n", node->data.varDecl.varType);
 
     // The previous token is the variable name
     if (previousToken.type != TOKEN_IDENTIFIER) {
-        fprintf(stderr, "Error: Expect variable name. Found: Type=%d, Lexeme='%.*s', Line=%d\n", previousToken.type, previousToken.length, previousToken.start, previousToken.line);
-        exit(1);
+        syntaxError("Error: Expect variable name. Found: Type=%d, Lexeme='%.*s', Line=%d\n", previousToken.type, previousToken.length, tokenStart(previousToken), previousToken.line);
     }
-    node->data.varDecl.name = custom_strndup(previousToken.start, previousToken.length);
-    printf("Variable name: '%s'\n", node->data.varDecl.name);
+    node->data.varDecl.name = custom_strndup(tokenStart(previousToken), previousToken.length);
+    TRACE("Variable name: '%s'\n", node->data.varDecl.name);
 
     // Consume the '=' token
-    printf("Before consuming '=' token: Type=%d, Lexeme='%.*s'\n", currentToken.type, currentToken.length, currentToken.start);
+    TRACE("Before consuming '=' token: Type=%d, Lexeme='%.*s'\n", currentToken.type, currentToken.length, tokenStart(currentToken));
     consume(TOKEN_EQUAL, "Expect '=' after variable name.");
-    printf("After consuming '=' token: Type=%d, Lexeme='%.*s'\n", currentToken.type, currentToken.length, currentToken.start);
+    TRACE("After consuming '=' token: Type=%d, Lexeme='%.*s'\n", currentToken.type, currentToken.length, tokenStart(currentToken));
 
     // Parse the initializer expression
     node->data.varDecl.initializer = expression();
-    printf("Variable initializer parsed\n");
+    TRACE("Variable initializer parsed\n");
 
     // Consume the ';' token
     consume(TOKEN_SEMICOLON, "Expect ';' after variable declaration.");
-    printf("Parsed variable declaration: %s %s\n", node->data.varDecl.varType, node->data.varDecl.name);
+    TRACE("Parsed variable declaration: %s %s\n", node->data.varDecl.varType, node->data.varDecl.name);
 
     return node;
 }
 
 static ASTNode* funcDeclaration(TokenType type) {
-    ASTNode* node = newASTNode(AST_FUNC_DECL);
+    ASTNode* node = newNode(AST_FUNC_DECL);
 
     // Set the function return type from the captured type token
     if (type == TOKEN_INT) {
@@ -187,66 +269,80 @@ static ASTNode* funcDeclaration(TokenType type) {
         node->data.funcDecl.returnType = custom_strndup("str", 3);
     }
 
-    printf("Parsing function declaration: return type='%s'\n", node->data.funcDecl.returnType);
+    TRACE("Parsing function declaration: return type='%s'\n", node->data.funcDecl.returnType);
 
     // Consume the function name
     if (previousToken.type != TOKEN_IDENTIFIER) {
-        fprintf(stderr, "Error: Expect function name. Found: Type=%d, Lexeme='%.*s', Line=%d\n", previousToken.type, previousToken.length, previousToken.start, previousToken.line);
-        exit(1);
+        syntaxError("Error: Expect function name. Found: Type=%d, Lexeme='%.*s', Line=%d\n", previousToken.type, previousToken.length, tokenStart(previousToken), previousToken.line);
     }
-    node->data.funcDecl.name = custom_strndup(previousToken.start, previousToken.length);
-    printf("Function name: '%s'\n", node->data.funcDecl.name);
+    node->data.funcDecl.name = custom_strndup(tokenStart(previousToken), previousToken.length);
+    TRACE("Function name: '%s'\n", node->data.funcDecl.name);
     
     consume(TOKEN_LPAREN, "Expect '(' after function name.");
 
     // Parse parameters
     if (!check(TOKEN_RPAREN)) {
-        node->data.funcDecl.params = newASTNode(AST_PARAM);
+        node->data.funcDecl.params = newNode(AST_PARAM);
         ASTNode* param = node->data.funcDecl.params;
         while (true) {
             advance();
-            param->data.param.paramType = custom_strndup(previousToken.start, previousToken.length);
+            param->data.param.paramType = custom_strndup(tokenStart(previousToken), previousToken.length);
             consume(TOKEN_IDENTIFIER, "Expect parameter name.");
-            param->data.param.name = custom_strndup(previousToken.start, previousToken.length);
-            printf("Parameter: %s %s\n", param->data.param.paramType, param->data.param.name);
+            param->data.param.name = custom_strndup(tokenStart(previousToken), previousToken.length);
+            TRACE("Parameter: %s %s\n", param->data.param.paramType, param->data.param.name);
             if (!match(TOKEN_COMMA)) break;
-            param->next = newASTNode(AST_PARAM);
+            param->next = newNode(AST_PARAM);
             param = param->next;
         }
     }
     consume(TOKEN_RPAREN, "Expect ')' after parameters.");
-    node->data.funcDecl.body = block();
-    printf("Parsed function declaration: %s %s\n", node->data.funcDecl.returnType, node->data.funcDecl.name);
+    node->data.funcDecl.body = lazyBodies ? skipBody() : block();
+    TRACE("Parsed function declaration: %s %s\n", node->data.funcDecl.returnType, node->data.funcDecl.name);
     return node;
 }
 
+// Lazy parsing: match braces over the tokens of the body and keep where it
+// starts. Lexical errors are still reported here, syntax errors only once
+// the body is expanded.
+static ASTNode* skipBody() {
+    ASTNode* stub = newNode(AST_LAZY_BODY);
+    if (check(TOKEN_LBRACE)) {
+        stub->data.lazyBody.source = tokenStart(currentToken) - currentToken.offset;
+        stub->data.lazyBody.offset = currentToken.offset;
+        stub->data.lazyBody.line = currentToken.line;
+    }
+    consume(TOKEN_LBRACE, "Expect '{' before block.");
+    for (int depth = 1; depth > 0; advance()) {
+        if (check(TOKEN_EOF) || check(TOKEN_ERROR)) consume(TOKEN_RBRACE, "Expect '}' after block.");
+        if (check(TOKEN_LBRACE)) depth++;
+        if (check(TOKEN_RBRACE)) depth--;
+    }
+    return stub;
+}
+
 static ASTNode* block() {
-    ASTNode* node = newASTNode(AST_BLOCK);
+    ASTNode* node = newNode(AST_BLOCK);
     node->data.block.declarations = NULL;
 
     consume(TOKEN_LBRACE, "Expect '{' before block.");
+    ASTNode** tail = &node->data.block.declarations;
     while (!check(TOKEN_RBRACE) && !check(TOKEN_EOF)) {
-        if (!node->data.block.declarations) {
-            node->data.block.declarations = declaration();
-        } else {
-            ASTNode* decl = node->data.block.declarations;
-            while (decl->next) decl = decl->next;
-            decl->next = declaration();
-        }
+        *tail = declaration();
+        tail = &(*tail)->next;
     }
     consume(TOKEN_RBRACE, "Expect '}' after block.");
     return node;
 }
 
 static ASTNode* exprStatement() {
-    ASTNode* node = newASTNode(AST_EXPR_STMT);
+    ASTNode* node = newNode(AST_EXPR_STMT);
     node->data.exprStmt.expression = expression();
     consume(TOKEN_SEMICOLON, "Expect ';' after expression.");
     return node;
 }
 
 static ASTNode* returnStatement() {
-    ASTNode* node = newASTNode(AST_RETURN_STMT);
+    ASTNode* node = newNode(AST_RETURN_STMT);
     if (!check(TOKEN_SEMICOLON)) {
         node->data.returnStmt.value = expression();
     }
@@ -256,7 +352,7 @@ static ASTNode* returnStatement() {
 
 static ASTNode* statement() {
     if (match(TOKEN_RETURN)) return returnStatement();
-    if (match(TOKEN_LBRACE)) return block();
+    if (check(TOKEN_LBRACE)) return block(); // block() consumes the brace itself
     return exprStatement();
 }
 
@@ -275,20 +371,151 @@ static ASTNode* declaration() {
     return statement();
 }
 
+// import name;
+static ASTNode* importDeclaration() {
+    consume(TOKEN_IDENTIFIER, "Expect module name after 'import'.");
+    ASTNode* node = newNode(AST_IMPORT);
+    node->data.import.module = custom_strndup(tokenStart(previousToken), previousToken.length);
+    consume(TOKEN_SEMICOLON, "Expect ';' after import.");
+    return node;
+}
+
+static ASTNode* topLevelDeclaration() {
+    return match(TOKEN_IMPORT) ? importDeclaration() : declaration();
+}
+
 ASTNode* parse() {
     advance(); // Initialize currentToken
-    ASTNode* root = newASTNode(AST_BLOCK);
+    ASTNode* root = newNode(AST_BLOCK);
     root->data.block.declarations = NULL;
 
+    // Append through a tail pointer; rescanning the list made parsing quadratic
+    ASTNode** tail = &root->data.block.declarations;
     while (!check(TOKEN_EOF)) {
-        if (!root->data.block.declarations) {
-            root->data.block.declarations = declaration();
+        *tail = topLevelDeclaration();
+        tail = &(*tail)->next;
+    }
+
+    return root;
+}
+
+void setParseErrorStream(FILE* stream) {
+    errorStream = stream;
+}
+
+ASTNode* tryParse() {
+    jmp_buf jump;
+    jmp_buf* saved = recoveryPoint;
+    size_t mark = parsedNodeCount;
+    if (setjmp(jump)) {
+        recoveryPoint = saved;
+        releaseParsedNodes(mark, true);
+        return NULL;
+    }
+    recoveryPoint = &jump;
+    ASTNode* root = parse();
+    recoveryPoint = saved;
+    releaseParsedNodes(mark, false);
+    return root;
+}
+
+bool parseDeclarations(DeclarationCallback accept, void* context, char* message, size_t messageSize) {
+    jmp_buf jump;
+    jmp_buf* saved = recoveryPoint;
+    char* savedMessage = errorMessage;
+    size_t savedMessageSize = errorMessageSize;
+    size_t mark = parsedNodeCount;
+    volatile bool parsed = true;
+    if (setjmp(jump)) {
+        parsed = false;
+    } else {
+        recoveryPoint = &jump;
+        errorMessage = message;
+        errorMessageSize = messageSize;
+        advance();
+        while (!check(TOKEN_EOF)) {
+            const char* start = tokenStart(currentToken);
+            ASTNode* node = topLevelDeclaration();
+            // Every declaration ends with a ';' or '}' consumed by the parser
+            const char* end = tokenStart(previousToken) + previousToken.length;
+            const char* next = check(TOKEN_EOF) || check(TOKEN_ERROR) ? NULL : tokenStart(currentToken);
+            // Accepted declarations are the callback's, even if a later one fails
+            parsedNodeCount = mark;
+            if (!accept(node, start, end, previousToken.line, next, context)) break;
+        }
+    }
+    recoveryPoint = saved;
+    errorMessage = savedMessage;
+    errorMessageSize = savedMessageSize;
+    releaseParsedNodes(mark, !parsed);
+    return parsed;
+}
+
+void setLazyBodies(bool lazy) {
+    lazyBodies = lazy;
+}
+
+void setTokenTiming(bool timed) {
+    timeTokens = timed;
+}
+
+// With `keep` the parsed body replaces the stub, otherwise it is dropped
+static bool parseLazyBody(ASTNode* function, bool keep) {
+    ASTNode* stub = function->data.funcDecl.body;
+    if (!stub || stub->type != AST_LAZY_BODY) return true;
+
+    jmp_buf jump;
+    jmp_buf* saved = recoveryPoint;
+    bool savedLazy = lazyBodies;
+    size_t mark = parsedNodeCount;
+    volatile bool parsed = true;
+    if (setjmp(jump)) {
+        parsed = false;
+    } else {
+        recoveryPoint = &jump;
+        // Functions nested in the body are parsed with it
+        lazyBodies = false;
+        resumeLexer(stub->data.lazyBody.source, stub->data.lazyBody.offset, stub->data.lazyBody.line);
+        advance();
+        ASTNode* body = block();
+        if (keep) {
+            function->data.funcDecl.body = body;
+            freeAST(stub);
         } else {
-            ASTNode* decl = root->data.block.declarations;
-            while (decl->next) decl = decl->next;
-            decl->next = declaration();
+            freeAST(body);
         }
     }
+    recoveryPoint = saved;
+    lazyBodies = savedLazy;
+    releaseParsedNodes(mark, !parsed);
+    return parsed;
+}
 
-    return root;
+bool expandFunctionBody(ASTNode* function) {
+    return parseLazyBody(function, true);
+}
+
+// Post-order, so the walk is done with the stub before it is replaced
+static void expandNode(ASTNode* node, int depth, void* context) {
+    (void)depth;
+    if (node->type == AST_FUNC_DECL && !expandFunctionBody(node)) *(bool*)context = false;
+}
+
+bool expandFunctionBodies(ASTNode* root) {
+    bool expanded = true;
+    ASTVisitor visitor = {NULL, expandNode, &expanded};
+    walkAST(root, &visitor);
+    return expanded;
+}
+
+static void checkNode(ASTNode* node, int depth, void* context) {
+    (void)depth;
+    if (node->type == AST_FUNC_DECL && !parseLazyBody(node, false)) *(bool*)context = false;
+}
+
+bool checkFunctionBodies(ASTNode* root) {
+    bool valid = true;
+    ASTVisitor visitor = {NULL, checkNode, &valid};
+    walkAST(root, &visitor);
+    return valid;
 }
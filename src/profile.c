@@ -0,0 +1,83 @@
+#include "profile.h"
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_NAME 255    // The %255s of loadProfile()
+// "edge <caller> <site> <callee>" at its longest, with the NUL
+#define MAX_KEY (sizeof("edge ") + MAX_NAME + 1 + 10 + 1 + MAX_NAME)
+
+void initProfile(Profile* profile) {
+    memset(profile, 0, sizeof(Profile));
+    initStringPool(&profile->keys);
+}
+
+void freeProfile(Profile* profile) {
+    freeStringPool(&profile->keys);
+    free(profile->counts);
+    memset(profile, 0, sizeof(Profile));
+}
+
+// Returns the key's new total
+static uint64_t addCount(Profile* profile, const char* key, uint64_t count) {
+    uint32_t id = internString(&profile->keys, key, strlen(key));
+    if (id >= profile->countCapacity) {
+        uint32_t previous = profile->countCapacity;
+        profile->countCapacity = profile->keys.capacity;
+        profile->counts = (uint64_t*)realloc(profile->counts, profile->countCapacity * sizeof(uint64_t));
+        memset(profile->counts + previous, 0, (profile->countCapacity - previous) * sizeof(uint64_t));
+    }
+    profile->counts[id] += count;
+    return profile->counts[id];
+}
+
+static uint64_t findCount(const Profile* profile, const char* key) {
+    uint32_t id = findString(&profile->keys, key, strlen(key));
+    return id == STRING_NOT_FOUND ? 0 : profile->counts[id];
+}
+
+bool loadProfile(Profile* profile, const char* path, FILE* err) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        fprintf(err, "Error: Could not open profile '%s'.\n", path);
+        return false;
+    }
+
+    char line[MAX_KEY + 64];
+    int number = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), file)) {
+        number++;
+        if (line[0] == '#' || line[0] == '\n') continue;
+
+        char caller[MAX_NAME + 1], callee[MAX_NAME + 1], key[MAX_KEY];
+        unsigned int site;
+        uint64_t count;
+        if (sscanf(line, "function %255s %" SCNu64, caller, &count) == 2) {
+            snprintf(key, sizeof(key), "function %s", caller);
+            uint64_t total = addCount(profile, key, count);
+            if (total > profile->maxFunctionCount) profile->maxFunctionCount = total;
+        } else if (sscanf(line, "edge %255s %u %255s %" SCNu64, caller, &site, callee, &count) == 4) {
+            snprintf(key, sizeof(key), "edge %s %u %s", caller, site, callee);
+            uint64_t total = addCount(profile, key, count);
+            if (total > profile->maxEdgeCount) profile->maxEdgeCount = total;
+        } else {
+            fprintf(err, "Error: Malformed profile line %d in '%s'.\n", number, path);
+            ok = false;
+        }
+    }
+    fclose(file);
+    return ok;
+}
+
+uint64_t profileFunctionCount(const Profile* profile, const char* name) {
+    char key[MAX_KEY];
+    if (snprintf(key, sizeof(key), "function %s", name) >= (int)sizeof(key)) return 0;
+    return findCount(profile, key);
+}
+
+uint64_t profileEdgeCount(const Profile* profile, const char* caller, uint32_t site, const char* callee) {
+    char key[MAX_KEY];
+    if (snprintf(key, sizeof(key), "edge %s %u %s", caller, site, callee) >= (int)sizeof(key)) return 0;
+    return findCount(profile, key);
+}
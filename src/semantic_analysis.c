@@ -1,9 +1,13 @@
 #include "semantic_analysis.h"
+#include "debug.h"
+#include "compat.h"
+#include "ast_visitor.h"
+#include "module.h"
 #include <stdio.h>
 #include <stdarg.h>
 #include <string.h>
 
-static ErrorFunction customErrorFunction = NULL;
+static THREAD_LOCAL ErrorFunction customErrorFunction = NULL;
 
 void setErrorFunction(ErrorFunction errorFunc) {
     customErrorFunction = errorFunc;
@@ -20,7 +24,7 @@ void error(const char *format, ...) {
     va_end(args);
 }
 
-static SymbolTable *currentScope = NULL;
+static THREAD_LOCAL SymbolTable *currentScope = NULL;
 
 void enterScope() {
     currentScope = createSymbolTable(currentScope);
@@ -35,7 +39,7 @@ void exitScope() {
 void analyzeVariableDeclaration(ASTNode *node) {
     Symbol *sym = lookupSymbol(currentScope, node->data.varDecl.name);
     if (sym) {
-        printf("Error triggered for variable '%s' already declared.\n", node->data.varDecl.name); // Debugging
+        TRACE("Error triggered for variable '%s' already declared.\n", node->data.varDecl.name); // Debugging
         error("Error: Variable '%s' already declared.", node->data.varDecl.name);
         return;
     }
@@ -51,30 +55,67 @@ void analyzeExpression(ASTNode *node) {
     }
 }
 
-void analyzeNode(ASTNode *node) {
-    if (node == NULL) return;
+// Globals of the imported module become visible to the rest of the file.
+// Only its interface is read, never its source.
+void analyzeImport(ASTNode *node) {
+    const ModuleInterface *module = importModule(node->data.import.module);
+    if (!module) {
+        error("Error: No interface for module '%s' (compile %s%s first).", node->data.import.module,
+              node->data.import.module, MODULE_SOURCE_SUFFIX);
+        return;
+    }
+    for (uint32_t i = 0; i < module->exportCount; i++) {
+        ModuleExport exported = moduleExport(module, i);
+        if (exported.kind == EXPORT_GLOBAL && !lookupSymbol(currentScope, exported.name)) {
+            addSymbol(currentScope, exported.name, exported.type);
+        }
+    }
+}
 
+static VisitResult enterNode(ASTNode *node, int depth, void *context) {
+    (void)depth;
+    (void)context;
     switch (node->type) {
-        case AST_VAR_DECL:
-            printf("Analyzing variable declaration: %s\n", node->data.varDecl.name); // Debugging
-            analyzeVariableDeclaration(node);
-            break;
         case AST_BLOCK:
             enterScope();
-            for (ASTNode *decl = node->data.block.declarations; decl != NULL; decl = decl->next) {
-                analyzeNode(decl);
-            }
-            exitScope();
             break;
         case AST_FUNC_DECL:
             // Add function analysis logic here
+            return VISIT_SKIP_CHILDREN;
+        case AST_IDENTIFIER:
+            analyzeExpression(node);
+            break;
+        case AST_IMPORT:
+            analyzeImport(node);
+            break;
+        default:
+            break;
+    }
+    return VISIT_CONTINUE;
+}
+
+static void leaveNode(ASTNode *node, int depth, void *context) {
+    (void)depth;
+    (void)context;
+    switch (node->type) {
+        case AST_VAR_DECL:
+            // Declared after its initializer has been checked
+            TRACE("Analyzing variable declaration: %s\n", node->data.varDecl.name); // Debugging
+            analyzeVariableDeclaration(node);
+            break;
+        case AST_BLOCK:
+            exitScope();
             break;
         default:
-            analyzeExpression(node);
             break;
     }
 }
 
+void analyzeNode(ASTNode *node) {
+    ASTVisitor visitor = {enterNode, leaveNode, NULL};
+    walkASTNode(node, &visitor);
+}
+
 void analyzeProgram(ASTNode *root) {
     enterScope();
     analyzeNode(root);
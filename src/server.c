@@ -0,0 +1,728 @@
+#include "server.h"
+#include "string_pool.h"
+#include "thread_pool.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <threads.h>
+#include <unistd.h>
+
+#define REQUEST_MAGIC "CPYQ"
+#define MAX_PATH_BYTES 4096
+#define MAX_OPTION_BYTES (REQUEST_OPTION_COUNT * MAX_PATH_BYTES)
+#define MODULE_BUCKETS 1024
+#define MODULE_CACHE_LIMIT (256u << 20)   // Drop cached results beyond this many bytes
+
+// Contents of one source file as last read. Shared by concurrent requests,
+// so it is reference counted and never modified once published.
+typedef struct {
+    int refs;
+    char* data;
+    size_t length;
+    uint32_t hash;
+} FileContents;
+
+typedef struct {
+    FileContents* contents;
+    dev_t device;
+    ino_t inode;
+    off_t size;
+    struct timespec modified;
+} FileEntry;
+
+// Result of compiling one exact source text with one set of options,
+// valid while the interfaces it imported resolve the same way. For an
+// --emit-obj request it holds the object, which a hit writes again.
+typedef struct ModuleEntry {
+    uint32_t hash;
+    unsigned flags;
+    char* options;              // The request's options, as sent
+    size_t optionsLength;
+    char* source;
+    size_t length;
+    ModuleDependencies dependencies;
+    int exitCode;
+    char* out;
+    size_t outLength;
+    char* err;
+    size_t errLength;
+    ObjectBuffer object;        // Empty unless an object was requested and built
+    struct ModuleEntry* next;
+} ModuleEntry;
+
+typedef struct {
+    mtx_t lock;
+    StringPool paths;           // Interned request paths; ids index `files`
+    FileEntry* files;
+    uint32_t fileCapacity;
+    ModuleEntry* modules[MODULE_BUCKETS];
+    size_t moduleBytes;
+    int listenFd;
+    atomic_bool stopping;
+} Daemon;
+
+typedef struct {
+    Daemon* daemon;
+    int fd;
+} Connection;
+
+// One compile request as read off the socket
+typedef struct {
+    unsigned flags;
+    const char* path;
+    const char* options;                        // The raw options section
+    size_t optionsLength;
+    const char* fields[REQUEST_OPTION_COUNT];   // Into `options`; "" when unset
+} CompileRequest;
+
+// ---------------------------------------------------------------------------
+// Socket helpers
+// ---------------------------------------------------------------------------
+
+static bool writeAll(int fd, const void* data, size_t length) {
+    const char* p = (const char*)data;
+    while (length > 0) {
+        ssize_t n = send(fd, p, length, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        length -= (size_t)n;
+    }
+    return true;
+}
+
+static bool readAll(int fd, void* data, size_t length) {
+    char* p = (char*)data;
+    while (length > 0) {
+        ssize_t n = recv(fd, p, length, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        length -= (size_t)n;
+    }
+    return true;
+}
+
+static bool writeU32(int fd, uint32_t value) {
+    uint8_t bytes[4] = {(uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24)};
+    return writeAll(fd, bytes, 4);
+}
+
+static bool readU32(int fd, uint32_t* value) {
+    uint8_t bytes[4];
+    if (!readAll(fd, bytes, 4)) return false;
+    *value = (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+    return true;
+}
+
+static bool writeBlob(int fd, const char* data, size_t length) {
+    return writeU32(fd, (uint32_t)length) && (length == 0 || writeAll(fd, data, length));
+}
+
+static bool readBlob(int fd, char** data, size_t* length) {
+    uint32_t n;
+    if (!readU32(fd, &n)) return false;
+    *data = (char*)malloc((size_t)n + 1);
+    if (!readAll(fd, *data, n)) {
+        free(*data);
+        *data = NULL;
+        return false;
+    }
+    (*data)[n] = '\0';
+    *length = n;
+    return true;
+}
+
+static bool sendResponse(int fd, int exitCode, const char* out, size_t outLength, const char* err, size_t errLength) {
+    return writeU32(fd, (uint32_t)exitCode) && writeBlob(fd, out, outLength) && writeBlob(fd, err, errLength);
+}
+
+static int connectSocket(const char* socketPath) {
+    struct sockaddr_un address;
+    if (strlen(socketPath) >= sizeof(address.sun_path)) return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socketPath);
+    if (connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// ---------------------------------------------------------------------------
+// Warm state
+// ---------------------------------------------------------------------------
+
+static void releaseContents(Daemon* daemon, FileContents* contents) {
+    mtx_lock(&daemon->lock);
+    bool last = --contents->refs == 0;
+    mtx_unlock(&daemon->lock);
+    if (last) {
+        free(contents->data);
+        free(contents);
+    }
+}
+
+// Return the file's contents, re-reading it only when it changed on disk
+static FileContents* acquireContents(Daemon* daemon, const char* path) {
+    struct stat st;
+    if (stat(path, &st) != 0) return NULL;
+
+    mtx_lock(&daemon->lock);
+    uint32_t id = internString(&daemon->paths, path, strlen(path));
+    if (id >= daemon->fileCapacity) {
+        uint32_t capacity = daemon->fileCapacity ? daemon->fileCapacity * 2 : 64;
+        while (capacity <= id) capacity *= 2;
+        daemon->files = (FileEntry*)realloc(daemon->files, capacity * sizeof(FileEntry));
+        memset(daemon->files + daemon->fileCapacity, 0, (capacity - daemon->fileCapacity) * sizeof(FileEntry));
+        daemon->fileCapacity = capacity;
+    }
+    FileEntry* entry = &daemon->files[id];
+    if (entry->contents && entry->device == st.st_dev && entry->inode == st.st_ino &&
+        entry->size == st.st_size && entry->modified.tv_sec == st.st_mtim.tv_sec &&
+        entry->modified.tv_nsec == st.st_mtim.tv_nsec) {
+        FileContents* contents = entry->contents;
+        contents->refs++;
+        mtx_unlock(&daemon->lock);
+        return contents;
+    }
+    mtx_unlock(&daemon->lock);
+
+    size_t length;
+    char* data = readSourceFile(path, &length);
+    if (!data) return NULL;
+
+    FileContents* contents = (FileContents*)malloc(sizeof(FileContents));
+    contents->refs = 2;  // The cache entry and the caller
+    contents->data = data;
+    contents->length = length;
+    contents->hash = hashString(data, length);
+
+    mtx_lock(&daemon->lock);
+    entry = &daemon->files[id];  // `files` may have been reallocated meanwhile
+    FileContents* old = entry->contents;
+    entry->contents = contents;
+    entry->device = st.st_dev;
+    entry->inode = st.st_ino;
+    entry->size = st.st_size;
+    entry->modified = st.st_mtim;
+    mtx_unlock(&daemon->lock);
+
+    if (old) releaseContents(daemon, old);
+    return contents;
+}
+
+static void freeModule(ModuleEntry* module) {
+    free(module->options);
+    free(module->source);
+    freeModuleDependencies(&module->dependencies);
+    free(module->out);
+    free(module->err);
+    free(module->object.data);
+    free(module);
+}
+
+static void freeModules(Daemon* daemon) {
+    for (int i = 0; i < MODULE_BUCKETS; i++) {
+        ModuleEntry* module = daemon->modules[i];
+        while (module) {
+            ModuleEntry* next = module->next;
+            freeModule(module);
+            module = next;
+        }
+        daemon->modules[i] = NULL;
+    }
+    daemon->moduleBytes = 0;
+}
+
+// The link to the entry for this source and these options, or to the end of its bucket
+static ModuleEntry** findModule(Daemon* daemon, const FileContents* contents, const CompileRequest* request) {
+    ModuleEntry** link = &daemon->modules[contents->hash % MODULE_BUCKETS];
+    for (; *link; link = &(*link)->next) {
+        const ModuleEntry* module = *link;
+        if (module->hash == contents->hash && module->flags == request->flags &&
+            module->optionsLength == request->optionsLength &&
+            memcmp(module->options, request->options, request->optionsLength) == 0 &&
+            module->length == contents->length && memcmp(module->source, contents->data, contents->length) == 0) {
+            break;
+        }
+    }
+    return link;
+}
+
+// ---------------------------------------------------------------------------
+// Request handling
+// ---------------------------------------------------------------------------
+
+static const char* optionField(const CompileRequest* request, RequestOption option) {
+    return request->fields[option][0] ? request->fields[option] : NULL;
+}
+
+static void requestOptions(const CompileRequest* request, CompileOptions* options) {
+    memset(options, 0, sizeof(CompileOptions));
+    unsigned flags = request->flags;
+    options->stats = (flags & REQUEST_FLAG_STATS) != 0;
+    options->statsJSON = (flags & REQUEST_FLAG_STATS_JSON) != 0;
+    options->lazyBodies = (flags & REQUEST_FLAG_CHECK) != 0;
+    options->check = (flags & REQUEST_FLAG_CHECK) != 0;
+    options->noConstantCalls = (flags & REQUEST_FLAG_NO_CONSTANT_CALLS) != 0;
+    options->codegen.heapStrings = (flags & REQUEST_FLAG_NO_ESCAPE_ANALYSIS) != 0;
+    options->codegen.noTailCalls = (flags & REQUEST_FLAG_NO_TAIL_CALLS) != 0;
+    options->codegen.noVectorize = (flags & REQUEST_FLAG_NO_VECTORIZE) != 0;
+    options->codegen.profileGenerate = (flags & REQUEST_FLAG_PROFILE_GENERATE) != 0;
+    options->statsPath = optionField(request, REQUEST_OPTION_STATS_OUTPUT);
+    options->emitASTPath = optionField(request, REQUEST_OPTION_EMIT_AST);
+    options->emitObjectPath = optionField(request, REQUEST_OPTION_EMIT_OBJECT);
+    options->emitAssemblyPath = optionField(request, REQUEST_OPTION_EMIT_ASSEMBLY);
+    options->emitInterfacePath = optionField(request, REQUEST_OPTION_EMIT_INTERFACE);
+    options->profileUsePath = optionField(request, REQUEST_OPTION_PROFILE_USE);
+    options->modulePath = optionField(request, REQUEST_OPTION_MODULE_PATH);
+    options->codegen.moduleName = optionField(request, REQUEST_OPTION_MODULE_NAME);
+    options->parallelLexBytes = (size_t)strtoull(request->fields[REQUEST_OPTION_PARALLEL_LEX_BYTES], NULL, 10);
+    options->sourcePath = request->path;
+}
+
+// The response and the object can be replayed. Stats are measured anew,
+// and a compilation that writes other files or reads a profile runs every
+// time.
+static bool isCacheable(const CompileOptions* options) {
+    return !options->stats && !options->statsPath && !options->emitASTPath && !options->emitAssemblyPath &&
+           !options->emitInterfacePath && !options->profileUsePath;
+}
+
+static size_t moduleBytes(const ModuleEntry* module) {
+    return module->optionsLength + module->length + module->outLength + module->errLength + module->object.size;
+}
+
+// Writes the object, if one was built, and sends the response; a failed
+// write fails the request
+static void deliver(int fd, const char* objectPath, const ObjectBuffer* object, int exitCode, const char* out,
+                    size_t outLength, const char* err, size_t errLength) {
+    if (!objectPath || !object->data) {
+        sendResponse(fd, exitCode, out, outLength, err, errLength);
+        return;
+    }
+    FILE* file = fopen(objectPath, "wb");
+    bool ok = file && fwrite(object->data, 1, object->size, file) == object->size;
+    if (file) ok = fclose(file) == 0 && ok;
+    if (ok) {
+        sendResponse(fd, exitCode, out, outLength, err, errLength);
+        return;
+    }
+    char message[MAX_PATH_BYTES + 64];
+    int n = snprintf(message, sizeof(message), "Error: Could not write '%s'.\n", objectPath);
+    char* errors = (char*)malloc(errLength + (size_t)n);
+    memcpy(errors, err, errLength);
+    memcpy(errors + errLength, message, (size_t)n);
+    sendResponse(fd, 1, out, outLength, errors, errLength + (size_t)n);
+    free(errors);
+}
+
+static void compileRequest(Daemon* daemon, int fd, const CompileRequest* request) {
+    FileContents* contents = acquireContents(daemon, request->path);
+    if (!contents) {
+        char message[MAX_PATH_BYTES + 64];
+        int n = snprintf(message, sizeof(message), "Error: Could not read '%s'.\n", request->path);
+        sendResponse(fd, 1, "", 0, message, (size_t)n);
+        return;
+    }
+
+    CompileOptions options;
+    requestOptions(request, &options);
+    bool cacheable = isCacheable(&options);
+    // A cacheable object is built in memory, kept and then written
+    const char* objectPath = cacheable ? options.emitObjectPath : NULL;
+    ObjectBuffer object = {NULL, 0};
+    if (objectPath) {
+        options.emitObjectPath = NULL;
+        options.emitObjectBuffer = &object;
+    }
+    if (cacheable) {
+        mtx_lock(&daemon->lock);
+        ModuleEntry* module = *findModule(daemon, contents, request);
+        if (module) {
+            // Copy out under the lock; a slow client must not stall other workers
+            DaemonResponse cached = {module->exitCode, (char*)malloc(module->outLength + 1), module->outLength,
+                                     (char*)malloc(module->errLength + 1), module->errLength};
+            memcpy(cached.out, module->out, module->outLength);
+            memcpy(cached.err, module->err, module->errLength);
+            ObjectBuffer cachedObject = {module->object.size ? (uint8_t*)malloc(module->object.size) : NULL,
+                                         module->object.size};
+            if (cachedObject.data) memcpy(cachedObject.data, module->object.data, module->object.size);
+            ModuleDependencies dependencies;
+            copyModuleDependencies(&module->dependencies, &dependencies);
+            mtx_unlock(&daemon->lock);
+
+            // A changed, new or deleted interface makes the result stale
+            bool current = moduleDependenciesCurrent(&dependencies, options.modulePath);
+            freeModuleDependencies(&dependencies);
+            if (current) {
+                deliver(fd, objectPath, &cachedObject, cached.exitCode, cached.out, cached.outLength, cached.err,
+                        cached.errLength);
+                free(cachedObject.data);
+                freeDaemonResponse(&cached);
+                releaseContents(daemon, contents);
+                return;
+            }
+            free(cachedObject.data);
+            freeDaemonResponse(&cached);
+        } else {
+            mtx_unlock(&daemon->lock);
+        }
+    }
+
+    char* out = NULL;
+    char* err = NULL;
+    size_t outLength = 0, errLength = 0;
+    FILE* outStream = open_memstream(&out, &outLength);
+    FILE* errStream = open_memstream(&err, &errLength);
+    ModuleDependencies dependencies = {NULL, 0};
+    options.dependencies = &dependencies;
+    int exitCode = compileSource(contents->data, &options, options.check ? NULL : outStream, errStream);
+    fclose(outStream);
+    fclose(errStream);
+
+    deliver(fd, objectPath, &object, exitCode, out, outLength, err, errLength);
+
+    if (cacheable) {
+        ModuleEntry* module = (ModuleEntry*)malloc(sizeof(ModuleEntry));
+        module->hash = contents->hash;
+        module->flags = request->flags;
+        module->options = (char*)malloc(request->optionsLength + 1);
+        memcpy(module->options, request->options, request->optionsLength);
+        module->optionsLength = request->optionsLength;
+        module->length = contents->length;
+        module->source = (char*)malloc(contents->length + 1);
+        memcpy(module->source, contents->data, contents->length + 1);
+        module->dependencies = dependencies;
+        module->exitCode = exitCode;
+        module->out = out;
+        module->outLength = outLength;
+        module->err = err;
+        module->errLength = errLength;
+        module->object = object;
+
+        // Replaces a stale entry, or one another worker added meanwhile
+        mtx_lock(&daemon->lock);
+        if (daemon->moduleBytes > MODULE_CACHE_LIMIT) freeModules(daemon);
+        ModuleEntry** link = findModule(daemon, contents, request);
+        ModuleEntry* old = *link;
+        module->next = old ? old->next : NULL;
+        *link = module;
+        daemon->moduleBytes += moduleBytes(module);
+        if (old) daemon->moduleBytes -= moduleBytes(old);
+        mtx_unlock(&daemon->lock);
+        if (old) freeModule(old);
+    } else {
+        freeModuleDependencies(&dependencies);
+        free(out);
+        free(err);
+    }
+    releaseContents(daemon, contents);
+}
+
+static void handleConnection(void* arg) {
+    Connection* connection = (Connection*)arg;
+    Daemon* daemon = connection->daemon;
+    int fd = connection->fd;
+    free(connection);
+
+    char magic[4];
+    uint32_t kind, flags, pathLength, optionsLength;
+    if (!readAll(fd, magic, 4) || memcmp(magic, REQUEST_MAGIC, 4) != 0 ||
+        !readU32(fd, &kind) || !readU32(fd, &flags) || !readU32(fd, &pathLength) ||
+        pathLength >= MAX_PATH_BYTES) {
+        close(fd);
+        return;
+    }
+    char path[MAX_PATH_BYTES];
+    if (!readAll(fd, path, pathLength) || !readU32(fd, &optionsLength) || optionsLength > MAX_OPTION_BYTES) {
+        close(fd);
+        return;
+    }
+    path[pathLength] = '\0';
+    char* options = (char*)malloc(optionsLength + 1);
+    if (!readAll(fd, options, optionsLength)) {
+        free(options);
+        close(fd);
+        return;
+    }
+
+    // Exactly one string per option, each terminated
+    CompileRequest request = {flags, path, options, optionsLength, {NULL}};
+    size_t offset = 0;
+    for (int i = 0; i < REQUEST_OPTION_COUNT && offset < optionsLength; i++) {
+        const char* end = (const char*)memchr(options + offset, '\0', optionsLength - offset);
+        if (!end) break;
+        request.fields[i] = options + offset;
+        offset = (size_t)(end - options) + 1;
+    }
+    if (kind == REQUEST_COMPILE && (offset != optionsLength || !request.fields[REQUEST_OPTION_COUNT - 1])) {
+        free(options);
+        close(fd);
+        return;
+    }
+
+    switch ((RequestKind)kind) {
+        case REQUEST_COMPILE:
+            compileRequest(daemon, fd, &request);
+            break;
+        case REQUEST_PING:
+            sendResponse(fd, 0, "", 0, "", 0);
+            break;
+        case REQUEST_SHUTDOWN:
+            atomic_store(&daemon->stopping, true);
+            sendResponse(fd, 0, "", 0, "", 0);
+            // Wakes the accept loop
+            shutdown(daemon->listenFd, SHUT_RDWR);
+            break;
+    }
+    free(options);
+    close(fd);
+}
+
+void defaultSocketPath(char* buffer, size_t size) {
+    const char* runtimeDir = getenv("XDG_RUNTIME_DIR");
+    if (runtimeDir && *runtimeDir) {
+        snprintf(buffer, size, "%s/my_compiler.sock", runtimeDir);
+    } else {
+        snprintf(buffer, size, "/tmp/my_compiler-%u.sock", (unsigned)getuid());
+    }
+}
+
+int runDaemon(const char* socketPath, int workers) {
+    struct sockaddr_un address;
+    if (strlen(socketPath) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Error: Socket path '%s' is too long.\n", socketPath);
+        return 1;
+    }
+
+    int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socketPath);
+    unlink(socketPath);
+    if (listenFd < 0 || bind(listenFd, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+        listen(listenFd, SOMAXCONN) != 0) {
+        fprintf(stderr, "Error: Could not listen on '%s': %s\n", socketPath, strerror(errno));
+        if (listenFd >= 0) close(listenFd);
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    Daemon* daemon = (Daemon*)calloc(1, sizeof(Daemon));
+    mtx_init(&daemon->lock, mtx_plain);
+    initStringPool(&daemon->paths);
+    daemon->listenFd = listenFd;
+    atomic_init(&daemon->stopping, false);
+
+    shareModuleInterfaces(true);
+    ThreadPool* pool = createThreadPool(workers);
+    fprintf(stderr, "my_compiler daemon listening on %s with %d workers\n", socketPath, threadPoolSize(pool));
+
+    while (!atomic_load(&daemon->stopping)) {
+        int fd = accept(listenFd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        Connection* connection = (Connection*)malloc(sizeof(Connection));
+        connection->daemon = daemon;
+        connection->fd = fd;
+        submitTask(pool, handleConnection, connection);
+    }
+
+    destroyThreadPool(pool);
+    close(listenFd);
+    unlink(socketPath);
+
+    for (uint32_t id = 0; id < daemon->fileCapacity; id++) {
+        if (daemon->files[id].contents) releaseContents(daemon, daemon->files[id].contents);
+    }
+    free(daemon->files);
+    freeModules(daemon);
+    shareModuleInterfaces(false);
+    freeStringPool(&daemon->paths);
+    mtx_destroy(&daemon->lock);
+    free(daemon);
+    return 0;
+}
+
+bool daemonRequest(const char* socketPath, RequestKind kind, unsigned flags, const char* path,
+                   const char* const* options, DaemonResponse* response) {
+    memset(response, 0, sizeof(DaemonResponse));
+    size_t pathLength = path ? strlen(path) : 0;
+    if (pathLength >= MAX_PATH_BYTES) return false;
+
+    char optionBytes[MAX_OPTION_BYTES];
+    size_t optionsLength = 0;
+    for (int i = 0; i < REQUEST_OPTION_COUNT; i++) {
+        const char* value = options && options[i] ? options[i] : "";
+        size_t length = strlen(value) + 1;
+        if (length > MAX_PATH_BYTES) return false;
+        memcpy(optionBytes + optionsLength, value, length);
+        optionsLength += length;
+    }
+
+    int fd = connectSocket(socketPath);
+    if (fd < 0) return false;
+
+    uint32_t exitCode;
+    bool ok = writeAll(fd, REQUEST_MAGIC, 4) && writeU32(fd, (uint32_t)kind) && writeU32(fd, flags) &&
+              writeBlob(fd, path, pathLength) && writeBlob(fd, optionBytes, optionsLength) &&
+              readU32(fd, &exitCode) &&
+              readBlob(fd, &response->out, &response->outLength) &&
+              readBlob(fd, &response->err, &response->errLength);
+    close(fd);
+    if (!ok) {
+        freeDaemonResponse(response);
+        return false;
+    }
+    response->exitCode = (int)exitCode;
+    return true;
+}
+
+// The daemon has its own working directory; relative paths are the
+// client's. With `list`, every entry of a ':'-separated list is resolved.
+static const char* clientPath(const char* path, bool list, const char* directory, char* buffer, size_t size) {
+    if (!path) return NULL;
+    size_t used = 0;
+    buffer[0] = '\0';
+    for (const char* entry = path;;) {
+        size_t length = list ? strcspn(entry, ":") : strlen(entry);
+        const char* prefix = entry[0] == '/' || length == 0 ? "" : directory;
+        int n = snprintf(buffer + used, size - used, "%s%s%s%.*s", used ? ":" : "", prefix, *prefix ? "/" : "",
+                         (int)length, entry);
+        if (n < 0 || (size_t)n >= size - used) return NULL;
+        used += (size_t)n;
+        if (entry[length] == '\0') return buffer;
+        entry += length + 1;
+    }
+}
+
+int runClient(const char* socketPath, const char* path, const CompileOptions* options) {
+    char absolute[PATH_MAX];
+    char directory[PATH_MAX];
+    if (!realpath(path, absolute)) {
+        fprintf(stderr, "Error: Could not read '%s'.\n", path);
+        return 1;
+    }
+    if (!getcwd(directory, sizeof(directory))) {
+        fprintf(stderr, "Error: Could not resolve the working directory.\n");
+        return 1;
+    }
+
+    unsigned flags = 0;
+    if (options->stats) flags |= REQUEST_FLAG_STATS;
+    if (options->statsJSON) flags |= REQUEST_FLAG_STATS_JSON;
+    if (options->check) flags |= REQUEST_FLAG_CHECK;
+    if (options->codegen.heapStrings) flags |= REQUEST_FLAG_NO_ESCAPE_ANALYSIS;
+    if (options->codegen.noTailCalls) flags |= REQUEST_FLAG_NO_TAIL_CALLS;
+    if (options->codegen.noVectorize) flags |= REQUEST_FLAG_NO_VECTORIZE;
+    if (options->noConstantCalls) flags |= REQUEST_FLAG_NO_CONSTANT_CALLS;
+    if (options->codegen.profileGenerate) flags |= REQUEST_FLAG_PROFILE_GENERATE;
+
+    static const RequestOption pathOptions[] = {
+        REQUEST_OPTION_STATS_OUTPUT, REQUEST_OPTION_EMIT_AST, REQUEST_OPTION_EMIT_OBJECT,
+        REQUEST_OPTION_EMIT_ASSEMBLY, REQUEST_OPTION_EMIT_INTERFACE, REQUEST_OPTION_PROFILE_USE,
+        REQUEST_OPTION_MODULE_PATH,
+    };
+    const char* fields[REQUEST_OPTION_COUNT] = {NULL};
+    fields[REQUEST_OPTION_STATS_OUTPUT] = options->statsPath;
+    fields[REQUEST_OPTION_EMIT_AST] = options->emitASTPath;
+    fields[REQUEST_OPTION_EMIT_OBJECT] = options->emitObjectPath;
+    fields[REQUEST_OPTION_EMIT_ASSEMBLY] = options->emitAssemblyPath;
+    fields[REQUEST_OPTION_EMIT_INTERFACE] = options->emitInterfacePath;
+    fields[REQUEST_OPTION_PROFILE_USE] = options->profileUsePath;
+    fields[REQUEST_OPTION_MODULE_PATH] = options->modulePath;
+    // As for a local --file, interfaces are looked for next to the source
+    char sourceDirectory[PATH_MAX];
+    if (!options->modulePath) {
+        const char* slash = strrchr(absolute, '/');
+        snprintf(sourceDirectory, sizeof(sourceDirectory), "%.*s", slash == absolute ? 1 : (int)(slash - absolute),
+                 absolute);
+        fields[REQUEST_OPTION_MODULE_PATH] = sourceDirectory;
+    }
+    fields[REQUEST_OPTION_MODULE_NAME] = options->codegen.moduleName;
+    char resolved[sizeof(pathOptions) / sizeof(pathOptions[0])][PATH_MAX];
+    for (size_t i = 0; i < sizeof(pathOptions) / sizeof(pathOptions[0]); i++) {
+        RequestOption option = pathOptions[i];
+        const char* value = fields[option];
+        fields[option] = clientPath(value, option == REQUEST_OPTION_MODULE_PATH, directory, resolved[i],
+                                    sizeof(resolved[i]));
+        if (value && !fields[option]) {
+            fprintf(stderr, "Error: Path '%s' is too long.\n", value);
+            return 1;
+        }
+    }
+    char lexBytes[32];
+    if (options->parallelLexBytes) {
+        snprintf(lexBytes, sizeof(lexBytes), "%zu", options->parallelLexBytes);
+        fields[REQUEST_OPTION_PARALLEL_LEX_BYTES] = lexBytes;
+    }
+
+    DaemonResponse response;
+    if (!daemonRequest(socketPath, REQUEST_COMPILE, flags, absolute, fields, &response)) {
+        fprintf(stderr, "Error: No compilation server on '%s'.\n", socketPath);
+        return 1;
+    }
+    fwrite(response.out, 1, response.outLength, stdout);
+    fwrite(response.err, 1, response.errLength, stderr);
+    int exitCode = response.exitCode;
+    freeDaemonResponse(&response);
+    return exitCode;
+}
+
+#else
+
+void defaultSocketPath(char* buffer, size_t size) {
+    snprintf(buffer, size, "my_compiler.sock");
+}
+
+int runDaemon(const char* socketPath, int workers) {
+    (void)socketPath;
+    (void)workers;
+    fprintf(stderr, "Error: The compilation server needs Unix domain sockets.\n");
+    return 1;
+}
+
+bool daemonRequest(const char* socketPath, RequestKind kind, unsigned flags, const char* path,
+                   const char* const* options, DaemonResponse* response) {
+    (void)socketPath;
+    (void)kind;
+    (void)flags;
+    (void)path;
+    (void)options;
+    memset(response, 0, sizeof(DaemonResponse));
+    return false;
+}
+
+int runClient(const char* socketPath, const char* path, const CompileOptions* options) {
+    (void)socketPath;
+    (void)path;
+    (void)options;
+    fprintf(stderr, "Error: The compilation server needs Unix domain sockets.\n");
+    return 1;
+}
+
+#endif
+
+void freeDaemonResponse(DaemonResponse* response) {
+    free(response->out);
+    free(response->err);
+    response->out = NULL;
+    response->err = NULL;
+}
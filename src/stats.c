@@ -0,0 +1,156 @@
+#include "stats.h"
+#include "compat.h"
+#include <string.h>
+#include <time.h>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+THREAD_LOCAL CompilerStats compilerStats = {.peakRSSKilobytes = -1};
+
+static THREAD_LOCAL double phaseWallStart[PHASE_COUNT];
+static THREAD_LOCAL double phaseCPUStart[PHASE_COUNT];
+
+static const char* const phaseNames[PHASE_COUNT] = {
+    [PHASE_LEX] = "lex",
+    [PHASE_PARSE] = "parse",
+    [PHASE_SEMANTIC] = "semantic",
+    [PHASE_CODEGEN] = "codegen",
+};
+
+static const char* const phaseItemNames[PHASE_COUNT] = {
+    [PHASE_LEX] = "tokens",
+    [PHASE_PARSE] = "nodes",
+    [PHASE_SEMANTIC] = "nodes",
+    [PHASE_CODEGEN] = "bytes",
+};
+
+static const char* const subsystemNames[MEM_SUBSYSTEM_COUNT] = {
+    [MEM_AST] = "ast",
+    [MEM_SYMBOLS] = "symbols",
+    [MEM_STRINGS] = "strings",
+};
+
+double wallClock() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// CPU time of the calling thread only: the daemon and batch builds run
+// several compilations in one process at once
+static double threadCPUClock() {
+#ifdef CLOCK_THREAD_CPUTIME_ID
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0) return (double)ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+    return (double)clock() / CLOCKS_PER_SEC;
+}
+
+static long peakRSS() {
+#ifndef _WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+        return usage.ru_maxrss / 1024; // Reported in bytes on macOS
+#else
+        return usage.ru_maxrss;
+#endif
+    }
+#endif
+    return -1;
+}
+
+void resetStats() {
+    memset(&compilerStats, 0, sizeof(CompilerStats));
+    compilerStats.peakRSSKilobytes = -1;
+}
+
+void beginPhase(CompilerPhase phase) {
+    phaseCPUStart[phase] = threadCPUClock();
+    phaseWallStart[phase] = wallClock();
+}
+
+void endPhase(CompilerPhase phase, unsigned long long items) {
+    PhaseStats* stats = &compilerStats.phases[phase];
+    stats->wallSeconds += wallClock() - phaseWallStart[phase];
+    stats->cpuSeconds += threadCPUClock() - phaseCPUStart[phase];
+    stats->items += items;
+    stats->ran = true;
+    compilerStats.peakRSSKilobytes = peakRSS();
+}
+
+void nestPhase(CompilerPhase inner, CompilerPhase outer) {
+    PhaseStats* nested = &compilerStats.phases[inner];
+    PhaseStats* stats = &compilerStats.phases[outer];
+    double share = stats->wallSeconds > 0 ? nested->wallSeconds / stats->wallSeconds : 0.0;
+    if (share > 1.0) share = 1.0;
+    nested->cpuSeconds = stats->cpuSeconds * share;
+    nested->cpuEstimated = true;
+    nested->ran = true;
+    stats->wallSeconds -= stats->wallSeconds * share;
+    stats->cpuSeconds -= nested->cpuSeconds;
+}
+
+static double rate(const PhaseStats* stats) {
+    return stats->wallSeconds > 0 ? stats->items / stats->wallSeconds : 0.0;
+}
+
+void printStatsText(FILE* out) {
+    double totalWall = 0, totalCPU = 0;
+    bool estimated = false;
+
+    fprintf(out, "=== Compiler statistics (%zu source bytes) ===\n", compilerStats.sourceBytes);
+    fprintf(out, "%-10s %12s %12s %14s %16s\n", "phase", "wall (ms)", "cpu (ms)", "items", "items/s");
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        const PhaseStats* stats = &compilerStats.phases[i];
+        if (!stats->ran) continue;
+        totalWall += stats->wallSeconds;
+        totalCPU += stats->cpuSeconds;
+        estimated = estimated || stats->cpuEstimated;
+        char cpu[32];
+        snprintf(cpu, sizeof(cpu), "%s%.3f", stats->cpuEstimated ? "~" : "", stats->cpuSeconds * 1e3);
+        fprintf(out, "%-10s %12.3f %12s %8llu %-5s %16.0f\n", phaseNames[i],
+                stats->wallSeconds * 1e3, cpu, stats->items, phaseItemNames[i], rate(stats));
+    }
+    fprintf(out, "%-10s %12.3f %12.3f\n", "total", totalWall * 1e3, totalCPU * 1e3);
+    if (estimated) fprintf(out, "~ estimated: the share of its enclosing phase's CPU time\n");
+
+    fprintf(out, "\n%-10s %12s %14s\n", "memory", "allocs", "bytes");
+    for (int i = 0; i < MEM_SUBSYSTEM_COUNT; i++) {
+        fprintf(out, "%-10s %12llu %14llu\n", subsystemNames[i],
+                compilerStats.allocs[i].count, compilerStats.allocs[i].bytes);
+    }
+    if (compilerStats.peakRSSKilobytes >= 0) {
+        fprintf(out, "peak RSS:  %ld KB\n", compilerStats.peakRSSKilobytes);
+    }
+    if (compilerStats.arithmeticOperations > 0) {
+        fprintf(out, "vectorized: %llu of %llu int +/- operations (%.1f%%)\n", compilerStats.vectorizedOperations,
+                compilerStats.arithmeticOperations,
+                100.0 * compilerStats.vectorizedOperations / compilerStats.arithmeticOperations);
+    }
+}
+
+void printStatsJSON(FILE* out) {
+    fprintf(out, "{\n  \"source_bytes\": %zu,\n  \"phases\": {", compilerStats.sourceBytes);
+    bool first = true;
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        const PhaseStats* stats = &compilerStats.phases[i];
+        if (!stats->ran) continue;
+        fprintf(out, "%s\n    \"%s\": {\"wall_ms\": %.3f, \"cpu_ms\": %.3f, \"cpu_estimated\": %s, \"%s\": %llu, "
+                "\"%s_per_sec\": %.0f}",
+                first ? "" : ",", phaseNames[i], stats->wallSeconds * 1e3, stats->cpuSeconds * 1e3,
+                stats->cpuEstimated ? "true" : "false", phaseItemNames[i], stats->items, phaseItemNames[i],
+                rate(stats));
+        first = false;
+    }
+    fprintf(out, "\n  },\n  \"memory\": {");
+    for (int i = 0; i < MEM_SUBSYSTEM_COUNT; i++) {
+        fprintf(out, "%s\n    \"%s\": {\"allocs\": %llu, \"bytes\": %llu}", i ? "," : "",
+                subsystemNames[i], compilerStats.allocs[i].count, compilerStats.allocs[i].bytes);
+    }
+    fprintf(out, "\n  },\n  \"peak_rss_kb\": %ld,\n", compilerStats.peakRSSKilobytes);
+    fprintf(out, "  \"arithmetic_operations\": %llu,\n  \"vectorized_operations\": %llu\n}\n",
+            compilerStats.arithmeticOperations, compilerStats.vectorizedOperations);
+}
@@ -0,0 +1,97 @@
+#include "string_pool.h"
+#include "stats.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_BUCKETS 64
+
+uint32_t hashString(const char* s, size_t length) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)s[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+void initStringPool(StringPool* pool) {
+    memset(pool, 0, sizeof(StringPool));
+}
+
+void freeStringPool(StringPool* pool) {
+    for (uint32_t i = 0; i < pool->count; i++) {
+        free(pool->strings[i]);
+    }
+    free(pool->strings);
+    free(pool->lengths);
+    free(pool->buckets);
+    initStringPool(pool);
+}
+
+static void growBuckets(StringPool* pool) {
+    uint32_t newCount = pool->bucketCount ? pool->bucketCount * 2 : INITIAL_BUCKETS;
+    uint32_t* buckets = (uint32_t*)calloc(newCount, sizeof(uint32_t));
+    for (uint32_t id = 0; id < pool->count; id++) {
+        uint32_t slot = hashString(pool->strings[id], pool->lengths[id]) & (newCount - 1);
+        while (buckets[slot]) slot = (slot + 1) & (newCount - 1);
+        buckets[slot] = id + 1;
+    }
+    free(pool->buckets);
+    pool->buckets = buckets;
+    pool->bucketCount = newCount;
+}
+
+uint32_t internString(StringPool* pool, const char* s, size_t length) {
+    // Keep the load factor under 1/2
+    if ((pool->count + 1) * 2 > pool->bucketCount) growBuckets(pool);
+
+    uint32_t mask = pool->bucketCount - 1;
+    uint32_t slot = hashString(s, length) & mask;
+    while (pool->buckets[slot]) {
+        uint32_t id = pool->buckets[slot] - 1;
+        if (pool->lengths[id] == length && memcmp(pool->strings[id], s, length) == 0) {
+            return id;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    if (pool->count == pool->capacity) {
+        pool->capacity = pool->capacity ? pool->capacity * 2 : 16;
+        pool->strings = (char**)realloc(pool->strings, pool->capacity * sizeof(char*));
+        pool->lengths = (uint32_t*)realloc(pool->lengths, pool->capacity * sizeof(uint32_t));
+    }
+
+    uint32_t id = pool->count++;
+    char* copy = (char*)malloc(length + 1);
+    STATS_ALLOC(MEM_STRINGS, length + 1);
+    memcpy(copy, s, length);
+    copy[length] = '\0';
+    pool->strings[id] = copy;
+    pool->lengths[id] = (uint32_t)length;
+    pool->totalBytes += length;
+    pool->buckets[slot] = id + 1;
+    return id;
+}
+
+uint32_t findString(const StringPool* pool, const char* s, size_t length) {
+    if (!pool->bucketCount) return STRING_NOT_FOUND;
+    uint32_t mask = pool->bucketCount - 1;
+    uint32_t slot = hashString(s, length) & mask;
+    while (pool->buckets[slot]) {
+        uint32_t id = pool->buckets[slot] - 1;
+        if (pool->lengths[id] == length && memcmp(pool->strings[id], s, length) == 0) {
+            return id;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return STRING_NOT_FOUND;
+}
+
+const char* poolString(const StringPool* pool, uint32_t id) {
+    return id < pool->count ? pool->strings[id] : NULL;
+}
+
+uint32_t poolStringLength(const StringPool* pool, uint32_t id) {
+    return id < pool->count ? pool->lengths[id] : 0;
+}
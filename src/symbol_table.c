@@ -1,10 +1,14 @@
 #include "symbol_table.h"
+#include "compat.h"
+#include "debug.h"
+#include "stats.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 
 SymbolTable* createSymbolTable(SymbolTable *parent) {
     SymbolTable *table = (SymbolTable *)malloc(sizeof(SymbolTable));
+    STATS_ALLOC(MEM_SYMBOLS, sizeof(SymbolTable));
     table->head = NULL;
     table->parent = parent;
     return table;
@@ -14,24 +18,26 @@ void addSymbol(SymbolTable *table, const char *name, const char *type) {
     Symbol *sym = (Symbol *)malloc(sizeof(Symbol));
     sym->name = _strdup(name);
     sym->type = _strdup(type);
+    STATS_ALLOC(MEM_SYMBOLS, sizeof(Symbol));
+    STATS_ALLOC(MEM_STRINGS, strlen(name) + strlen(type) + 2);
     sym->next = table->head;
     table->head = sym;
-    printf("Added symbol: %s\n", name); // Debugging
+    TRACE("Added symbol: %s\n", name); // Debugging
 }
 
 Symbol* lookupSymbol(SymbolTable *table, const char *name) {
-    printf("lookupSymbol: Looking for %s\n", name); // Debugging
+    TRACE("lookupSymbol: Looking for %s\n", name); // Debugging
     while (table) {
         for (Symbol *sym = table->head; sym != NULL; sym = sym->next) {
-            printf("Checking symbol: %s\n", sym->name); // Debugging
+            TRACE("Checking symbol: %s\n", sym->name); // Debugging
             if (strcmp(sym->name, name) == 0) {
-                printf("Symbol found: %s\n", sym->name); // Debugging
+                TRACE("Symbol found: %s\n", sym->name); // Debugging
                 return sym;
             }
         }
         table = table->parent;
     }
-    printf("Symbol not found: %s\n", name); // Debugging
+    TRACE("Symbol not found: %s\n", name); // Debugging
     return NULL;
 }
 
@@ -0,0 +1,125 @@
+#include "thread_pool.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <threads.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+typedef struct Task {
+    TaskFunction function;
+    void* arg;
+    struct Task* next;
+} Task;
+
+struct ThreadPool {
+    thrd_t* threads;
+    int workerCount;
+    Task* head;
+    Task* tail;
+    int pending;            // Queued plus running tasks
+    bool stopping;
+    mtx_t lock;
+    cnd_t taskAvailable;
+    cnd_t allDone;
+};
+
+static int workerMain(void* arg) {
+    ThreadPool* pool = (ThreadPool*)arg;
+    for (;;) {
+        mtx_lock(&pool->lock);
+        while (!pool->head && !pool->stopping) {
+            cnd_wait(&pool->taskAvailable, &pool->lock);
+        }
+        if (!pool->head) {
+            mtx_unlock(&pool->lock);
+            return 0;
+        }
+        Task* task = pool->head;
+        pool->head = task->next;
+        if (!pool->head) pool->tail = NULL;
+        mtx_unlock(&pool->lock);
+
+        task->function(task->arg);
+        free(task);
+
+        mtx_lock(&pool->lock);
+        if (--pool->pending == 0) cnd_broadcast(&pool->allDone);
+        mtx_unlock(&pool->lock);
+    }
+}
+
+int hardwareThreadCount() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+#endif
+}
+
+ThreadPool* createThreadPool(int workers) {
+    if (workers < 1) workers = hardwareThreadCount();
+
+    ThreadPool* pool = (ThreadPool*)calloc(1, sizeof(ThreadPool));
+    pool->threads = (thrd_t*)malloc(workers * sizeof(thrd_t));
+    mtx_init(&pool->lock, mtx_plain);
+    cnd_init(&pool->taskAvailable);
+    cnd_init(&pool->allDone);
+    for (int i = 0; i < workers; i++) {
+        if (thrd_create(&pool->threads[i], workerMain, pool) != thrd_success) break;
+        pool->workerCount++;
+    }
+    return pool;
+}
+
+void submitTask(ThreadPool* pool, TaskFunction function, void* arg) {
+    Task* task = (Task*)malloc(sizeof(Task));
+    task->function = function;
+    task->arg = arg;
+    task->next = NULL;
+
+    mtx_lock(&pool->lock);
+    if (pool->tail) {
+        pool->tail->next = task;
+    } else {
+        pool->head = task;
+    }
+    pool->tail = task;
+    pool->pending++;
+    cnd_signal(&pool->taskAvailable);
+    mtx_unlock(&pool->lock);
+}
+
+void waitThreadPool(ThreadPool* pool) {
+    mtx_lock(&pool->lock);
+    while (pool->pending > 0) {
+        cnd_wait(&pool->allDone, &pool->lock);
+    }
+    mtx_unlock(&pool->lock);
+}
+
+void destroyThreadPool(ThreadPool* pool) {
+    mtx_lock(&pool->lock);
+    pool->stopping = true;
+    cnd_broadcast(&pool->taskAvailable);
+    mtx_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->workerCount; i++) {
+        thrd_join(pool->threads[i], NULL);
+    }
+    mtx_destroy(&pool->lock);
+    cnd_destroy(&pool->taskAvailable);
+    cnd_destroy(&pool->allDone);
+    free(pool->threads);
+    free(pool);
+}
+
+int threadPoolSize(const ThreadPool* pool) {
+    return pool->workerCount;
+}
@@ -0,0 +1,233 @@
+#include <stdlib.h>
+#include <string.h>
+#include "test_framework.h"
+#include "lexer.h"
+#include "parser.h"
+#include "ast.h"
+#include "ast_serialize.h"
+
+static int stringsEqual(const char* a, const char* b) {
+    if (!a || !b) return a == b;
+    return strcmp(a, b) == 0;
+}
+
+// Structural comparison of two trees, including `next` chains
+static int astEqual(const ASTNode* a, const ASTNode* b) {
+    for (; a && b; a = a->next, b = b->next) {
+        if (a->type != b->type) return 0;
+        switch (a->type) {
+            case AST_VAR_DECL:
+                if (!stringsEqual(a->data.varDecl.varType, b->data.varDecl.varType) ||
+                    !stringsEqual(a->data.varDecl.name, b->data.varDecl.name) ||
+                    !astEqual(a->data.varDecl.initializer, b->data.varDecl.initializer)) return 0;
+                break;
+            case AST_FUNC_DECL:
+                if (!stringsEqual(a->data.funcDecl.returnType, b->data.funcDecl.returnType) ||
+                    !stringsEqual(a->data.funcDecl.name, b->data.funcDecl.name) ||
+                    !astEqual(a->data.funcDecl.params, b->data.funcDecl.params) ||
+                    !astEqual(a->data.funcDecl.body, b->data.funcDecl.body)) return 0;
+                break;
+            case AST_PARAM:
+                if (!stringsEqual(a->data.param.paramType, b->data.param.paramType) ||
+                    !stringsEqual(a->data.param.name, b->data.param.name)) return 0;
+                break;
+            case AST_BLOCK:
+                if (!astEqual(a->data.block.declarations, b->data.block.declarations)) return 0;
+                break;
+            case AST_EXPR_STMT:
+                if (!astEqual(a->data.exprStmt.expression, b->data.exprStmt.expression)) return 0;
+                break;
+            case AST_BINARY_EXPR:
+                if (a->operator != b->operator ||
+                    !astEqual(a->data.binaryExpr.left, b->data.binaryExpr.left) ||
+                    !astEqual(a->data.binaryExpr.right, b->data.binaryExpr.right)) return 0;
+                break;
+            case AST_LITERAL:
+                if (!stringsEqual(a->data.literal.value, b->data.literal.value)) return 0;
+                break;
+            case AST_IDENTIFIER:
+                if (!stringsEqual(a->data.identifier.name, b->data.identifier.name)) return 0;
+                break;
+            case AST_CALL_EXPR:
+                if (!stringsEqual(a->data.callExpr.callee, b->data.callExpr.callee) ||
+                    !astEqual(a->data.callExpr.arguments, b->data.callExpr.arguments)) return 0;
+                break;
+            case AST_RETURN_STMT:
+                if (!astEqual(a->data.returnStmt.value, b->data.returnStmt.value)) return 0;
+                break;
+        }
+    }
+    return a == b;
+}
+
+static const char* program =
+    "int x = 10;\n"
+    "int add(int a, int b) { return a + b; }\n"
+    "int y = x * 2 - 1;\n"
+    "x + y;";
+
+void test_round_trip() {
+    initLexer(program);
+    ASTNode* ast = parse();
+
+    ASTBuffer buffer;
+    ASSERT_EQ(1, serializeAST(ast, &buffer, stderr));
+
+    ASTView view;
+    ASSERT_EQ(1, openASTView(&view, buffer.data, buffer.size, stderr));
+    ASTNode* loaded = materializeAST(&view);
+    ASSERT_EQ(1, astEqual(ast, loaded));
+
+    freeAST(loaded);
+    freeASTBuffer(&buffer);
+    freeAST(ast);
+}
+
+void test_zero_copy_view() {
+    initLexer(program);
+    ASTNode* ast = parse();
+
+    ASTBuffer buffer;
+    ASSERT_EQ(1, serializeAST(ast, &buffer, stderr));
+    ASTView view;
+    ASSERT_EQ(1, openASTView(&view, buffer.data, buffer.size, stderr));
+
+    ASTRef root = astViewRoot(&view);
+    ASSERT_EQ(AST_BLOCK, astViewKind(&view, root));
+
+    ASTRef decl = astViewChild(&view, root, 0);
+    ASSERT_EQ(AST_VAR_DECL, astViewKind(&view, decl));
+    const char* name = astViewString(&view, decl, 1);
+    ASSERT_STR_EQ("x", name);
+    // Strings are served straight out of the buffer
+    ASSERT_EQ(1, (const uint8_t*)name > buffer.data && (const uint8_t*)name < buffer.data + buffer.size);
+
+    ASTRef func = astViewNext(&view, decl);
+    ASSERT_EQ(AST_FUNC_DECL, astViewKind(&view, func));
+    ASSERT_STR_EQ("add", astViewString(&view, func, 1));
+    ASTRef params = astViewChild(&view, func, 0);
+    ASSERT_STR_EQ("b", astViewString(&view, astViewNext(&view, params), 1));
+
+    ASTRef exprStmt = astViewNext(&view, astViewNext(&view, func));
+    ASSERT_EQ(AST_EXPR_STMT, astViewKind(&view, exprStmt));
+    ASTRef binary = astViewChild(&view, exprStmt, 0);
+    ASSERT_EQ(TOKEN_PLUS, astViewOperator(&view, binary));
+    ASSERT_EQ(AST_REF_NULL, astViewNext(&view, exprStmt));
+
+    // "x" is interned once although it appears three times
+    ASSERT_EQ(1, view.stringCount < view.nodeCount);
+
+    freeASTBuffer(&buffer);
+    freeAST(ast);
+}
+
+void test_file_round_trip() {
+    const char* path = "test_ast_serialize.cpya";
+    initLexer(program);
+    ASTNode* ast = parse();
+    ASSERT_EQ(1, writeASTFile(ast, path, stderr));
+
+    ASTView view;
+    ASSERT_EQ(1, mapASTFile(path, &view, stderr));
+    ASTNode* loaded = materializeAST(&view);
+    ASSERT_EQ(1, astEqual(ast, loaded));
+
+    closeASTView(&view);
+    remove(path);
+    freeAST(loaded);
+    freeAST(ast);
+}
+
+void test_rejects_bad_input() {
+    ASTView view;
+    FILE* sink = tmpfile();
+    const char garbage[64] = "not an ast";
+    ASSERT_EQ(0, openASTView(&view, garbage, sizeof(garbage), sink));
+
+    initLexer("int x = 1;");
+    ASTNode* ast = parse();
+    ASTBuffer buffer;
+    ASSERT_EQ(1, serializeAST(ast, &buffer, stderr));
+
+    buffer.data[4] = AST_FORMAT_VERSION + 1;
+    ASSERT_EQ(0, openASTView(&view, buffer.data, buffer.size, sink));
+    buffer.data[4] = AST_FORMAT_VERSION;
+    ASSERT_EQ(0, openASTView(&view, buffer.data, buffer.size - 1, sink));
+    freeASTBuffer(&buffer);
+    freeAST(ast);
+
+    // Every single-byte change to the node section either still opens as
+    // a tree that materializes or is rejected; kinds past the table, a lazy
+    // body and references to anything but an unclaimed earlier record are
+    // among the rejections
+    initLexer("int add(int a, int b) { return a + b; }\nint y = add(1, 2) * 3;");
+    ast = parse();
+    ASSERT_EQ(1, serializeAST(ast, &buffer, stderr));
+    size_t nodes = AST_FORMAT_HEADER_SIZE;
+    ASSERT_EQ(1, openASTView(&view, buffer.data, buffer.size, stderr));
+    size_t nodeEnd = nodes + view.nodeSectionSize;
+    int rejected = 0;
+    for (size_t offset = nodes; offset < nodeEnd; offset++) {
+        const uint8_t values[] = {0x00, 0x01, 0x0b, 0x7f, 0x80, 0xff};
+        uint8_t original = buffer.data[offset];
+        for (size_t i = 0; i < sizeof(values); i++) {
+            buffer.data[offset] = values[i];
+            if (openASTView(&view, buffer.data, buffer.size, sink)) {
+                freeAST(materializeAST(&view));
+            } else {
+                rejected++;
+            }
+        }
+        buffer.data[offset] = original;
+    }
+    ASSERT_EQ(1, rejected > 0);
+    buffer.data[nodes] = AST_LAZY_BODY;
+    ASSERT_EQ(0, openASTView(&view, buffer.data, buffer.size, sink));
+    buffer.data[nodes] = 0xff;
+    ASSERT_EQ(0, openASTView(&view, buffer.data, buffer.size, sink));
+
+    freeASTBuffer(&buffer);
+    freeAST(ast);
+    fclose(sink);
+}
+
+// A million-term left-nested sum: neither writing nor loading may recurse.
+// astEqual() would, so the loaded tree is compared by serializing it again.
+void test_deep_round_trip() {
+    const int terms = 1000000;
+    char* source = (char*)malloc((size_t)terms * 4 + 16);
+    char* p = source + sprintf(source, "int x = 1");
+    for (int i = 1; i < terms; i++) p += sprintf(p, " + 1");
+    strcpy(p, ";");
+    initLexer(source);
+    ASTNode* ast = parse();
+    ASSERT_EQ(1, ast != NULL);
+
+    ASTBuffer buffer;
+    ASSERT_EQ(1, serializeAST(ast, &buffer, stderr));
+    ASTView view;
+    ASSERT_EQ(1, openASTView(&view, buffer.data, buffer.size, stderr));
+    ASSERT_EQ((uint32_t)(2 * terms + 1), view.nodeCount);   // Block, declaration, terms and operators
+    ASTNode* loaded = materializeAST(&view);
+
+    ASTBuffer again;
+    ASSERT_EQ(1, serializeAST(loaded, &again, stderr));
+    ASSERT_EQ(buffer.size, again.size);
+    ASSERT_EQ(0, memcmp(buffer.data, again.data, buffer.size));
+
+    freeASTBuffer(&again);
+    freeASTBuffer(&buffer);
+    freeAST(loaded);
+    freeAST(ast);
+    free(source);
+}
+
+int main() {
+    RUN_TEST(test_round_trip);
+    RUN_TEST(test_zero_copy_view);
+    RUN_TEST(test_file_round_trip);
+    RUN_TEST(test_rejects_bad_input);
+    RUN_TEST(test_deep_round_trip);
+    printf("All AST serialization tests passed.\n");
+    return 0;
+}
@@ -0,0 +1,175 @@
+#include <string.h>
+#include "test_framework.h"
+#include "lexer.h"
+#include "ast.h"
+#include "ast_visitor.h"
+#include "compat.h"
+
+static ASTNode* identifier(const char* name) {
+    ASTNode* node = newASTNode(AST_IDENTIFIER);
+    node->data.identifier.name = _strdup(name);
+    return node;
+}
+
+static ASTNode* literal(const char* value) {
+    ASTNode* node = newASTNode(AST_LITERAL);
+    node->data.literal.value = _strdup(value);
+    return node;
+}
+
+static ASTNode* binary(ASTNode* left, ASTNode* right) {
+    ASTNode* node = newASTNode(AST_BINARY_EXPR);
+    node->data.binaryExpr.left = left;
+    node->operator = TOKEN_PLUS;
+    node->data.binaryExpr.right = right;
+    return node;
+}
+
+static ASTNode* exprStmt(ASTNode* expression) {
+    ASTNode* node = newASTNode(AST_EXPR_STMT);
+    node->data.exprStmt.expression = expression;
+    return node;
+}
+
+typedef struct {
+    char trace[256];
+    int stopAfter;
+    int entered;
+} TraceContext;
+
+static const char* label(const ASTNode* node) {
+    switch (node->type) {
+        case AST_BLOCK: return "B";
+        case AST_VAR_DECL: return "V";
+        case AST_EXPR_STMT: return "S";
+        case AST_BINARY_EXPR: return "+";
+        case AST_IDENTIFIER: return node->data.identifier.name;
+        case AST_LITERAL: return node->data.literal.value;
+        default: return "?";
+    }
+}
+
+static VisitResult traceEnter(ASTNode* node, int depth, void* context) {
+    TraceContext* trace = (TraceContext*)context;
+    char item[32];
+    snprintf(item, sizeof(item), "<%s%d", label(node), depth);
+    strcat(trace->trace, item);
+    if (++trace->entered == trace->stopAfter) return VISIT_STOP;
+    return node->type == AST_VAR_DECL && trace->stopAfter < 0 ? VISIT_SKIP_CHILDREN : VISIT_CONTINUE;
+}
+
+static void traceLeave(ASTNode* node, int depth, void* context) {
+    TraceContext* trace = (TraceContext*)context;
+    char item[32];
+    snprintf(item, sizeof(item), ">%s%d", label(node), depth);
+    strcat(trace->trace, item);
+}
+
+// { int v = a + 1; b; }
+static ASTNode* sampleTree() {
+    ASTNode* decl = newASTNode(AST_VAR_DECL);
+    decl->data.varDecl.varType = _strdup("int");
+    decl->data.varDecl.name = _strdup("v");
+    decl->data.varDecl.initializer = binary(identifier("a"), literal("1"));
+    decl->next = exprStmt(identifier("b"));
+
+    ASTNode* block = newASTNode(AST_BLOCK);
+    block->data.block.declarations = decl;
+    return block;
+}
+
+void test_pre_and_post_order() {
+    ASTNode* tree = sampleTree();
+    TraceContext trace = {"", 0, 0};
+    ASTVisitor visitor = {traceEnter, traceLeave, &trace};
+
+    ASSERT_EQ(1, walkAST(tree, &visitor));
+    ASSERT_STR_EQ("<B0<V1<+2<a3>a3<13>13>+2>V1<S1<b2>b2>S1>B0", trace.trace);
+
+    freeAST(tree);
+}
+
+void test_skip_children() {
+    ASTNode* tree = sampleTree();
+    TraceContext trace = {"", -1, 0};
+    ASTVisitor visitor = {traceEnter, traceLeave, &trace};
+
+    ASSERT_EQ(1, walkAST(tree, &visitor));
+    ASSERT_STR_EQ("<B0<V1>V1<S1<b2>b2>S1>B0", trace.trace);
+
+    freeAST(tree);
+}
+
+void test_stop() {
+    ASTNode* tree = sampleTree();
+    TraceContext trace = {"", 3, 0};
+    ASTVisitor visitor = {traceEnter, traceLeave, &trace};
+
+    ASSERT_EQ(0, walkAST(tree, &visitor));
+    ASSERT_STR_EQ("<B0<V1<+2", trace.trace);
+
+    freeAST(tree);
+}
+
+void test_node_does_not_follow_siblings() {
+    ASTNode* first = exprStmt(identifier("a"));
+    first->next = exprStmt(identifier("b"));
+    TraceContext trace = {"", 0, 0};
+    ASTVisitor visitor = {traceEnter, NULL, &trace};
+
+    walkASTNode(first, &visitor);
+    ASSERT_STR_EQ("<S0<a1", trace.trace);
+
+    freeAST(first);
+}
+
+static VisitResult countNode(ASTNode* node, int depth, void* context) {
+    (void)node;
+    (void)depth;
+    (*(long*)context)++;
+    return VISIT_CONTINUE;
+}
+
+#define MILLION 1000000
+
+void test_million_statement_list() {
+    ASTNode* head = NULL;
+    for (int i = 0; i < MILLION; i++) {
+        ASTNode* statement = exprStmt(literal("0"));
+        statement->next = head;
+        head = statement;
+    }
+
+    long count = 0;
+    ASTVisitor visitor = {countNode, NULL, &count};
+    ASSERT_EQ(1, walkAST(head, &visitor));
+    ASSERT_EQ(2L * MILLION, count);
+
+    freeAST(head);
+}
+
+void test_million_deep_expression() {
+    // ((((x + 1) + 1) + 1) ...): one million levels of nesting
+    ASTNode* expression = identifier("x");
+    for (int i = 0; i < MILLION; i++) {
+        expression = binary(expression, literal("1"));
+    }
+
+    long count = 0;
+    ASTVisitor visitor = {countNode, NULL, &count};
+    ASSERT_EQ(1, walkAST(expression, &visitor));
+    ASSERT_EQ(2L * MILLION + 1, count);
+
+    freeAST(expression);
+}
+
+int main() {
+    RUN_TEST(test_pre_and_post_order);
+    RUN_TEST(test_skip_children);
+    RUN_TEST(test_stop);
+    RUN_TEST(test_node_does_not_follow_siblings);
+    RUN_TEST(test_million_statement_list);
+    RUN_TEST(test_million_deep_expression);
+    printf("All AST visitor tests passed.\n");
+    return 0;
+}
@@ -0,0 +1,182 @@
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include "test_framework.h"
+#include "async_io.h"
+#include "batch.h"
+#include "driver.h"
+
+static const char* batchDirectory = "test_batch_build";
+
+static void writeFile(const char* path, const char* contents) {
+    FILE* file = fopen(path, "w");
+    fputs(contents, file);
+    fclose(file);
+}
+
+// Reads in pieces and a write through either backend land like pread()/pwrite()
+static void checkAsyncIO(bool useRing) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/io.bin", batchDirectory);
+    char expected[3000];
+    for (size_t i = 0; i < sizeof(expected); i++) expected[i] = (char)('a' + i % 26);
+
+    AsyncIO* io = createAsyncIO(4, useRing);
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0666);
+    ASSERT_EQ(1, fd >= 0);
+    submitWrite(io, fd, expected, sizeof(expected), 0, expected);
+    IOCompletion completions[4];
+    ASSERT_EQ(1, (int)collectCompletions(io, completions, 4, true));
+    ASSERT_EQ((void*)expected, completions[0].context);
+    ASSERT_EQ((int64_t)sizeof(expected), completions[0].result);
+
+    char actual[3000];
+    for (int i = 0; i < 3; i++) submitRead(io, fd, actual + i * 1000, 1000, (uint64_t)i * 1000, actual + i * 1000);
+    ASSERT_EQ(3u, asyncIOInFlight(io));
+    size_t collected = 0;
+    while (collected < 3) {
+        size_t count = collectCompletions(io, completions, 4, true);
+        for (size_t i = 0; i < count; i++) ASSERT_EQ((int64_t)1000, completions[i].result);
+        collected += count;
+    }
+    ASSERT_EQ(0, memcmp(expected, actual, sizeof(expected)));
+    ASSERT_EQ(0u, asyncIOInFlight(io));
+
+    // Past the end nothing is read; a bad descriptor is an error
+    submitRead(io, fd, actual, 10, sizeof(expected), NULL);
+    submitRead(io, -1, actual, 10, 0, NULL);
+    collected = 0;
+    int64_t results[2];
+    while (collected < 2) collected += collectCompletions(io, completions + collected, 4, true);
+    results[0] = completions[0].result;
+    results[1] = completions[1].result;
+    ASSERT_EQ(1, (results[0] == 0 && results[1] < 0) || (results[1] == 0 && results[0] < 0));
+    close(fd);
+    destroyAsyncIO(io);
+}
+
+void test_async_io() {
+    char command[512];
+    snprintf(command, sizeof(command), "rm -rf %s && mkdir -p %s", batchDirectory, batchDirectory);
+    ASSERT_EQ(0, system(command));
+    checkAsyncIO(false);
+    AsyncIO* probe = createAsyncIO(1, true);
+    bool ring = asyncIOUsesRing(probe);
+    destroyAsyncIO(probe);
+    if (ring) checkAsyncIO(true);
+    else printf("io_uring is not available; only the fallback was tested.\n");
+}
+
+// More files than the batch keeps in flight, one that does not parse, one
+// that is missing and one with its own object path
+void test_batch_matches_single_compilations() {
+    char command[512];
+    snprintf(command, sizeof(command), "rm -rf %s && mkdir -p %s/src", batchDirectory, batchDirectory);
+    ASSERT_EQ(0, system(command));
+
+    char listPath[PATH_MAX], path[PATH_MAX], source[256];
+    snprintf(listPath, sizeof(listPath), "%s/files.txt", batchDirectory);
+    FILE* list = fopen(listPath, "w");
+    fprintf(list, "# generated\n\n");
+    const int files = 150;
+    for (int i = 0; i < files; i++) {
+        snprintf(path, sizeof(path), "%s/src/f%d.cpy", batchDirectory, i);
+        snprintf(source, sizeof(source), "int scale%d(int x) { return x * %d; }\nint v = scale%d(%d);\n", i, i, i, i);
+        writeFile(path, i == 7 ? "int broken = ;\n" : source);
+        if (i == 9) fprintf(list, "  %s %s/nine.o\n", path, batchDirectory);
+        else fprintf(list, "%s\n", path);
+    }
+    fprintf(list, "%s/src/missing.cpy\n", batchDirectory);
+    fclose(list);
+
+    for (int useRing = 0; useRing < 2; useRing++) {
+        char output[PATH_MAX];
+        snprintf(output, sizeof(output), "%s/out%d", batchDirectory, useRing);
+        BatchOptions options = {listPath, output, 2, !useRing, {0}};
+        BatchSummary summary;
+        FILE* out = fopen("/dev/null", "w");
+        FILE* err = tmpfile();
+        ASSERT_EQ(1, runBatch(&options, &summary, out, err));
+        fclose(out);
+        fclose(err);
+        ASSERT_EQ(files + 1, summary.files);
+        ASSERT_EQ(files - 1, summary.compiled);
+        ASSERT_EQ(2, summary.failed);
+
+        for (int i = 0; i < files; i++) {
+            if (i == 7) continue;
+            snprintf(path, sizeof(path), "%s/src/f%d.cpy", batchDirectory, i);
+            char reference[PATH_MAX], object[PATH_MAX];
+            snprintf(reference, sizeof(reference), "%s/reference.o", batchDirectory);
+            if (i == 9) snprintf(object, sizeof(object), "%s/nine.o", batchDirectory);
+            else ASSERT_EQ(1, snprintf(object, sizeof(object), "%s/f%d.o", output, i) < (int)sizeof(object));
+            CompileOptions compile = {0};
+            compile.emitObjectPath = reference;
+            char* text = readSourceFile(path, NULL);
+            ASSERT_EQ(0, compileSource(text, &compile, NULL, stderr));
+            free(text);
+
+            size_t expectedLength, actualLength;
+            char* expected = readSourceFile(reference, &expectedLength);
+            char* actual = readSourceFile(object, &actualLength);
+            ASSERT_EQ(1, actual != NULL);
+            ASSERT_EQ(expectedLength, actualLength);
+            ASSERT_EQ(0, memcmp(expected, actual, expectedLength));
+            free(expected);
+            free(actual);
+        }
+    }
+
+    snprintf(command, sizeof(command), "rm -rf %s", batchDirectory);
+    system(command);
+}
+
+// Sources with the same name in different directories would both write
+// <dir>/x.o; the list is rejected before anything is compiled
+void test_batch_rejects_shared_objects() {
+    char command[512];
+    snprintf(command, sizeof(command), "rm -rf %s && mkdir -p %s/a %s/b", batchDirectory, batchDirectory,
+             batchDirectory);
+    ASSERT_EQ(0, system(command));
+    char listPath[PATH_MAX], path[PATH_MAX];
+    snprintf(listPath, sizeof(listPath), "%s/files.txt", batchDirectory);
+    FILE* list = fopen(listPath, "w");
+    for (int i = 0; i < 2; i++) {
+        snprintf(path, sizeof(path), "%s/%c/x.cpy", batchDirectory, "ab"[i]);
+        writeFile(path, "int x = 1;\n");
+        fprintf(list, "%s\n", path);
+    }
+    fclose(list);
+
+    char output[PATH_MAX];
+    snprintf(output, sizeof(output), "%s/out", batchDirectory);
+    BatchOptions options = {listPath, output, 1, true, {0}};
+    FILE* err = tmpfile();
+    ASSERT_EQ(1, runBatch(&options, NULL, stdout, err));
+    rewind(err);
+    char message[PATH_MAX * 2];
+    ASSERT_EQ(1, fgets(message, sizeof(message), err) != NULL && strstr(message, "x.o") != NULL);
+    fclose(err);
+    ASSERT_EQ(1, snprintf(path, sizeof(path), "%s/x.o", output) < (int)sizeof(path));
+    ASSERT_EQ(0, access(path, F_OK) == 0);
+
+    // Naming one object explicitly resolves it
+    list = fopen(listPath, "w");
+    fprintf(list, "%s/a/x.cpy\n%s/b/x.cpy %s/bx.o\n", batchDirectory, batchDirectory, output);
+    fclose(list);
+    FILE* out = fopen("/dev/null", "w");
+    ASSERT_EQ(0, runBatch(&options, NULL, out, stderr));
+    fclose(out);
+
+    snprintf(command, sizeof(command), "rm -rf %s", batchDirectory);
+    system(command);
+}
+
+int main() {
+    RUN_TEST(test_async_io);
+    RUN_TEST(test_batch_matches_single_compilations);
+    RUN_TEST(test_batch_rejects_shared_objects);
+    printf("All batch tests passed.\n");
+    return 0;
+}
@@ -0,0 +1,584 @@
+#include <stdint.h>
+#include <string.h>
+#include "test_framework.h"
+#include "lexer.h"
+#include "parser.h"
+#include "ast.h"
+#include "codegen.h"
+#include "optimizer.h"
+#include "elf_writer.h"
+#include "string_pool.h"
+#include "stats.h"
+#include "compat.h"
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#endif
+
+// Minimal ELF64 reader for checking what writeELFObject produced
+typedef struct {
+    uint8_t* data;
+    size_t size;
+} Image;
+
+static uint64_t read64(const uint8_t* p) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) value = (value << 8) | p[i];
+    return value;
+}
+
+static uint32_t read32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t read16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static const uint8_t* sectionHeader(const Image* image, int index) {
+    return image->data + read64(image->data + 40) + 64 * (size_t)index;
+}
+
+static const char* sectionName(const Image* image, int index) {
+    const uint8_t* names = sectionHeader(image, read16(image->data + 62));
+    return (const char*)image->data + read64(names + 24) + read32(sectionHeader(image, index));
+}
+
+static int findSection(const Image* image, const char* name) {
+    for (int i = 0; i < read16(image->data + 60); i++) {
+        if (strcmp(sectionName(image, i), name) == 0) return i;
+    }
+    return -1;
+}
+
+// Returns the symbol's table entry, or NULL
+static const uint8_t* findSymbol(const Image* image, const char* name) {
+    const uint8_t* symtab = sectionHeader(image, findSection(image, ".symtab"));
+    const uint8_t* strtab = sectionHeader(image, (int)read32(symtab + 40));
+    const char* strings = (const char*)image->data + read64(strtab + 24);
+    for (uint64_t offset = 0; offset < read64(symtab + 32); offset += 24) {
+        const uint8_t* symbol = image->data + read64(symtab + 24) + offset;
+        if (strcmp(strings + read32(symbol), name) == 0) return symbol;
+    }
+    return NULL;
+}
+
+static ObjectFile compileProgram(const char* source, Image* image) {
+    initLexer(source);
+    ASTNode* ast = parse();
+    ObjectFile object;
+    initObjectFile(&object);
+    ASSERT_EQ(1, generateCode(ast, NULL, &object, NULL, stderr));
+    freeAST(ast);
+    ASSERT_EQ(1, writeELFObject(&object, &image->data, &image->size));
+    return object;
+}
+
+void test_elf_header_and_symbols() {
+    Image image;
+    ObjectFile object = compileProgram(
+        "int add(int a, int b) { return a + b; }\n"
+        "int twice(int x) { return add(x, x); }\n", &image);
+
+    ASSERT_EQ(0, memcmp(image.data, "\177ELF", 4));
+    ASSERT_EQ(2, image.data[4]);              // 64-bit
+    ASSERT_EQ(1, read16(image.data + 16));    // Relocatable
+    ASSERT_EQ(62, read16(image.data + 18));   // x86-64
+
+    const uint8_t* add = findSymbol(&image, "add");
+    const uint8_t* twice = findSymbol(&image, "twice");
+    ASSERT_EQ(1, add != NULL && twice != NULL);
+    ASSERT_EQ(0x12, add[4]);                  // GLOBAL FUNC
+    ASSERT_EQ(findSection(&image, ".text"), read16(add + 6));
+    ASSERT_EQ(1, read64(add + 16) > 0);       // Size
+    ASSERT_EQ(NULL, findSymbol(&image, MODULE_INIT_SYMBOL));
+
+    // twice -> add goes through a PLT32 relocation, resolved by the linker
+    int rela = findSection(&image, ".rela.text");
+    ASSERT_EQ(1, rela > 0);
+    const uint8_t* relocation = image.data + read64(sectionHeader(&image, rela) + 24);
+    ASSERT_EQ(RELOC_X86_64_PLT32, (uint32_t)read64(relocation + 8));
+    ASSERT_EQ(-4, (int64_t)read64(relocation + 16));
+
+    free(image.data);
+    freeObjectFile(&object);
+}
+
+void test_external_call_is_undefined() {
+    Image image;
+    ObjectFile object = compileProgram("int main() { return helper(1, 2); }", &image);
+
+    const uint8_t* helper = findSymbol(&image, "helper");
+    ASSERT_EQ(1, helper != NULL);
+    ASSERT_EQ(0x10, helper[4]);               // GLOBAL NOTYPE
+    ASSERT_EQ(0, read16(helper + 6));         // SHN_UNDEF
+
+    free(image.data);
+    freeObjectFile(&object);
+}
+
+void test_string_literals_are_pooled() {
+    Image image;
+    ObjectFile object = compileProgram("str s = \"hi\"; str t = \"hi\";", &image);
+    free(image.data);
+
+    // One header + "hi\0" for both uses
+    const SectionBuffer* rodata = &object.sections[SECTION_RODATA];
+    ASSERT_EQ(16 + 3, rodata->size);
+    ASSERT_EQ(2, read64(rodata->data));                           // Length
+    ASSERT_EQ(hashString("hi", 2), read32(rodata->data + 8));     // Hash
+    ASSERT_EQ(1, read32(rodata->data + 12));                      // Static
+    ASSERT_STR_EQ("hi", (const char*)rodata->data + 16);
+    ASSERT_EQ(16, object.sections[SECTION_BSS].size);
+
+    // Both leaq instructions address the same bytes, past the header
+    int loads = 0;
+    for (uint32_t i = 0; i < object.relocationCount; i++) {
+        const ObjectRelocation* relocation = &object.relocations[i];
+        if (object.symbols[relocation->symbol].kind != SYMBOL_SECTION) continue;
+        ASSERT_EQ(RELOC_X86_64_PC32, relocation->type);
+        ASSERT_EQ(16 - 4, relocation->addend);
+        loads++;
+    }
+    ASSERT_EQ(2, loads);
+
+    freeObjectFile(&object);
+}
+
+void test_string_type_errors() {
+    initLexer("int f() { return \"a\" * 2; } str g() { return 1; } int n = \"x\";");
+    ASTNode* ast = parse();
+    ObjectFile object;
+    initObjectFile(&object);
+    FILE* err = tmpfile();
+    ASSERT_EQ(0, generateCode(ast, NULL, &object, NULL, err));
+
+    char message[512] = "";
+    rewind(err);
+    size_t length = fread(message, 1, sizeof(message) - 1, err);
+    message[length] = '\0';
+    ASSERT_EQ(1, strstr(message, "not defined for str and int") != NULL);
+    ASSERT_EQ(1, strstr(message, "Return of int from a function returning str") != NULL);
+    ASSERT_EQ(1, strstr(message, "Variable 'n' expects int but got str") != NULL);
+
+    fclose(err);
+    freeAST(ast);
+    freeObjectFile(&object);
+}
+
+void test_reports_errors() {
+    initLexer("int f() { return missing; } int g(float x) { return 1; }");
+    ASTNode* ast = parse();
+    ObjectFile object;
+    initObjectFile(&object);
+    FILE* err = tmpfile();
+    ASSERT_EQ(0, generateCode(ast, NULL, &object, NULL, err));
+
+    char message[256] = "";
+    rewind(err);
+    size_t length = fread(message, 1, sizeof(message) - 1, err);
+    message[length] = '\0';
+    ASSERT_EQ(1, strstr(message, "Undeclared identifier 'missing'") != NULL);
+    ASSERT_EQ(1, strstr(message, "float") != NULL);
+
+    fclose(err);
+    freeAST(ast);
+    freeObjectFile(&object);
+}
+
+#ifndef _WIN32
+// Link the object with the system toolchain and run it
+void test_links_and_runs() {
+    if (system("cc --version > /dev/null 2>&1") != 0) {
+        printf("No system C compiler; skipping link test.\n");
+        return;
+    }
+
+    Image image;
+    ObjectFile object = compileProgram(
+        "int scale = 3 + 4;\n"
+        "int many(int a, int b, int c, int d, int e, int f, int g, int h) {\n"
+        "    return a - b + c - d + e - f + g * h;\n" // No precedence yet: (... + g) * h
+        "}\n"
+        "int fact(int n) { return n * step(n); }\n"
+        "int step(int n) { { int done = n - 1; return pick(done, done); } }\n"
+        "int pick(int n, int m) { return 0 * fact1(n) + n / (m + 1 - m); }\n"
+        "int fact1(int n) { return 0; }\n"
+        "int scaled(int x) { return x * scale; }\n"
+        "{ int t = scaled(1); t; }\n", &image);
+    free(image.data);
+
+    ASSERT_EQ(1, writeELFFile(&object, "test_codegen_output.o"));
+    freeObjectFile(&object);
+
+    FILE* harness = fopen("test_codegen_main.c", "w");
+    fputs("long many(long, long, long, long, long, long, long, long);\n"
+          "long fact(long); long scaled(long); long cpy_init(void);\n"
+          "extern long scale;\n"
+          "int main(void) {\n"
+          "    if (many(1, 2, 3, 4, 5, 6, 7, 8) != 32) return 1;\n"
+          "    if (fact(5) != 20) return 2;\n"
+          "    if (scale != 0 || cpy_init() != 0) return 3;\n"
+          "    if (scaled(6) != 6 * 7) return 4;\n"
+          "    return 0;\n"
+          "}\n", harness);
+    fclose(harness);
+
+    int status = system("cc -o test_codegen_program test_codegen_main.c test_codegen_output.o && ./test_codegen_program");
+    ASSERT_EQ(1, WIFEXITED(status));
+    ASSERT_EQ(0, WEXITSTATUS(status));
+
+    remove("test_codegen_output.o");
+    remove("test_codegen_main.c");
+    remove("test_codegen_program");
+}
+
+// Folded literals, run-time concatenation and the str builtins, linked
+// against the runtime library
+void test_strings_link_with_runtime() {
+    if (system("cc --version > /dev/null 2>&1") != 0) {
+        printf("No system C compiler; skipping link test.\n");
+        return;
+    }
+
+    initLexer("str greeting(str name) { return \"Hello, \" + name + \"!\" + \"\"; }\n"
+              "str folded() { return \"con\" + \"cat\" + \"enated\"; }\n"
+              "int size(str s) { return len(s); }\n"
+              "int same(str a, str b) { return equals(a, b); }\n"
+              "int literal() { return equals(\"cat\", \"cat\"); }\n");
+    ASTNode* ast = parse();
+    ASSERT_EQ(3, foldStringConstants(ast));
+    ObjectFile object;
+    initObjectFile(&object);
+    ASSERT_EQ(1, generateCode(ast, NULL, &object, NULL, stderr));
+    freeAST(ast);
+    ASSERT_EQ(1, writeELFFile(&object, "test_codegen_strings.o"));
+    freeObjectFile(&object);
+
+    FILE* harness = fopen("test_codegen_strings_main.c", "w");
+    fputs("#include <string.h>\n"
+          "#include \"cpy_runtime.h\"\n"
+          "cpy_str greeting(cpy_str); cpy_str folded(void);\n"
+          "long size(cpy_str); long same(cpy_str, cpy_str); long literal(void);\n"
+          "int main(void) {\n"
+          "    cpy_str name = cpy_str_new(\"world\", 5);\n"
+          "    cpy_str hello = greeting(name);\n"
+          "    if (strcmp(hello, \"Hello, world!\") != 0) return 1;\n"
+          "    if (size(hello) != 13 || cpy_str_header(hello)->hash != cpy_str_hash(hello, 13)) return 2;\n"
+          "    if (strcmp(folded(), \"concatenated\") != 0 || size(folded()) != 12) return 3;\n"
+          "    if (!(cpy_str_header(folded())->flags & CPY_STR_STATIC)) return 4;\n"
+          "    if (!same(hello, cpy_str_new(\"Hello, world!\", 13)) || same(hello, name)) return 5;\n"
+          "    if (literal() != 1) return 6;\n"
+          "    return 0;\n"
+          "}\n", harness);
+    fclose(harness);
+
+    int status = system("cc -I " CPY_RUNTIME_INCLUDE " -o test_codegen_strings test_codegen_strings_main.c "
+                        "test_codegen_strings.o " CPY_RUNTIME_LIBRARY " && ./test_codegen_strings");
+    ASSERT_EQ(1, WIFEXITED(status));
+    ASSERT_EQ(0, WEXITSTATUS(status));
+
+    remove("test_codegen_strings.o");
+    remove("test_codegen_strings_main.c");
+    remove("test_codegen_strings");
+}
+
+// Tail calls run in constant stack: the harness's check() records the
+// stack depth it is called at and ends the program after enough calls,
+// which would overflow the stack if each recursion kept its frame
+void test_tail_calls_run_in_constant_stack() {
+    if (system("cc --version > /dev/null 2>&1") != 0) {
+        printf("No system C compiler; skipping link test.\n");
+        return;
+    }
+
+    Image image;
+    ObjectFile object = compileProgram(
+        "int spin(int n) { check(n, n); return spin(n + 1); }\n"
+        "int ping(int n) { check(n, n); return pong(n + 1, 0); }\n"
+        "int pong(int n, int unused) { return ping(n); }\n"
+        "int rotate(int a, int b, int c, int d, int e, int f, int g, int h) {\n"
+        "    check(a, h - 7);\n"
+        "    return rotate(b, c, d, e, f, g, h, a + 8);\n"
+        "}\n"
+        "int wide(int a, int b, int c, int d, int e, int f, int g, int h) {\n"
+        "    return rotate(a, b, c, d, e, f, g, h);\n" // Stack arguments reuse ours
+        "}\n"
+        "int text(str s, int n) { check(n, n + len(s + s) - 600); return text(s, n + 1); }\n", &image);
+    free(image.data);
+    ASSERT_EQ(1, writeELFFile(&object, "test_codegen_tail.o"));
+    freeObjectFile(&object);
+
+    FILE* harness = fopen("test_codegen_tail_main.c", "w");
+    fputs("#include <stdlib.h>\n"
+          "#include <string.h>\n"
+          "#include \"cpy_runtime.h\"\n"
+          "long spin(long); long ping(long); long text(cpy_str, long);\n"
+          "long wide(long, long, long, long, long, long, long, long);\n"
+          "static char* depth;\n"
+          "static long calls;\n"
+          "long check(long value, long expected) {\n"
+          "    char here;\n"
+          "    if (value != expected) exit(10);\n"
+          "    if (!depth) depth = &here;\n"
+          "    if (&here != depth) exit(11);\n"
+          "    if (++calls == 1000000) exit(0);\n"
+          "    return 0;\n"
+          "}\n"
+          "int main(int argc, char** argv) {\n"
+          "    char text300[300];\n"
+          "    memset(text300, 'x', 300);\n"
+          "    switch (argv[1][0]) {\n"
+          "        case 's': return (int)spin(0);\n"
+          "        case 'p': return (int)ping(0);\n"
+          "        case 'w': return (int)wide(1, 2, 3, 4, 5, 6, 7, 8);\n"
+          "        case 't': return (int)text(cpy_str_new(text300, 300), 0);\n"
+          "    }\n"
+          "    return 12;\n"
+          "}\n", harness);
+    fclose(harness);
+
+    int status = system("cc -I " CPY_RUNTIME_INCLUDE " -o test_codegen_tail test_codegen_tail_main.c "
+                        "test_codegen_tail.o " CPY_RUNTIME_LIBRARY " && ./test_codegen_tail s && ./test_codegen_tail p"
+                        " && ./test_codegen_tail w && ./test_codegen_tail t");
+    ASSERT_EQ(1, WIFEXITED(status));
+    ASSERT_EQ(0, WEXITSTATUS(status));
+
+    remove("test_codegen_tail.o");
+    remove("test_codegen_tail_main.c");
+    remove("test_codegen_tail");
+}
+
+// Temporaries that do not escape go to the per-call region, spilling from
+// the inline buffer into chunks; only returned values reach the heap
+void test_non_escaping_strings_use_region() {
+    if (system("cc --version > /dev/null 2>&1") != 0) {
+        printf("No system C compiler; skipping link test.\n");
+        return;
+    }
+
+    initLexer("int measure(str a) { str t = a + a + a; return len(t + t) + len(a + \"!\"); }\n"
+              "str shout(str a) { str t = a + \"!\"; return t + t; }\n"
+              "int early(str a) { return len(a); len(a + a); }\n");
+    ASTNode* ast = parse();
+    ObjectFile object;
+    initObjectFile(&object);
+    ASSERT_EQ(1, generateCode(ast, NULL, &object, NULL, stderr));
+    freeAST(ast);
+    ASSERT_EQ(1, writeELFFile(&object, "test_codegen_region.o"));
+    freeObjectFile(&object);
+
+    FILE* harness = fopen("test_codegen_region_main.c", "w");
+    fputs("#include <string.h>\n"
+          "#include \"cpy_runtime.h\"\n"
+          "long measure(cpy_str); cpy_str shout(cpy_str); long early(cpy_str);\n"
+          "int main(void) {\n"
+          "    char text[201];\n"
+          "    memset(text, 'x', 200);\n"
+          "    cpy_str a = cpy_str_new(text, 200);\n"
+          "    cpy_reset_alloc_stats();\n"
+          "    if (measure(a) != 1200 + 201) return 1;\n"
+          "    const CpyAllocStats* stats = cpy_alloc_stats();\n"
+          "    if (stats->heapAllocations != 0 || stats->regionAllocations != 4) return 2;\n"
+          "    if (stats->regionChunks == 0) return 3;\n"  // 1200 bytes overflow the buffer
+          "    cpy_str s = shout(cpy_str_new(\"ab\", 2));\n"
+          "    if (strcmp(s, \"ab!ab!\") != 0 || !(cpy_str_header(s)->flags & CPY_STR_HEAP)) return 4;\n"
+          "    if (stats->heapAllocations != 2 || stats->regionAllocations != 5) return 5;\n"
+          "    if (early(s) != 6 || stats->regionAllocations != 5) return 6;\n"
+          "    return 0;\n"
+          "}\n", harness);
+    fclose(harness);
+
+    int status = system("cc -I " CPY_RUNTIME_INCLUDE " -o test_codegen_region test_codegen_region_main.c "
+                        "test_codegen_region.o " CPY_RUNTIME_LIBRARY " && ./test_codegen_region");
+    ASSERT_EQ(1, WIFEXITED(status));
+    ASSERT_EQ(0, WEXITSTATUS(status));
+
+    remove("test_codegen_region.o");
+    remove("test_codegen_region_main.c");
+    remove("test_codegen_region");
+}
+
+// An instrumented build writes its counts at exit. Rebuilt with them, the
+// function that never ran moves to .text.unlikely, and the program computes
+// the same result with hot calls inlined and hot variables in callee-saved
+// registers, which the -O2 harness relies on across calls.
+static const char* profiledSource =
+    "int square(int x) { return x * x; }\n"
+    "int never(int x) { return x - 1; }\n"
+    "int mix(int a, int b) { int s = a * b + square(a); return s + a + b + s; }\n"
+    "int hop(int a, int b) { int c = mix(a, b) + a; int d = c + c; return step(c, a + d, b + c + d); }\n"
+    "str tag(str s, int n) { str t = s + \"-\"; return t + t + s; }\n";
+
+static bool buildProfiled(const CodegenOptions* options, Image* image) {
+    initLexer(profiledSource);
+    ASTNode* ast = parse();
+    ObjectFile object;
+    initObjectFile(&object);
+    bool ok = generateCode(ast, options, &object, NULL, stderr) && writeELFFile(&object, "test_codegen_pgo.o") &&
+              writeELFObject(&object, &image->data, &image->size);
+    freeObjectFile(&object);
+    freeAST(ast);
+    return ok;
+}
+
+void test_profile_guided_build() {
+    if (system("cc --version > /dev/null 2>&1") != 0) {
+        printf("No system C compiler; skipping link test.\n");
+        return;
+    }
+
+    FILE* harness = fopen("test_codegen_pgo_main.c", "w");
+    fputs("#include <stdio.h>\n"
+          "#include <string.h>\n"
+          "#include \"cpy_runtime.h\"\n"
+          "long hop(long, long); long never(long); cpy_str tag(cpy_str, long);\n"
+          "long step(long c, long d, long b) { return c * 3 + d - b; }\n"
+          "int main(int argc, char** argv) {\n"
+          "    long total = 0;\n"
+          "    for (long i = 0; i < 1000; i++) total += hop(i, i % 7) ^ (total >> 3);\n"
+          "    if (argc > 2) total += never(1);\n"
+          "    if (strcmp(tag(cpy_str_new(\"ab\", 2), 0), \"ab-ab-ab\") != 0) return 1;\n"
+          "    FILE* out = fopen(argv[1], \"w\");\n"
+          "    fprintf(out, \"%ld\\n\", total);\n"
+          "    return fclose(out) != 0;\n"
+          "}\n", harness);
+    fclose(harness);
+
+    Image image;
+    CodegenOptions options = {0};
+    options.profileGenerate = true;
+    ASSERT_EQ(1, buildProfiled(&options, &image));
+    ASSERT_EQ(1, findSection(&image, "cpy_prof") > 0);
+    free(image.data);
+    remove("test_codegen_pgo.profile");
+    int status = system("cc -O2 -I " CPY_RUNTIME_INCLUDE " -o test_codegen_pgo test_codegen_pgo_main.c "
+                        "test_codegen_pgo.o " CPY_RUNTIME_LIBRARY " && CPY_PROFILE_FILE=test_codegen_pgo.profile "
+                        "./test_codegen_pgo test_codegen_pgo_instrumented.out");
+    ASSERT_EQ(1, WIFEXITED(status));
+    ASSERT_EQ(0, WEXITSTATUS(status));
+
+    Profile profile;
+    initProfile(&profile);
+    ASSERT_EQ(1, loadProfile(&profile, "test_codegen_pgo.profile", stderr));
+    ASSERT_EQ(1000, (int)profileFunctionCount(&profile, "hop"));
+    ASSERT_EQ(1000, (int)profileFunctionCount(&profile, "square"));
+    ASSERT_EQ(1000, (int)profileEdgeCount(&profile, "hop", 0, "mix"));
+    ASSERT_EQ(1000, (int)profileEdgeCount(&profile, "hop", 1, "step"));
+    ASSERT_EQ(0, (int)profileFunctionCount(&profile, "never"));
+
+    options.profileGenerate = false;
+    options.profile = &profile;
+    ASSERT_EQ(1, buildProfiled(&options, &image));
+    freeProfile(&profile);
+    ASSERT_EQ(-1, findSection(&image, "cpy_prof"));
+    int cold = findSection(&image, ".text.unlikely");
+    ASSERT_EQ(1, cold > 0);
+    ASSERT_EQ(cold, read16(findSymbol(&image, "never") + 6));
+    ASSERT_EQ(findSection(&image, ".text"), read16(findSymbol(&image, "hop") + 6));
+    ASSERT_EQ(0, (int)read64(findSymbol(&image, "square") + 8)); // Hottest first, ties in source order
+    free(image.data);
+
+    status = system("cc -O2 -I " CPY_RUNTIME_INCLUDE " -o test_codegen_pgo test_codegen_pgo_main.c "
+                    "test_codegen_pgo.o " CPY_RUNTIME_LIBRARY " && ./test_codegen_pgo test_codegen_pgo_optimized.out"
+                    " && cmp -s test_codegen_pgo_instrumented.out test_codegen_pgo_optimized.out");
+    ASSERT_EQ(1, WIFEXITED(status));
+    ASSERT_EQ(0, WEXITSTATUS(status));
+
+    remove("test_codegen_pgo.o");
+    remove("test_codegen_pgo.profile");
+    remove("test_codegen_pgo_main.c");
+    remove("test_codegen_pgo_instrumented.out");
+    remove("test_codegen_pgo_optimized.out");
+    remove("test_codegen_pgo");
+}
+
+// Isomorphic declaration pairs go to SSE2 lanes, dependent or non-int ones
+// stay scalar, and both builds compute the same values
+static const char* vectorSource =
+    "int kernel(int a, int b, int c, int d) {\n"
+    "    int x0 = a + b - 7;\n"
+    "    int x1 = c + d - 9;\n"
+    "    int y0 = x0 - c + 3;\n"   // Reads x0/x1 back from one vector store
+    "    int y1 = x1 - a + 5;\n"
+    "    int z0 = y0 + 1;\n"
+    "    int z1 = z0 + 2;\n"       // Depends on z0
+    "    int m0 = y0 * 2;\n"       // No 64-bit lane multiply in SSE2
+    "    int m1 = y1 * 3;\n"
+    "    return x0 * 1000 + x1 + y0 * 7 + y1 + z1 + m0 + m1;\n"
+    "}\n"
+    "str text(str s, str t) { str u = s + t; str v = t + s; return u + v; }\n";
+
+static unsigned long long buildVectorKernel(bool noVectorize, const char* objectPath) {
+    initLexer(vectorSource);
+    ASTNode* ast = parse();
+    CodegenOptions options = {0};
+    options.noVectorize = noVectorize;
+    ObjectFile object;
+    initObjectFile(&object);
+    compilerStats.vectorizedOperations = 0;
+    ASSERT_EQ(1, generateCode(ast, &options, &object, NULL, stderr));
+    freeAST(ast);
+    ASSERT_EQ(1, writeELFFile(&object, objectPath));
+    freeObjectFile(&object);
+    return compilerStats.vectorizedOperations;
+}
+
+void test_vectorized_pairs_match_scalar() {
+    if (system("cc --version > /dev/null 2>&1") != 0) {
+        printf("No system C compiler; skipping link test.\n");
+        return;
+    }
+
+    // x and y pairs: two operations each, in two lanes
+    ASSERT_EQ(8, (int)buildVectorKernel(false, "test_codegen_vector.o"));
+    ASSERT_EQ(0, (int)buildVectorKernel(true, "test_codegen_scalar.o"));
+
+    FILE* harness = fopen("test_codegen_vector_main.c", "w");
+    fputs("#include <stdio.h>\n"
+          "long kernel(long, long, long, long);\n"
+          "int main(void) {\n"
+          "    long total = 0;\n"
+          "    for (long i = -500; i < 500; i++) total = total * 31 + kernel(i, i * 7, -i, 3 * i + 1);\n"
+          "    printf(\"%ld\\n\", total);\n"
+          "    return 0;\n"
+          "}\n", harness);
+    fclose(harness);
+
+    int status = system("cc -o test_codegen_vector test_codegen_vector_main.c test_codegen_vector.o "
+                        CPY_RUNTIME_LIBRARY " && "
+                        "cc -o test_codegen_scalar test_codegen_vector_main.c test_codegen_scalar.o "
+                        CPY_RUNTIME_LIBRARY " && "
+                        "./test_codegen_vector > test_codegen_vector.out && "
+                        "./test_codegen_scalar > test_codegen_scalar.out && "
+                        "cmp -s test_codegen_vector.out test_codegen_scalar.out");
+    ASSERT_EQ(1, WIFEXITED(status));
+    ASSERT_EQ(0, WEXITSTATUS(status));
+
+    remove("test_codegen_vector.o");
+    remove("test_codegen_scalar.o");
+    remove("test_codegen_vector_main.c");
+    remove("test_codegen_vector");
+    remove("test_codegen_scalar");
+    remove("test_codegen_vector.out");
+    remove("test_codegen_scalar.out");
+}
+#endif
+
+int main() {
+    RUN_TEST(test_elf_header_and_symbols);
+    RUN_TEST(test_external_call_is_undefined);
+    RUN_TEST(test_string_literals_are_pooled);
+    RUN_TEST(test_string_type_errors);
+    RUN_TEST(test_reports_errors);
+#ifndef _WIN32
+    RUN_TEST(test_links_and_runs);
+    RUN_TEST(test_strings_link_with_runtime);
+    RUN_TEST(test_non_escaping_strings_use_region);
+    RUN_TEST(test_tail_calls_run_in_constant_stack);
+    RUN_TEST(test_profile_guided_build);
+    RUN_TEST(test_vectorized_pairs_match_scalar);
+#endif
+    printf("All codegen tests passed.\n");
+    return 0;
+}
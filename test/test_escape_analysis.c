@@ -0,0 +1,90 @@
+#include <string.h>
+#include "test_framework.h"
+#include "lexer.h"
+#include "parser.h"
+#include "ast.h"
+#include "escape_analysis.h"
+
+// Only `len` reads its arguments without keeping them
+static bool lenOnly(const ASTNode* call, void* context) {
+    (void)context;
+    return strcmp(call->data.callExpr.callee, "len") == 0;
+}
+
+static ASTNode* parseFunction(const char* source, ASTNode** ast) {
+    initLexer(source);
+    *ast = parse();
+    ASTNode* function = (*ast)->data.block.declarations;
+    analyzeFunctionEscapes(function, lenOnly, NULL);
+    return function;
+}
+
+// The n-th statement of the function body
+static ASTNode* statement(ASTNode* function, int n) {
+    ASTNode* node = function->data.funcDecl.body->data.block.declarations;
+    while (n-- > 0) node = node->next;
+    return node;
+}
+
+void test_returned_value_escapes() {
+    ASTNode* ast;
+    ASTNode* f = parseFunction("str f(str a) { return a + \"x\" + \"y\"; }", &ast);
+    ASTNode* value = statement(f, 0)->data.returnStmt.value;
+    ASSERT_EQ(false, value->noEscape);
+    // The intermediate a + "x" is only an operand
+    ASSERT_EQ(true, value->data.binaryExpr.left->noEscape);
+    freeAST(ast);
+}
+
+void test_read_only_arguments_do_not_escape() {
+    ASTNode* ast;
+    ASTNode* f = parseFunction("int f(str a) { len(a + a); keep(a + a); return 0; }", &ast);
+    ASSERT_EQ(true, statement(f, 0)->data.exprStmt.expression->data.callExpr.arguments->noEscape);
+    ASSERT_EQ(false, statement(f, 1)->data.exprStmt.expression->data.callExpr.arguments->noEscape);
+    freeAST(ast);
+}
+
+void test_locals_propagate() {
+    ASTNode* ast;
+    ASTNode* f = parseFunction(
+        "str f(str a) {\n"
+        "    str t = a + a;\n"      // Dies: only measured
+        "    str u = a + \"u\";\n"  // Escapes through v
+        "    str v = u;\n"
+        "    len(t);\n"
+        "    return v;\n"
+        "}", &ast);
+    ASSERT_EQ(true, statement(f, 0)->data.varDecl.initializer->noEscape);
+    ASSERT_EQ(false, statement(f, 1)->data.varDecl.initializer->noEscape);
+    freeAST(ast);
+}
+
+void test_discarded_and_nested_blocks() {
+    ASTNode* ast;
+    ASTNode* f = parseFunction("int f(str a) { a + a; { str b = a + a; keep(b); } return 0; }", &ast);
+    ASSERT_EQ(true, statement(f, 0)->data.exprStmt.expression->noEscape);
+    ASTNode* inner = statement(f, 1)->data.block.declarations;
+    ASSERT_EQ(false, inner->data.varDecl.initializer->noEscape);
+    freeAST(ast);
+}
+
+void test_module_globals_escape() {
+    initLexer("str g = \"a\" + h; { str t = g + g; len(t); } int f() { return 0; }");
+    ASTNode* ast = parse();
+    analyzeModuleEscapes(ast, lenOnly, NULL);
+    ASTNode* global = ast->data.block.declarations;
+    ASSERT_EQ(false, global->data.varDecl.initializer->noEscape);
+    ASTNode* local = global->next->data.block.declarations;
+    ASSERT_EQ(true, local->data.varDecl.initializer->noEscape);
+    freeAST(ast);
+}
+
+int main() {
+    RUN_TEST(test_returned_value_escapes);
+    RUN_TEST(test_read_only_arguments_do_not_escape);
+    RUN_TEST(test_locals_propagate);
+    RUN_TEST(test_discarded_and_nested_blocks);
+    RUN_TEST(test_module_globals_escape);
+    printf("All escape analysis tests passed.\n");
+    return 0;
+}
@@ -0,0 +1,210 @@
+#include <stdarg.h>
+#include <string.h>
+#include "test_framework.h"
+#include "lexer.h"
+#include "parser.h"
+#include "ast.h"
+#include "ast_serialize.h"
+#include "semantic_analysis.h"
+#include "incremental.h"
+
+static const char* program = "int base = 40;\n"
+                             "int twice(int x) { return x * 2; }\n"
+                             "str label(str s) { return \"<\" + s + \">\"; }\n"
+                             "int more = base + 1;\n"
+                             "int thrice(int x) {\n    int y = x + x;\n    return y + x;\n}\n"
+                             "twice(more);\n";
+
+static char fullDiagnostics[4096];
+
+static void collectError(const char* format, va_list args) {
+    size_t used = strlen(fullDiagnostics);
+    if (used > 0) fullDiagnostics[used++] = '\n';
+    vsnprintf(fullDiagnostics + used, sizeof(fullDiagnostics) - used, format, args);
+}
+
+static void joinDiagnostics(const Document* document, char* buffer, size_t size) {
+    Diagnostic diagnostics[64];
+    size_t count = documentDiagnostics(document, diagnostics, 64);
+    buffer[0] = '\0';
+    for (size_t i = 0; i < count && i < 64; i++) {
+        size_t used = strlen(buffer);
+        snprintf(buffer + used, size - used, "%s%s", i > 0 ? "\n" : "", diagnostics[i].message);
+    }
+}
+
+static int sameTree(const ASTNode* a, const ASTNode* b) {
+    ASTBuffer left = {0}, right = {0};
+    serializeAST(a, &left, stderr);
+    serializeAST(b, &right, stderr);
+    int same = left.size == right.size && memcmp(left.data, right.data, left.size) == 0;
+    freeASTBuffer(&left);
+    freeASTBuffer(&right);
+    return same;
+}
+
+// The document must agree with parsing and analysing its text from scratch
+static void checkAgainstFullParse(const Document* document) {
+    const char* text = documentText(document, NULL);
+    FILE* sink = tmpfile();
+    setParseErrorStream(sink);
+    initLexer(text);
+    ASTNode* ast = tryParse();
+    setParseErrorStream(NULL);
+    fclose(sink);
+    if (!ast) {
+        ASSERT_EQ(1, documentAST(document) == NULL);
+        ASSERT_EQ(1, documentDiagnostics(document, NULL, 0) > 0);
+        return;
+    }
+    ASSERT_EQ(1, documentAST(document) != NULL);
+    ASSERT_EQ(1, sameTree(ast, documentAST(document)));
+
+    fullDiagnostics[0] = '\0';
+    setErrorFunction(collectError);
+    analyzeProgram(ast);
+    setErrorFunction(NULL);
+    char diagnostics[4096];
+    joinDiagnostics(document, diagnostics, sizeof(diagnostics));
+    ASSERT_STR_EQ(fullDiagnostics, diagnostics);
+    freeAST(ast);
+}
+
+static const ASTNode* topLevel(const Document* document, int index) {
+    const ASTNode* node = documentAST(document)->data.block.declarations;
+    while (index-- > 0) node = node->next;
+    return node;
+}
+
+static size_t offsetOf(const Document* document, const char* needle) {
+    const char* text = documentText(document, NULL);
+    return (size_t)(strstr(text, needle) - text);
+}
+
+static void replace(Document* document, const char* needle, const char* text) {
+    ASSERT_EQ(1, editDocument(document, offsetOf(document, needle), strlen(needle), text, strlen(text)));
+}
+
+void test_reuses_untouched_functions() {
+    Document* document = openDocument(program, strlen(program));
+    checkAgainstFullParse(document);
+    const ASTNode* twice = topLevel(document, 1);
+    const ASTNode* label = topLevel(document, 2);
+    const ASTNode* thrice = topLevel(document, 4);
+
+    replace(document, "x * 2", "x * 3 + 1");
+    checkAgainstFullParse(document);
+    ASSERT_EQ(1, topLevel(document, 1) != twice);
+    ASSERT_EQ(1, topLevel(document, 2) == label);
+    ASSERT_EQ(1, topLevel(document, 4) == thrice);
+
+    // Inserting a declaration between two others leaves both alone
+    label = topLevel(document, 2);
+    const ASTNode* more = topLevel(document, 3);
+    ASSERT_EQ(1, editDocument(document, offsetOf(document, "int more"), 0, "int extra() { return 0; }\n", 26));
+    checkAgainstFullParse(document);
+    ASSERT_EQ(1, topLevel(document, 2) == label);
+    ASSERT_EQ(1, topLevel(document, 4) == more);
+    ASSERT_EQ(1, topLevel(document, 5) == thrice);
+    closeDocument(document);
+}
+
+void test_updates_diagnostics() {
+    Document* document = openDocument(program, strlen(program));
+    replace(document, "int more = base + 1;", "int more = missing + 1;");
+    checkAgainstFullParse(document);
+    Diagnostic diagnostics[4];
+    ASSERT_EQ(1, (int)documentDiagnostics(document, diagnostics, 4));
+    ASSERT_STR_EQ("Error: Undeclared identifier 'missing'.", diagnostics[0].message);
+    ASSERT_EQ(offsetOf(document, "int more"), diagnostics[0].offset);
+
+    // Declaring it earlier fixes the later global
+    ASSERT_EQ(1, editDocument(document, 0, 0, "int missing = 2;\n", 17));
+    checkAgainstFullParse(document);
+    ASSERT_EQ(0, (int)documentDiagnostics(document, NULL, 0));
+
+    replace(document, "int base", "int missing");
+    checkAgainstFullParse(document);
+    ASSERT_EQ(1, (int)documentDiagnostics(document, diagnostics, 4));
+    ASSERT_STR_EQ("Error: Variable 'missing' already declared.", diagnostics[0].message);
+    closeDocument(document);
+}
+
+void test_recovers_from_syntax_errors() {
+    Document* document = openDocument(program, strlen(program));
+    replace(document, "x * 2;", "x * 2");
+    checkAgainstFullParse(document);
+    ASSERT_EQ(1, documentAST(document) == NULL);
+    Diagnostic diagnostics[4];
+    ASSERT_EQ(1, (int)documentDiagnostics(document, diagnostics, 4));
+    ASSERT_EQ(0, strncmp("Error: Expect ';'", diagnostics[0].message, 17));
+
+    // Edits elsewhere keep the error, and fixing it restores the program
+    replace(document, "base + 1", "base + 2");
+    checkAgainstFullParse(document);
+    replace(document, "x * 2", "x * 2;");
+    checkAgainstFullParse(document);
+    ASSERT_EQ(1, documentAST(document) != NULL);
+
+    // An unterminated string swallows the rest of the text
+    replace(document, "\"<\"", "\"<");
+    checkAgainstFullParse(document);
+    replace(document, "\"<", "\"<\"");
+    checkAgainstFullParse(document);
+    ASSERT_EQ(0, (int)documentDiagnostics(document, NULL, 0));
+    closeDocument(document);
+}
+
+static unsigned nextRandom(unsigned* state) {
+    *state = *state * 1103515245u + 12345u;
+    return (*state >> 16) & 0x7fff;
+}
+
+// Random edits, each checked and then undone, must always agree with a
+// full parse
+void test_random_edits_match_full_parse() {
+    static const char* pieces[] = {"x", "1", " ", "\n", ";", "{", "}", "+", "int ", "y = 2;", "(", ")",
+                                   "\"", "// ", "int f() { return 1; }", ",", "z"};
+    Document* document = openDocument(program, strlen(program));
+    unsigned state = 7;
+    for (int i = 0; i < 2000; i++) {
+        size_t length;
+        const char* text = documentText(document, &length);
+        size_t offset = nextRandom(&state) % (length + 1);
+        size_t removed = nextRandom(&state) % 4;
+        if (removed > length - offset) removed = length - offset;
+        const char* piece = nextRandom(&state) % 3 == 0 ? "" : pieces[nextRandom(&state) % 17];
+        char saved[8];
+        memcpy(saved, text + offset, removed);
+
+        ASSERT_EQ(1, editDocument(document, offset, removed, piece, strlen(piece)));
+        checkAgainstFullParse(document);
+        ASSERT_EQ(1, editDocument(document, offset, strlen(piece), saved, removed));
+        checkAgainstFullParse(document);
+        ASSERT_EQ(1, documentAST(document) != NULL);
+    }
+    ASSERT_STR_EQ(program, documentText(document, NULL));
+    ASSERT_EQ(0, editDocument(document, strlen(program), 1, "", 0));
+
+    // Edits piling up on a document that mostly does not parse
+    for (int i = 0; i < 1000; i++) {
+        size_t length;
+        documentText(document, &length);
+        size_t offset = nextRandom(&state) % (length + 1);
+        size_t removed = nextRandom(&state) % 3;
+        if (removed > length - offset) removed = length - offset;
+        const char* piece = pieces[nextRandom(&state) % 17];
+        ASSERT_EQ(1, editDocument(document, offset, removed, piece, strlen(piece)));
+        checkAgainstFullParse(document);
+    }
+    closeDocument(document);
+}
+
+int main() {
+    RUN_TEST(test_reuses_untouched_functions);
+    RUN_TEST(test_updates_diagnostics);
+    RUN_TEST(test_recovers_from_syntax_errors);
+    RUN_TEST(test_random_edits_match_full_parse);
+    printf("All incremental tests passed.\n");
+    return 0;
+}
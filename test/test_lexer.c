@@ -3,7 +3,7 @@
 #include "lexer.h"
 
 void printToken(Token token) {
-    printf("Token: Type=%d, Lexeme=%.*s, Line=%d\n", token.type, token.length, token.start, token.line);
+    printf("Token: Type=%d, Lexeme=%.*s, Line=%d\n", token.type, token.length, tokenStart(token), token.line);
 }
 
 void runTests() {
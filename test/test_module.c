@@ -0,0 +1,224 @@
+#include <stdarg.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "test_framework.h"
+#include "lexer.h"
+#include "parser.h"
+#include "ast.h"
+#include "semantic_analysis.h"
+#include "module.h"
+#include "build.h"
+
+static const char* interfacePath = "test_module_math.cpyi";
+static const char* buildDirectory = "test_module_build";
+
+static const char* mathSource = "int base = 40;\n"
+                                "int twice(int x) { return x * 2; }\n"
+                                "str label(str s, int n) { return \"<\" + s + \">\"; }\n";
+
+static ASTNode* parseSource(const char* source) {
+    initLexer(source);
+    return parse();
+}
+
+static void writeFile(const char* path, const char* contents) {
+    FILE* file = fopen(path, "w");
+    fputs(contents, file);
+    fclose(file);
+}
+
+static uint64_t interfaceHash(const char* source, const char* name) {
+    ASTNode* ast = parseSource(source);
+    ASSERT_EQ(1, writeModuleInterface(ast, name, NULL, 0, interfacePath));
+    freeAST(ast);
+    ModuleInterface module;
+    ASSERT_EQ(1, mapModuleInterface(interfacePath, &module));
+    uint64_t hash = module.hash;
+    closeModuleInterface(&module);
+    return hash;
+}
+
+void test_parses_imports() {
+    ASTNode* ast = parseSource("import math; int important = 1;");
+    ASTNode* first = ast->data.block.declarations;
+    ASSERT_EQ(AST_IMPORT, first->type);
+    ASSERT_STR_EQ("math", first->data.import.module);
+    ASSERT_EQ(AST_VAR_DECL, first->next->type);
+    ASSERT_STR_EQ("important", first->next->data.varDecl.name);
+    freeAST(ast);
+}
+
+void test_interface_lists_signatures() {
+    ASTNode* ast = parseSource(mathSource);
+    ModuleStamp stamp = {123, 456};
+    ASSERT_EQ(1, writeModuleInterface(ast, "math", &stamp, 0, interfacePath));
+    freeAST(ast);
+
+    ModuleInterface module;
+    ASSERT_EQ(1, mapModuleInterface(interfacePath, &module));
+    ASSERT_STR_EQ("math", module.name);
+    ASSERT_EQ(123, (int)module.source.size);
+    ASSERT_EQ(456, (int)module.source.modified);
+    ASSERT_EQ(3, (int)module.exportCount);
+    ModuleExport global = moduleExport(&module, 0);
+    ASSERT_EQ(EXPORT_GLOBAL, global.kind);
+    ASSERT_STR_EQ("base", global.name);
+    ASSERT_STR_EQ("int", global.type);
+    ModuleExport label = moduleExport(&module, 2);
+    ASSERT_EQ(EXPORT_FUNCTION, label.kind);
+    ASSERT_STR_EQ("label", label.name);
+    ASSERT_STR_EQ("str", label.type);
+    ASSERT_STR_EQ("str,int", label.params);
+    // `base` needs initializing
+    ASSERT_EQ(1, (int)module.initCount);
+    ASSERT_STR_EQ("cpy_init_math", moduleInit(&module, 0));
+    closeModuleInterface(&module);
+    remove(interfacePath);
+}
+
+// Importers depend on signatures only, not on bodies
+void test_hash_covers_signatures_only() {
+    uint64_t hash = interfaceHash(mathSource, "math");
+    ASSERT_EQ(1, hash == interfaceHash("int base = 1 + 2;\n"
+                                       "int twice(int x) { return x + x; }\n"
+                                       "str label(str s, int n) { return s; }\n", "math"));
+    ASSERT_EQ(0, hash == interfaceHash("int base = 40;\n"
+                                       "int twice(int x) { return x * 2; }\n"
+                                       "str label(str s, str n) { return s; }\n", "math"));
+    remove(interfacePath);
+}
+
+static char lastError[256];
+
+static void captureError(const char* format, va_list args) {
+    vsnprintf(lastError, sizeof(lastError), format, args);
+}
+
+void test_analysis_reads_interfaces() {
+    ASTNode* math = parseSource(mathSource);
+    ASSERT_EQ(1, writeModuleInterface(math, "math", NULL, 0, "math.cpyi"));
+    freeAST(math);
+
+    setErrorFunction(captureError);
+    setModuleSearchPath("does_not_exist:.");
+    lastError[0] = '\0';
+    ASTNode* ast = parseSource("import math; int y = base;");
+    analyzeProgram(ast);
+    ASSERT_STR_EQ("", lastError);
+    freeAST(ast);
+
+    ast = parseSource("import geometry; int y = 1;");
+    analyzeProgram(ast);
+    ASSERT_STR_EQ("Error: No interface for module 'geometry' (compile geometry.cpy first).", lastError);
+    freeAST(ast);
+    unloadModules();
+    setErrorFunction(NULL);
+    remove("math.cpyi");
+}
+
+static void writeModule(const char* name, const char* contents) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/src/%s.cpy", buildDirectory, name);
+    writeFile(path, contents);
+}
+
+static BuildSummary build(int jobs) {
+    char entry[256], output[256];
+    snprintf(entry, sizeof(entry), "%s/src/app.cpy", buildDirectory);
+    snprintf(output, sizeof(output), "%s/out", buildDirectory);
+    BuildOptions options = {entry, output, jobs, {0}};
+    BuildSummary summary;
+    FILE* out = fopen("/dev/null", "w");
+    ASSERT_EQ(0, runBuild(&options, &summary, out, stderr));
+    fclose(out);
+    return summary;
+}
+
+#ifndef _WIN32
+void test_builds_module_graph() {
+    char command[512];
+    snprintf(command, sizeof(command), "rm -rf %s && mkdir -p %s/src", buildDirectory, buildDirectory);
+    ASSERT_EQ(0, system(command));
+    // app imports util and math, util imports math
+    writeModule("math", mathSource);
+    writeModule("util", "import math;\nint offset = base + 1;\nint bump(int x) { return twice(x) + offset; }\n");
+    writeModule("app", "import util;\nimport math;\nint result = bump(base);\n"
+                       "int answer() { return result + len(label(\"abc\", 0)); }\n");
+
+    BuildSummary summary = build(2);
+    ASSERT_EQ(3, summary.modules);
+    ASSERT_EQ(3, summary.compiled);
+    summary = build(2);
+    ASSERT_EQ(0, summary.compiled);
+    ASSERT_EQ(3, summary.upToDate);
+
+    // A new body with the same signatures recompiles math alone
+    writeModule("math", "int base = 40;\n"
+                        "int twice(int x) { return x + x + 0; }\n"
+                        "str label(str s, int n) { return \"<\" + s + \">\"; }\n");
+    summary = build(1);
+    ASSERT_EQ(1, summary.compiled);
+    ASSERT_EQ(2, summary.upToDate);
+
+    // A new export reaches both importers
+    writeModule("math", "int base = 40;\n"
+                        "int twice(int x) { return x * 2; }\n"
+                        "str label(str s, int n) { return \"<\" + s + \">\"; }\n"
+                        "int unused() { return 0; }\n");
+    summary = build(0);
+    ASSERT_EQ(3, summary.compiled);
+
+    if (system("cc --version > /dev/null 2>&1") != 0) {
+        printf("No system C compiler; skipping link test.\n");
+        return;
+    }
+    snprintf(command, sizeof(command), "%s/main.c", buildDirectory);
+    writeFile(command, "long cpy_init(void); long answer(void);\n"
+                       "int main(void) { cpy_init(); return answer() == 80 + 41 + 5 ? 0 : 1; }\n");
+    snprintf(command, sizeof(command), "cd %s && cc -o program main.c out/*.o " CPY_RUNTIME_LIBRARY " && ./program",
+             buildDirectory);
+    int status = system(command);
+    ASSERT_EQ(1, WIFEXITED(status));
+    ASSERT_EQ(0, WEXITSTATUS(status));
+
+    snprintf(command, sizeof(command), "rm -rf %s", buildDirectory);
+    system(command);
+}
+
+void test_reports_import_cycles() {
+    char command[512];
+    snprintf(command, sizeof(command), "rm -rf %s && mkdir -p %s/src", buildDirectory, buildDirectory);
+    ASSERT_EQ(0, system(command));
+    writeModule("app", "import a;\nint x = 1;\n");
+    writeModule("a", "import b;\n");
+    writeModule("b", "import a;\n");
+
+    char entry[256];
+    snprintf(entry, sizeof(entry), "%s/src/app.cpy", buildDirectory);
+    BuildOptions options = {entry, buildDirectory, 1, {0}};
+    FILE* err = tmpfile();
+    ASSERT_EQ(1, runBuild(&options, NULL, stdout, err));
+    rewind(err);
+    char message[256] = "";
+    fgets(message, sizeof(message), err);
+    fclose(err);
+    ASSERT_EQ(0, strncmp("Error: Import cycle", message, 19));
+
+    snprintf(command, sizeof(command), "rm -rf %s", buildDirectory);
+    system(command);
+}
+#endif
+
+int main() {
+    RUN_TEST(test_parses_imports);
+    RUN_TEST(test_interface_lists_signatures);
+    RUN_TEST(test_hash_covers_signatures_only);
+    RUN_TEST(test_analysis_reads_interfaces);
+#ifndef _WIN32
+    RUN_TEST(test_builds_module_graph);
+    RUN_TEST(test_reports_import_cycles);
+#endif
+    printf("All module tests passed.\n");
+    return 0;
+}
@@ -0,0 +1,156 @@
+#include <string.h>
+#include "test_framework.h"
+#include "lexer.h"
+#include "parser.h"
+#include "ast.h"
+#include "optimizer.h"
+
+// Initializer of the first declaration in `source`, after folding
+static ASTNode* foldInitializer(const char* source, int expectedFolds, ASTNode** ast) {
+    initLexer(source);
+    *ast = parse();
+    ASSERT_EQ(expectedFolds, foldStringConstants(*ast));
+    return (*ast)->data.block.declarations->data.varDecl.initializer;
+}
+
+void test_folds_literal_concatenation() {
+    ASTNode* ast;
+    ASTNode* value = foldInitializer("str s = \"ab\" + \"c\" + \"\" + \"d\";", 3, &ast);
+    ASSERT_EQ(AST_LITERAL, value->type);
+    ASSERT_STR_EQ("\"abcd\"", value->data.literal.value);
+    freeAST(ast);
+}
+
+void test_reassociates_after_variable() {
+    // (x + "a") + "b"  ->  x + "ab"
+    ASTNode* ast;
+    ASTNode* value = foldInitializer("str s = x + \"a\" + \"b\";", 1, &ast);
+    ASSERT_EQ(AST_BINARY_EXPR, value->type);
+    ASSERT_EQ(AST_IDENTIFIER, value->data.binaryExpr.left->type);
+    ASSERT_STR_EQ("\"ab\"", value->data.binaryExpr.right->data.literal.value);
+    freeAST(ast);
+}
+
+void test_leaves_other_expressions() {
+    ASTNode* ast;
+    ASTNode* value = foldInitializer("int n = 1 + 2;", 0, &ast);
+    ASSERT_EQ(AST_BINARY_EXPR, value->type);
+    freeAST(ast);
+
+    // Folding "a" + x would need the right operand to be constant
+    value = foldInitializer("str s = \"a\" + x + y;", 0, &ast);
+    ASSERT_EQ(AST_BINARY_EXPR, value->type);
+    freeAST(ast);
+}
+
+void test_folds_inside_functions() {
+    initLexer("str f(str x) { return x + \"-\" + \"-\"; } str g() { return \"a\" + \"b\"; }");
+    ASTNode* ast = parse();
+    ASSERT_EQ(2, foldStringConstants(ast));
+    ASTNode* g = ast->data.block.declarations->next;
+    ASTNode* returned = g->data.funcDecl.body->data.block.declarations->data.returnStmt.value;
+    ASSERT_STR_EQ("\"ab\"", returned->data.literal.value);
+    freeAST(ast);
+}
+
+// Returned value of the function declared last in `source`, after evaluation
+static ASTNode* evaluateLast(const char* source, int expectedCalls, long fuel, ASTNode** ast) {
+    initLexer(source);
+    *ast = parse();
+    ASSERT_EQ(expectedCalls, evaluateConstantCalls(*ast, fuel));
+    ASTNode* last = (*ast)->data.block.declarations;
+    while (last->next) last = last->next;
+    ASTNode* statement = last->data.funcDecl.body->data.block.declarations;
+    while (statement->next) statement = statement->next;
+    return statement->data.returnStmt.value;
+}
+
+void test_evaluates_pure_calls() {
+    ASTNode* ast;
+    ASTNode* value = evaluateLast("int add(int a, int b) { return a + b; }"
+                                  "int main() { return add(1, 2) * 10; }",
+                                  1, CONSTANT_CALL_FUEL, &ast);
+    ASSERT_EQ(AST_BINARY_EXPR, value->type);
+    ASSERT_STR_EQ("3", value->data.binaryExpr.left->data.literal.value);
+    freeAST(ast);
+
+    // Inner calls fold first, so the outer one sees literal arguments
+    value = evaluateLast("int square(int x) { int y = x * x; return y; }"
+                         "int sub(int a, int b) { return a - b; }"
+                         "int main() { return sub(square(3), square(4)); }",
+                         3, CONSTANT_CALL_FUEL, &ast);
+    ASSERT_EQ(AST_LITERAL, value->type);
+    ASSERT_STR_EQ("-7", value->data.literal.value);
+    freeAST(ast);
+
+    // str values and builtins
+    value = evaluateLast("str twice(str s) { return s + s; }"
+                         "int main() { return len(twice(twice(\"ab\"))) + equals(\"x\", \"x\"); }",
+                         4, CONSTANT_CALL_FUEL, &ast);
+    ASSERT_EQ(AST_BINARY_EXPR, value->type);
+    ASSERT_STR_EQ("8", value->data.binaryExpr.left->data.literal.value);
+    ASSERT_STR_EQ("1", value->data.binaryExpr.right->data.literal.value);
+    freeAST(ast);
+
+    value = evaluateLast("str greet(str name) { return \"hello, \" + name; }"
+                         "str main() { return greet(\"world\"); }",
+                         1, CONSTANT_CALL_FUEL, &ast);
+    ASSERT_STR_EQ("\"hello, world\"", value->data.literal.value);
+    freeAST(ast);
+}
+
+void test_leaves_impure_calls() {
+    ASTNode* ast;
+    // Reads a global, calls external code, or calls a function that does
+    ASTNode* value = evaluateLast("int limit = 10;"
+                                  "int capped(int x) { return x - limit; }"
+                                  "int logged(int x) { print(x); return x; }"
+                                  "int wrapper(int x) { return logged(x) + 1; }"
+                                  "int main() { return capped(1) + logged(2) + wrapper(3); }",
+                                  0, CONSTANT_CALL_FUEL, &ast);
+    ASSERT_EQ(AST_BINARY_EXPR, value->type);
+    freeAST(ast);
+
+    // Division by zero traps at run time, and a non-literal argument is unknown
+    value = evaluateLast("int divide(int a, int b) { return a / b; }"
+                         "int main(int n) { return divide(1, 0) + divide(n, 1); }",
+                         0, CONSTANT_CALL_FUEL, &ast);
+    ASSERT_EQ(AST_BINARY_EXPR, value->type);
+    freeAST(ast);
+
+    // Type errors are for the code generator to report
+    value = evaluateLast("int id(int x) { return x; } int main() { return id(\"a\"); }", 0, CONSTANT_CALL_FUEL, &ast);
+    ASSERT_EQ(AST_CALL_EXPR, value->type);
+    freeAST(ast);
+}
+
+void test_fuel_bounds_evaluation() {
+    ASTNode* ast;
+    // Unbounded recursion runs out of fuel (or depth) instead of hanging
+    ASTNode* value = evaluateLast("int forever(int n) { return forever(n + 1); }"
+                                  "int main() { return forever(0); }",
+                                  0, CONSTANT_CALL_FUEL, &ast);
+    ASSERT_EQ(AST_CALL_EXPR, value->type);
+    freeAST(ast);
+
+    const char* source = "int f(int n) { int a = n + 1; int b = a + 1; return b + 1; }"
+                         "int main() { return f(1); }";
+    value = evaluateLast(source, 0, 5, &ast);
+    ASSERT_EQ(AST_CALL_EXPR, value->type);
+    freeAST(ast);
+    value = evaluateLast(source, 1, 100, &ast);
+    ASSERT_STR_EQ("4", value->data.literal.value);
+    freeAST(ast);
+}
+
+int main() {
+    RUN_TEST(test_folds_literal_concatenation);
+    RUN_TEST(test_reassociates_after_variable);
+    RUN_TEST(test_leaves_other_expressions);
+    RUN_TEST(test_folds_inside_functions);
+    RUN_TEST(test_evaluates_pure_calls);
+    RUN_TEST(test_leaves_impure_calls);
+    RUN_TEST(test_fuel_bounds_evaluation);
+    printf("All optimizer tests passed.\n");
+    return 0;
+}
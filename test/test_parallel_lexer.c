@@ -0,0 +1,73 @@
+#include <string.h>
+#include "test_framework.h"
+#include "lexer.h"
+#include "parallel_lexer.h"
+
+// Every chunk count must give exactly the tokens of a serial scan
+static void checkAgainstSerial(const char* source, int maxChunks) {
+    size_t length = strlen(source);
+    for (int chunks = 1; chunks <= maxChunks; chunks++) {
+        TokenList list;
+        lexParallel(source, length, chunks, &list);
+        initLexer(source);
+        size_t i = 0;
+        for (;; i++) {
+            Token token = scanToken();
+            ASSERT_EQ(1, i < list.count);
+            ASSERT_EQ(token.type, list.tokens[i].type);
+            ASSERT_EQ(token.offset, list.tokens[i].offset);
+            ASSERT_EQ(token.length, list.tokens[i].length);
+            ASSERT_EQ(token.line, list.tokens[i].line);
+            if (token.type == TOKEN_EOF) break;
+        }
+        ASSERT_EQ(i + 1, list.count);
+        freeTokenList(&list);
+    }
+}
+
+void test_matches_serial_lexing() {
+    checkAgainstSerial("", 4);
+    checkAgainstSerial("\n\n\n", 4);
+    checkAgainstSerial("int x = 1;\nint y = x + 2;\n// comment\nstr s = \"a\";\nf(x,\ny);\n", 30);
+    checkAgainstSerial("int twice(int x) {\r\n    return x * 2;\r\n}\r\ntwice(4);", 30);
+}
+
+void test_strings_spanning_cuts() {
+    // Newlines inside strings, and quotes hidden in comments, make most
+    // cuts land inside a literal
+    checkAgainstSerial("str a = \"one\ntwo\nthree\nfour\";\n// \"not a string\nstr b = \"x\n\n\ny\";\nb;\n", 60);
+    checkAgainstSerial("str s = \"\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\";\nint n = 1;\n", 40);
+}
+
+void test_errors_match_serial_lexing() {
+    checkAgainstSerial("int a = 1;\nint b = @;\n#\nint c = 3;\n", 30);
+    checkAgainstSerial("int a = 1;\nstr s = \"never closed\nint b = 2;\nint c = 3;\n", 40);
+}
+
+void test_large_generated_source() {
+    static const char* lines[] = {"int v = 12 + w * 3;\n", "str t = \"a\nb\";\n", "// note \"\n",
+                                  "int f(int a, int b) { return a - b; }\n", "f(1, 2);\n", "\n"};
+    size_t capacity = 1 << 20;
+    char* source = (char*)malloc(capacity + 64);
+    size_t length = 0;
+    unsigned state = 3;
+    while (length < capacity) {
+        state = state * 1103515245u + 12345u;
+        const char* line = lines[(state >> 16) % 6];
+        size_t size = strlen(line);
+        memcpy(source + length, line, size);
+        length += size;
+    }
+    source[length] = '\0';
+    checkAgainstSerial(source, 16);
+    free(source);
+}
+
+int main() {
+    RUN_TEST(test_matches_serial_lexing);
+    RUN_TEST(test_strings_spanning_cuts);
+    RUN_TEST(test_errors_match_serial_lexing);
+    RUN_TEST(test_large_generated_source);
+    printf("All parallel lexer tests passed.\n");
+    return 0;
+}
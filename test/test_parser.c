@@ -68,17 +68,99 @@ void test_expression_statement() {
     ASSERT_EQ(AST_EXPR_STMT, decl->type);
     ASSERT_EQ(AST_BINARY_EXPR, decl->data.exprStmt.expression->type);
     ASSERT_STR_EQ("a", decl->data.exprStmt.expression->data.binaryExpr.left->data.identifier.name);
-    ASSERT_EQ(TOKEN_PLUS, decl->data.exprStmt.expression->data.binaryExpr.operator);
+    ASSERT_EQ(TOKEN_PLUS, decl->data.exprStmt.expression->operator);
     ASSERT_STR_EQ("b", decl->data.exprStmt.expression->data.binaryExpr.right->data.identifier.name);
 
     freeAST(ast);
 }
 
+void test_call_expression() {
+    const char *source = "f(a, 2, g());";
+    initLexer(source);
+    ASTNode *ast = parse();
+
+    ASTNode* call = ast->data.block.declarations->data.exprStmt.expression;
+    ASSERT_EQ(AST_CALL_EXPR, call->type);
+    ASSERT_STR_EQ("f", call->data.callExpr.callee);
+
+    ASTNode* argument = call->data.callExpr.arguments;
+    ASSERT_STR_EQ("a", argument->data.identifier.name);
+    argument = argument->next;
+    ASSERT_STR_EQ("2", argument->data.literal.value);
+    argument = argument->next;
+    ASSERT_EQ(AST_CALL_EXPR, argument->type);
+    ASSERT_EQ(NULL, argument->data.callExpr.arguments);
+    ASSERT_EQ(NULL, argument->next);
+
+    freeAST(ast);
+}
+
+void test_lazy_function_bodies() {
+    const char *source = "int add(int a, int b) {\n    int c = a + b;\n    return c;\n}\nadd(1, 2);";
+    setLazyBodies(true);
+    initLexer(source);
+    ASTNode *ast = parse();
+    setLazyBodies(false);
+
+    ASTNode* function = ast->data.block.declarations;
+    ASSERT_EQ(AST_LAZY_BODY, function->data.funcDecl.body->type);
+    ASSERT_EQ(1, function->data.funcDecl.body->data.lazyBody.line);
+    ASSERT_EQ(AST_EXPR_STMT, function->next->type);
+
+    // Expanding gives the body an eager parse would have built
+    ASSERT_EQ(1, expandFunctionBody(function));
+    ASTNode* body = function->data.funcDecl.body;
+    ASSERT_EQ(AST_BLOCK, body->type);
+    ASTNode* statement = body->data.block.declarations;
+    ASSERT_EQ(AST_VAR_DECL, statement->type);
+    ASSERT_STR_EQ("c", statement->data.varDecl.name);
+    ASSERT_EQ(AST_BINARY_EXPR, statement->data.varDecl.initializer->type);
+    ASSERT_EQ(AST_RETURN_STMT, statement->next->type);
+    ASSERT_STR_EQ("c", statement->next->data.returnStmt.value->data.identifier.name);
+    ASSERT_EQ(NULL, statement->next->next);
+
+    // A second expansion leaves the parsed body alone
+    ASSERT_EQ(1, expandFunctionBody(function));
+    ASSERT_EQ(body, function->data.funcDecl.body);
+    freeAST(ast);
+}
+
+void test_lazy_body_errors() {
+    const char *source = "int broken() { return 1 +; }\nint fine() { { return 2; } }";
+    FILE* sink = tmpfile();
+    setParseErrorStream(sink);
+    setLazyBodies(true);
+    initLexer(source);
+    ASTNode *ast = tryParse();
+    ASSERT_EQ(1, ast != NULL);
+
+    // Syntax errors in a body wait for its expansion or check; a check
+    // keeps the stubs
+    ASTNode* broken = ast->data.block.declarations;
+    ASSERT_EQ(0, checkFunctionBodies(ast));
+    ASSERT_EQ(AST_LAZY_BODY, broken->next->data.funcDecl.body->type);
+    ASSERT_EQ(1, checkFunctionBodies(broken->next));
+    ASSERT_EQ(1, expandFunctionBody(broken->next));
+    ASSERT_EQ(AST_BLOCK, broken->next->data.funcDecl.body->data.block.declarations->type);
+    ASSERT_EQ(0, expandFunctionBody(broken));
+    ASSERT_EQ(0, expandFunctionBodies(ast));
+    freeAST(ast);
+
+    // Unbalanced braces are found while skipping
+    initLexer("int open() { { return 1; }\nopen();");
+    ASSERT_EQ(NULL, tryParse());
+    setLazyBodies(false);
+    setParseErrorStream(NULL);
+    fclose(sink);
+}
 
 int main() {
     RUN_TEST(test_var_declaration);
     RUN_TEST(test_func_declaration);
     RUN_TEST(test_expression_statement);
+    RUN_TEST(test_call_expression);
+    RUN_TEST(test_lazy_function_bodies);
+    RUN_TEST(test_lazy_body_errors);
     printf("All tests passed.\n");
     return 0;
 }
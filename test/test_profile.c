@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include "test_framework.h"
+#include "profile.h"
+
+static const char* profilePath = "test_profile.profile";
+
+static void writeProfile(const char* contents) {
+    FILE* file = fopen(profilePath, "w");
+    fputs(contents, file);
+    fclose(file);
+}
+
+void test_reads_counts() {
+    writeProfile("# cpy profile\n"
+                 "function main 1\n"
+                 "function hot 5000\n"
+                 "function cold 0\n"
+                 "edge main 0 hot 5000\n"
+                 "edge hot 2 printf 12\n");
+    Profile profile;
+    initProfile(&profile);
+    ASSERT_EQ(1, loadProfile(&profile, profilePath, stderr));
+    ASSERT_EQ(5000, (int)profileFunctionCount(&profile, "hot"));
+    ASSERT_EQ(0, (int)profileFunctionCount(&profile, "cold"));
+    ASSERT_EQ(0, (int)profileFunctionCount(&profile, "missing"));
+    ASSERT_EQ(5000, (int)profileEdgeCount(&profile, "main", 0, "hot"));
+    ASSERT_EQ(12, (int)profileEdgeCount(&profile, "hot", 2, "printf"));
+    ASSERT_EQ(0, (int)profileEdgeCount(&profile, "hot", 1, "printf"));
+    ASSERT_EQ(5000, (int)profile.maxFunctionCount);
+    ASSERT_EQ(5000, (int)profile.maxEdgeCount);
+    freeProfile(&profile);
+    remove(profilePath);
+}
+
+// Runs append to the same file; their counts add up
+void test_runs_accumulate() {
+    writeProfile("# cpy profile\nfunction f 3\nedge f 0 g 2\n# cpy profile\nfunction f 4\nedge f 0 g 2\n");
+    Profile profile;
+    initProfile(&profile);
+    ASSERT_EQ(1, loadProfile(&profile, profilePath, stderr));
+    ASSERT_EQ(7, (int)profileFunctionCount(&profile, "f"));
+    ASSERT_EQ(4, (int)profileEdgeCount(&profile, "f", 0, "g"));
+    ASSERT_EQ(7, (int)profile.maxFunctionCount);
+    freeProfile(&profile);
+    remove(profilePath);
+}
+
+void test_rejects_malformed_files() {
+    Profile profile;
+    initProfile(&profile);
+    ASSERT_EQ(0, loadProfile(&profile, "test_profile_missing.profile", stderr));
+    writeProfile("function f 1\nfunction g\n");
+    ASSERT_EQ(0, loadProfile(&profile, profilePath, stderr));
+    freeProfile(&profile);
+    remove(profilePath);
+}
+
+int main() {
+    RUN_TEST(test_reads_counts);
+    RUN_TEST(test_runs_accumulate);
+    RUN_TEST(test_rejects_malformed_files);
+    printf("All profile tests passed.\n");
+    return 0;
+}
@@ -0,0 +1,178 @@
+#include <limits.h>
+#include <string.h>
+#include <threads.h>
+#include <unistd.h>
+#include "test_framework.h"
+#include "driver.h"
+#include "server.h"
+
+static const char* serverDirectory = "test_server_build";
+static char socketPath[PATH_MAX];
+
+static void writeFile(const char* path, const char* contents) {
+    FILE* file = fopen(path, "w");
+    fputs(contents, file);
+    fclose(file);
+}
+
+static int serve(void* arg) {
+    (void)arg;
+    return runDaemon(socketPath, 2);
+}
+
+// Path of a file in the test directory
+static const char* testPath(char* buffer, const char* name) {
+    snprintf(buffer, PATH_MAX, "%s/%s", serverDirectory, name);
+    return buffer;
+}
+
+static DaemonResponse compile(const char* path, unsigned flags, const char* const* options) {
+    DaemonResponse response;
+    ASSERT_EQ(1, daemonRequest(socketPath, REQUEST_COMPILE, flags, path, options, &response));
+    return response;
+}
+
+// Both streams come back, and a repeated request is answered the same
+static void checkCompile(const char* path) {
+    for (int i = 0; i < 2; i++) {
+        DaemonResponse response = compile(path, 0, NULL);
+        ASSERT_EQ(0, response.exitCode);
+        ASSERT_STR_EQ("Block\n  VarDecl: int x = \n    BinaryExpr: +\n      Literal: 1\n      Literal: 2\n",
+                      response.out);
+        ASSERT_EQ((size_t)0, response.errLength);
+        freeDaemonResponse(&response);
+    }
+}
+
+// --check reports semantic errors through the exit code and prints no dump
+static void checkDiagnostics(const char* path) {
+    DaemonResponse response = compile(path, REQUEST_FLAG_CHECK, NULL);
+    ASSERT_EQ(1, response.exitCode);
+    ASSERT_EQ((size_t)0, response.outLength);
+    ASSERT_EQ(1, strstr(response.err, "Undeclared identifier 'z'") != NULL);
+    freeDaemonResponse(&response);
+}
+
+// The object matches a local compilation, also when it comes from the cache
+static void checkObject(const char* path) {
+    char object[PATH_MAX], assembly[PATH_MAX], reference[PATH_MAX];
+    testPath(object, "x.o");
+    testPath(assembly, "x.s");
+    testPath(reference, "reference.o");
+    CompileOptions local = {0};
+    local.emitObjectPath = reference;
+    char* text = readSourceFile(path, NULL);
+    ASSERT_EQ(0, compileSource(text, &local, NULL, stderr));
+    free(text);
+    size_t expectedLength;
+    char* expected = readSourceFile(reference, &expectedLength);
+
+    const char* options[REQUEST_OPTION_COUNT] = {NULL};
+    options[REQUEST_OPTION_EMIT_OBJECT] = object;
+    for (int i = 0; i < 2; i++) {
+        remove(object);
+        DaemonResponse response = compile(path, 0, options);
+        ASSERT_EQ(0, response.exitCode);
+        freeDaemonResponse(&response);
+        size_t actualLength;
+        char* actual = readSourceFile(object, &actualLength);
+        ASSERT_EQ(1, actual != NULL);
+        ASSERT_EQ(expectedLength, actualLength);
+        ASSERT_EQ(0, memcmp(expected, actual, expectedLength));
+        free(actual);
+    }
+    free(expected);
+
+    // Uncached options reach the compilation too
+    options[REQUEST_OPTION_EMIT_OBJECT] = NULL;
+    options[REQUEST_OPTION_EMIT_ASSEMBLY] = assembly;
+    DaemonResponse response = compile(path, 0, options);
+    ASSERT_EQ(0, response.exitCode);
+    freeDaemonResponse(&response);
+    ASSERT_EQ(0, access(assembly, F_OK));
+}
+
+static void buildInterface(const char* source) {
+    char path[PATH_MAX], interface[PATH_MAX];
+    writeFile(testPath(path, "math.cpy"), source);
+    const char* options[REQUEST_OPTION_COUNT] = {NULL};
+    options[REQUEST_OPTION_EMIT_INTERFACE] = testPath(interface, "math.cpyi");
+    options[REQUEST_OPTION_MODULE_NAME] = "math";
+    options[REQUEST_OPTION_MODULE_PATH] = serverDirectory;
+    DaemonResponse response = compile(path, REQUEST_FLAG_CHECK, options);
+    ASSERT_EQ(0, response.exitCode);
+    freeDaemonResponse(&response);
+}
+
+// A cached result is dropped once an interface it imported changes
+static void checkStaleImports() {
+    char path[PATH_MAX];
+    writeFile(testPath(path, "main.cpy"), "import math;\nint v = base;\n");
+    const char* options[REQUEST_OPTION_COUNT] = {NULL};
+    options[REQUEST_OPTION_MODULE_PATH] = serverDirectory;
+
+    buildInterface("int base = 40;\n");
+    for (int i = 0; i < 2; i++) {
+        DaemonResponse response = compile(path, REQUEST_FLAG_CHECK, options);
+        ASSERT_EQ(0, response.exitCode);
+        freeDaemonResponse(&response);
+    }
+
+    buildInterface("int other = 40;\n");
+    DaemonResponse response = compile(path, REQUEST_FLAG_CHECK, options);
+    ASSERT_EQ(1, response.exitCode);
+    ASSERT_EQ(1, strstr(response.err, "Undeclared identifier 'base'") != NULL);
+    freeDaemonResponse(&response);
+
+    buildInterface("int base = 41;\n");
+    response = compile(path, REQUEST_FLAG_CHECK, options);
+    ASSERT_EQ(0, response.exitCode);
+    freeDaemonResponse(&response);
+}
+
+void test_daemon_requests() {
+    char command[512];
+    snprintf(command, sizeof(command), "rm -rf %s && mkdir -p %s", serverDirectory, serverDirectory);
+    ASSERT_EQ(0, system(command));
+    testPath(socketPath, "daemon.sock");
+
+    thrd_t thread;
+    ASSERT_EQ(thrd_success, thrd_create(&thread, serve, NULL));
+    DaemonResponse response;
+    bool up = false;
+    for (int i = 0; i < 500 && !up; i++) {
+        up = daemonRequest(socketPath, REQUEST_PING, 0, NULL, NULL, &response);
+        if (up) freeDaemonResponse(&response);
+        else usleep(10000);
+    }
+    ASSERT_EQ(1, up);
+
+    char path[PATH_MAX];
+    writeFile(testPath(path, "sum.cpy"), "int x = 1 + 2;\n");
+    checkCompile(path);
+    checkObject(path);
+    writeFile(testPath(path, "undeclared.cpy"), "int y = z;\n");
+    checkDiagnostics(path);
+    checkStaleImports();
+
+    // Unreadable sources are reported, not fatal
+    response = compile(testPath(path, "missing.cpy"), 0, NULL);
+    ASSERT_EQ(1, response.exitCode);
+    freeDaemonResponse(&response);
+
+    ASSERT_EQ(1, daemonRequest(socketPath, REQUEST_SHUTDOWN, 0, NULL, NULL, &response));
+    freeDaemonResponse(&response);
+    int result;
+    thrd_join(thread, &result);
+    ASSERT_EQ(0, result);
+    ASSERT_EQ(0, daemonRequest(socketPath, REQUEST_PING, 0, NULL, NULL, &response));
+
+    snprintf(command, sizeof(command), "rm -rf %s", serverDirectory);
+    system(command);
+}
+
+int main() {
+    RUN_TEST(test_daemon_requests);
+    printf("All server tests passed.\n");
+    return 0;
+}